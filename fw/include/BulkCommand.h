@@ -0,0 +1,112 @@
+#ifndef BULK_COMMAND_H
+#define BULK_COMMAND_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "RS485Bus.h"
+#include "BusRouting.h"
+
+#define BULK_FRAME_TYPE          23       // S_CUSTOM
+#define BULK_MAX_ID              254
+#define BULK_MAP_WORDS           8        // Bitmapa ID-eva 0..255
+#define BULK_FRAME_MAX           136      // >= SYSCTRL_BUF_LEN (main.cpp); buf[1] je ID kontrolera
+
+#define BULK_JOBS                2        // Istovremenih /sysctrl.cgi zahtjeva sa listom ID-eva
+#define BULK_WINDOW              2        // Upita jednog zahtjeva u redu po segmentu - ostatak reda ostaje drugim klijentima
+#define BULK_RING                16       // Završenih upita koji čekaju klijenta; >= BULK_WINDOW * ROUTING_SEGMENTS
+#define BULK_REPLY_MAX           24       // Bajtova odgovora u NDJSON liniji (hex)
+#define BULK_LINE_MAX            128
+
+// Posmatrač svakog završenog upita (keš, metrike, health) - bus task; txn.tx ne važi za pratioce
+typedef void (*BulkObserver)(uint8_t cmd, uint8_t id, BusTransaction& txn);
+
+enum BulkOutcome : uint8_t {
+    BULK_OUT_BROADCAST = BUS_RESULT_COUNT,   // Poslano na DEF_TFBRA - bez potvrde kontrolera
+    BULK_OUT_CIRCUIT_OPEN,                   // Breaker otvoren - upit nije poslan
+};
+
+struct BulkResult {
+    uint8_t id;
+    uint8_t result;          // BusResult ili BulkOutcome
+    uint16_t rttMs;
+    uint8_t replyLen;        // Skraćeno na BULK_REPLY_MAX
+    uint8_t reply[BULK_REPLY_MAX];
+};
+
+class BulkCommand;
+
+struct BulkJob {
+    BulkCommand* owner;      // Bus callback dobija samo job (txn.arg)
+    bool used;
+    bool attached;           // false = klijent otišao; slot se oslobađa kada se vrate upiti u toku
+    bool trailerSent;
+    BusClass cls;
+    bool shareable;
+    uint8_t frame[BULK_FRAME_MAX];
+    uint16_t len;
+
+    uint32_t pending[ROUTING_SEGMENTS][BULK_MAP_WORDS];  // ID-evi koji čekaju upit, po segmentu
+    uint32_t broadcast[BULK_MAP_WORDS];                  // Linije bez upita (već poslan broadcast)
+    uint32_t offline[BULK_MAP_WORDS];
+    uint8_t inFlight[ROUTING_SEGMENTS];
+    uint8_t presetCursor;    // Sljedeći ID za broadcast/offline linije
+
+    uint16_t total;
+    uint16_t ok;
+    uint16_t failed;
+    uint16_t unconfirmed;    // broadcast
+    uint16_t skipped;        // circuit_open
+
+    BulkResult ring[BULK_RING];
+    uint8_t head;
+    uint8_t count;
+
+    char line[BULK_LINE_MAX];
+    uint16_t lineLen;
+    uint16_t linePos;
+};
+
+/**
+ * Jedna komanda za listu kontrolera (/sysctrl.cgi?ID=1-40,55,...).
+ *
+ * Frame se sastavi jednom, a po ID-u se mijenja samo buf[1]. Svaki segment ima svoj prozor od
+ * BULK_WINDOW upita u redu busa: callback završenog upita stavlja u red sljedeći ID istog segmenta,
+ * pa bus radi frame za frame bez čekanja HTTP klijenta, a segmenti rade paralelno. Rezultati idu u ring
+ * koji chunked odgovor (fill) predaje kao NDJSON; pun ring zaustavlja nove upite.
+ */
+class BulkCommand {
+public:
+    BulkCommand(RS485Bus& (*busFor)(uint8_t id), uint8_t (*segmentOf)(uint8_t id),
+                uint16_t (*timeoutFor)(uint8_t id, BusClass cls), BulkObserver observer);
+
+    bool available();                 // Slobodan slot - provjera prije broadcast-a koji se ne može povući
+
+    // ids = unicast upiti; broadcast/offline = ID-evi koji dobijaju liniju bez upita. NULL = nema slobodnog slota
+    BulkJob* start(const uint8_t* frame, uint16_t len, BusClass cls, bool shareable,
+                   const uint32_t* ids, const uint32_t* broadcast, const uint32_t* offline);
+
+    // AwsResponseFiller: RESPONSE_TRY_AGAIN dok čeka bus, 0 na kraju
+    size_t fill(BulkJob* job, uint8_t* buf, size_t maxLen);
+    void detach(BulkJob* job);        // onDisconnect
+    void tick();                      // loop(): ponovi upite odbijene zbog punog reda
+
+    static bool mapHas(const uint32_t* map, uint8_t id) { return (map[id >> 5] >> (id & 31)) & 1; }
+    static void mapSet(uint32_t* map, uint8_t id) { map[id >> 5] |= (1UL << (id & 31)); }
+    static void mapClear(uint32_t* map, uint8_t id) { map[id >> 5] &= ~(1UL << (id & 31)); }
+
+private:
+    BulkJob _jobs[BULK_JOBS];
+    RS485Bus& (*_busFor)(uint8_t id);
+    uint8_t (*_segmentOf)(uint8_t id);
+    uint16_t (*_timeoutFor)(uint8_t id, BusClass cls);
+    BulkObserver _observer;
+    portMUX_TYPE _mux;
+
+    void advance(BulkJob* job, uint8_t seg);
+    bool nextPreset(BulkJob* job, BulkResult& out);
+    size_t formatLine(char* out, size_t max, const BulkResult& r);
+    void releaseIfIdle(BulkJob* job);
+    static void onReply(BusTransaction& txn);
+};
+
+#endif // BULK_COMMAND_H
@@ -0,0 +1,56 @@
+#ifndef BUS_BUFFER_POOL_H
+#define BUS_BUFFER_POOL_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+
+// Klase veličine: većina komandi i odgovora staje u 16 bajtova, FW DATA paket (6 + 128) u 160,
+// a najveći frame koji parser prima (TF_MAX_PAYLOAD_RX) u 1024
+#define BUS_BUF_CLASSES          3
+#define BUS_BUF_SMALL_SIZE       16
+#define BUS_BUF_SMALL_COUNT      32
+#define BUS_BUF_MEDIUM_SIZE      160
+#define BUS_BUF_MEDIUM_COUNT     8
+#define BUS_BUF_LARGE_SIZE       1024
+#define BUS_BUF_LARGE_COUNT      2
+
+struct BusBufferStats {
+    uint16_t size;
+    uint16_t count;
+    uint16_t inUse;
+    uint16_t peak;
+    uint32_t allocs;
+    uint32_t fails;          // Klasa puna i nema veće slobodne
+};
+
+/**
+ * Pool TX/RX bafera RS485 transakcija po klasama veličine.
+ *
+ * Transakcija dobija bafer veličine svog payload-a (TX) odnosno LEN polja odgovora (RX) umjesto
+ * dva fiksna niza maksimalne veličine u svakom slotu. Ako je klasa puna uzima se sljedeća veća.
+ * Bitmapa slobodnih po klasi, zaštićena spinlock-om (alloc iz HTTP handlera, release iz bus taska).
+ */
+class BusBufferPool {
+public:
+    BusBufferPool();
+
+    // Najmanji slobodan bafer >= len; NULL ako nema. cap = stvarna veličina bafera
+    uint8_t* alloc(uint16_t len, uint16_t& cap);
+    void release(uint8_t* buf);
+
+    void getStats(int cls, BusBufferStats& out);
+    static uint16_t maxSize() { return BUS_BUF_LARGE_SIZE; }
+
+private:
+    uint8_t _small[BUS_BUF_SMALL_COUNT][BUS_BUF_SMALL_SIZE];
+    uint8_t _medium[BUS_BUF_MEDIUM_COUNT][BUS_BUF_MEDIUM_SIZE];
+    uint8_t _large[BUS_BUF_LARGE_COUNT][BUS_BUF_LARGE_SIZE];
+
+    uint32_t _free[BUS_BUF_CLASSES];      // Bit po baferu, 1 = slobodan
+    BusBufferStats _stats[BUS_BUF_CLASSES];
+    portMUX_TYPE _mux;
+
+    uint8_t* slot(int cls, int index);
+};
+
+#endif // BUS_BUFFER_POOL_H
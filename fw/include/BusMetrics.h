@@ -0,0 +1,51 @@
+#ifndef BUS_METRICS_H
+#define BUS_METRICS_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+
+// Log skala 1-2-5 (ms); zadnji bucket je +Inf
+#define METRICS_RTT_BUCKETS      10
+#define METRICS_MAX_ID           254
+#define METRICS_MAX_COMMANDS     32    // Različitih RS485 komandi - više nego što ih HTTP API zna
+
+struct RttHistogram {
+    uint32_t buckets[METRICS_RTT_BUCKETS]; // Nekumulativno - Prometheus export sabira
+    uint32_t count;
+    uint32_t sumMs;
+    uint32_t timeouts;
+};
+
+/**
+ * RTT histogrami RS485 transakcija po komandi i po kontroleru.
+ *
+ * Puni ih completion callback (RS485 bus task) za transakcije koje su stvarno bile na busu,
+ * čita /metrics. Bucketi su logaritamski pa i 3 ms i 2 s odgovori imaju smislenu rezoluciju.
+ */
+class BusMetrics {
+public:
+    BusMetrics();
+
+    void observeRtt(uint8_t cmd, uint8_t id, uint32_t rttMs);
+    void observeTimeout(uint8_t cmd, uint8_t id);
+
+    // slot 0..METRICS_MAX_COMMANDS-1; false ako je slot prazan
+    bool getCommand(int slot, uint8_t& cmd, RttHistogram& out);
+    // false ako za ID nema ni jednog mjerenja
+    bool getController(uint8_t id, RttHistogram& out);
+
+    // Gornja granica bucketa u ms, 0 za +Inf
+    static uint16_t bucketBound(int bucket);
+
+private:
+    RttHistogram _commands[METRICS_MAX_COMMANDS];
+    uint8_t _commandCodes[METRICS_MAX_COMMANDS];
+    uint8_t _commandCount;
+    RttHistogram _controllers[METRICS_MAX_ID];
+    portMUX_TYPE _mux;
+
+    RttHistogram* commandSlot(uint8_t cmd);
+    static void add(RttHistogram& h, uint32_t rttMs);
+};
+
+#endif // BUS_METRICS_H
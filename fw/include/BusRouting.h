@@ -0,0 +1,37 @@
+#ifndef BUS_ROUTING_H
+#define BUS_ROUTING_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <freertos/FreeRTOS.h>
+
+#define ROUTING_MAX_ID      254
+#define ROUTING_SEGMENTS    2     // Bitmapa: ID je na segmentu 0 ili 1
+
+/**
+ * Tabela ID kontrolera -> RS485 segment.
+ *
+ * Jedan bit po ID-u (podrazumijevano segment 0), čuva se u NVS-u ("busroute") kao blob od 32 bajta.
+ * Čitaju je HTTP handler i loop() za svaku transakciju, piše se samo konfiguracijom (setRange).
+ */
+class BusRouting {
+public:
+    BusRouting();
+
+    void begin();   // Učitaj tabelu iz NVS-a
+
+    uint8_t segmentFor(uint8_t id);
+
+    // Postavi segment za ID-eve first..last i sačuvaj; false za neispravan raspon/segment
+    bool setRange(uint8_t first, uint8_t last, uint8_t segment);
+
+    // Sljedeći neprekidni raspon ID-eva na istom segmentu počevši od 'from'; false kada nema više
+    bool nextRange(uint8_t from, uint8_t& first, uint8_t& last, uint8_t& segment);
+
+private:
+    uint32_t _map[8];
+    portMUX_TYPE _mux;
+    Preferences _prefs;
+};
+
+#endif // BUS_ROUTING_H
@@ -0,0 +1,118 @@
+#ifndef BUS_SPEED_H
+#define BUS_SPEED_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "RS485Bus.h"
+#include "ControllerRoster.h"
+
+// Brzine busa - indeks je i bit u RosterEntry::baudMask; 0 je osnovna brzina na kojoj sve kreće
+#define BAUD_RATE_COUNT          4
+#define BAUD_BASE_INDEX          0
+
+// Protokol (CMD_SET_BAUD): upit [CMD][ID][0] -> [CMD][mask][~mask],
+// prebacivanje [CMD][DEF_TFBRA][1][indeks][hold] - kontroler se vraća na osnovnu brzinu
+// ako u 'hold' sekundi nakon prebacivanja ne primi ni jedan ispravan frame
+#define BAUD_OP_QUERY            0x00
+#define BAUD_OP_SWITCH           0x01
+#define BAUD_HOLD_SEC            5
+
+#define BAUD_VERIFY_TIMEOUT_MS   40       // Ping nakon prebacivanja - kontroler je već poznat
+#define BAUD_CHECK_MS            10000    // Provjera CRC grešaka i mogućeg podizanja brzine
+#define BAUD_CRC_SPIKE           5        // CRC grešaka u BAUD_CHECK_MS -> korak niže
+#define BAUD_RETRY_MS            3600000UL // Odbijena brzina se ne pokušava ponovo sat vremena
+
+enum BaudState : uint8_t {
+    BAUD_STATE_RESET,        // Boot: vrati kontrolere zaostale na višoj brzini na osnovnu
+    BAUD_STATE_WAIT_ROSTER,  // Čeka prolaz roster-a na osnovnoj brzini
+    BAUD_STATE_IDLE,
+    BAUD_STATE_SWITCHING,    // Broadcast u redu - čeka da bus task prebaci UART
+    BAUD_STATE_VERIFY,       // Ping svakom kontroleru segmenta na novoj brzini
+};
+
+enum BaudAction : uint8_t {
+    BAUD_ACT_SWITCH,         // sendAtBaud(rate(fromIdx), rate(toIdx)) broadcast prebacivanja na toIdx
+    BAUD_ACT_PING,           // GET_SYSID za id
+};
+
+struct BaudStep {
+    BaudAction action;
+    uint8_t fromIdx;
+    uint8_t toIdx;
+    uint8_t id;
+};
+
+struct BusSpeedStatus {
+    uint8_t state;           // BaudState
+    uint8_t rateIdx;
+    uint8_t targetIdx;
+    uint8_t commonMask;      // Presjek podržanih brzina kontrolera segmenta
+    uint16_t controllers;
+    uint32_t switches;       // Uspješna podizanja brzine
+    uint32_t fallbacks;
+    const char* lastFallback; // "verify", "crc" ili NULL
+    uint8_t blockedIdx;      // Brzina koja se ne pokušava do isteka, 0 = ništa
+    uint32_t blockedForMs;
+};
+
+/**
+ * Pregovaranje brzine jednog RS485 segmenta.
+ *
+ * Bus je multidrop, pa brzina važi za cijeli segment: najveća koju podržavaju SVI prisutni kontroleri
+ * (roster pamti podržane brzine po ID-u). Prebacivanje je broadcast na staroj brzini nakon kojeg bus
+ * task prebaci UART, pa ping svakog kontrolera na novoj. Neuspjeh ili nagli porast CRC grešaka vraća
+ * segment korak niže i blokira odbijenu brzinu BAUD_RETRY_MS.
+ *
+ * Kao i roster sweep, ovo je samo stanje - loop() (nextStep) šalje frame-ove, a bus task javlja
+ * rezultate pinga.
+ */
+class BusSpeed {
+public:
+    BusSpeed(uint8_t segment, ControllerRoster& roster, uint8_t (*segmentOf)(uint8_t id));
+
+    // true -> izvrši step; busBaud i counters su trenutno stanje segmenta
+    bool nextStep(BaudStep& step, uint32_t busBaud, const BusCounters& counters);
+    void onPingResult(bool ok);
+    void retryStep();        // Frame nije stao u red busa - ponovi isti korak kasnije
+    void negotiate();        // Nazad na osnovnu brzinu, novi prolaz roster-a, pa pregovaranje ispočetka
+
+    void getStatus(BusSpeedStatus& out);
+
+    static uint32_t rate(uint8_t idx);
+    static const char* stateName(uint8_t state);
+
+private:
+    uint8_t _segment;
+    ControllerRoster& _roster;
+    uint8_t (*_segmentOf)(uint8_t id);
+
+    BaudState _state;
+    uint8_t _rateIdx;
+    uint8_t _targetIdx;
+    uint8_t _commonMask;
+    uint16_t _controllers;
+    uint16_t _cursor;        // RESET: indeks brzine, VERIFY: sljedeći ID
+    bool _inFlight;
+    bool _retry;
+    bool _rescan;            // negotiate(): novi prolaz roster-a nakon povratka na osnovnu brzinu
+    bool _negotiatePending;
+    bool _verifyFailed;
+    BaudStep _lastStep;
+    uint32_t _waitPass;
+    uint32_t _nextCheckAt;
+    uint32_t _lastCrc;
+    uint8_t _blockedIdx;
+    uint32_t _blockedUntil;
+    uint32_t _switches;
+    uint32_t _fallbacks;
+    const char* _lastFallback;
+
+    portMUX_TYPE _mux;
+
+    static bool onSegment(uint8_t id, void* self);
+    uint8_t bestTarget(uint32_t now);
+    void startSwitch(BaudStep& step, uint8_t fromIdx, uint8_t toIdx);
+    void fallback(BaudStep& step, uint8_t fromIdx, uint8_t toIdx, const char* reason, uint32_t now);
+};
+
+#endif // BUS_SPEED_H
@@ -0,0 +1,60 @@
+#ifndef BUS_TRACE_H
+#define BUS_TRACE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+extern "C" {
+    #include "TinyFrame.h"
+}
+
+#define BUS_TRACE_ENTRIES   256   // ~7 KB RAM
+#define BUS_TRACE_PREFIX    12    // Bajtova payload-a po zapisu (CMD + ID + par bajtova)
+
+enum BusTraceDir : uint8_t {
+    BUS_TRACE_TX,
+    BUS_TRACE_RX,
+};
+
+// Format zapisa je i binarni format /bus_trace?format=bin - ne mijenjati bez promjene verzije
+struct BusTraceRecord {
+    uint32_t seq;
+    uint32_t timeUs;         // micros() - prelazi preko nule nakon ~71 min
+    uint8_t dir;             // BusTraceDir
+    uint8_t status;          // TF_FrameStatus
+    uint8_t frameId;
+    uint8_t type;
+    uint16_t len;            // LEN iz zaglavlja (cijeli payload, ne samo prefix)
+    uint8_t prefixLen;
+    uint8_t reserved;
+    uint8_t data[BUS_TRACE_PREFIX];
+};
+
+/**
+ * Ring buffer RS485 frame-ova (TX i RX) sa mikrosekundnim vremenom.
+ *
+ * Upis (record) je jedan memcpy pod spinlock-om pa trace može stalno raditi u produkciji,
+ * za razliku od ispisa svakog bajta na Serial. Piše samo RS485 bus task, čita HTTP handler.
+ * Najstariji zapisi se prepisuju; seq raste monotono pa klijent može čitati inkrementalno.
+ */
+class BusTrace {
+public:
+    BusTrace();
+
+    void record(BusTraceDir dir, uint8_t status, uint8_t frameId, uint8_t type, uint16_t len,
+                const uint8_t* data, uint16_t dataLen);
+
+    // Raspon dostupnih seq brojeva; first > last ako je trace prazan
+    void bounds(uint32_t& first, uint32_t& last);
+
+    // Kopira zapise od fromSeq (ili najstarijeg dostupnog) naviše, najviše max; vraća broj zapisa
+    uint16_t read(uint32_t fromSeq, BusTraceRecord* out, uint16_t max);
+
+    static const char* statusName(uint8_t status);
+
+private:
+    BusTraceRecord _ring[BUS_TRACE_ENTRIES];
+    uint32_t _nextSeq;       // Seq sljedećeg zapisa, počinje od 1
+    portMUX_TYPE _mux;
+};
+
+#endif // BUS_TRACE_H
@@ -0,0 +1,184 @@
+#ifndef COMMAND_TABLE_H
+#define COMMAND_TABLE_H
+
+// Bez Arduino zaglavlja - tabela, enkoderi i dekoderi se prevode i na hostu
+#include <stdint.h>
+#include <stddef.h>
+
+#define QR_CODE_MAX_LEN          128      // QR_CODE_SET / QR_CODE_GET string
+#define COMMAND_MAX_PARAMS       3        // Obavezni parametri poslije ID-a
+#define COMMAND_MAX_FIELDS       2        // Bajtovi odgovora koji se direktno upisuju kao JSON polja
+#define COMMAND_FAULT_MAX        80
+#define COMMAND_ACK              0x06
+
+// IC kontroler komande (0x94-0xF2) - NE MIJENJATI, definisano u common.h; ESP32 lokalne komande 0x50-0x72
+enum CommandType
+{
+  CMD_UNKNOWN,
+  CMD_GET_ROOM_STATUS = 0x94,      // IC kontroler - Get Room Status (Card Stacker)
+  // ESP32 lokalne komande - Interni pinovi i senzori
+  CMD_ESP_GET_PINS = 0xA0,
+  CMD_ESP_SET_PIN = 0xA1,
+  CMD_ESP_RESET_PIN = 0xA2,
+  CMD_ESP_PULSE_PIN = 0xA3,
+  CMD_GET_STATUS = 0xAA,
+
+  // IC Kontroler komande - RS485 (common.h) - NE MIJENJATI!
+  CMD_GET_ROOM_TEMP = 0xAC,
+  CMD_SET_PIN = 0xB1,
+  CMD_GET_PINS = 0xB2,
+  CMD_SET_THST_ON = 0xB4,
+  CMD_GET_FAN_DIFFERENCE = 0xB5,
+  CMD_GET_FAN_BAND = 0xB6,
+  CMD_RESTART_CTRL = 0xC0,
+  CMD_READ_LOG = 0xCE,             // IC kontroler - Read last log
+  CMD_DELETE_LOG = 0xCF,           // IC kontroler - Delete last log
+  CMD_SET_GUEST_IN_TEMP = 0xD0,
+  CMD_SET_GUEST_OUT_TEMP = 0xD1,
+  CMD_SET_ROOM_TEMP = 0xD6,
+  CMD_GET_GUEST_IN_TEMP = 0xD7,
+  CMD_GET_GUEST_OUT_TEMP = 0xD8,
+  CMD_OPEN_DOOR = 0xDB,            // HOTEL_SET_PIN_V2
+  CMD_SET_THST_HEATING = 0xDC,
+  CMD_SET_THST_COOLING = 0xDD,
+  CMD_SET_THST_OFF = 0xDE,
+  CMD_SET_PASSWORD = 0x96,
+
+  CMD_QR_CODE_GET = 0xE5,          // IC kontroler - Get QR Code
+  CMD_QR_CODE_SET = 0xE6,          // IC kontroler - Set QR Code
+  CMD_SET_LANG = 0xE9,             // IC kontroler - Set Language
+  CMD_GET_SYSID = 0xEA,            // IC kontroler - Get System ID
+  CMD_SET_SYSID = 0xEB,            // IC kontroler - Set System ID
+  CMD_GET_PASSWORD = 0xEC,         // IC kontroler
+  CMD_SET_FWD_HEATING = 0xED,      // IC kontroler - Set Forward Heating Flag
+  CMD_SET_FWD_COOLING = 0xEE,      // IC kontroler - Set Forward Cooling Flag
+  CMD_SET_ENABLE_HEATING = 0xEF,   // IC kontroler - Set Enable Heating Flag
+  CMD_SET_ENABLE_COOLING = 0xF0,   // IC kontroler - Set Enable Cooling Flag
+  CMD_GET_VERSION = 0xF1,          // IC kontroler / ESP32 - Get Firmware Versions
+  CMD_SET_BAUD = 0xF2,             // IC kontroler - Upit/prebacivanje brzine busa (samo BusSpeed, ne HTTP)
+  // ESP32 lokalne komande - Premješteno na siguran opseg (0x50-0x68)
+
+  CMD_GET_SSID_PSWRD = 0x50,
+  CMD_SET_SSID_PSWRD = 0x51,
+  CMD_GET_MDNS_NAME = 0x52,
+  CMD_SET_MDNS_NAME = 0x53,
+  CMD_GET_TCPIP_PORT = 0x54,
+  CMD_SET_TCPIP_PORT = 0x55,
+  CMD_GET_IP_ADDRESS = 0x56,
+  CMD_RESTART = 0x57,
+  CMD_GET_TIMER = 0x58,
+  CMD_SET_TIMER = 0x59,
+  CMD_GET_TIME = 0x5A,
+  CMD_SET_TIME = 0x5B,
+  CMD_OUTDOOR_LIGHT_ON = 0x5C,
+  CMD_OUTDOOR_LIGHT_OFF = 0x5D,
+  CMD_GET_PINGWDG = 0x5E,
+  CMD_PINGWDG_ON = 0x5F,
+  CMD_PINGWDG_OFF = 0x60,
+  CMD_TH_SETPOINT = 0x61,
+  CMD_TH_DIFF = 0x62,
+  CMD_TH_STATUS = 0x63,
+  CMD_TH_HEATING = 0x64,
+  CMD_TH_COOLING = 0x65,
+  CMD_TH_OFF = 0x66,
+  CMD_TH_ON = 0x67,
+  CMD_TH_EMA = 0x68,
+  CMD_SOS_RESET = 0x69,  // Resetuje SOS status nakon što je hitnost riješena
+  CMD_SET_IR_PROTOCOL = 0x70, // Set IR Protocol ID
+  CMD_GET_IR_PROTOCOL = 0x71, // Get IR Protocol ID
+  CMD_SET_IR = 0x72           // Send basic IR command (ON/OFF, Mode, Temp)
+
+};
+
+enum CommandParamKind : uint8_t {
+    PARAM_BYTE,              // Cijeli broj u [min, max] -> 1 bajt u frame-u
+    PARAM_WORD,              // Cijeli broj u [min, max] -> 2 bajta, MSB prvi
+    PARAM_TEXT,              // Tekst dužine [min, max]; u frame ga upisuje enkoder komande
+};
+
+enum CommandFieldKind : uint8_t {
+    FIELD_BYTE,
+    FIELD_BOOL,
+};
+
+struct CommandParamSpec {
+    const char* name;        // NULL = kraj liste
+    CommandParamKind kind;
+    int32_t min;
+    int32_t max;
+    const char* hint;        // Tekst u zagradi poruke o grešci; NULL = "must be min-max"
+};
+
+struct CommandField {
+    const char* key;         // NULL = kraj liste
+    uint8_t offset;          // Bajt odgovora
+    CommandFieldKind kind;
+};
+
+// Izvor parametara zahtjeva (HTTP, makro korak, host test); NULL = parametar ne postoji
+struct CommandInput {
+    void* ctx;
+    const char* (*lookup)(void* ctx, const char* name);
+
+    const char* get(const char* name) const { return lookup(ctx, name); }
+};
+
+// Odredište polja odgovora (JsonDocument na uređaju); tekst se kopira, value NULL = JSON null
+struct ReplyWriter {
+    void* ctx;
+    void (*putInt)(void* ctx, const char* key, int32_t value);
+    void (*putBool)(void* ctx, const char* key, bool value);
+    void (*putText)(void* ctx, const char* key, const char* value);
+    void (*putError)(void* ctx, const char* message);
+
+    void integer(const char* key, int32_t value) const { putInt(ctx, key, value); }
+    void boolean(const char* key, bool value) const { putBool(ctx, key, value); }
+    void text(const char* key, const char* value) const { putText(ctx, key, value); }
+    void error(const char* message) const { putError(ctx, message); }
+};
+
+struct CommandFault {
+    int code;                // HTTP kod
+    char message[COMMAND_FAULT_MAX];
+};
+
+struct CommandDescriptor;
+
+// Parametri iz spec liste su već provjereni; values[i] odgovara params[i] (PARAM_TEXT: 0). Vraća dužinu ili 0 uz fault
+typedef int (*CommandEncoder)(const CommandDescriptor& d, const CommandInput& in, uint8_t id, const int32_t* values,
+                              uint8_t* buf, size_t max, CommandFault& fault);
+// Poziva se nakon provjere replyCode/replyMin i upisa result/fields
+typedef void (*CommandDecoder)(const CommandDescriptor& d, const uint8_t* reply, uint16_t len, const ReplyWriter& out);
+
+/**
+ * Opis jedne komande kontrolera: šta zahtjev mora imati, kako izgleda frame i kako se čita odgovor.
+ *
+ * Svaka komanda ima ID (1-254) u buf[1]; params su ostali obavezni parametri redom kojim ih
+ * generički enkoder upisuje iza ID-a. Komanda sa posebnim formatom (lozinke, PIN, QR kod) ima svoj
+ * encode, a tabela i dalje nosi provjeru prisutnosti i opsega. Odgovor: replyCode mora biti prvi bajt
+ * (0 = bez provjere), kraći od replyMin je greška, zatim result, fields i decode.
+ */
+struct CommandDescriptor {
+    CommandType cmd;
+    CommandParamSpec params[COMMAND_MAX_PARAMS];
+    CommandEncoder encode;   // NULL = [CMD][ID][parametri]
+    uint8_t replyCode;
+    uint8_t replyMin;
+    const char* result;      // "result" polje odgovora; NULL = bez njega
+    const char* failed;      // != NULL: result samo uz ACK u reply[1], inače ovaj tekst
+    CommandField fields[COMMAND_MAX_FIELDS];
+    CommandDecoder decode;   // NULL = ništa više
+};
+
+CommandType commandFromName(const char* name, size_t len);
+
+// NULL = komanda nije za kontroler (lokalna ili nepoznata)
+const CommandDescriptor* findCommand(CommandType cmd);
+
+// Dužina frame-a u buf; 0 uz fault.code != 0 za neispravne parametre
+int encodeCommand(const CommandDescriptor& d, const CommandInput& in, uint8_t* buf, size_t max, CommandFault& fault);
+
+// false = odgovor nije u formatu komande (pozivalac ga prikazuje sirovo)
+bool decodeReply(const CommandDescriptor& d, const uint8_t* reply, uint16_t len, const ReplyWriter& out);
+
+#endif // COMMAND_TABLE_H
@@ -0,0 +1,112 @@
+#ifndef CONTROLLER_HEALTH_H
+#define CONTROLLER_HEALTH_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "RS485Bus.h"
+
+// Adresni prostor kontrolera na busu
+#define HEALTH_MAX_ID            254
+// Klase za koje se mjeri RTT (access, write, read, log) - firmware ima vlastite timeoute
+#define HEALTH_CLASSES           (BUS_CLASS_LOG + 1)
+
+// RTO granice (ms) - RFC 6298 princip, prilagođeno RS485 busu
+#define RTO_INITIAL_MS           BUS_DEFAULT_TIMEOUT_MS  // Dok nema uzorka
+#define RTO_MIN_MS               40
+#define RTO_MAX_MS               3000
+#define RTO_GRANULARITY_MS       10     // Min dodatak na SRTT (UART + bus task wake)
+#define RTO_MAX_BACKOFF          3      // Nakon uzastopnih timeouta RTO se udvostručuje do x8
+
+// Circuit breaker
+#define BREAKER_FAIL_THRESHOLD   3      // Uzastopni timeouti do otvaranja
+#define BREAKER_PROBE_MIN_MS     5000   // Prva proba nakon otvaranja
+#define BREAKER_PROBE_MAX_MS     60000  // Interval proba se udvostručuje do ove granice
+#define BREAKER_PROBE_TIMEOUT_MS 150
+
+enum BreakerState {
+    BREAKER_CLOSED,       // Normalan rad
+    BREAKER_OPEN,         // Kontroler ne odgovara - zahtjevi odmah odbijeni
+    BREAKER_HALF_OPEN,    // Proba u toku
+};
+
+struct RttInfo {
+    uint16_t srttMs;
+    uint16_t rttvarMs;
+    uint16_t rtoMs;
+    uint8_t samples;       // Zasićeno na 255
+    uint8_t backoff;
+};
+
+struct BreakerInfo {
+    BreakerState state;
+    uint8_t failures;      // Uzastopni timeouti
+    uint16_t trips;        // Koliko puta je otvoren
+    uint32_t rejected;     // Zahtjevi odbijeni bez slanja na bus
+    uint32_t openForMs;    // Od zadnjeg otvaranja (0 ako je zatvoren)
+    uint32_t nextProbeInMs;
+};
+
+/**
+ * Procjena zdravlja kontrolera na RS485 busu.
+ *
+ * Za svaki (ID, klasa komande) vodi zaglađen RTT i varijansu (SRTT/RTTVAR kao TCP) i iz njih
+ * računa timeout transakcije. Zdrav kontroler sa brzim odgovorima dobija kratak timeout,
+ * spor (npr. SET_PASSWORD) dovoljno dug da ne ističe greškom.
+ *
+ * Po ID-u vodi i circuit breaker: nakon BREAKER_FAIL_THRESHOLD uzastopnih timeouta zahtjevi
+ * za taj ID se odbijaju bez slanja, a loop() povremeno šalje probu (nextProbe) dok kontroler
+ * ne odgovori. Mrtva soba tako ne troši vrijeme busa koje trebaju žive sobe.
+ */
+class ControllerHealth {
+public:
+    ControllerHealth();
+
+    uint16_t timeoutFor(uint8_t id, BusClass cls);
+
+    void onReply(uint8_t id, BusClass cls, uint32_t rttMs);
+    void onTimeout(uint8_t id, BusClass cls);
+
+    // false ako za (ID, klasa) još nema mjerenja
+    bool getRtt(uint8_t id, BusClass cls, RttInfo& out);
+
+    // false -> breaker otvoren, odbij zahtjev odmah
+    bool allowRequest(uint8_t id);
+
+    // ID kojem je vrijeme za probu (prelazi u HALF_OPEN) ili 0
+    uint8_t nextProbe();
+    void onProbeResult(uint8_t id, bool ok);
+
+    // false ako breaker nikad nije reagovao (zatvoren, bez grešaka)
+    bool getBreaker(uint8_t id, BreakerInfo& out);
+    static const char* breakerName(BreakerState state);
+
+private:
+    struct Estimator {
+        uint16_t srtt8;    // SRTT << 3
+        uint16_t rttvar4;  // RTTVAR << 2
+        uint8_t samples;
+        uint8_t backoff;
+    };
+
+    struct Breaker {
+        uint8_t state;
+        uint8_t failures;
+        uint8_t probeShift;   // Interval probe = BREAKER_PROBE_MIN_MS << probeShift
+        uint16_t trips;
+        uint32_t rejected;
+        uint32_t openedAt;
+        uint32_t nextProbeAt;
+    };
+
+    Estimator _rtt[HEALTH_MAX_ID][HEALTH_CLASSES];
+    Breaker _breakers[HEALTH_MAX_ID];
+    uint8_t _probeCursor;
+    portMUX_TYPE _mux;
+
+    Estimator* estimator(uint8_t id, BusClass cls);
+    static uint16_t rto(const Estimator& e);
+    void recordSuccess(uint8_t id);
+    void openBreaker(Breaker& b, uint32_t now);
+};
+
+#endif // CONTROLLER_HEALTH_H
@@ -0,0 +1,113 @@
+#ifndef CONTROLLER_ROSTER_H
+#define CONTROLLER_ROSTER_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <freertos/FreeRTOS.h>
+
+// Adresni prostor koji se pretražuje (255 = broadcast)
+#define ROSTER_MAX_ID            254
+#define ROSTER_PROBE_TIMEOUT_MS  60       // Prazna adresa ne smije dugo držati bus
+#define ROSTER_STEP_MS           20       // Pauza između upita sweepa
+#define ROSTER_BOOT_DELAY_MS     15000    // Prvi prolaz nakon što se boot saobraćaj smiri
+#define ROSTER_REFRESH_MS        600000UL // Novi prolaz svakih 10 min
+#define ROSTER_MISS_LIMIT        2        // Uzastopni prolazi bez odgovora do brisanja iz roster-a
+#define ROSTER_FLUSH_PER_CALL    4        // Max NVS upisa po flush() pozivu
+
+// Format odgovora na GET_VERSION
+enum RosterFormat : uint8_t {
+    ROSTER_FMT_UNKNOWN,      // GET_VERSION još nije odgovoren
+    ROSTER_FMT_SYSID_ONLY,   // Stariji firmware - kratak/nepoznat GET_VERSION odgovor
+    ROSTER_FMT_VERSION5,     // [CMD] + 5 x uint32 verzija (21 bajt)
+};
+
+enum RosterQuery : uint8_t {
+    ROSTER_Q_SYSID,
+    ROSTER_Q_VERSION,
+    ROSTER_Q_BAUD,           // Podržane brzine busa (BusSpeed)
+};
+
+struct RosterEntry {
+    uint16_t sysid;
+    uint32_t bootloaderVer;
+    uint32_t appVer;
+    uint8_t format;          // RosterFormat
+    uint8_t baudMask;        // Bit N = BusSpeed::rate(N) podržan; 0 = još nije upitano
+    uint8_t misses;
+    uint32_t lastSeenMs;     // millis() zadnjeg odgovora, 0 = samo učitano iz NVS
+};
+
+struct RosterStats {
+    uint16_t live;
+    uint16_t cursor;         // Sljedeći ID u prolazu
+    uint32_t passes;
+    uint32_t lastPassMs;     // Trajanje zadnjeg kompletnog prolaza
+    bool sweeping;
+};
+
+/**
+ * Spisak kontrolera prisutnih na RS485 busu.
+ *
+ * Pozadinski sweep (ControllerRoster::nextStep iz loop()) šalje GET_SYSID svakoj adresi sa kratkim
+ * timeoutom, a za one koje odgovore i GET_VERSION i upit podržanih brzina busa. Istovremeno je na busu najviše jedan upit sweepa,
+ * u najnižoj klasi, tako da ne smeta gostima. Odgovori iz običnog saobraćaja (learn*) osvježavaju
+ * roster bez čekanja na sljedeći prolaz.
+ *
+ * Identitet (sysid, verzije, format) se čuva u NVS-u ("roster", ključ po ID-u) i upisuje samo kada se
+ * promijeni, iz loop() (flush) - nikad iz bus taska.
+ */
+class ControllerRoster {
+public:
+    ControllerRoster();
+
+    void begin();                 // Učitaj roster iz NVS-a
+    void flush();                 // Upiši promijenjene unose u NVS
+
+    // true -> pošalji upit (query) za id; rezultat prijaviti sa onSweepReply ili retryStep
+    bool nextStep(uint8_t& id, RosterQuery& query);
+    void onSweepReply(uint8_t id, RosterQuery query, bool ok, const uint8_t* data, uint16_t len);
+    void retryStep();             // Upit nije stao u red busa - ponovi isti korak kasnije
+    void rescan();                // Odmah započni novi prolaz
+
+    // Uspješni odgovori iz običnog saobraćaja
+    void learnSysid(uint8_t id, const uint8_t* data, uint16_t len);
+    void learnVersion(uint8_t id, const uint8_t* data, uint16_t len);
+
+    // Presjek baudMask svih prisutnih kontrolera za koje filter vrati true (nepoznato = samo osnovna brzina)
+    uint8_t commonBaudMask(bool (*filter)(uint8_t id, void* arg), void* arg, uint16_t& count);
+    bool isLive(uint8_t id);
+    bool get(uint8_t id, RosterEntry& out);
+    void getStats(RosterStats& out);
+
+    static const char* formatName(uint8_t format);
+
+private:
+    RosterEntry _entries[ROSTER_MAX_ID];
+    uint32_t _live[8];            // Bitmapa prisutnih ID-eva (1..254)
+    uint32_t _dirty[8];           // Bitmapa unosa za upis u NVS
+    bool _liveDirty;
+
+    bool _sweeping;
+    bool _inFlight;
+    uint8_t _stepId;
+    RosterQuery _stepQuery;
+    uint16_t _cursor;
+    uint8_t _versionId;           // ID koji je odgovorio na SYSID i čeka GET_VERSION
+    uint8_t _baudId;              // ID koji čeka upit podržanih brzina
+    uint32_t _nextPassAt;
+    uint32_t _passStartedAt;
+    uint32_t _lastPassMs;
+    uint32_t _passes;
+
+    Preferences _prefs;
+    portMUX_TYPE _mux;
+
+    static bool testBit(const uint32_t* map, uint8_t id);
+    static void setBit(uint32_t* map, uint8_t id, bool value);
+    void markSeen(uint8_t id, uint16_t sysid);
+    void markVersion(uint8_t id, const uint8_t* data, uint16_t len);
+    void markBaud(uint8_t id, bool ok, const uint8_t* data, uint16_t len);
+    void markMissed(uint8_t id);
+};
+
+#endif // CONTROLLER_ROSTER_H
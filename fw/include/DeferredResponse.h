@@ -0,0 +1,47 @@
+#ifndef DEFERRED_RESPONSE_H
+#define DEFERRED_RESPONSE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <ESPAsyncWebServer.h>
+#include "JsonWriter.h"
+
+struct tcp_pcb;
+
+#define DEFERRED_BODY_MAX        768      // Omotač + "data" odgovora kontrolera (RS485_REPLY_JSON_MAX) ili rezultat makroa
+
+/**
+ * HTTP odgovor koji sastavlja RS485 bus task, a šalje async_tcp task.
+ *
+ * Request i klijent ESPAsyncWebServer-a pripadaju async_tcp tasku, pa bus callback ne smije zvati
+ * request->send(). Handler odmah preda ovaj objekat sa request->send(); callback upiše tijelo u sink()
+ * i pozove complete(code). complete() preko tcpip_callback odmah okida poll konekcije, pa async_tcp
+ * task u _ack() šalje zaglavlje i tijelo bez čekanja periodičnog poll-a (~500 ms). HTTP kod
+ * (408, 503...) ostaje kakav je bio.
+ */
+class DeferredResponse : public AsyncAbstractResponse {
+public:
+    explicit DeferredResponse(const char* contentType = "application/json");
+
+    JsonBufferSink& sink() { return _sink; }   // Samo prije complete()
+    void complete(int code);                   // Bus task; jednom
+
+    bool _sourceValid() const override { return true; }
+    void _respond(AsyncWebServerRequest* request) override;
+    size_t _ack(AsyncWebServerRequest* request, size_t len, uint32_t time) override;
+    size_t _fillBuffer(uint8_t* buf, size_t maxLen) override;
+
+private:
+    char _body[DEFERRED_BODY_MAX];
+    JsonBufferSink _sink;
+    size_t _sent;
+    bool _ready;
+    AsyncClient* _client;      // Postavlja _respond(); NULL dok handler ne pozove request->send()
+    tcp_pcb* _pcb;
+    portMUX_TYPE _mux;
+
+    bool ready();
+    static void pollNow(void* ctx);
+};
+
+#endif // DEFERRED_RESPONSE_H
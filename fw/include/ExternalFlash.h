@@ -3,6 +3,8 @@
 
 #include <Arduino.h>
 #include <SPI.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include "FirmwareDefs.h"
 
 // W25Q64 Commands
@@ -28,6 +30,7 @@ public:
     
     // Slot management
     bool eraseSlot(uint8_t slotIndex);
+    bool eraseSlotSector(uint8_t slotIndex, uint32_t offset);   // 4K sektor unutar slota (LogStore)
     bool writeBufferToSlot(uint8_t slotIndex, uint32_t offset, const uint8_t* data, size_t len);
     bool readBufferFromSlot(uint8_t slotIndex, uint32_t offset, uint8_t* buffer, size_t len);
     
@@ -43,6 +46,10 @@ public:
 private:
     int _cs;
     SPIClass& _spi;
+    SemaphoreHandle_t _lock;   // Upload/update (async_tcp, loop) i LogStore dijele isti SPI čip
+
+    void lock();
+    void unlock();
 
     void waitUntilReady();
     void writeEnable();
@@ -35,4 +35,11 @@ typedef struct {
 #define FW_SLOT_SIZE         (1 * 1024 * 1024) // 1MB po slotu
 #define FW_SLOT_COUNT        8
 
+// Slot za LogStore (append-only log kontrolera); -1 = bez log store-a (default).
+// Uključuje se build flag-om (npr. -DLOG_STORE_SLOT=7): LogStore formatira slot bez svog zaglavlja,
+// pa postojeća slika u tom slotu nestaje, a upload i /start_update ga više ne prihvataju.
+#ifndef LOG_STORE_SLOT
+#define LOG_STORE_SLOT       -1
+#endif
+
 #endif // FIRMWARE_DEFS_H
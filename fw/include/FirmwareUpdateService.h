@@ -5,6 +5,7 @@
 extern "C" {
     #include "TinyFrame.h"
 }
+#include "RS485Bus.h"
 #include "ExternalFlash.h"
 #include "FirmwareDefs.h"
 
@@ -46,12 +47,13 @@ enum UpdateState {
 
 class FirmwareUpdateService {
 public:
-    FirmwareUpdateService(ExternalFlash& flash, TinyFrame& tf);
+    FirmwareUpdateService(ExternalFlash& flash, RS485Bus& bus);
 
     // Start a broadcast or single update
     // fromSlot: 0-7
     // targetAddr: 1-254
-    bool startUpdate(uint8_t fromSlot, uint8_t targetAddr, uint32_t stagingAddr = 0x90000000);
+    // bus: RS485 segment na kojem je targetAddr (NULL = bus iz konstruktora)
+    bool startUpdate(uint8_t fromSlot, uint8_t targetAddr, uint32_t stagingAddr = 0x90000000, RS485Bus* bus = NULL);
 
     void loop(); // Call in main loop
     void reset(); // Reset to IDLE state
@@ -68,7 +70,8 @@ public:
 
 private:
     ExternalFlash& _flash;
-    TinyFrame& _tf;
+    RS485Bus& _defaultBus;
+    RS485Bus* _bus;            // Segment aktivnog update-a
 
     uint8_t _activeSlot;
     uint8_t _targetAddr;
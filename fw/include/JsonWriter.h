@@ -0,0 +1,185 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+// Bez Arduino zaglavlja - sink je bilo koja klasa sa write(const uint8_t*, size_t) (AsyncResponseStream, Print)
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define JSON_WRITER_DEPTH        16       // Ugniježđenih objekata/nizova
+
+// Fiksni bafer (NDJSON linija, podaci odgovora prije omotača); višak se odbacuje, overflow() to javlja
+class JsonBufferSink {
+public:
+    JsonBufferSink(char* buf, size_t cap) : _buf(buf), _cap(cap), _len(0), _overflow(false) {
+        if (_cap > 0) _buf[0] = '\0';
+    }
+
+    size_t write(const uint8_t* data, size_t len) {
+        if (_len + len >= _cap) {
+            _overflow = true;
+            len = (_cap > _len + 1) ? _cap - _len - 1 : 0;
+        }
+        memcpy(_buf + _len, data, len);
+        _len += len;
+        if (_cap > 0) _buf[_len] = '\0';
+        return len;
+    }
+
+    const char* c_str() const { return _buf; }
+    size_t length() const { return _len; }
+    bool overflow() const { return _overflow; }
+
+private:
+    char* _buf;
+    size_t _cap;
+    size_t _len;
+    bool _overflow;
+};
+
+/**
+ * JSON bez DOM-a: vrijednosti se upisuju u sink redom kojim se pozivaju, bez JsonDocument-a i String-a.
+ *
+ * Zarezi i escape stringova su na writeru; struktura je na pozivaocu (svaki begin ima svoj end,
+ * u objektu key prije vrijednosti). float ide sa 7 značajnih cifara kao ArduinoJson, NaN/Inf kao null.
+ */
+template <class Sink>
+class JsonWriter {
+public:
+    explicit JsonWriter(Sink& sink) : _sink(sink), _depth(0), _first(1), _afterKey(false) {}
+
+    JsonWriter& beginObject() { return open('{'); }
+    JsonWriter& beginObject(const char* name) { return key(name).open('{'); }
+    JsonWriter& beginArray() { return open('['); }
+    JsonWriter& beginArray(const char* name) { return key(name).open('['); }
+
+    JsonWriter& endObject() { return close('}'); }
+    JsonWriter& endArray() { return close(']'); }
+
+    JsonWriter& key(const char* name) {
+        separator();
+        string(name);
+        put(":", 1);
+        _afterKey = true;
+        return *this;
+    }
+
+    JsonWriter& value(const char* s) {
+        separator();
+        if (s == NULL) put("null", 4);
+        else string(s);
+        return *this;
+    }
+
+    JsonWriter& value(bool b) {
+        separator();
+        if (b) put("true", 4);
+        else put("false", 5);
+        return *this;
+    }
+
+    JsonWriter& value(int v) { return number("%d", v); }
+    JsonWriter& value(unsigned int v) { return number("%u", v); }
+    JsonWriter& value(long v) { return number("%ld", v); }
+    JsonWriter& value(unsigned long v) { return number("%lu", v); }
+    JsonWriter& value(long long v) { return number("%lld", v); }
+    JsonWriter& value(unsigned long long v) { return number("%llu", v); }
+
+    JsonWriter& value(float v) { return real(v, 7); }
+    JsonWriter& value(double v) { return real(v, 15); }
+
+    JsonWriter& null() {
+        separator();
+        put("null", 4);
+        return *this;
+    }
+
+    // Već serijalizovana JSON vrijednost (npr. iz JsonBufferSink)
+    JsonWriter& raw(const char* json, size_t len) {
+        separator();
+        put(json, len);
+        return *this;
+    }
+
+    template <class T>
+    JsonWriter& field(const char* name, T v) { return key(name).value(v); }
+    JsonWriter& nullField(const char* name) { return key(name).null(); }
+
+private:
+    Sink& _sink;
+    uint8_t _depth;
+    uint32_t _first;         // Bit po nivou: još nema elemenata
+    bool _afterKey;
+
+    void put(const char* s, size_t len) { _sink.write((const uint8_t*)s, len); }
+
+    void separator() {
+        if (_afterKey) {
+            _afterKey = false;
+            return;
+        }
+        if (_first & (1UL << _depth)) _first &= ~(1UL << _depth);
+        else put(",", 1);
+    }
+
+    JsonWriter& open(char c) {
+        separator();
+        put(&c, 1);
+        if (_depth < JSON_WRITER_DEPTH) _depth++;
+        _first |= (1UL << _depth);
+        return *this;
+    }
+
+    JsonWriter& close(char c) {
+        if (_depth > 0) _depth--;
+        put(&c, 1);
+        return *this;
+    }
+
+    template <class T>
+    JsonWriter& number(const char* fmt, T v) {
+        char buf[24];
+        separator();
+        int len = snprintf(buf, sizeof(buf), fmt, v);
+        put(buf, len);
+        return *this;
+    }
+
+    JsonWriter& real(double v, int digits) {
+        if (isnan(v) || isinf(v)) return null();
+        char buf[32];
+        separator();
+        int len = snprintf(buf, sizeof(buf), "%.*g", digits, v);
+        put(buf, len);
+        return *this;
+    }
+
+    void string(const char* s) {
+        put("\"", 1);
+        const char* run = s;
+        for (; *s; s++) {
+            unsigned char c = *s;
+            if (c >= 0x20 && c != '"' && c != '\\') continue;
+            put(run, s - run);
+            run = s + 1;
+            char esc[7];
+            switch (c) {
+            case '"':  put("\\\"", 2); break;
+            case '\\': put("\\\\", 2); break;
+            case '\n': put("\\n", 2); break;
+            case '\r': put("\\r", 2); break;
+            case '\t': put("\\t", 2); break;
+            default:
+                snprintf(esc, sizeof(esc), "\\u%04x", c);
+                put(esc, 6);
+                break;
+            }
+        }
+        put(run, s - run);
+        put("\"", 1);
+    }
+};
+
+#endif // JSON_WRITER_H
@@ -0,0 +1,70 @@
+#ifndef LOG_COLLECTOR_H
+#define LOG_COLLECTOR_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "RS485Bus.h"
+#include "ControllerRoster.h"
+#include "LogDrain.h"
+#include "LogStore.h"
+
+#define LOG_COLLECT_ROUND_MS     60000    // Pauza nakon kruga kroz roster bez ijednog novog zapisa
+#define LOG_COLLECT_RETRY_MS     5000     // Upis u flash nije uspio - zapis ostaje na kontroleru
+
+enum LogCollectState : uint8_t {
+    LOG_COLLECT_IDLE,        // Bira sljedeći kontroler
+    LOG_COLLECT_READ,        // READ_LOG čeka prazan bus
+    LOG_COLLECT_BUSY,        // Upit na busu
+    LOG_COLLECT_STORE,       // Pročitan zapis čeka upis u LogStore (loop)
+    LOG_COLLECT_DELETE,      // DELETE_LOG čeka prazan bus - tek nakon upisa u flash
+};
+
+struct LogCollectorStats {
+    uint32_t collected;
+    uint32_t duplicates;     // Isti zapis ponovo pročitan nakon neuspjelog DELETE-a - nije upisan dvaput
+    uint32_t readFailures;
+    uint32_t deleteFailures;
+    uint32_t storeFailures;
+    uint32_t rounds;
+    uint8_t currentId;       // 0 = između krugova
+    LogCollectState state;
+};
+
+/**
+ * Pozadinsko pražnjenje logova kontrolera u LogStore.
+ *
+ * Iz loop(): za jedan po jedan kontroler iz roster-a izmjenjuje READ_LOG / DELETE_LOG, ali samo kada
+ * je bus tog segmenta prazan. DELETE ide tek kada je zapis upisan u eksterni flash, pa restart ili
+ * nestanak struje ne gube zapis. Kontroler sa aktivnim /logs/drain se preskače.
+ */
+class LogCollector {
+public:
+    LogCollector(LogStore& store, ControllerRoster& roster, LogDrain& drain, RS485Bus& (*busFor)(uint8_t id));
+
+    void tick();             // loop()
+    bool owns(uint8_t id);   // READ/DELETE ciklus u toku - ručni READ_LOG/DELETE_LOG i drain čekaju
+    void getStats(LogCollectorStats& out);
+
+private:
+    LogStore& _store;
+    ControllerRoster& _roster;
+    LogDrain& _drain;
+    RS485Bus& (*_busFor)(uint8_t id);
+
+    LogCollectState _state;
+    uint8_t _id;
+    uint8_t _cursor;
+    bool _roundFound;        // Bar jedan zapis u ovom krugu
+    uint32_t _nextRoundAt;
+    uint8_t _entry[LOG_DRAIN_ENTRY_SIZE];
+    uint8_t _last[LOG_DRAIN_ENTRY_SIZE];  // Zadnji upisan zapis _id-a
+    bool _haveLast;
+    LogCollectorStats _stats;
+
+    portMUX_TYPE _mux;
+
+    bool pickNext(uint32_t now);
+    static void onReply(BusTransaction& txn);
+};
+
+#endif // LOG_COLLECTOR_H
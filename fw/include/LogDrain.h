@@ -0,0 +1,92 @@
+#ifndef LOG_DRAIN_H
+#define LOG_DRAIN_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "RS485Bus.h"
+
+// Komande kontrolera (CommandType u main.cpp)
+#define LOG_DRAIN_READ_CMD       0xCE     // CMD_READ_LOG:   [CMD][16][16 bajta zapisa][addr H][addr L]
+#define LOG_DRAIN_DELETE_CMD     0xCF     // CMD_DELETE_LOG: [CMD][0 = LOGGER_OK, 1 = LOGGER_EMPTY]...
+#define LOG_DRAIN_FRAME_TYPE     23       // S_CUSTOM
+
+#define LOG_DRAIN_JOBS           2        // Istovremenih drain sesija
+#define LOG_DRAIN_RING           32       // Pročitanih zapisa koji čekaju klijenta (~1 poll interval AsyncTCP-a)
+#define LOG_DRAIN_ENTRY_SIZE     16
+#define LOG_DRAIN_LINE_MAX       384      // Jedna NDJSON linija
+#define LOG_DRAIN_ORPHAN_MS      600000UL // Napuštena sesija čuva nepreuzete zapise 10 min
+#define LOG_DRAIN_MAX_LIMIT      1000
+
+// Jedan zapis (bajtovi 2..17 READ_LOG odgovora) -> JSON objekat bez '\n'; vraća dužinu
+typedef size_t (*LogEntryFormatter)(char* out, size_t max, uint8_t id, const uint8_t* entry);
+
+// Zapis napuštene sesije, već obrisan na kontroleru, nakon isteka LOG_DRAIN_ORPHAN_MS (loop()); false = nije sačuvan
+typedef bool (*LogOrphanSink)(uint8_t id, const uint8_t* entry);
+
+enum LogDrainState : uint8_t {
+    LOG_DRAIN_FREE,
+    LOG_DRAIN_READY,         // Sljedeći upit čeka (mjesto u ringu ili slobodan red busa)
+    LOG_DRAIN_BUSY,          // READ ili DELETE na busu
+    LOG_DRAIN_DONE,
+};
+
+class LogDrain;
+
+struct LogDrainJob {
+    LogDrain* owner;         // Bus callback dobija samo job (txn.arg)
+    LogDrainState state;
+    uint8_t id;
+    RS485Bus* bus;
+    bool remove;             // false: samo trenutni zapis, bez DELETE_LOG
+    bool pendingDelete;      // Zadnji pročitani zapis je u ringu, još nije obrisan na kontroleru
+    bool attached;           // Klijent čita; false = napušteno, čeka preuzimanje ili istek
+    bool trailerSent;
+    uint16_t limit;
+    uint16_t produced;       // Zapisa pročitanih u ovoj sesiji
+    uint16_t delivered;
+    const char* reason;      // Zašto je DONE: empty, limit, read_only, timeout...
+    uint32_t detachedAt;
+
+    uint8_t ring[LOG_DRAIN_RING][LOG_DRAIN_ENTRY_SIZE];
+    uint8_t head;
+    uint8_t count;
+
+    char line[LOG_DRAIN_LINE_MAX];
+    uint16_t lineLen;
+    uint16_t linePos;
+};
+
+/**
+ * Pražnjenje access loga kontrolera (READ_LOG / DELETE_LOG petlja) na uređaju.
+ *
+ * Bus callbackovi izmjenjuju READ i DELETE bez čekanja klijenta i pune ring pročitanih zapisa;
+ * chunked HTTP odgovor (fill) ih formatira kao NDJSON. Kada je ring pun petlja staje, pa brzina
+ * ne prelazi ono što klijent preuzima. Ako klijent ode, novi DELETE se ne šalje, a zapisi iz ringa
+ * (već obrisani na kontroleru) čekaju sljedeći drain istog ID-a LOG_DRAIN_ORPHAN_MS, pa idu u orphan sink.
+ */
+class LogDrain {
+public:
+    LogDrain(LogEntryFormatter formatter, LogOrphanSink orphans = NULL);
+
+    // Nova sesija ili preuzimanje napuštene za isti ID; NULL ako je ID već aktivan ili nema slota
+    LogDrainJob* start(RS485Bus& bus, uint8_t id, bool remove, uint16_t limit, bool& busy);
+
+    // AwsResponseFiller: RESPONSE_TRY_AGAIN dok čeka bus, 0 na kraju
+    size_t fill(LogDrainJob* job, uint8_t* buf, size_t maxLen);
+    void detach(LogDrainJob* job);    // onDisconnect
+    void tick();                      // loop(): ponovi upite odbijene zbog punog reda, istek napuštenih
+    bool active(uint8_t id);          // Sesija (i napuštena) za ID - LogCollector ga tada preskače
+
+private:
+    LogDrainJob _jobs[LOG_DRAIN_JOBS];
+    LogEntryFormatter _formatter;
+    LogOrphanSink _orphans;
+    portMUX_TYPE _mux;
+
+    void advance(LogDrainJob* job);
+    void finish(LogDrainJob* job, const char* reason);
+    void releaseIfIdle(LogDrainJob* job);
+    static void onReply(BusTransaction& txn);
+};
+
+#endif // LOG_DRAIN_H
@@ -0,0 +1,126 @@
+#ifndef LOG_STORE_H
+#define LOG_STORE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "ExternalFlash.h"
+
+#define LOG_STORE_SECTOR_SIZE        4096
+#define LOG_STORE_SECTORS            (FW_SLOT_SIZE / LOG_STORE_SECTOR_SIZE) // Sektor 0 = zaglavlje, 1..255 = ring
+#define LOG_STORE_RECORD_SIZE        32
+#define LOG_STORE_RECORDS_PER_SECTOR 126                                    // + 64 B sažetak na kraju sektora
+#define LOG_STORE_SUMMARY_OFFSET     (LOG_STORE_RECORDS_PER_SECTOR * LOG_STORE_RECORD_SIZE)
+#define LOG_STORE_BLOOM_BYTES        56
+#define LOG_STORE_BLOOM_HASHES       3
+#define LOG_STORE_CAPACITY           ((LOG_STORE_SECTORS - 1) * LOG_STORE_RECORDS_PER_SECTOR)
+
+#define LOG_STORE_MAGIC              "HBLOG01"
+#define LOG_RECORD_COMMIT            0xA5   // Programira se zadnji - prekinut upis ostaje 0xFF
+#define LOG_SUMMARY_MAGIC            0x5A
+
+#define LOG_QUERY_SCAN_BUDGET        1024   // Zapisa pročitanih po next() pozivu (async_tcp task)
+#define LOG_DAY_ANY_FROM             0
+#define LOG_DAY_ANY_TO               0xFFFF
+
+struct __attribute__((packed)) LogRecord {
+    uint8_t commit;          // LOG_RECORD_COMMIT kada je zapis cijeli
+    uint8_t id;              // Kontroler
+    uint16_t day;            // Dana od 01.01.2000 (iz BCD datuma zapisa), 0 = nevažeći datum
+    uint32_t seq;            // Globalni redni broj - najveći određuje glavu ringa nakon restarta
+    uint32_t storedAt;       // Unix vrijeme prijema na bridge, 0 = vrijeme nije bilo sinhronizovano
+    uint8_t entry[16];       // Zapis kontrolera kao u READ_LOG (log_id, event, type, group, card_id, BCD datum/vrijeme)
+    uint8_t reserved[4];
+};
+
+struct __attribute__((packed)) LogSectorSummary {
+    uint8_t magic;
+    uint8_t count;
+    uint16_t minDay;
+    uint16_t maxDay;
+    uint8_t reserved[2];
+    uint8_t bloom[LOG_STORE_BLOOM_BYTES];   // card_id zapisa sektora
+};
+
+enum LogQueryStep : uint8_t {
+    LOG_Q_MATCH,             // out je popunjen
+    LOG_Q_AGAIN,             // Budžet potrošen - pozovi ponovo
+    LOG_Q_END,
+};
+
+// Filter i kursor jednog upita; od najnovijeg zapisa prema najstarijem
+struct LogQuery {
+    uint8_t id;              // 0 = svi kontroleri
+    bool byCard;
+    uint8_t card[5];
+    uint16_t fromDay;
+    uint16_t toDay;
+
+    uint16_t sector;
+    int16_t record;
+    uint16_t visited;
+    bool sectorChecked;
+    uint32_t scanned;        // Pročitanih zapisa
+    uint32_t skippedSectors; // Preskočenih po indeksu (dan, card_id)
+};
+
+struct LogStoreStats {
+    uint32_t records;        // Trenutno u ringu
+    uint32_t capacity;
+    uint32_t appended;
+    uint32_t overwritten;    // Najstariji zapisi obrisani kada se ring zatvori
+    uint32_t writeFailures;
+    uint32_t nextSeq;
+};
+
+/**
+ * Append-only spremište logova kontrolera u jednom slotu W25Q64 (LOG_STORE_SLOT, 1 MB).
+ *
+ * Sektor 0 je zaglavlje formata, sektori 1..255 su ring od po 126 zapisa od 32 B. Kada se sektor napuni,
+ * na njegov kraj se upisuje sažetak (najmanji/najveći dan i Bloom filter card_id-a) i briše se najstariji
+ * sektor. U RAM-u je samo raspon dana i broj zapisa po sektoru (~1.3 KB); upit preskače sektore čiji
+ * raspon dana ili Bloom filter ne odgovara, bez čitanja zapisa.
+ */
+class LogStore {
+public:
+    LogStore(ExternalFlash& flash, int slot);
+
+    bool begin();            // Nakon extFlash.begin(): formatiranje ili pronalazak glave ringa
+    bool ready() { return _ready; }
+
+    bool append(uint8_t id, const uint8_t* entry, uint32_t storedAt);   // loop() - piše flash
+    void startQuery(LogQuery& q);
+    LogQueryStep next(LogQuery& q, LogRecord& out);
+
+    void getStats(LogStoreStats& out);
+
+    static uint16_t dayNumber(uint8_t day, uint8_t month, uint16_t year);
+    static uint16_t entryDay(const uint8_t* entry);
+
+private:
+    ExternalFlash& _flash;
+    int _slot;
+    bool _ready;
+
+    uint16_t _head;
+    uint8_t _headCount;
+    uint32_t _nextSeq;
+    uint8_t _headBloom[LOG_STORE_BLOOM_BYTES];
+
+    uint8_t _count[LOG_STORE_SECTORS];
+    uint16_t _minDay[LOG_STORE_SECTORS];
+    uint16_t _maxDay[LOG_STORE_SECTORS];
+
+    LogStoreStats _stats;
+    portMUX_TYPE _mux;
+
+    static uint32_t offsetOf(uint16_t sector, int record);
+    static void bloomAdd(uint8_t* bloom, const uint8_t* card);
+    static bool bloomHas(const uint8_t* bloom, const uint8_t* card);
+    bool format();
+    void scanSector(uint16_t sector, uint8_t& used, uint8_t& valid, uint16_t& minDay, uint16_t& maxDay,
+                    uint8_t* bloom, uint32_t& maxSeq);
+    void writeSummary(uint16_t sector, uint8_t count, uint16_t minDay, uint16_t maxDay, const uint8_t* bloom);
+    void sealHead();
+};
+
+#endif // LOG_STORE_H
@@ -0,0 +1,260 @@
+#ifndef RS485_BUS_H
+#define RS485_BUS_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+extern "C" {
+    #include "TinyFrame.h"
+}
+#include "BusTrace.h"
+#include "BusBufferPool.h"
+
+// Bus task parametri
+#define BUS_TASK_STACK           6144
+#define BUS_TASK_PRIORITY        5     // iznad loop() (1), ispod WiFi/lwIP taskova
+#define BUS_TASK_CORE            1
+#define BUS_RX_BUFFER_SIZE       2048  // UART driver ring buffer (default je 256 bajtova)
+#define BUS_RX_CHUNK             128   // Blok koji se odjednom predaje TF_Accept()
+#define BUS_IDLE_WAIT_MS         20    // Bez aktivne transakcije task spava dok ne stigne RX ili novi posao
+
+// Dubina reda po klasi prioriteta
+#define BUS_QUEUE_LEN_ACCESS     4
+#define BUS_QUEUE_LEN_WRITE      8
+#define BUS_QUEUE_LEN_READ       8
+#define BUS_QUEUE_LEN_LOG        4
+#define BUS_QUEUE_LEN_FIRMWARE   2
+#define BUS_QUEUE_LEN            (BUS_QUEUE_LEN_ACCESS + BUS_QUEUE_LEN_WRITE + BUS_QUEUE_LEN_READ + \
+                                  BUS_QUEUE_LEN_LOG + BUS_QUEUE_LEN_FIRMWARE)
+#define BUS_TXN_POOL             (BUS_QUEUE_LEN + 2) // Redovi + aktivna + jedna u završavanju
+
+// Starvation zaštita: transakcija napreduje za jednu klasu za svakih BUS_AGING_STEP_MS čekanja
+#define BUS_AGING_STEP_MS        250
+#define BUS_MAX_PAYLOAD          BUS_BUF_LARGE_SIZE // TX/RX payload - bafer po veličini iz BusBufferPool
+#define BUS_DEFAULT_TIMEOUT_MS   (TF_PARSER_TIMEOUT_TICKS * 10)
+
+// Oporavak busa (parser, ID listeneri, UART) umjesto restarta uređaja
+#define BUS_RECOVER_IDLE_MS      10    // Linija mora biti tiha ovoliko prije nastavka
+#define BUS_RECOVER_IDLE_MAX_MS  200   // Najduže čekanje na tišinu
+#define BUS_RECOVER_WINDOW_MS    60000
+#define BUS_RECOVER_MAX          3     // Više oporavaka u prozoru -> recoveryExhausted()
+
+#define BUS_BAUD_SETTLE_MS       20    // Bus miruje nakon promjene brzine - kontroleri prebacuju UART
+
+enum BusResult {
+    BUS_OK,
+    BUS_TIMEOUT,
+    BUS_SEND_FAILED,   // TinyFrame nije mogao poslati frame (npr. nema slobodnog ID listenera)
+    BUS_ABORTED,       // Prekinuto oporavkom busa - ništa se ne zna o odgovoru
+    BUS_NO_BUFFER,     // Odgovor stigao, ali nema slobodnog bafera njegove veličine
+    BUS_RESULT_COUNT
+};
+
+// Klase prioriteta - manji broj = veći prioritet
+enum BusClass {
+    BUS_CLASS_ACCESS,     // OPEN_DOOR, lozinke - gost čeka pred vratima
+    BUS_CLASS_WRITE,      // Setpoint i ostale SET komande, RTC
+    BUS_CLASS_READ,       // GET komande (dashboard polling)
+    BUS_CLASS_LOG,        // READ_LOG / DELETE_LOG drain
+    BUS_CLASS_FIRMWARE,   // Firmware update paketi
+    BUS_CLASS_COUNT
+};
+
+// Statistika jedne klase (kopija za /bus_status)
+struct BusClassStats {
+    uint16_t depth;        // Trenutno u redu
+    uint16_t capacity;
+    uint32_t enqueued;
+    uint32_t rejected;     // Red pun
+    uint32_t started;
+    uint32_t aged;         // Pokrenuto ispred višeg prioriteta zbog starosti
+    uint32_t coalesced;    // Pridruženo identičnoj transakciji u toku - bez novog frame-a
+    uint32_t waitLastMs;   // Čekanje u redu do početka slanja
+    uint32_t waitMaxMs;
+    uint32_t waitAvgMs;    // EWMA, alpha = 1/8
+};
+
+// Brojači fizičkog sloja i parsera (kumulativni od boot-a)
+struct BusCounters {
+    uint32_t framesTx;
+    uint32_t framesRx;         // Ispravni frame-ovi
+    uint32_t bytesTx;
+    uint32_t bytesRx;
+    uint32_t txBytesPerSec;    // Zadnja puna sekunda
+    uint32_t rxBytesPerSec;
+    uint32_t headCrcErrors;
+    uint32_t dataCrcErrors;
+    uint32_t oversize;         // LEN > TF_MAX_PAYLOAD_RX
+    uint32_t parserTimeouts;
+    uint32_t unhandled;        // Frame bez listenera - najčešće odgovor koji je stigao nakon timeouta
+    uint32_t listenerFull;     // TF_Query odbijen - popunjeno TF_MAX_ID_LST
+    uint32_t results[BUS_RESULT_COUNT]; // Završene transakcije po BusResult
+};
+
+struct BusRecoveryStats {
+    uint32_t recoveries;
+    uint32_t uartReinits;
+    uint32_t aborted;          // Aktivne transakcije prekinute oporavkom
+    uint32_t discardedBytes;   // Bajtovi izbačeni iz RX-a tokom oporavka
+    uint32_t lastAtMs;         // millis() zadnjeg oporavka, 0 = nikad
+    uint8_t recent;            // Oporavci u tekućem prozoru
+    bool exhausted;
+};
+
+struct BusTransaction;
+
+// Completion callback - poziva se iz bus taska kada transakcija završi
+typedef void (*BusCallback)(BusTransaction& txn);
+
+struct BusTransaction {
+    uint32_t ticket;           // 0 = slobodan slot
+    BusClass cls;
+    uint32_t enqueuedAt;       // millis() u trenutku stavljanja u red
+    TF_TYPE type;
+    uint8_t* tx;               // Iz BusBufferPool, veličine payload-a; pratilac ga odmah vraća
+    uint16_t txLen;
+    bool expectReply;
+    uint16_t timeoutMs;
+    uint32_t sendBaud;         // != 0: UART na ovu brzinu prije slanja (samo send)
+    uint32_t nextBaud;         // != 0: UART ostaje na ovoj brzini nakon slanja
+    volatile bool cancelled;   // Klijent otišao - ne zovi callback
+    bool shareable;            // Read-only: identičan upit može dijeliti odgovor
+    bool isFollower;           // Čeka odgovor tuđe transakcije, nije u redu
+    BusTransaction* followers; // Lanac pratilaca koji dobijaju isti odgovor
+    BusTransaction* nextFollower;
+
+    BusCallback callback;
+    void* arg;                 // npr. AsyncWebServerRequest*
+    uint32_t tag;              // Slobodan podatak pozivaoca (CMD, ID...)
+
+    BusResult result;
+    uint32_t startedAt;        // millis() kada je frame poslan
+    uint32_t rttMs;            // Vrijeme od slanja do odgovora (BUS_OK)
+    uint8_t* reply;            // BUS_OK: bafer veličine LEN polja, važi samo do povratka iz callbacka
+    uint16_t replyLen;
+};
+
+/**
+ * RS485 bus engine.
+ *
+ * Jedan FreeRTOS task posjeduje UART i TinyFrame instancu: prima bajtove, tick-a parser
+ * i izvršava transakcije iz reda jednu po jednu (half-duplex, single master).
+ * Task budi UART onReceive događaj ili novi posao u redu (task notify); primljeni bajtovi
+ * se iz driver ring buffera predaju parseru u blokovima.
+ * HTTP handleri i ostali servisi samo stavljaju transakcije u red i dobijaju rezultat
+ * kroz callback, umjesto da blokiraju AsyncTCP task čekajući odgovor.
+ *
+ * Svaki RS485 segment ima svoju instancu (UART, DE pin, TinyFrame, task), pa segmenti
+ * izvršavaju transakcije istovremeno.
+ *
+ * Svaka klasa prioriteta ima svoj ograničen red. Sljedeća transakcija je ona sa najvećim
+ * efektivnim prioritetom (klasa umanjena za starost), pa OPEN_DOOR ne čeka iza READ_LOG
+ * ili firmware paketa, a niže klase i dalje napreduju pod opterećenjem.
+ */
+class RS485Bus {
+public:
+    // rxPin/txPin = -1 -> podrazumijevani pinovi UART-a; name = ime bus taska (više segmenata)
+    RS485Bus(HardwareSerial& serial, int dePin, int rxPin = -1, int txPin = -1, const char* name = "rs485");
+
+    // Registracija listenera - pozvati prije begin()
+    bool addTypeListener(TF_TYPE type, TF_Listener cb);
+
+    bool begin(uint32_t baud);
+
+    // Query: šalje frame i čeka odgovor sa istim frame ID-om.
+    // Vraća ticket (> 0) ili 0 ako je red pun.
+    // shareable: identičan (type, payload) upit koji je već u redu ili na busu se ne šalje
+    // ponovo - pozivalac dobija isti odgovor. Samo za read-only komande!
+    uint32_t query(BusClass cls, TF_TYPE type, const uint8_t* data, uint16_t len, uint16_t timeoutMs,
+                   BusCallback cb, void* arg, uint32_t tag = 0, bool shareable = false);
+
+    // Fire-and-forget frame (RTC broadcast, firmware paketi...)
+    bool send(BusClass cls, TF_TYPE type, const uint8_t* data, uint16_t len);
+
+    // Fire-and-forget frame na brzini sendBaud, nakon kojeg bus nastavlja na nextBaud (0 = bez promjene).
+    // Promjena se izvršava u bus tasku između transakcija, pa ni jedan frame ne ide "preko" nje.
+    bool sendAtBaud(BusClass cls, TF_TYPE type, const uint8_t* data, uint16_t len, uint32_t sendBaud, uint32_t nextBaud);
+
+    uint32_t baud() { return _baud; }
+
+    // Nema aktivne transakcije ni ničega u redovima - slot za pozadinske poslove (RTC)
+    bool isIdle();
+
+    // Otkaži callback transakcije (npr. klijent zatvorio konekciju)
+    void cancel(uint32_t ticket);
+
+    // Zatraži oporavak (izvršava bus task): ID listeneri, drain UART-a, tišina na liniji, reset parsera.
+    // Ponovljen oporavak u BUS_RECOVER_WINDOW_MS re-inicijalizuje i UART.
+    void recover(bool reinitUart = false);
+
+    // Više od BUS_RECOVER_MAX oporavaka u prozoru - bus se ne oporavlja, restart je zadnja opcija
+    bool recoveryExhausted() { return _recovery.exhausted; }
+    void getRecoveryStats(BusRecoveryStats& out);
+
+    // TF_WriteImpl -> fizički sloj
+    void write(const uint8_t* buff, uint32_t len);
+
+    TinyFrame* tf() { return &_tf; }
+    BusTrace& trace() { return _trace; }
+
+    // TF_FrameHook -> trace primljenih/odbačenih frame-ova
+    void onFrame(TF_FrameStatus status);
+
+    void getStats(BusClass cls, BusClassStats& out);
+    void getBufferStats(int cls, BusBufferStats& out) { _buffers.getStats(cls, out); }
+    void getCounters(BusCounters& out);
+    static const char* className(BusClass cls);
+    static const char* resultName(BusResult result);
+
+private:
+    HardwareSerial& _serial;
+    int _dePin;
+    int _rxPin;
+    int _txPin;
+    const char* _name;
+    volatile uint32_t _baud;
+    TinyFrame _tf;
+    BusTrace _trace;
+    uint32_t _txRemaining;     // Bajtovi frame-a koji TinyFrame još šalje u sljedećim write() blokovima
+
+    TaskHandle_t _task;
+    QueueHandle_t _queues[BUS_CLASS_COUNT];
+    BusClassStats _stats[BUS_CLASS_COUNT];
+    SemaphoreHandle_t _lock;   // Štiti pool i completion od cancel() iz drugih taskova
+
+    BusTransaction _pool[BUS_TXN_POOL];
+    BusBufferPool _buffers;
+    BusTransaction* _active;
+    uint32_t _nextTicket;
+
+    BusCounters _counters;     // Piše samo bus task
+    uint32_t _rateWindowStart;
+    uint32_t _rateTxBase;
+    uint32_t _rateRxBase;
+
+    volatile uint8_t _recoverRequest;  // 0 = ništa, 1 = parser/RX, 2 = i UART re-init
+    BusRecoveryStats _recovery;
+    uint32_t _recoverWindowStart;
+
+    BusTransaction* allocate(uint16_t txLen);
+    void release(BusTransaction* txn);
+    uint32_t enqueue(BusTransaction* txn, bool shareable = false);
+    BusTransaction* dequeueNext();
+    bool attachFollower(BusTransaction* txn);
+    bool dropIfCancelled(BusTransaction* txn);
+
+    static void taskEntry(void* self);
+    void run();
+    void startNext();
+    void complete(BusTransaction* txn, BusResult result);
+    void doRecover(bool reinitUart);
+    void applyBaud(uint32_t baud);
+    void traceTx(const uint8_t* buff, uint32_t len);
+    void updateRates(uint32_t now);
+
+    static TF_Result replyListener(TinyFrame* tf, TF_Msg* msg);
+};
+
+#endif // RS485_BUS_H
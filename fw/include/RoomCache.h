@@ -0,0 +1,60 @@
+#ifndef ROOM_CACHE_H
+#define ROOM_CACHE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+
+// Direktno indeksiran keš: red po ID-u kontrolera (1..254), fiksni slot po keširanoj komandi.
+// Red (ROOM_CACHE_CMDS x Entry = 288 B) se alocira pri prvom odgovoru tog ID-a i ostaje -
+// RAM raste sa brojem kontrolera koji su odgovorili, najviše ~73 KB za svih 254.
+#define ROOM_CACHE_IDS         254
+#define ROOM_CACHE_CMDS        8     // Komande sa TTL > 0 u roomCacheTtl()
+#define ROOM_CACHE_ENTRIES     (ROOM_CACHE_IDS * ROOM_CACHE_CMDS)
+#define ROOM_CACHE_MAX_REPLY   24    // Najduži keširani odgovor je GET_VERSION (21 bajt)
+
+struct RoomCacheStats {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t stores;
+    uint32_t invalidations;
+    uint16_t used;
+};
+
+/**
+ * Read-through keš odgovora kontrolera.
+ *
+ * Čuva sirovi RS485 odgovor po (ID kontrolera, komanda) zajedno sa vremenom prijema i TTL-om,
+ * tako da se isti dekoder (sendRs485Reply) koristi i za svjež i za keširan odgovor.
+ * Svaki (ID, komanda) ima svoj slot, pa se unosi nikad ne istiskuju međusobno.
+ * Pristupa mu AsyncTCP task (lookup) i RS485 bus task (store/invalidate), zaštićeno spinlock-om.
+ */
+class RoomCache {
+public:
+    RoomCache();
+
+    // Vraća true ako postoji odgovor mlađi od min(TTL, maxAgeMs)
+    bool lookup(uint8_t id, uint8_t cmd, uint32_t maxAgeMs, uint8_t* out, uint16_t& len, uint32_t& ageMs);
+
+    void store(uint8_t id, uint8_t cmd, const uint8_t* data, uint16_t len, uint32_t ttlMs);
+    void invalidate(uint8_t id, uint8_t cmd);
+    void invalidateAll(uint8_t id);
+
+    void getStats(RoomCacheStats& out);
+
+private:
+    struct Entry {
+        uint32_t storedAt;
+        uint32_t ttlMs;
+        uint8_t len;           // 0 = prazan slot
+        uint8_t data[ROOM_CACHE_MAX_REPLY];
+    };
+
+    Entry* _rows[ROOM_CACHE_IDS];    // NULL dok ID ne odgovori na keširanu komandu
+    RoomCacheStats _stats;
+    portMUX_TYPE _mux;
+
+    static int slotFor(uint8_t cmd);
+    Entry* find(uint8_t id, uint8_t cmd);
+};
+
+#endif // ROOM_CACHE_H
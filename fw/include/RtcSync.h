@@ -0,0 +1,68 @@
+#ifndef RTC_SYNC_H
+#define RTC_SYNC_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "ControllerRoster.h"
+
+#define RTC_CHECK_MS             300000UL  // Očitavanje sata jednog kontrolera segmenta (round-robin)
+#define RTC_DRIFT_MAX_S          2         // Veće odstupanje -> broadcast
+#define RTC_SYNC_MAX_MS          3600000UL // Broadcast bar jednom na sat (firmware bez GET_RTC, neočitani kontroleri)
+#define RTC_MAX_DEFER_MS         30000     // Bus bez praznog slota ovoliko dugo -> šalji svejedno
+#define RTC_READ_TIMEOUT_MS      60
+
+enum RtcAction : uint8_t {
+    RTC_ACT_BROADCAST,       // SET_RTC_DATE_TIME na DEF_TFBRA, vrijeme u trenutku slanja
+    RTC_ACT_READ,            // GET_RTC_DATE_TIME za id
+};
+
+struct RtcSyncStats {
+    uint32_t broadcasts;
+    uint32_t deferredSends;  // Poslano bez praznog slota nakon RTC_MAX_DEFER_MS
+    uint32_t checks;
+    uint32_t readFailures;   // Timeout ili firmware bez GET_RTC
+    int32_t lastDriftS;      // Kontroler - ESP32, sekunde
+    uint8_t lastDriftId;     // 0 = još nema očitanja
+    uint32_t lastBroadcastAgoMs;
+    const char* lastReason;  // "boot", "drift", "interval", "manual"
+    bool pending;
+};
+
+/**
+ * Sinhronizacija RTC-a kontrolera jednog RS485 segmenta.
+ *
+ * Umjesto broadcast-a svake minute iz Ticker-a: loop() pita nextStep() samo kada je bus prazan
+ * (nema aktivne transakcije ni ničega u redu), pa RTC frame ne čeka ispred gosta ni firmware paketa.
+ * Povremeno se očita sat jednog kontrolera; broadcast ide samo kada odstupanje pređe RTC_DRIFT_MAX_S,
+ * nakon boot-a/ručnog podešavanja vremena i najmanje jednom u RTC_SYNC_MAX_MS.
+ */
+class RtcSync {
+public:
+    RtcSync(uint8_t segment, ControllerRoster& roster, uint8_t (*segmentOf)(uint8_t id));
+
+    // true -> izvrši action (za RTC_ACT_READ i id); busIdle = bus bez aktivne transakcije i reda
+    bool nextStep(bool busIdle, RtcAction& action, uint8_t& id);
+    void onBroadcast(bool queued);
+    void onReadResult(uint8_t id, bool ok, int32_t driftS); // Iz bus taska
+    void requestBroadcast(const char* reason);
+
+    void getStats(RtcSyncStats& out);
+
+private:
+    uint8_t _segment;
+    ControllerRoster& _roster;
+    uint8_t (*_segmentOf)(uint8_t id);
+
+    const char* _pendingReason;   // != NULL -> broadcast čeka prazan slot
+    uint32_t _pendingSince;
+    uint32_t _lastBroadcastAt;
+    uint32_t _nextCheckAt;
+    uint8_t _cursor;
+    bool _inFlight;
+    bool _idleAtStep;             // Za deferredSends u onBroadcast()
+    RtcSyncStats _stats;
+
+    portMUX_TYPE _mux;
+};
+
+#endif // RTC_SYNC_H
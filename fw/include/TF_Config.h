@@ -203,4 +203,5 @@ typedef uint8_t TF_COUNT;
 #define TF_MAX_GEN_LST  5
 #define TF_PARSER_TIMEOUT_TICKS 50
 #define TF_Error(format, ...) 
+#define TF_USE_FRAME_HOOK 1   // TF_FrameHook() za svaki primljen/odbačen frame (RS485Bus trace)
 #endif //TF_CONFIG_H
@@ -475,6 +475,26 @@ struct TinyFrame_ {
  */
 extern void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len);
 
+#if TF_USE_FRAME_HOOK
+
+    /** Ishod parsiranja jednog frame-a */
+    typedef enum {
+        TF_FRAME_OK,              //!< Frame ispravan, slijedi TF_HandleReceivedMessage
+        TF_FRAME_HEAD_CKSUM,      //!< Checksum zaglavlja ne odgovara
+        TF_FRAME_DATA_CKSUM,      //!< Checksum podataka ne odgovara
+        TF_FRAME_TOO_LONG,        //!< LEN > TF_MAX_PAYLOAD_RX, podaci odbačeni
+        TF_FRAME_PARSER_TIMEOUT,  //!< Frame prekinut usred prijema
+        TF_FRAME_UNHANDLED,       //!< Ispravan frame (već prijavljen kao OK) koji nijedan listener nije preuzeo
+    } TF_FrameStatus;
+
+    /**
+     * Poziva parser kada završi ili odbaci frame; tf->id, tf->type, tf->len i tf->data
+     * opisuju frame u trenutku poziva. Mora biti kratka - izvršava se u TF_AcceptChar().
+     */
+    extern void TF_FrameHook(TinyFrame *tf, TF_FrameStatus status);
+
+#endif
+
 // Mutex functions
 #if TF_USE_MUTEX
 
@@ -0,0 +1,277 @@
+#include "BulkCommand.h"
+#include <ESPAsyncWebServer.h>
+
+BulkCommand::BulkCommand(RS485Bus& (*busFor)(uint8_t id), uint8_t (*segmentOf)(uint8_t id),
+                         uint16_t (*timeoutFor)(uint8_t id, BusClass cls), BulkObserver observer)
+    : _busFor(busFor), _segmentOf(segmentOf), _timeoutFor(timeoutFor), _observer(observer) {
+    memset(_jobs, 0, sizeof(_jobs));
+    _mux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+static uint16_t mapCount(const uint32_t* map) {
+    uint16_t n = 0;
+    for (int w = 0; w < BULK_MAP_WORDS; w++) n += __builtin_popcount(map[w]);
+    return n;
+}
+
+bool BulkCommand::available() {
+    bool found = false;
+
+    portENTER_CRITICAL(&_mux);
+    for (int i = 0; i < BULK_JOBS && !found; i++) found = !_jobs[i].used;
+    portEXIT_CRITICAL(&_mux);
+
+    return found;
+}
+
+BulkJob* BulkCommand::start(const uint8_t* frame, uint16_t len, BusClass cls, bool shareable,
+                            const uint32_t* ids, const uint32_t* broadcast, const uint32_t* offline) {
+    if (len < 2 || len > BULK_FRAME_MAX) return NULL;
+
+    BulkJob* job = NULL;
+
+    portENTER_CRITICAL(&_mux);
+    for (int i = 0; i < BULK_JOBS; i++) {
+        if (_jobs[i].used) continue;
+        job = &_jobs[i];
+        job->used = true;
+        job->attached = false; // Callbackova još nema - ostatak se puni van spinlock-a
+        break;
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    if (job == NULL) return NULL;
+
+    memset(job->pending, 0, sizeof(job->pending));
+    memset(job->inFlight, 0, sizeof(job->inFlight));
+    memcpy(job->broadcast, broadcast, sizeof(job->broadcast));
+    memcpy(job->offline, offline, sizeof(job->offline));
+    memcpy(job->frame, frame, len);
+    job->owner = this;
+    job->len = len;
+    job->cls = cls;
+    job->shareable = shareable;
+    job->presetCursor = 1;
+    job->trailerSent = false;
+    job->head = 0;
+    job->count = 0;
+    job->lineLen = 0;
+    job->linePos = 0;
+    job->ok = 0;
+    job->failed = 0;
+    job->unconfirmed = mapCount(broadcast);
+    job->skipped = mapCount(offline);
+    job->total = mapCount(ids) + job->unconfirmed + job->skipped;
+
+    for (int id = 1; id <= BULK_MAX_ID; id++) {
+        if (!mapHas(ids, id)) continue;
+        uint8_t seg = _segmentOf(id);
+        mapSet(job->pending[seg < ROUTING_SEGMENTS ? seg : 0], id);
+    }
+
+    portENTER_CRITICAL(&_mux);
+    job->attached = true;
+    portEXIT_CRITICAL(&_mux);
+
+    for (uint8_t s = 0; s < ROUTING_SEGMENTS; s++) advance(job, s);
+    return job;
+}
+
+void BulkCommand::advance(BulkJob* job, uint8_t seg) {
+    for (;;) {
+        int id = -1;
+
+        portENTER_CRITICAL(&_mux);
+        int inFlight = 0;
+        for (int s = 0; s < ROUTING_SEGMENTS; s++) inFlight += job->inFlight[s];
+        // Svaki upit u toku ima rezervisano mjesto u ringu
+        if (job->used && job->attached && job->inFlight[seg] < BULK_WINDOW && job->count + inFlight < BULK_RING) {
+            for (int w = 0; w < BULK_MAP_WORDS && id < 0; w++) {
+                if (job->pending[seg][w]) id = w * 32 + __builtin_ctz(job->pending[seg][w]);
+            }
+            if (id >= 0) {
+                mapClear(job->pending[seg], id);
+                job->inFlight[seg]++;
+            }
+        }
+        portEXIT_CRITICAL(&_mux);
+
+        if (id < 0) return;
+
+        uint8_t frame[BULK_FRAME_MAX];
+        memcpy(frame, job->frame, job->len); // job->frame se ne mijenja dok je slot zauzet
+        frame[1] = id;
+
+        uint32_t tag = (uint32_t)id | ((uint32_t)seg << 8);
+        if (_busFor(id).query(job->cls, BULK_FRAME_TYPE, frame, job->len, _timeoutFor(id, job->cls),
+                              onReply, job, tag, job->shareable) == 0) {
+            portENTER_CRITICAL(&_mux);
+            mapSet(job->pending[seg], id); // Red pun - tick() ponavlja
+            job->inFlight[seg]--;
+            portEXIT_CRITICAL(&_mux);
+            releaseIfIdle(job);
+            return;
+        }
+    }
+}
+
+void BulkCommand::onReply(BusTransaction& txn) {
+    BulkJob* job = static_cast<BulkJob*>(txn.arg);
+    BulkCommand* self = job->owner;
+    uint8_t id = txn.tag & 0xFF;
+    uint8_t seg = (txn.tag >> 8) & 0xFF;
+
+    self->_observer(job->frame[0], id, txn);
+
+    portENTER_CRITICAL(&self->_mux);
+    job->inFlight[seg]--;
+    if (job->attached && txn.result == BUS_ABORTED) {
+        mapSet(job->pending[seg], id); // Oporavak busa - isti ID ponovo
+    } else if (job->attached) {
+        BulkResult& r = job->ring[(job->head + job->count) % BULK_RING];
+        job->count++;
+        r.id = id;
+        r.result = txn.result;
+        r.rttMs = (txn.result == BUS_OK) ? txn.rttMs : 0;
+        r.replyLen = 0;
+        if (txn.result == BUS_OK) {
+            r.replyLen = (txn.replyLen > BULK_REPLY_MAX) ? BULK_REPLY_MAX : txn.replyLen;
+            memcpy(r.reply, txn.reply, r.replyLen);
+            job->ok++;
+        } else {
+            job->failed++;
+        }
+    }
+    portEXIT_CRITICAL(&self->_mux);
+
+    // Samo isti segment - callback drži lock svog busa, tuđi bus bi mogao čekati na njega
+    self->advance(job, seg);
+    self->releaseIfIdle(job);
+}
+
+// Poziva se pod _mux
+bool BulkCommand::nextPreset(BulkJob* job, BulkResult& out) {
+    while (job->presetCursor <= BULK_MAX_ID) {
+        uint8_t id = job->presetCursor++;
+        bool bcast = mapHas(job->broadcast, id);
+        if (!bcast && !mapHas(job->offline, id)) continue;
+
+        out.id = id;
+        out.result = bcast ? BULK_OUT_BROADCAST : BULK_OUT_CIRCUIT_OPEN;
+        out.rttMs = 0;
+        out.replyLen = 0;
+        return true;
+    }
+    return false;
+}
+
+size_t BulkCommand::formatLine(char* out, size_t max, const BulkResult& r) {
+    const char* name;
+    if (r.result == BULK_OUT_BROADCAST) name = "broadcast";
+    else if (r.result == BULK_OUT_CIRCUIT_OPEN) name = "circuit_open";
+    else name = RS485Bus::resultName((BusResult)r.result);
+
+    int len = snprintf(out, max, "{\"id\":%d,\"result\":\"%s\"", r.id, name);
+    if (r.result == BUS_OK) {
+        len += snprintf(out + len, max - len, ",\"rtt_ms\":%u,\"reply\":\"", r.rttMs);
+        for (int i = 0; i < r.replyLen; i++) len += snprintf(out + len, max - len, "%02X", r.reply[i]);
+        len += snprintf(out + len, max - len, "\"");
+    }
+    len += snprintf(out + len, max - len, "}\n");
+    return len;
+}
+
+size_t BulkCommand::fill(BulkJob* job, uint8_t* buf, size_t maxLen) {
+    size_t out = 0;
+    bool freed = false;
+
+    while (out < maxLen) {
+        if (job->linePos < job->lineLen) {
+            size_t n = job->lineLen - job->linePos;
+            if (n > maxLen - out) n = maxLen - out;
+            memcpy(buf + out, job->line + job->linePos, n);
+            out += n;
+            job->linePos += n;
+            continue;
+        }
+
+        BulkResult r;
+        bool haveResult = false;
+        bool trailer = false;
+
+        portENTER_CRITICAL(&_mux);
+        job->lineLen = 0;
+        job->linePos = 0;
+        if (nextPreset(job, r)) {
+            haveResult = true;
+        } else if (job->count > 0) {
+            r = job->ring[job->head];
+            job->head = (job->head + 1) % BULK_RING;
+            job->count--;
+            haveResult = true;
+            freed = true;
+        } else if (!job->trailerSent) {
+            bool idle = true;
+            for (int s = 0; s < ROUTING_SEGMENTS; s++) {
+                if (job->inFlight[s] > 0 || mapCount(job->pending[s]) > 0) idle = false;
+            }
+            if (idle) {
+                job->trailerSent = true;
+                trailer = true;
+            }
+        }
+        portEXIT_CRITICAL(&_mux);
+
+        if (haveResult) {
+            job->lineLen = formatLine(job->line, BULK_LINE_MAX, r);
+        } else if (trailer) {
+            int len = snprintf(job->line, BULK_LINE_MAX,
+                               "{\"done\":true,\"count\":%u,\"ok\":%u,\"failed\":%u,\"broadcast\":%u,\"circuit_open\":%u}\n",
+                               job->total, job->ok, job->failed, job->unconfirmed, job->skipped);
+            job->lineLen = (len > 0 && len < BULK_LINE_MAX) ? len : 0;
+        } else {
+            break;
+        }
+    }
+
+    if (freed) {
+        for (uint8_t s = 0; s < ROUTING_SEGMENTS; s++) advance(job, s);
+    }
+    if (out > 0) return out;
+
+    bool finished;
+    portENTER_CRITICAL(&_mux);
+    finished = job->trailerSent && job->linePos >= job->lineLen;
+    portEXIT_CRITICAL(&_mux);
+    return finished ? 0 : RESPONSE_TRY_AGAIN;
+}
+
+void BulkCommand::releaseIfIdle(BulkJob* job) {
+    portENTER_CRITICAL(&_mux);
+    bool idle = job->used && !job->attached;
+    for (int s = 0; s < ROUTING_SEGMENTS && idle; s++) idle = (job->inFlight[s] == 0);
+    if (idle) job->used = false;
+    portEXIT_CRITICAL(&_mux);
+}
+
+void BulkCommand::detach(BulkJob* job) {
+    portENTER_CRITICAL(&_mux);
+    job->attached = false; // Novi upiti se ne šalju; upiti u toku završavaju bez ringa
+    portEXIT_CRITICAL(&_mux);
+
+    releaseIfIdle(job);
+}
+
+void BulkCommand::tick() {
+    for (int i = 0; i < BULK_JOBS; i++) {
+        BulkJob* job = &_jobs[i];
+        bool retry;
+
+        portENTER_CRITICAL(&_mux);
+        retry = job->used && job->attached;
+        portEXIT_CRITICAL(&_mux);
+
+        if (!retry) continue;
+        for (uint8_t s = 0; s < ROUTING_SEGMENTS; s++) advance(job, s);
+    }
+}
@@ -0,0 +1,82 @@
+#include "BusBufferPool.h"
+
+static const uint16_t classSize[BUS_BUF_CLASSES] = {BUS_BUF_SMALL_SIZE, BUS_BUF_MEDIUM_SIZE, BUS_BUF_LARGE_SIZE};
+static const uint16_t classCount[BUS_BUF_CLASSES] = {BUS_BUF_SMALL_COUNT, BUS_BUF_MEDIUM_COUNT, BUS_BUF_LARGE_COUNT};
+
+BusBufferPool::BusBufferPool() {
+    memset(_stats, 0, sizeof(_stats));
+    for (int c = 0; c < BUS_BUF_CLASSES; c++) {
+        _free[c] = (classCount[c] >= 32) ? 0xFFFFFFFFUL : ((1UL << classCount[c]) - 1);
+        _stats[c].size = classSize[c];
+        _stats[c].count = classCount[c];
+    }
+    _mux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+uint8_t* BusBufferPool::slot(int cls, int index) {
+    switch (cls) {
+        case 0:  return _small[index];
+        case 1:  return _medium[index];
+        default: return _large[index];
+    }
+}
+
+uint8_t* BusBufferPool::alloc(uint16_t len, uint16_t& cap) {
+    uint8_t* buf = NULL;
+    int first = 0;
+    while (first < BUS_BUF_CLASSES && classSize[first] < len) first++;
+    if (first == BUS_BUF_CLASSES) return NULL;
+
+    portENTER_CRITICAL(&_mux);
+    for (int c = first; c < BUS_BUF_CLASSES; c++) {
+        if (_free[c] == 0) continue;
+
+        int index = __builtin_ctz(_free[c]);
+        _free[c] &= ~(1UL << index);
+        BusBufferStats& st = _stats[c];
+        st.allocs++;
+        if (++st.inUse > st.peak) st.peak = st.inUse;
+        buf = slot(c, index);
+        cap = classSize[c];
+        break;
+    }
+    if (buf == NULL) _stats[first].fails++;
+    portEXIT_CRITICAL(&_mux);
+
+    return buf;
+}
+
+void BusBufferPool::release(uint8_t* buf) {
+    if (buf == NULL) return;
+
+    // Klasa i indeks iz adrese - bafer je uvijek iz jednog od tri niza
+    int cls;
+    int index;
+    if (buf >= &_small[0][0] && buf < &_small[0][0] + sizeof(_small)) {
+        cls = 0;
+        index = (buf - &_small[0][0]) / BUS_BUF_SMALL_SIZE;
+    } else if (buf >= &_medium[0][0] && buf < &_medium[0][0] + sizeof(_medium)) {
+        cls = 1;
+        index = (buf - &_medium[0][0]) / BUS_BUF_MEDIUM_SIZE;
+    } else if (buf >= &_large[0][0] && buf < &_large[0][0] + sizeof(_large)) {
+        cls = 2;
+        index = (buf - &_large[0][0]) / BUS_BUF_LARGE_SIZE;
+    } else {
+        return;
+    }
+
+    portENTER_CRITICAL(&_mux);
+    if (!(_free[cls] & (1UL << index))) {
+        _free[cls] |= (1UL << index);
+        _stats[cls].inUse--;
+    }
+    portEXIT_CRITICAL(&_mux);
+}
+
+void BusBufferPool::getStats(int cls, BusBufferStats& out) {
+    if (cls < 0 || cls >= BUS_BUF_CLASSES) return;
+
+    portENTER_CRITICAL(&_mux);
+    out = _stats[cls];
+    portEXIT_CRITICAL(&_mux);
+}
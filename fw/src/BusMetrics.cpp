@@ -0,0 +1,73 @@
+#include "BusMetrics.h"
+
+static const uint16_t rttBoundsMs[METRICS_RTT_BUCKETS - 1] = {2, 5, 10, 20, 50, 100, 200, 500, 1000};
+
+BusMetrics::BusMetrics() {
+    memset(_commands, 0, sizeof(_commands));
+    memset(_commandCodes, 0, sizeof(_commandCodes));
+    memset(_controllers, 0, sizeof(_controllers));
+    _commandCount = 0;
+    _mux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+uint16_t BusMetrics::bucketBound(int bucket) {
+    return (bucket < METRICS_RTT_BUCKETS - 1) ? rttBoundsMs[bucket] : 0;
+}
+
+void BusMetrics::add(RttHistogram& h, uint32_t rttMs) {
+    int b = 0;
+    while (b < METRICS_RTT_BUCKETS - 1 && rttMs > rttBoundsMs[b]) b++;
+    h.buckets[b]++;
+    h.count++;
+    h.sumMs += rttMs;
+}
+
+RttHistogram* BusMetrics::commandSlot(uint8_t cmd) {
+    for (int i = 0; i < _commandCount; i++) {
+        if (_commandCodes[i] == cmd) return &_commands[i];
+    }
+    if (_commandCount >= METRICS_MAX_COMMANDS) return NULL;
+
+    _commandCodes[_commandCount] = cmd;
+    return &_commands[_commandCount++];
+}
+
+void BusMetrics::observeRtt(uint8_t cmd, uint8_t id, uint32_t rttMs) {
+    portENTER_CRITICAL(&_mux);
+    RttHistogram* h = commandSlot(cmd);
+    if (h != NULL) add(*h, rttMs);
+    if (id >= 1 && id <= METRICS_MAX_ID) add(_controllers[id - 1], rttMs);
+    portEXIT_CRITICAL(&_mux);
+}
+
+void BusMetrics::observeTimeout(uint8_t cmd, uint8_t id) {
+    portENTER_CRITICAL(&_mux);
+    RttHistogram* h = commandSlot(cmd);
+    if (h != NULL) h->timeouts++;
+    if (id >= 1 && id <= METRICS_MAX_ID) _controllers[id - 1].timeouts++;
+    portEXIT_CRITICAL(&_mux);
+}
+
+bool BusMetrics::getCommand(int slot, uint8_t& cmd, RttHistogram& out) {
+    bool valid = false;
+
+    portENTER_CRITICAL(&_mux);
+    if (slot >= 0 && slot < _commandCount) {
+        cmd = _commandCodes[slot];
+        out = _commands[slot];
+        valid = true;
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    return valid;
+}
+
+bool BusMetrics::getController(uint8_t id, RttHistogram& out) {
+    if (id < 1 || id > METRICS_MAX_ID) return false;
+
+    portENTER_CRITICAL(&_mux);
+    out = _controllers[id - 1];
+    portEXIT_CRITICAL(&_mux);
+
+    return out.count > 0 || out.timeouts > 0;
+}
@@ -0,0 +1,56 @@
+#include "BusRouting.h"
+#include "LogMacros.h"
+
+BusRouting::BusRouting() {
+    memset(_map, 0, sizeof(_map));
+    _mux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+void BusRouting::begin() {
+    uint32_t map[8];
+
+    _prefs.begin("busroute", true);
+    if (_prefs.getBytes("map", map, sizeof(map)) == sizeof(map)) {
+        portENTER_CRITICAL(&_mux);
+        memcpy(_map, map, sizeof(_map));
+        portEXIT_CRITICAL(&_mux);
+    }
+    _prefs.end();
+
+    int onSecond = 0;
+    for (int i = 0; i < 8; i++) onSecond += __builtin_popcount(_map[i]);
+    LOG_INFO("[Routing] %d controllers routed to segment 1\n", onSecond);
+}
+
+uint8_t BusRouting::segmentFor(uint8_t id) {
+    // Čitanje jedne riječi je atomsko - bez spinlock-a na vrućoj putanji
+    return (_map[id >> 5] >> (id & 31)) & 1;
+}
+
+bool BusRouting::setRange(uint8_t first, uint8_t last, uint8_t segment) {
+    if (first < 1 || last > ROUTING_MAX_ID || first > last || segment >= ROUTING_SEGMENTS) return false;
+
+    uint32_t map[8];
+    portENTER_CRITICAL(&_mux);
+    for (int id = first; id <= last; id++) {
+        if (segment) _map[id >> 5] |= (1UL << (id & 31));
+        else _map[id >> 5] &= ~(1UL << (id & 31));
+    }
+    memcpy(map, _map, sizeof(map));
+    portEXIT_CRITICAL(&_mux);
+
+    _prefs.begin("busroute", false);
+    _prefs.putBytes("map", map, sizeof(map));
+    _prefs.end();
+    return true;
+}
+
+bool BusRouting::nextRange(uint8_t from, uint8_t& first, uint8_t& last, uint8_t& segment) {
+    if (from < 1 || from > ROUTING_MAX_ID) return false;
+
+    first = from;
+    segment = segmentFor(from);
+    last = from;
+    while (last < ROUTING_MAX_ID && segmentFor(last + 1) == segment) last++;
+    return true;
+}
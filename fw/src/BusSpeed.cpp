@@ -0,0 +1,260 @@
+#include "BusSpeed.h"
+#include "LogMacros.h"
+
+static const uint32_t baudRates[BAUD_RATE_COUNT] = {115200, 230400, 460800, 921600};
+
+BusSpeed::BusSpeed(uint8_t segment, ControllerRoster& roster, uint8_t (*segmentOf)(uint8_t id))
+    : _segment(segment), _roster(roster), _segmentOf(segmentOf) {
+    _state = BAUD_STATE_RESET;
+    _rateIdx = BAUD_BASE_INDEX;
+    _targetIdx = BAUD_BASE_INDEX;
+    _commonMask = 0x01;
+    _controllers = 0;
+    _cursor = BAUD_BASE_INDEX + 1;
+    _inFlight = false;
+    _retry = false;
+    _rescan = false;
+    _negotiatePending = false;
+    _verifyFailed = false;
+    _waitPass = 1;
+    _nextCheckAt = 0;
+    _lastCrc = 0;
+    _blockedIdx = 0;
+    _blockedUntil = 0;
+    _switches = 0;
+    _fallbacks = 0;
+    _lastFallback = NULL;
+    memset(&_lastStep, 0, sizeof(_lastStep));
+    _mux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+uint32_t BusSpeed::rate(uint8_t idx) {
+    return (idx < BAUD_RATE_COUNT) ? baudRates[idx] : baudRates[BAUD_BASE_INDEX];
+}
+
+bool BusSpeed::onSegment(uint8_t id, void* self) {
+    BusSpeed* bs = static_cast<BusSpeed*>(self);
+    return bs->_segmentOf(id) == bs->_segment;
+}
+
+uint8_t BusSpeed::bestTarget(uint32_t now) {
+    bool blocked = _blockedIdx != 0 && (int32_t)(now - _blockedUntil) < 0;
+    if (!blocked) _blockedIdx = 0;
+
+    for (int idx = BAUD_RATE_COUNT - 1; idx > BAUD_BASE_INDEX; idx--) {
+        if (!(_commonMask & (1 << idx))) continue;
+        if (blocked && idx >= _blockedIdx) continue;
+        return idx;
+    }
+    return BAUD_BASE_INDEX;
+}
+
+void BusSpeed::startSwitch(BaudStep& step, uint8_t fromIdx, uint8_t toIdx) {
+    step.action = BAUD_ACT_SWITCH;
+    step.fromIdx = fromIdx;
+    step.toIdx = toIdx;
+    step.id = 0;
+    _targetIdx = toIdx;
+    _state = BAUD_STATE_SWITCHING;
+}
+
+void BusSpeed::fallback(BaudStep& step, uint8_t fromIdx, uint8_t toIdx, const char* reason, uint32_t now) {
+    _blockedIdx = fromIdx;
+    _blockedUntil = now + BAUD_RETRY_MS;
+    _fallbacks++;
+    _lastFallback = reason;
+    startSwitch(step, fromIdx, toIdx);
+}
+
+bool BusSpeed::nextStep(BaudStep& step, uint32_t busBaud, const BusCounters& counters) {
+    uint32_t now = millis();
+    uint32_t crc = counters.headCrcErrors + counters.dataCrcErrors;
+    bool send = false;
+    bool rescan = false;
+    const char* reason = NULL;   // Log van spinlock-a
+    int settledIdx = -1;
+
+    RosterStats rs;
+    _roster.getStats(rs);
+    uint16_t count;
+    uint8_t mask = _roster.commonBaudMask(onSegment, this, count);
+
+    portENTER_CRITICAL(&_mux);
+    _commonMask = mask;
+    _controllers = count;
+
+    if (_retry) {
+        // Isti korak ponovo - frame nije stao u red ili ga je prekinuo oporavak busa
+        _retry = false;
+        step = _lastStep;
+        _inFlight = (step.action == BAUD_ACT_PING);
+        portEXIT_CRITICAL(&_mux);
+        return true;
+    }
+
+    if (_negotiatePending && (_state == BAUD_STATE_IDLE || _state == BAUD_STATE_WAIT_ROSTER)) {
+        _negotiatePending = false;
+        _blockedIdx = 0;
+        _state = BAUD_STATE_RESET;
+        _cursor = BAUD_BASE_INDEX + 1;
+        _rescan = true;
+    }
+
+    switch (_state) {
+        case BAUD_STATE_RESET:
+            // Nakon restarta mosta kontroleri mogu biti na bilo kojoj višoj brzini
+            if (_cursor < BAUD_RATE_COUNT) {
+                startSwitch(step, _cursor++, BAUD_BASE_INDEX);
+                _state = BAUD_STATE_RESET;
+                send = true;
+            } else {
+                _rateIdx = BAUD_BASE_INDEX;
+                _targetIdx = BAUD_BASE_INDEX;
+                _waitPass = rs.passes + 1;
+                _state = BAUD_STATE_WAIT_ROSTER;
+                rescan = _rescan;
+                _rescan = false;
+            }
+            break;
+
+        case BAUD_STATE_WAIT_ROSTER:
+            if (rs.passes >= _waitPass) {
+                _state = BAUD_STATE_IDLE;
+                _nextCheckAt = now;
+                _lastCrc = crc;
+            }
+            break;
+
+        case BAUD_STATE_IDLE: {
+            if ((int32_t)(now - _nextCheckAt) < 0) break;
+            _nextCheckAt = now + BAUD_CHECK_MS;
+
+            uint32_t errors = crc - _lastCrc;
+            _lastCrc = crc;
+            if (_rateIdx != BAUD_BASE_INDEX && errors >= BAUD_CRC_SPIKE) {
+                uint8_t lower = _rateIdx - 1;
+                while (lower > BAUD_BASE_INDEX && !(_commonMask & (1 << lower))) lower--;
+                reason = "crc";
+                fallback(step, _rateIdx, lower, reason, now);
+                send = true;
+                break;
+            }
+
+            // I naniže: novi kontroler bez podrške za trenutnu brzinu
+            uint8_t target = bestTarget(now);
+            if (target != _rateIdx) {
+                startSwitch(step, _rateIdx, target);
+                send = true;
+            }
+            break;
+        }
+
+        case BAUD_STATE_SWITCHING:
+            if (busBaud == rate(_targetIdx)) {
+                _state = BAUD_STATE_VERIFY;
+                _cursor = 1;
+                _verifyFailed = false;
+            }
+            break;
+
+        case BAUD_STATE_VERIFY: {
+            if (_inFlight) break;
+
+            uint16_t id = _cursor;
+            if (!_verifyFailed) {
+                while (id <= ROSTER_MAX_ID && !(_roster.isLive(id) && _segmentOf(id) == _segment)) id++;
+            }
+
+            if (_verifyFailed || id > ROSTER_MAX_ID) {
+                if (_verifyFailed && _targetIdx != BAUD_BASE_INDEX) {
+                    // Podizanje se vraća na prethodnu brzinu, neuspjeli korak naniže na osnovnu
+                    uint8_t back = (_targetIdx > _rateIdx) ? _rateIdx : BAUD_BASE_INDEX;
+                    reason = "verify";
+                    fallback(step, _targetIdx, back, reason, now);
+                    send = true;
+                    break;
+                }
+                if (_targetIdx > _rateIdx) _switches++;
+                _rateIdx = _targetIdx;
+                _state = BAUD_STATE_IDLE;
+                _nextCheckAt = now + BAUD_CHECK_MS;
+                _lastCrc = crc;
+                settledIdx = _rateIdx;
+                break;
+            }
+
+            step.action = BAUD_ACT_PING;
+            step.fromIdx = _targetIdx;
+            step.toIdx = _targetIdx;
+            step.id = id;
+            _cursor = id + 1;
+            _inFlight = true;
+            send = true;
+            break;
+        }
+    }
+
+    if (send) _lastStep = step;
+    portEXIT_CRITICAL(&_mux);
+
+    if (rescan) _roster.rescan();
+    if (reason != NULL) {
+        LOG_ERROR("[BusSpeed] Segment %d: %u baud failed (%s), falling back to %u\n",
+                  _segment, rate(step.fromIdx), reason, rate(step.toIdx));
+    } else if (send && step.action == BAUD_ACT_SWITCH && _state == BAUD_STATE_SWITCHING) {
+        LOG_INFO("[BusSpeed] Segment %d: switching %u -> %u baud (%d controllers)\n",
+                 _segment, rate(step.fromIdx), rate(step.toIdx), count);
+    } else if (settledIdx >= 0) {
+        LOG_INFO("[BusSpeed] Segment %d: running at %u baud\n", _segment, rate(settledIdx));
+    }
+    return send;
+}
+
+void BusSpeed::onPingResult(bool ok) {
+    portENTER_CRITICAL(&_mux);
+    if (!ok) _verifyFailed = true;
+    _inFlight = false;
+    portEXIT_CRITICAL(&_mux);
+}
+
+void BusSpeed::retryStep() {
+    portENTER_CRITICAL(&_mux);
+    _retry = true;
+    _inFlight = false;
+    portEXIT_CRITICAL(&_mux);
+}
+
+void BusSpeed::negotiate() {
+    portENTER_CRITICAL(&_mux);
+    _negotiatePending = true;
+    portEXIT_CRITICAL(&_mux);
+}
+
+void BusSpeed::getStatus(BusSpeedStatus& out) {
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&_mux);
+    out.state = _state;
+    out.rateIdx = _rateIdx;
+    out.targetIdx = _targetIdx;
+    out.commonMask = _commonMask;
+    out.controllers = _controllers;
+    out.switches = _switches;
+    out.fallbacks = _fallbacks;
+    out.lastFallback = _lastFallback;
+    bool blocked = _blockedIdx != 0 && (int32_t)(now - _blockedUntil) < 0;
+    out.blockedIdx = blocked ? _blockedIdx : 0;
+    out.blockedForMs = blocked ? _blockedUntil - now : 0;
+    portEXIT_CRITICAL(&_mux);
+}
+
+const char* BusSpeed::stateName(uint8_t state) {
+    switch (state) {
+        case BAUD_STATE_RESET:       return "reset";
+        case BAUD_STATE_WAIT_ROSTER: return "wait_roster";
+        case BAUD_STATE_IDLE:        return "idle";
+        case BAUD_STATE_SWITCHING:   return "switching";
+        case BAUD_STATE_VERIFY:      return "verify";
+        default:                     return "unknown";
+    }
+}
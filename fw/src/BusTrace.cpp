@@ -0,0 +1,60 @@
+#include "BusTrace.h"
+
+BusTrace::BusTrace() {
+    memset(_ring, 0, sizeof(_ring));
+    _nextSeq = 1;
+    _mux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+void BusTrace::record(BusTraceDir dir, uint8_t status, uint8_t frameId, uint8_t type, uint16_t len,
+                      const uint8_t* data, uint16_t dataLen) {
+    uint32_t now = micros();
+    if (data == NULL) dataLen = 0;
+    if (dataLen > BUS_TRACE_PREFIX) dataLen = BUS_TRACE_PREFIX;
+
+    portENTER_CRITICAL(&_mux);
+    BusTraceRecord& r = _ring[(_nextSeq - 1) % BUS_TRACE_ENTRIES];
+    r.seq = _nextSeq++;
+    r.timeUs = now;
+    r.dir = dir;
+    r.status = status;
+    r.frameId = frameId;
+    r.type = type;
+    r.len = len;
+    r.prefixLen = dataLen;
+    r.reserved = 0;
+    memcpy(r.data, data, dataLen);
+    portEXIT_CRITICAL(&_mux);
+}
+
+void BusTrace::bounds(uint32_t& first, uint32_t& last) {
+    portENTER_CRITICAL(&_mux);
+    last = _nextSeq - 1;
+    first = (_nextSeq > BUS_TRACE_ENTRIES) ? _nextSeq - BUS_TRACE_ENTRIES : 1;
+    portEXIT_CRITICAL(&_mux);
+}
+
+uint16_t BusTrace::read(uint32_t fromSeq, BusTraceRecord* out, uint16_t max) {
+    uint16_t count = 0;
+
+    portENTER_CRITICAL(&_mux);
+    uint32_t first = (_nextSeq > BUS_TRACE_ENTRIES) ? _nextSeq - BUS_TRACE_ENTRIES : 1;
+    if (fromSeq < first) fromSeq = first;
+    for (uint32_t seq = fromSeq; seq < _nextSeq && count < max; seq++) {
+        out[count++] = _ring[(seq - 1) % BUS_TRACE_ENTRIES];
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    return count;
+}
+
+const char* BusTrace::statusName(uint8_t status) {
+    switch (status) {
+        case TF_FRAME_OK:             return "ok";
+        case TF_FRAME_HEAD_CKSUM:     return "head_crc";
+        case TF_FRAME_DATA_CKSUM:     return "data_crc";
+        case TF_FRAME_TOO_LONG:       return "too_long";
+        case TF_FRAME_PARSER_TIMEOUT: return "parser_timeout";
+        default:                      return "unknown";
+    }
+}
@@ -0,0 +1,491 @@
+#include "CommandTable.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Imena komandi sortirana po imenu (strcmp redoslijed) - binarna pretraga, bez poređenja String-ova.
+ * Nova komanda ide na svoje abecedno mjesto; static_assert ispod odbija nesortiranu tabelu.
+ */
+struct CommandName {
+    const char* name;
+    CommandType cmd;
+};
+
+static constexpr CommandName commandNames[] = {
+    {"DELETE_LOG",          CMD_DELETE_LOG},
+    {"ESP_GET_PINS",        CMD_ESP_GET_PINS},
+    {"ESP_PULSE_PIN",       CMD_ESP_PULSE_PIN},
+    {"ESP_RESET_PIN",       CMD_ESP_RESET_PIN},
+    {"ESP_SET_PIN",         CMD_ESP_SET_PIN},
+    {"GET_FAN_BAND",        CMD_GET_FAN_BAND},
+    {"GET_FAN_DIFFERENCE",  CMD_GET_FAN_DIFFERENCE},
+    {"GET_GUEST_IN_TEMP",   CMD_GET_GUEST_IN_TEMP},
+    {"GET_GUEST_OUT_TEMP",  CMD_GET_GUEST_OUT_TEMP},
+    {"GET_IP_ADDRESS",      CMD_GET_IP_ADDRESS},
+    {"GET_IR_PROTOCOL",     CMD_GET_IR_PROTOCOL},
+    {"GET_MDNS_NAME",       CMD_GET_MDNS_NAME},
+    {"GET_PASSWORD",        CMD_GET_PASSWORD},
+    {"GET_PINGWDG",         CMD_GET_PINGWDG},
+    {"GET_PINS",            CMD_GET_PINS},
+    {"GET_ROOM_STATUS",     CMD_GET_ROOM_STATUS},
+    {"GET_ROOM_TEMP",       CMD_GET_ROOM_TEMP},
+    {"GET_SSID_PSWRD",      CMD_GET_SSID_PSWRD},
+    {"GET_STATUS",          CMD_GET_STATUS},
+    {"GET_SYSID",           CMD_GET_SYSID},
+    {"GET_TCPIP_PORT",      CMD_GET_TCPIP_PORT},
+    {"GET_TIME",            CMD_GET_TIME},
+    {"GET_TIMER",           CMD_GET_TIMER},
+    {"GET_VERSION",         CMD_GET_VERSION},
+    {"OPEN_DOOR",           CMD_OPEN_DOOR},
+    {"OUTDOOR_LIGHT_OFF",   CMD_OUTDOOR_LIGHT_OFF},
+    {"OUTDOOR_LIGHT_ON",    CMD_OUTDOOR_LIGHT_ON},
+    {"PINGWDG_OFF",         CMD_PINGWDG_OFF},
+    {"PINGWDG_ON",          CMD_PINGWDG_ON},
+    {"QR_CODE_GET",         CMD_QR_CODE_GET},
+    {"QR_CODE_SET",         CMD_QR_CODE_SET},
+    {"READ_LOG",            CMD_READ_LOG},
+    {"RESTART",             CMD_RESTART},
+    {"RESTART_CTRL",        CMD_RESTART_CTRL},
+    {"SET_ENABLE_COOLING",  CMD_SET_ENABLE_COOLING},
+    {"SET_ENABLE_HEATING",  CMD_SET_ENABLE_HEATING},
+    {"SET_FWD_COOLING",     CMD_SET_FWD_COOLING},
+    {"SET_FWD_HEATING",     CMD_SET_FWD_HEATING},
+    {"SET_GUEST_IN_TEMP",   CMD_SET_GUEST_IN_TEMP},
+    {"SET_GUEST_OUT_TEMP",  CMD_SET_GUEST_OUT_TEMP},
+    {"SET_IR",              CMD_SET_IR},
+    {"SET_IR_PROTOCOL",     CMD_SET_IR_PROTOCOL},
+    {"SET_LANG",            CMD_SET_LANG},
+    {"SET_MDNS_NAME",       CMD_SET_MDNS_NAME},
+    {"SET_PASSWORD",        CMD_SET_PASSWORD},
+    {"SET_PIN",             CMD_SET_PIN},
+    {"SET_ROOM_TEMP",       CMD_SET_ROOM_TEMP},
+    {"SET_SSID_PSWRD",      CMD_SET_SSID_PSWRD},
+    {"SET_SYSID",           CMD_SET_SYSID},
+    {"SET_TCPIP_PORT",      CMD_SET_TCPIP_PORT},
+    {"SET_THST_COOLING",    CMD_SET_THST_COOLING},
+    {"SET_THST_HEATING",    CMD_SET_THST_HEATING},
+    {"SET_THST_OFF",        CMD_SET_THST_OFF},
+    {"SET_THST_ON",         CMD_SET_THST_ON},
+    {"SET_TIME",            CMD_SET_TIME},
+    {"SET_TIMER",           CMD_SET_TIMER},
+    {"SOS_RESET",           CMD_SOS_RESET},
+    {"TH_COOLING",          CMD_TH_COOLING},
+    {"TH_DIFF",             CMD_TH_DIFF},
+    {"TH_EMA",              CMD_TH_EMA},
+    {"TH_HEATING",          CMD_TH_HEATING},
+    {"TH_OFF",              CMD_TH_OFF},
+    {"TH_ON",               CMD_TH_ON},
+    {"TH_SETPOINT",         CMD_TH_SETPOINT},
+    {"TH_STATUS",           CMD_TH_STATUS},
+};
+
+#define COMMAND_NAME_COUNT (sizeof(commandNames) / sizeof(commandNames[0]))
+
+constexpr int commandNameCmp(const char* a, const char* b) {
+    return (*a != *b || *a == '\0') ? (int)(unsigned char)*a - (int)(unsigned char)*b : commandNameCmp(a + 1, b + 1);
+}
+
+constexpr bool commandNamesSorted(size_t i) {
+    return (i + 1 >= COMMAND_NAME_COUNT) ? true
+                                         : (commandNameCmp(commandNames[i].name, commandNames[i + 1].name) < 0 &&
+                                            commandNamesSorted(i + 1));
+}
+
+static_assert(commandNamesSorted(0), "commandNames must be sorted by name, without duplicates");
+
+CommandType commandFromName(const char* name, size_t len) {
+    size_t lo = 0;
+    size_t hi = COMMAND_NAME_COUNT;
+
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        const char* entry = commandNames[mid].name;
+        int c = strncmp(entry, name, len);
+        if (c == 0 && entry[len] != '\0') c = 1; // Ime iz tabele je duže - iza traženog
+        if (c == 0) return commandNames[mid].cmd;
+        if (c < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return CMD_UNKNOWN;
+}
+
+static int fail(CommandFault& fault, int code, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vsnprintf(fault.message, sizeof(fault.message), format, args);
+    va_end(args);
+    fault.code = code;
+    return 0;
+}
+
+// Cijeli broj u [min, max]; false uz fault ako nedostaje ili je van opsega
+static bool readInt(const CommandInput& in, const char* name, int32_t min, int32_t max, const char* hint,
+                    int32_t& out, CommandFault& fault) {
+    const char* value = in.get(name);
+    if (value == NULL) {
+        fail(fault, 400, "Missing %s parameter", name);
+        return false;
+    }
+
+    char* end;
+    long v = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || v < min || v > max) {
+        if (hint != NULL) fail(fault, 400, "Invalid %s (%s)", name, hint);
+        else fail(fault, 400, "Invalid %s (must be %ld-%ld)", name, (long)min, (long)max);
+        return false;
+    }
+
+    out = (int32_t)v;
+    return true;
+}
+
+static int encodeSetPin(const CommandDescriptor& d, const CommandInput& in, uint8_t id, const int32_t* values,
+                        uint8_t* buf, size_t max, CommandFault& fault) {
+    buf[0] = d.cmd;
+    buf[1] = id;
+    buf[2] = 254;
+    buf[3] = values[0]; // PIN
+    buf[4] = values[1]; // VALUE
+    return 5;
+}
+
+static int encodeGetPins(const CommandDescriptor& d, const CommandInput& in, uint8_t id, const int32_t* values,
+                         uint8_t* buf, size_t max, CommandFault& fault) {
+    buf[0] = CMD_SET_PIN;   // Kontroler čita pinove kroz SET_PIN sa podkomandom GET_PINS
+    buf[1] = id;
+    buf[2] = CMD_GET_PINS;
+    return 3;
+}
+
+// Grupa korisnika iz TYPE; 0 = nepoznat tip
+static char userGroup(const char* type) {
+    if (strcmp(type, "GUEST") == 0) return 'G';
+    if (strcmp(type, "MAID") == 0) return 'H';
+    if (strcmp(type, "MANAGER") == 0) return 'M';
+    if (strcmp(type, "SERVICE") == 0) return 'S';
+    return 0;
+}
+
+static int encodeSetPassword(const CommandDescriptor& d, const CommandInput& in, uint8_t id, const int32_t* values,
+                             uint8_t* buf, size_t max, CommandFault& fault) {
+    const char* type = in.get("TYPE");
+    char* text = (char*)buf + 2;
+    size_t room = max - 2;
+    int32_t guestId;
+    int n;
+
+    // Brisanje Guest lozinke: G{ID}X - bez PASSWORD parametra
+    if (strcmp(type, "DELETE_GUEST") == 0) {
+        if (!readInt(in, "GUEST_ID", 1, 8, NULL, guestId, fault)) return 0;
+        n = snprintf(text, room, "G%dX", (int)guestId);
+    } else {
+        char group = userGroup(type);
+        if (group == 0) {
+            return fail(fault, 400, "Invalid TYPE (must be GUEST, MAID, MANAGER, SERVICE or DELETE_GUEST)");
+        }
+
+        const char* password = in.get("PASSWORD");
+        if (password == NULL) return fail(fault, 400, "Missing PASSWORD parameter");
+        for (const char* p = password; *p; p++) {
+            if (!isdigit((unsigned char)*p)) return fail(fault, 400, "Password must contain only digits");
+        }
+
+        if (group == 'G') {
+            // Guest lozinka: G{ID},{PASSWORD},{EXPIRY}; EXPIRY = HHMMDDMMYY
+            if (!readInt(in, "GUEST_ID", 1, 8, NULL, guestId, fault)) return 0;
+            const char* expiry = in.get("EXPIRY");
+            if (expiry == NULL) return fail(fault, 400, "Missing EXPIRY parameter");
+            if (strlen(expiry) != 10) return fail(fault, 400, "Invalid EXPIRY format (must be HHMMDDMMYY)");
+            n = snprintf(text, room, "G%d,%s,%s", (int)guestId, password, expiry);
+        } else {
+            n = snprintf(text, room, "%c%s", group, password);
+        }
+    }
+
+    if (n < 0 || (size_t)n + 1 > room) return fail(fault, 400, "Password too long");
+
+    buf[0] = d.cmd;
+    buf[1] = id;
+    return 2 + n + 1; // Sa terminatorom
+}
+
+static int encodeGetPassword(const CommandDescriptor& d, const CommandInput& in, uint8_t id, const int32_t* values,
+                             uint8_t* buf, size_t max, CommandFault& fault) {
+    char group = userGroup(in.get("TYPE"));
+    if (group == 0) return fail(fault, 400, "Invalid TYPE (must be GUEST, MAID, MANAGER or SERVICE)");
+
+    buf[0] = d.cmd;
+    buf[1] = id;
+    buf[2] = group;
+    if (group != 'G') return 3;
+
+    int32_t guestId;
+    if (!readInt(in, "GUEST_ID", 1, 8, NULL, guestId, fault)) return 0;
+    buf[3] = guestId;
+    return 4;
+}
+
+static int encodeQrCode(const CommandDescriptor& d, const CommandInput& in, uint8_t id, const int32_t* values,
+                        uint8_t* buf, size_t max, CommandFault& fault) {
+    const char* qr = in.get("QR_CODE");
+    size_t len = strlen(qr);
+    if (2 + len + 1 > max) return fail(fault, 400, "QR Code too long");
+
+    buf[0] = d.cmd;
+    buf[1] = id;
+    memcpy(buf + 2, qr, len);
+    buf[2 + len] = 0;  // Terminator van dužine frame-a
+    return 2 + len;    // CMD + ID + string
+}
+
+static void decodeRoomTemp(const CommandDescriptor& d, const uint8_t* r, uint16_t len, const ReplyWriter& out) {
+    static const char* const extended[] = {
+        "fan_speed", "thermostat_control_mode", "setpoint_max", "setpoint_min", "fan_control_mode",
+        "forward_heating", "forward_cooling", "thst_enable_heating", "thst_enable_cooling",
+    };
+    const int count = sizeof(extended) / sizeof(extended[0]);
+
+    out.integer("room_temperature", r[1]);
+    out.integer("setpoint_temperature", r[2]);
+
+    // Pun format (rs485_termostat.c): CMD + 11 bajtova; rs485_scene.c šalje samo temperature
+    bool full = (len >= 3 + count);
+    for (int i = 0; i < count; i++) {
+        if (!full) out.text(extended[i], NULL);
+        else if (i >= 5) out.boolean(extended[i], r[3 + i] != 0); // forward_* i thst_enable_*
+        else out.integer(extended[i], r[3 + i]);
+    }
+}
+
+static void decodePins(const CommandDescriptor& d, const uint8_t* r, uint16_t len, const ReplyWriter& out) {
+    if (len == 3 && r[1] == CMD_GET_PINS) {
+        char bits[9];
+        for (int i = 7; i >= 0; i--) bits[7 - i] = ((r[2] >> i) & 1) ? '1' : '0';
+        bits[8] = '\0';
+        out.text("pin_states", bits);
+    } else {
+        out.text("result", "Pin set OK");
+    }
+}
+
+static void decodeRoomStatus(const CommandDescriptor& d, const uint8_t* r, uint16_t len, const ReplyWriter& out) {
+    out.text("room_status", r[1] ? "GUEST_IN" : "EMPTY");
+    out.boolean("card_inserted", r[1] != 0);
+}
+
+static void decodeQrCode(const CommandDescriptor& d, const uint8_t* r, uint16_t len, const ReplyWriter& out) {
+    // Odgovor je samo string, bez CMD bajta
+    char qr[QR_CODE_MAX_LEN + 1] = {0};
+    memcpy(qr, r, (len < QR_CODE_MAX_LEN) ? len : QR_CODE_MAX_LEN);
+    out.text("qr_code", qr);
+}
+
+static void decodeSysid(const CommandDescriptor& d, const uint8_t* r, uint16_t len, const ReplyWriter& out) {
+    uint16_t sysid = (r[1] << 8) | r[2];
+    char hex[8];
+    snprintf(hex, sizeof(hex), "0x%04X", sysid);
+    out.integer("system_id", sysid);
+    out.text("system_id_hex", hex);
+}
+
+static void decodePassword(const CommandDescriptor& d, const uint8_t* r, uint16_t len, const ReplyWriter& out) {
+    if (r[1] != COMMAND_ACK) {
+        out.error("Password read FAILED (NAK)");
+        return;
+    }
+
+    if (len == 10) {
+        // Guest: CMD + ACK + guest_id + 3 bajta lozinke + 4 bajta Unix vremena isteka (UTC)
+        uint32_t password = ((uint32_t)r[3] << 16) | ((uint32_t)r[4] << 8) | r[5];
+        time_t expiry = (time_t)(((uint32_t)r[6] << 24) | ((uint32_t)r[7] << 16) | ((uint32_t)r[8] << 8) | r[9]);
+        char expiryStr[20];
+        strftime(expiryStr, sizeof(expiryStr), "%Y-%m-%d %H:%M", gmtime(&expiry));
+
+        out.text("user_type", "guest");
+        out.integer("guest_id", r[2]);
+        out.integer("password", password);
+        out.text("expiry", expiryStr);
+    } else if (len == 5) {
+        // Maid/Manager/Service: CMD + ACK + 3 bajta lozinke
+        out.text("user_type", "staff");
+        out.integer("password", ((uint32_t)r[2] << 16) | ((uint32_t)r[3] << 8) | r[4]);
+    } else {
+        char message[48];
+        snprintf(message, sizeof(message), "Unexpected response format (length=%u)", len);
+        out.error(message);
+    }
+}
+
+static void decodeVersion(const CommandDescriptor& d, const uint8_t* r, uint16_t len, const ReplyWriter& out) {
+    // [CMD][bootloader][app][bootloader backup][app backup][novi fajl], svaka verzija 4 bajta big-endian
+    static const char* const names[] = {
+        "bootloader_version", "application_version", "bootloader_backup_version",
+        "application_backup_version", "new_file_version",
+    };
+
+    for (int i = 0; i < 5; i++) {
+        const uint8_t* p = r + 1 + i * 4;
+        uint32_t version = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+        char hex[12];
+        snprintf(hex, sizeof(hex), "0x%08X", (unsigned)version);
+        out.text(names[i], version != 0 ? hex : NULL);
+    }
+}
+
+#define VALUE_TEMP   {{"VALUE", PARAM_BYTE, 5, 40, NULL}}
+#define VALUE_FLAG   {{"VALUE", PARAM_BYTE, 0, 1, "must be 0 or 1"}}
+#define NO_PARAMS    {}
+#define NO_FIELDS    {}
+
+/**
+ * Komande kontrolera, sortirane po CommandType (binarna pretraga u findCommand).
+ * cmd, params, encode, replyCode, replyMin, result, failed, fields, decode
+ */
+static constexpr CommandDescriptor commandTable[] = {
+    {CMD_GET_ROOM_STATUS, NO_PARAMS, NULL, CMD_GET_ROOM_STATUS, 2, NULL, NULL, NO_FIELDS, decodeRoomStatus},
+    {CMD_SET_PASSWORD, {{"TYPE", PARAM_TEXT, 1, 16, NULL}}, encodeSetPassword,
+     CMD_SET_PASSWORD, 1, "Password set OK", "Password set FAILED", NO_FIELDS, NULL},
+    {CMD_GET_ROOM_TEMP, NO_PARAMS, NULL, CMD_GET_ROOM_TEMP, 3, NULL, NULL, NO_FIELDS, decodeRoomTemp},
+    {CMD_SET_PIN, {{"PIN", PARAM_BYTE, 1, 6, NULL}, {"VALUE", PARAM_BYTE, 0, 1, "must be 0 or 1"}}, encodeSetPin,
+     CMD_SET_PIN, 1, NULL, NULL, NO_FIELDS, decodePins},
+    {CMD_GET_PINS, NO_PARAMS, encodeGetPins, CMD_SET_PIN, 1, NULL, NULL, NO_FIELDS, decodePins},
+    {CMD_SET_THST_ON, NO_PARAMS, NULL, CMD_SET_THST_ON, 1, "Thermostat set OK", NULL, NO_FIELDS, NULL},
+    {CMD_GET_FAN_DIFFERENCE, NO_PARAMS, NULL, CMD_GET_FAN_DIFFERENCE, 2, NULL, NULL,
+     {{"fan_difference", 1, FIELD_BYTE}}, NULL},
+    {CMD_GET_FAN_BAND, NO_PARAMS, NULL, CMD_GET_FAN_BAND, 3, NULL, NULL,
+     {{"fan_low_band", 1, FIELD_BYTE}, {"fan_high_band", 2, FIELD_BYTE}}, NULL},
+    {CMD_RESTART_CTRL, NO_PARAMS, NULL, CMD_RESTART_CTRL, 1, "Controller restart OK", NULL, NO_FIELDS, NULL},
+    // READ_LOG / DELETE_LOG odgovor sastavlja main.cpp (decodeLogEntry, vlastiti format poruke)
+    {CMD_READ_LOG, NO_PARAMS, NULL, 0, 0, NULL, NULL, NO_FIELDS, NULL},
+    {CMD_DELETE_LOG, NO_PARAMS, NULL, 0, 0, NULL, NULL, NO_FIELDS, NULL},
+    {CMD_SET_GUEST_IN_TEMP, VALUE_TEMP, NULL, CMD_SET_GUEST_IN_TEMP, 1, "Temperature set OK", NULL, NO_FIELDS, NULL},
+    {CMD_SET_GUEST_OUT_TEMP, VALUE_TEMP, NULL, CMD_SET_GUEST_OUT_TEMP, 1, "Temperature set OK", NULL, NO_FIELDS, NULL},
+    {CMD_SET_ROOM_TEMP, VALUE_TEMP, NULL, CMD_SET_ROOM_TEMP, 1, "Temperature set OK", NULL, NO_FIELDS, NULL},
+    {CMD_GET_GUEST_IN_TEMP, NO_PARAMS, NULL, CMD_GET_GUEST_IN_TEMP, 2, NULL, NULL,
+     {{"guest_in_temperature", 1, FIELD_BYTE}}, NULL},
+    {CMD_GET_GUEST_OUT_TEMP, NO_PARAMS, NULL, CMD_GET_GUEST_OUT_TEMP, 2, NULL, NULL,
+     {{"guest_out_temperature", 1, FIELD_BYTE}}, NULL},
+    {CMD_OPEN_DOOR, NO_PARAMS, NULL, CMD_OPEN_DOOR, 1, "Door opened", NULL, NO_FIELDS, NULL},
+    {CMD_SET_THST_HEATING, NO_PARAMS, NULL, CMD_SET_THST_HEATING, 1, "Thermostat set OK", NULL, NO_FIELDS, NULL},
+    {CMD_SET_THST_COOLING, NO_PARAMS, NULL, CMD_SET_THST_COOLING, 1, "Thermostat set OK", NULL, NO_FIELDS, NULL},
+    {CMD_SET_THST_OFF, NO_PARAMS, NULL, CMD_SET_THST_OFF, 1, "Thermostat set OK", NULL, NO_FIELDS, NULL},
+    {CMD_QR_CODE_GET, NO_PARAMS, NULL, 0, 0, NULL, NULL, NO_FIELDS, decodeQrCode},
+    {CMD_QR_CODE_SET, {{"QR_CODE", PARAM_TEXT, 0, QR_CODE_MAX_LEN, NULL}}, encodeQrCode,
+     CMD_QR_CODE_SET, 1, "QR code set OK", "QR code set FAILED", NO_FIELDS, NULL},
+    {CMD_SET_LANG, {{"VALUE", PARAM_BYTE, 0, 2, "0=SRB, 1=ENG, 2=GER"}}, NULL,
+     CMD_SET_LANG, 1, "Language set OK", NULL, NO_FIELDS, NULL},
+    {CMD_GET_SYSID, NO_PARAMS, NULL, CMD_GET_SYSID, 3, NULL, NULL, NO_FIELDS, decodeSysid},
+    {CMD_SET_SYSID, {{"VALUE", PARAM_WORD, 0, 0xFFFF, NULL}}, NULL,
+     CMD_SET_SYSID, 1, "System ID set OK", "System ID set FAILED", NO_FIELDS, NULL},
+    {CMD_GET_PASSWORD, {{"TYPE", PARAM_TEXT, 1, 16, NULL}}, encodeGetPassword,
+     CMD_GET_PASSWORD, 2, NULL, NULL, NO_FIELDS, decodePassword},
+    {CMD_SET_FWD_HEATING, VALUE_FLAG, NULL, CMD_SET_FWD_HEATING, 2, "Forward heating flag set", NULL,
+     {{"value", 1, FIELD_BOOL}}, NULL},
+    {CMD_SET_FWD_COOLING, VALUE_FLAG, NULL, CMD_SET_FWD_COOLING, 2, "Forward cooling flag set", NULL,
+     {{"value", 1, FIELD_BOOL}}, NULL},
+    {CMD_SET_ENABLE_HEATING, VALUE_FLAG, NULL, CMD_SET_ENABLE_HEATING, 2, "Enable heating flag set", NULL,
+     {{"value", 1, FIELD_BOOL}}, NULL},
+    {CMD_SET_ENABLE_COOLING, VALUE_FLAG, NULL, CMD_SET_ENABLE_COOLING, 2, "Enable cooling flag set", NULL,
+     {{"value", 1, FIELD_BOOL}}, NULL},
+    {CMD_GET_VERSION, NO_PARAMS, NULL, CMD_GET_VERSION, 21, NULL, NULL, NO_FIELDS, decodeVersion},
+};
+
+#define COMMAND_TABLE_COUNT (sizeof(commandTable) / sizeof(commandTable[0]))
+
+constexpr bool commandTableSorted(size_t i) {
+    return (i + 1 >= COMMAND_TABLE_COUNT) ? true
+                                          : (commandTable[i].cmd < commandTable[i + 1].cmd && commandTableSorted(i + 1));
+}
+
+static_assert(commandTableSorted(0), "commandTable must be sorted by CommandType, without duplicates");
+
+const CommandDescriptor* findCommand(CommandType cmd) {
+    size_t lo = 0;
+    size_t hi = COMMAND_TABLE_COUNT;
+
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (commandTable[mid].cmd == cmd) return &commandTable[mid];
+        if (commandTable[mid].cmd < cmd) lo = mid + 1;
+        else hi = mid;
+    }
+    return NULL;
+}
+
+int encodeCommand(const CommandDescriptor& d, const CommandInput& in, uint8_t* buf, size_t max, CommandFault& fault) {
+    fault.code = 0;
+    fault.message[0] = '\0';
+
+    // Poruka kao "Missing ID or VALUE" - svi obavezni parametri komande
+    bool missing = (in.get("ID") == NULL);
+    int count = 0;
+    while (count < COMMAND_MAX_PARAMS && d.params[count].name != NULL) {
+        if (in.get(d.params[count].name) == NULL) missing = true;
+        count++;
+    }
+    if (missing) {
+        int n = snprintf(fault.message, sizeof(fault.message), "Missing ID");
+        for (int i = 0; i < count && n > 0 && (size_t)n < sizeof(fault.message); i++) {
+            n += snprintf(fault.message + n, sizeof(fault.message) - n, "%s%s",
+                          (i == count - 1) ? " or " : ", ", d.params[i].name);
+        }
+        fault.code = 400;
+        return 0;
+    }
+
+    int32_t id;
+    if (!readInt(in, "ID", 1, 254, NULL, id, fault)) return 0;
+
+    int32_t values[COMMAND_MAX_PARAMS] = {0};
+    for (int i = 0; i < count; i++) {
+        const CommandParamSpec& p = d.params[i];
+        if (p.kind == PARAM_TEXT) {
+            size_t len = strlen(in.get(p.name));
+            if (len < (size_t)p.min || len > (size_t)p.max) {
+                return fail(fault, 400, "Invalid %s (length %ld-%ld)", p.name, (long)p.min, (long)p.max);
+            }
+        } else if (!readInt(in, p.name, p.min, p.max, p.hint, values[i], fault)) {
+            return 0;
+        }
+    }
+
+    if (d.encode != NULL) return d.encode(d, in, (uint8_t)id, values, buf, max, fault);
+
+    size_t len = 0;
+    buf[len++] = d.cmd;
+    buf[len++] = (uint8_t)id;
+    for (int i = 0; i < count; i++) {
+        if (d.params[i].kind == PARAM_WORD) buf[len++] = (uint8_t)(values[i] >> 8);
+        buf[len++] = (uint8_t)values[i];
+    }
+    return len;
+}
+
+bool decodeReply(const CommandDescriptor& d, const uint8_t* reply, uint16_t len, const ReplyWriter& out) {
+    if (d.replyCode != 0 && (len < 1 || reply[0] != d.replyCode)) return false;
+
+    if (len < d.replyMin) {
+        char message[64];
+        snprintf(message, sizeof(message), "Invalid response length (expected %u, got %u)", d.replyMin, len);
+        out.error(message);
+        return true;
+    }
+
+    if (d.result != NULL) {
+        bool ack = (d.failed == NULL) || (len >= 2 && reply[1] == COMMAND_ACK);
+        out.text("result", ack ? d.result : d.failed);
+    }
+
+    for (int i = 0; i < COMMAND_MAX_FIELDS && d.fields[i].key != NULL; i++) {
+        const CommandField& f = d.fields[i];
+        if (f.kind == FIELD_BOOL) out.boolean(f.key, reply[f.offset] != 0);
+        else out.integer(f.key, reply[f.offset]);
+    }
+
+    if (d.decode != NULL) d.decode(d, reply, len, out);
+    return true;
+}
@@ -0,0 +1,195 @@
+#include "ControllerHealth.h"
+
+ControllerHealth::ControllerHealth() {
+    memset(_rtt, 0, sizeof(_rtt));
+    memset(_breakers, 0, sizeof(_breakers));
+    _probeCursor = 0;
+    _mux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+ControllerHealth::Estimator* ControllerHealth::estimator(uint8_t id, BusClass cls) {
+    if (id < 1 || id > HEALTH_MAX_ID || cls >= HEALTH_CLASSES) return NULL;
+    return &_rtt[id - 1][cls];
+}
+
+uint16_t ControllerHealth::rto(const Estimator& e) {
+    if (e.samples == 0) return RTO_INITIAL_MS;
+
+    // RTO = SRTT + max(G, 4 * RTTVAR); rttvar4 je već 4 * RTTVAR
+    uint32_t timeout = (e.srtt8 >> 3) + ((e.rttvar4 > RTO_GRANULARITY_MS) ? e.rttvar4 : RTO_GRANULARITY_MS);
+    if (timeout < RTO_MIN_MS) timeout = RTO_MIN_MS;
+    timeout <<= e.backoff;
+    if (timeout > RTO_MAX_MS) timeout = RTO_MAX_MS;
+    return (uint16_t)timeout;
+}
+
+uint16_t ControllerHealth::timeoutFor(uint8_t id, BusClass cls) {
+    uint16_t timeout = RTO_INITIAL_MS;
+
+    portENTER_CRITICAL(&_mux);
+    Estimator* e = estimator(id, cls);
+    if (e != NULL) timeout = rto(*e);
+    portEXIT_CRITICAL(&_mux);
+
+    return timeout;
+}
+
+void ControllerHealth::onReply(uint8_t id, BusClass cls, uint32_t rttMs) {
+    if (rttMs > RTO_MAX_MS) rttMs = RTO_MAX_MS;
+    int32_t r = (int32_t)rttMs;
+
+    portENTER_CRITICAL(&_mux);
+    Estimator* e = estimator(id, cls);
+    if (e != NULL) {
+        if (e->samples == 0) {
+            // Prvi uzorak: SRTT = R, RTTVAR = R/2
+            e->srtt8 = r << 3;
+            e->rttvar4 = r << 1;
+        } else {
+            // SRTT += (R - SRTT)/8, RTTVAR += (|R - SRTT| - RTTVAR)/4
+            int32_t err = r - (e->srtt8 >> 3);
+            e->srtt8 = (uint16_t)(e->srtt8 + err);
+            if (err < 0) err = -err;
+            e->rttvar4 = (uint16_t)(e->rttvar4 + err - (e->rttvar4 >> 2));
+        }
+        if (e->samples < 255) e->samples++;
+        e->backoff = 0;
+    }
+    recordSuccess(id);
+    portEXIT_CRITICAL(&_mux);
+}
+
+void ControllerHealth::onTimeout(uint8_t id, BusClass cls) {
+    portENTER_CRITICAL(&_mux);
+    Estimator* e = estimator(id, cls);
+    if (e != NULL && e->samples > 0 && e->backoff < RTO_MAX_BACKOFF) {
+        e->backoff++;
+    }
+
+    if (id >= 1 && id <= HEALTH_MAX_ID) {
+        Breaker& b = _breakers[id - 1];
+        if (b.failures < 255) b.failures++;
+        if (b.state == BREAKER_CLOSED && b.failures >= BREAKER_FAIL_THRESHOLD) {
+            b.probeShift = 0;
+            openBreaker(b, millis());
+        }
+    }
+    portEXIT_CRITICAL(&_mux);
+}
+
+bool ControllerHealth::getRtt(uint8_t id, BusClass cls, RttInfo& out) {
+    bool valid = false;
+
+    portENTER_CRITICAL(&_mux);
+    Estimator* e = estimator(id, cls);
+    if (e != NULL && e->samples > 0) {
+        out.srttMs = e->srtt8 >> 3;
+        out.rttvarMs = e->rttvar4 >> 2;
+        out.rtoMs = rto(*e);
+        out.samples = e->samples;
+        out.backoff = e->backoff;
+        valid = true;
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    return valid;
+}
+
+void ControllerHealth::recordSuccess(uint8_t id) {
+    if (id < 1 || id > HEALTH_MAX_ID) return;
+
+    Breaker& b = _breakers[id - 1];
+    b.state = BREAKER_CLOSED;
+    b.failures = 0;
+    b.probeShift = 0;
+}
+
+void ControllerHealth::openBreaker(Breaker& b, uint32_t now) {
+    uint32_t interval = (uint32_t)BREAKER_PROBE_MIN_MS << b.probeShift;
+    if (interval > BREAKER_PROBE_MAX_MS) interval = BREAKER_PROBE_MAX_MS;
+
+    if (b.state == BREAKER_CLOSED) {
+        b.openedAt = now;
+        b.trips++;
+    }
+    b.state = BREAKER_OPEN;
+    b.nextProbeAt = now + interval;
+}
+
+bool ControllerHealth::allowRequest(uint8_t id) {
+    if (id < 1 || id > HEALTH_MAX_ID) return true;
+
+    bool allowed;
+    portENTER_CRITICAL(&_mux);
+    Breaker& b = _breakers[id - 1];
+    allowed = (b.state == BREAKER_CLOSED);
+    if (!allowed) b.rejected++;
+    portEXIT_CRITICAL(&_mux);
+
+    return allowed;
+}
+
+uint8_t ControllerHealth::nextProbe() {
+    uint8_t id = 0;
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&_mux);
+    // Round-robin da jedna soba ne zauzme sve probe
+    for (int i = 0; i < HEALTH_MAX_ID; i++) {
+        _probeCursor = (_probeCursor % HEALTH_MAX_ID) + 1;
+        Breaker& b = _breakers[_probeCursor - 1];
+        if (b.state == BREAKER_OPEN && (int32_t)(now - b.nextProbeAt) >= 0) {
+            b.state = BREAKER_HALF_OPEN;
+            id = _probeCursor;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    return id;
+}
+
+void ControllerHealth::onProbeResult(uint8_t id, bool ok) {
+    if (id < 1 || id > HEALTH_MAX_ID) return;
+
+    portENTER_CRITICAL(&_mux);
+    Breaker& b = _breakers[id - 1];
+    if (ok) {
+        recordSuccess(id);
+    } else if (b.state == BREAKER_HALF_OPEN) {
+        if (b.probeShift < 8) b.probeShift++;
+        openBreaker(b, millis());
+    }
+    portEXIT_CRITICAL(&_mux);
+}
+
+bool ControllerHealth::getBreaker(uint8_t id, BreakerInfo& out) {
+    if (id < 1 || id > HEALTH_MAX_ID) return false;
+
+    uint32_t now = millis();
+    bool active;
+
+    portENTER_CRITICAL(&_mux);
+    Breaker& b = _breakers[id - 1];
+    active = (b.state != BREAKER_CLOSED || b.failures > 0 || b.trips > 0);
+    if (active) {
+        out.state = (BreakerState)b.state;
+        out.failures = b.failures;
+        out.trips = b.trips;
+        out.rejected = b.rejected;
+        out.openForMs = (b.state != BREAKER_CLOSED) ? now - b.openedAt : 0;
+        out.nextProbeInMs = (b.state == BREAKER_OPEN && (int32_t)(b.nextProbeAt - now) > 0) ? b.nextProbeAt - now : 0;
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    return active;
+}
+
+const char* ControllerHealth::breakerName(BreakerState state) {
+    switch (state) {
+        case BREAKER_CLOSED:    return "closed";
+        case BREAKER_OPEN:      return "open";
+        case BREAKER_HALF_OPEN: return "half_open";
+        default:                return "unknown";
+    }
+}
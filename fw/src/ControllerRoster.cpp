@@ -0,0 +1,338 @@
+#include "ControllerRoster.h"
+#include "LogMacros.h"
+
+// Dio unosa koji preživi restart
+struct PersistedEntry {
+    uint16_t sysid;
+    uint8_t format;
+    uint32_t bootloaderVer;
+    uint32_t appVer;
+    uint8_t baudMask;        // Dodano kasnije - stariji zapisi su kraći
+};
+#define PERSISTED_V1_SIZE   offsetof(PersistedEntry, baudMask)
+
+static uint32_t readBE32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+ControllerRoster::ControllerRoster() {
+    memset(_entries, 0, sizeof(_entries));
+    memset(_live, 0, sizeof(_live));
+    memset(_dirty, 0, sizeof(_dirty));
+    _liveDirty = false;
+    _sweeping = false;
+    _inFlight = false;
+    _stepId = 0;
+    _stepQuery = ROSTER_Q_SYSID;
+    _cursor = 1;
+    _versionId = 0;
+    _baudId = 0;
+    _nextPassAt = 0;
+    _passStartedAt = 0;
+    _lastPassMs = 0;
+    _passes = 0;
+    _mux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+bool ControllerRoster::testBit(const uint32_t* map, uint8_t id) {
+    return (map[id >> 5] >> (id & 31)) & 1;
+}
+
+void ControllerRoster::setBit(uint32_t* map, uint8_t id, bool value) {
+    if (value) map[id >> 5] |= (1UL << (id & 31));
+    else map[id >> 5] &= ~(1UL << (id & 31));
+}
+
+void ControllerRoster::begin() {
+    int loaded = 0;
+
+    _prefs.begin("roster", true);
+    // Bitmapa prisutnih - čitaju se samo ključevi koji postoje
+    if (_prefs.getBytes("live", _live, sizeof(_live)) != sizeof(_live)) {
+        memset(_live, 0, sizeof(_live));
+    }
+    for (int id = 1; id <= ROSTER_MAX_ID; id++) {
+        if (!testBit(_live, id)) continue;
+
+        char key[6];
+        snprintf(key, sizeof(key), "c%d", id);
+        PersistedEntry p;
+        memset(&p, 0, sizeof(p));
+        size_t n = _prefs.getBytes(key, &p, sizeof(p));
+        if (n != sizeof(p) && n != PERSISTED_V1_SIZE) {
+            setBit(_live, id, false);
+            continue;
+        }
+        RosterEntry& e = _entries[id - 1];
+        e.sysid = p.sysid;
+        e.format = p.format;
+        e.bootloaderVer = p.bootloaderVer;
+        e.appVer = p.appVer;
+        e.baudMask = p.baudMask;
+        loaded++;
+    }
+    _prefs.end();
+
+    _nextPassAt = millis() + ROSTER_BOOT_DELAY_MS;
+    LOG_INFO("[Roster] %d controllers loaded from NVS\n", loaded);
+}
+
+void ControllerRoster::flush() {
+    uint8_t ids[ROSTER_FLUSH_PER_CALL];
+    PersistedEntry data[ROSTER_FLUSH_PER_CALL];
+    bool live[ROSTER_FLUSH_PER_CALL];
+    uint32_t liveMap[8];
+    int count = 0;
+    bool writeLive;
+
+    // Kopija pod spinlock-om, NVS upis van njega
+    portENTER_CRITICAL(&_mux);
+    for (int id = 1; id <= ROSTER_MAX_ID && count < ROSTER_FLUSH_PER_CALL; id++) {
+        if (!testBit(_dirty, id)) continue;
+        setBit(_dirty, id, false);
+        const RosterEntry& e = _entries[id - 1];
+        ids[count] = id;
+        live[count] = testBit(_live, id);
+        data[count].sysid = e.sysid;
+        data[count].format = e.format;
+        data[count].bootloaderVer = e.bootloaderVer;
+        data[count].appVer = e.appVer;
+        data[count].baudMask = e.baudMask;
+        count++;
+    }
+    writeLive = _liveDirty;
+    _liveDirty = false;
+    memcpy(liveMap, _live, sizeof(liveMap));
+    portEXIT_CRITICAL(&_mux);
+
+    if (count == 0 && !writeLive) return;
+
+    _prefs.begin("roster", false);
+    for (int i = 0; i < count; i++) {
+        char key[6];
+        snprintf(key, sizeof(key), "c%d", ids[i]);
+        if (live[i]) _prefs.putBytes(key, &data[i], sizeof(PersistedEntry));
+        else _prefs.remove(key);
+    }
+    if (writeLive) _prefs.putBytes("live", liveMap, sizeof(liveMap));
+    _prefs.end();
+}
+
+bool ControllerRoster::nextStep(uint8_t& id, RosterQuery& query) {
+    uint32_t now = millis();
+    bool send = false;
+
+    portENTER_CRITICAL(&_mux);
+    if (!_inFlight) {
+        if (_versionId != 0) {
+            _stepId = _versionId;
+            _stepQuery = ROSTER_Q_VERSION;
+            _versionId = 0;
+            send = true;
+        } else if (_baudId != 0) {
+            _stepId = _baudId;
+            _stepQuery = ROSTER_Q_BAUD;
+            _baudId = 0;
+            send = true;
+        } else if (_sweeping) {
+            if (_cursor > ROSTER_MAX_ID) {
+                _sweeping = false;
+                _passes++;
+                _lastPassMs = now - _passStartedAt;
+                _nextPassAt = now + ROSTER_REFRESH_MS;
+            } else {
+                _stepId = _cursor++;
+                _stepQuery = ROSTER_Q_SYSID;
+                send = true;
+            }
+        } else if ((int32_t)(now - _nextPassAt) >= 0) {
+            _sweeping = true;
+            _cursor = 1;
+            _passStartedAt = now;
+        }
+
+        if (send) {
+            _inFlight = true;
+            id = _stepId;
+            query = _stepQuery;
+        }
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    return send;
+}
+
+void ControllerRoster::retryStep() {
+    portENTER_CRITICAL(&_mux);
+    if (_inFlight) {
+        if (_stepQuery == ROSTER_Q_VERSION) _versionId = _stepId;
+        else if (_stepQuery == ROSTER_Q_BAUD) _baudId = _stepId;
+        else _cursor = _stepId;
+        _inFlight = false;
+    }
+    portEXIT_CRITICAL(&_mux);
+}
+
+void ControllerRoster::rescan() {
+    portENTER_CRITICAL(&_mux);
+    _sweeping = true;
+    _cursor = 1;
+    _passStartedAt = millis();
+    portEXIT_CRITICAL(&_mux);
+}
+
+void ControllerRoster::markSeen(uint8_t id, uint16_t sysid) {
+    RosterEntry& e = _entries[id - 1];
+    if (!testBit(_live, id) || e.sysid != sysid) {
+        // Nov kontroler ili zamijenjen uređaj - stare verzije više ne važe
+        if (e.sysid != sysid) {
+            e.format = ROSTER_FMT_UNKNOWN;
+            e.baudMask = 0;
+        }
+        setBit(_live, id, true);
+        setBit(_dirty, id, true);
+        _liveDirty = true;
+    }
+    e.sysid = sysid;
+    e.misses = 0;
+    e.lastSeenMs = millis();
+}
+
+void ControllerRoster::markVersion(uint8_t id, const uint8_t* data, uint16_t len) {
+    RosterEntry& e = _entries[id - 1];
+    uint8_t format = ROSTER_FMT_SYSID_ONLY;
+    uint32_t boot = 0;
+    uint32_t app = 0;
+
+    if (len >= 21) {
+        format = ROSTER_FMT_VERSION5;
+        boot = readBE32(data + 1);
+        app = readBE32(data + 5);
+    }
+    if (e.format != format || e.bootloaderVer != boot || e.appVer != app) {
+        e.format = format;
+        e.bootloaderVer = boot;
+        e.appVer = app;
+        if (testBit(_live, id)) setBit(_dirty, id, true);
+    }
+}
+
+void ControllerRoster::markBaud(uint8_t id, bool ok, const uint8_t* data, uint16_t len) {
+    RosterEntry& e = _entries[id - 1];
+    uint8_t mask = 0x01; // Bez odgovora/stariji firmware - samo osnovna brzina
+
+    // Odgovor [CMD][mask][~mask] - komplement razlikuje ga od generičkog ACK-a starijeg firmware-a
+    if (ok && len >= 3 && (uint8_t)(data[1] ^ data[2]) == 0xFF) mask |= data[1];
+
+    if (e.baudMask != mask) {
+        e.baudMask = mask;
+        if (testBit(_live, id)) setBit(_dirty, id, true);
+    }
+}
+
+void ControllerRoster::markMissed(uint8_t id) {
+    if (!testBit(_live, id)) return;
+
+    RosterEntry& e = _entries[id - 1];
+    if (e.misses < 255) e.misses++;
+    if (e.misses >= ROSTER_MISS_LIMIT) {
+        setBit(_live, id, false);
+        setBit(_dirty, id, true);
+        _liveDirty = true;
+    }
+}
+
+void ControllerRoster::onSweepReply(uint8_t id, RosterQuery query, bool ok, const uint8_t* data, uint16_t len) {
+    if (id < 1 || id > ROSTER_MAX_ID) return;
+
+    portENTER_CRITICAL(&_mux);
+    if (query == ROSTER_Q_SYSID) {
+        if (ok && len >= 3) {
+            markSeen(id, ((uint16_t)data[1] << 8) | data[2]);
+            _versionId = id;
+        } else if (!ok) {
+            markMissed(id);
+        }
+    } else if (query == ROSTER_Q_VERSION) {
+        if (ok) markVersion(id, data, len);
+        _baudId = id; // Firmware se mogao promijeniti - brzine se provjeravaju u svakom prolazu
+    } else {
+        markBaud(id, ok, data, len);
+    }
+    _inFlight = false;
+    portEXIT_CRITICAL(&_mux);
+}
+
+void ControllerRoster::learnSysid(uint8_t id, const uint8_t* data, uint16_t len) {
+    if (id < 1 || id > ROSTER_MAX_ID || len < 3) return;
+
+    portENTER_CRITICAL(&_mux);
+    markSeen(id, ((uint16_t)data[1] << 8) | data[2]);
+    portEXIT_CRITICAL(&_mux);
+}
+
+void ControllerRoster::learnVersion(uint8_t id, const uint8_t* data, uint16_t len) {
+    if (id < 1 || id > ROSTER_MAX_ID) return;
+
+    portENTER_CRITICAL(&_mux);
+    markVersion(id, data, len);
+    portEXIT_CRITICAL(&_mux);
+}
+
+uint8_t ControllerRoster::commonBaudMask(bool (*filter)(uint8_t id, void* arg), void* arg, uint16_t& count) {
+    uint8_t mask = 0xFF;
+    count = 0;
+
+    portENTER_CRITICAL(&_mux);
+    for (int id = 1; id <= ROSTER_MAX_ID; id++) {
+        if (!testBit(_live, id) || !filter(id, arg)) continue;
+        uint8_t m = _entries[id - 1].baudMask;
+        mask &= m ? m : 0x01;
+        count++;
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    return count ? mask : 0x01;
+}
+
+bool ControllerRoster::isLive(uint8_t id) {
+    if (id < 1 || id > ROSTER_MAX_ID) return false;
+
+    bool live;
+    portENTER_CRITICAL(&_mux);
+    live = testBit(_live, id);
+    portEXIT_CRITICAL(&_mux);
+
+    return live;
+}
+
+bool ControllerRoster::get(uint8_t id, RosterEntry& out) {
+    if (id < 1 || id > ROSTER_MAX_ID) return false;
+
+    bool live;
+    portENTER_CRITICAL(&_mux);
+    live = testBit(_live, id);
+    if (live) out = _entries[id - 1];
+    portEXIT_CRITICAL(&_mux);
+
+    return live;
+}
+
+void ControllerRoster::getStats(RosterStats& out) {
+    portENTER_CRITICAL(&_mux);
+    out.live = 0;
+    for (int i = 0; i < 8; i++) out.live += __builtin_popcount(_live[i]);
+    out.cursor = _cursor;
+    out.passes = _passes;
+    out.lastPassMs = _lastPassMs;
+    out.sweeping = _sweeping;
+    portEXIT_CRITICAL(&_mux);
+}
+
+const char* ControllerRoster::formatName(uint8_t format) {
+    switch (format) {
+        case ROSTER_FMT_SYSID_ONLY: return "sysid_only";
+        case ROSTER_FMT_VERSION5:   return "version5";
+        default:                    return "unknown";
+    }
+}
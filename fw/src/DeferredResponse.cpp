@@ -0,0 +1,85 @@
+#include "DeferredResponse.h"
+#include <lwip/tcpip.h>
+#include <lwip/priv/tcp_priv.h>
+
+// Konekcija kojoj treba poll - kopija, jer odgovor može biti obrisan prije nego tcpip task stigne do nje
+struct DeferredPoll {
+    tcp_pcb* pcb;
+    void* client;
+};
+
+DeferredResponse::DeferredResponse(const char* contentType)
+    : _sink(_body, sizeof(_body)), _sent(0), _ready(false), _client(NULL), _pcb(NULL) {
+    _mux = portMUX_INITIALIZER_UNLOCKED;
+    setContentType(contentType);
+}
+
+void DeferredResponse::complete(int code) {
+    setCode(code);
+    setContentLength(_sink.length());
+
+    DeferredPoll poll = {NULL, NULL};
+    portENTER_CRITICAL(&_mux);
+    _ready = true; // Tijelo je upisano - async_tcp ga čita tek nakon ovoga
+    poll.pcb = _pcb;
+    poll.client = _client;
+    portEXIT_CRITICAL(&_mux);
+
+    // Bez _pcb handler još nije predao odgovor - _respond() će ga poslati direktno
+    if (poll.pcb == NULL) return;
+    DeferredPoll* ctx = new DeferredPoll(poll);
+    if (tcpip_callback(pollNow, ctx) != ERR_OK) delete ctx; // Ostaje periodični poll
+}
+
+// tcpip task: pcb se ne može zatvoriti paralelno. Ako je još aktivan i pripada istom klijentu,
+// njegov poll callback (AsyncTCP) javlja LWIP_TCP_POLL async_tcp tasku -> request->_onPoll() -> _ack()
+void DeferredResponse::pollNow(void* ctx) {
+    DeferredPoll* poll = static_cast<DeferredPoll*>(ctx);
+
+    for (tcp_pcb* pcb = tcp_active_pcbs; pcb != NULL; pcb = pcb->next) {
+        if (pcb != poll->pcb) continue;
+        if (pcb->callback_arg == poll->client && pcb->poll != NULL) pcb->poll(pcb->callback_arg, pcb);
+        break;
+    }
+    delete poll;
+}
+
+bool DeferredResponse::ready() {
+    bool r;
+
+    portENTER_CRITICAL(&_mux);
+    r = _ready;
+    portEXIT_CRITICAL(&_mux);
+
+    return r;
+}
+
+void DeferredResponse::_respond(AsyncWebServerRequest* request) {
+    AsyncClient* client = request->client();
+    bool r;
+
+    portENTER_CRITICAL(&_mux);
+    _client = client;
+    _pcb = client->pcb();
+    r = _ready;
+    portEXIT_CRITICAL(&_mux);
+
+    // Odgovor još nije stigao - ostaje RESPONSE_SETUP, complete() okida poll, a on _ack()
+    if (r) AsyncAbstractResponse::_respond(request);
+}
+
+size_t DeferredResponse::_ack(AsyncWebServerRequest* request, size_t len, uint32_t time) {
+    if (_state == RESPONSE_SETUP) {
+        if (ready()) AsyncAbstractResponse::_respond(request);
+        return 0;
+    }
+    return AsyncAbstractResponse::_ack(request, len, time);
+}
+
+size_t DeferredResponse::_fillBuffer(uint8_t* buf, size_t maxLen) {
+    size_t n = _sink.length() - _sent;
+    if (n > maxLen) n = maxLen;
+    memcpy(buf, _body + _sent, n);
+    _sent += n;
+    return n;
+}
@@ -1,9 +1,19 @@
 #include "ExternalFlash.h"
 #include "LogMacros.h"
 
-ExternalFlash::ExternalFlash(int csPin, SPIClass& spiBus) : _cs(csPin), _spi(spiBus) {}
+ExternalFlash::ExternalFlash(int csPin, SPIClass& spiBus) : _cs(csPin), _spi(spiBus), _lock(NULL) {}
+
+void ExternalFlash::lock() {
+    if (_lock) xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+}
+
+void ExternalFlash::unlock() {
+    if (_lock) xSemaphoreGiveRecursive(_lock);
+}
 
 bool ExternalFlash::begin() {
+    if (_lock == NULL) _lock = xSemaphoreCreateRecursiveMutex();
+
     pinMode(_cs, OUTPUT);
     digitalWrite(_cs, HIGH);
     delay(100); // Longer initial delay
@@ -151,7 +161,38 @@ bool ExternalFlash::eraseSlot(uint8_t slotIndex) {
     return true;
 }
 
+bool ExternalFlash::eraseSlotSector(uint8_t slotIndex, uint32_t offset) {
+    uint32_t startAddr = getSlotAddress(slotIndex);
+    if (startAddr == 0xFFFFFFFF || offset >= FW_SLOT_SIZE) return false;
+
+    eraseSector4K(startAddr + (offset & ~0xFFFUL));
+    return true;
+}
+
+void ExternalFlash::eraseSector4K(uint32_t addr) {
+    lock();
+    waitUntilReady();
+    writeEnable();
+
+    digitalWrite(_cs, LOW);
+    delayMicroseconds(1);
+
+    _spi.beginTransaction(SPISettings(4000000, MSBFIRST, SPI_MODE0));
+    _spi.transfer(W25Q_SECTOR_ERASE_4K);
+    _spi.transfer((addr >> 16) & 0xFF);
+    _spi.transfer((addr >> 8) & 0xFF);
+    _spi.transfer(addr & 0xFF);
+    _spi.endTransaction();
+
+    delayMicroseconds(1);
+    digitalWrite(_cs, HIGH);
+
+    waitUntilReady();
+    unlock();
+}
+
 void ExternalFlash::eraseBlock64K(uint32_t addr) {
+    lock();
     waitUntilReady();
     writeEnable();
     
@@ -174,6 +215,7 @@ void ExternalFlash::eraseBlock64K(uint32_t addr) {
     
     // LOG_DEBUG_F("ExtFlash: Erase Block %08X command sent.\n", addr);
     waitUntilReady();
+    unlock();
 }
 
 void ExternalFlash::write(uint32_t addr, const uint8_t* buf, size_t len) {
@@ -182,6 +224,7 @@ void ExternalFlash::write(uint32_t addr, const uint8_t* buf, size_t len) {
     const uint8_t* ptr = buf;
     uint32_t currentAddr = addr;
 
+    lock();
     while (toWrite > 0) {
         waitUntilReady();
         writeEnable();
@@ -211,9 +254,11 @@ void ExternalFlash::write(uint32_t addr, const uint8_t* buf, size_t len) {
         toWrite -= chunk;
     }
     waitUntilReady();
+    unlock();
 }
 
 void ExternalFlash::read(uint32_t addr, uint8_t* buf, size_t len) {
+    lock();
     waitUntilReady();
     
     digitalWrite(_cs, LOW);
@@ -231,6 +276,7 @@ void ExternalFlash::read(uint32_t addr, uint8_t* buf, size_t len) {
     
     delayMicroseconds(1);
     digitalWrite(_cs, HIGH);
+    unlock();
 }
 
 bool ExternalFlash::writeBufferToSlot(uint8_t slotIndex, uint32_t offset, const uint8_t* data, size_t len) {
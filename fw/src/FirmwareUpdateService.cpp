@@ -38,12 +38,13 @@ static uint32_t stm32_crc32_update(uint32_t crc, const uint8_t *data, size_t len
     return crc;
 }
 
-FirmwareUpdateService::FirmwareUpdateService(ExternalFlash& flash, TinyFrame& tf) 
-    : _flash(flash), _tf(tf), _state(UPD_IDLE), _lastProgress(0), _lastProgressTime(0), 
+FirmwareUpdateService::FirmwareUpdateService(ExternalFlash& flash, RS485Bus& bus) 
+    : _flash(flash), _defaultBus(bus), _bus(&bus), _state(UPD_IDLE), _lastProgress(0), _lastProgressTime(0), 
       _wasCompleted(false), _lastTerminalState(UPD_IDLE) {}
 
-bool FirmwareUpdateService::startUpdate(uint8_t fromSlot, uint8_t targetAddr, uint32_t stagingAddr) {
+bool FirmwareUpdateService::startUpdate(uint8_t fromSlot, uint8_t targetAddr, uint32_t stagingAddr, RS485Bus* bus) {
     if (_state != UPD_IDLE) return false;
+    _bus = (bus != NULL) ? bus : &_defaultBus;
 
     // Validate Slot and Read Info
     if (fromSlot < 4) {
@@ -231,7 +232,7 @@ void FirmwareUpdateService::sendStartRequest() {
     // sa staging adresom koju očekuje agent (npr. 0x90000000 za QSPI)
     memcpy(&payload[18], &_stagingAddr, 4);
 
-    TF_SendSimple(&_tf, TF_TYPE_FIRMWARE_UPDATE, payload, 26);
+    _bus->send(BUS_CLASS_FIRMWARE, TF_TYPE_FIRMWARE_UPDATE, payload, 26);
     
     _timerStart = millis();
     _state = UPD_WAIT_START_ACK;
@@ -262,7 +263,7 @@ void FirmwareUpdateService::sendDataPacket() {
     memcpy(&payload[2], &_currentSeq, 4);
     memcpy(&payload[6], _chunkBuffer, chunk);
 
-    TF_SendSimple(&_tf, TF_TYPE_FIRMWARE_UPDATE, payload, 6 + chunk);
+    _bus->send(BUS_CLASS_FIRMWARE, TF_TYPE_FIRMWARE_UPDATE, payload, 6 + chunk);
 
     _lastPacketSize = chunk;
     _timerStart = millis();
@@ -276,7 +277,7 @@ void FirmwareUpdateService::sendFinishRequest() {
     payload[1] = _targetAddr;
     memcpy(&payload[2], &_fwInfo.crc32, 4);
 
-    TF_SendSimple(&_tf, TF_TYPE_FIRMWARE_UPDATE, payload, 6);
+    _bus->send(BUS_CLASS_FIRMWARE, TF_TYPE_FIRMWARE_UPDATE, payload, 6);
 
     _timerStart = millis();
     _state = UPD_WAIT_FINISH_ACK;
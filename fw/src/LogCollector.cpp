@@ -0,0 +1,142 @@
+#include "LogCollector.h"
+#include <time.h>
+#include "LogMacros.h"
+
+LogCollector::LogCollector(LogStore& store, ControllerRoster& roster, LogDrain& drain, RS485Bus& (*busFor)(uint8_t id))
+    : _store(store), _roster(roster), _drain(drain), _busFor(busFor) {
+    _state = LOG_COLLECT_IDLE;
+    _id = 0;
+    _cursor = 1;
+    _roundFound = false;
+    _nextRoundAt = 0;
+    _haveLast = false;
+    memset(&_stats, 0, sizeof(_stats));
+    _mux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+// Sljedeći prisutni kontroler od kursora; false na kraju kruga
+bool LogCollector::pickNext(uint32_t now) {
+    while (_cursor <= ROSTER_MAX_ID) {
+        uint8_t candidate = _cursor++;
+        if (_roster.isLive(candidate) && !_drain.active(candidate)) {
+            _id = candidate;
+            _haveLast = false;
+            return true;
+        }
+    }
+
+    _cursor = 1;
+    _stats.rounds++;
+    if (!_roundFound) _nextRoundAt = now + LOG_COLLECT_ROUND_MS;
+    _roundFound = false;
+    return false;
+}
+
+void LogCollector::tick() {
+    if (!_store.ready()) return;
+
+    uint32_t now = millis();
+    LogCollectState state;
+
+    portENTER_CRITICAL(&_mux);
+    state = _state;
+    portEXIT_CRITICAL(&_mux);
+
+    if (state == LOG_COLLECT_BUSY) return;
+
+    if (state == LOG_COLLECT_IDLE) {
+        if ((int32_t)(now - _nextRoundAt) < 0 || !pickNext(now)) return;
+        state = LOG_COLLECT_READ;
+    }
+
+    if (state == LOG_COLLECT_STORE) {
+        time_t t = time(NULL);
+        uint32_t storedAt = (t > 1600000000) ? (uint32_t)t : 0;
+        if (!_store.append(_id, _entry, storedAt)) {
+            LOG_ERROR("[LogCollector] ID %d: flash write failed\n", _id);
+            portENTER_CRITICAL(&_mux);
+            _stats.storeFailures++;
+            _state = LOG_COLLECT_IDLE;
+            portEXIT_CRITICAL(&_mux);
+            _nextRoundAt = now + LOG_COLLECT_RETRY_MS;
+            return;
+        }
+        memcpy(_last, _entry, sizeof(_last));
+        _haveLast = true;
+        _roundFound = true;
+        _stats.collected++;
+        state = LOG_COLLECT_DELETE;
+    }
+
+    // Klijent je u međuvremenu pokrenuo /logs/drain za ovaj ID - zapis je već u flashu, kontroler prepušten klijentu
+    if (_drain.active(_id)) state = LOG_COLLECT_IDLE;
+
+    if (state != LOG_COLLECT_IDLE && !_busFor(_id).isIdle()) {
+        portENTER_CRITICAL(&_mux);
+        _state = state;
+        portEXIT_CRITICAL(&_mux);
+        return;
+    }
+
+    uint8_t query[2] = {(uint8_t)(state == LOG_COLLECT_DELETE ? LOG_DRAIN_DELETE_CMD : LOG_DRAIN_READ_CMD), _id};
+
+    portENTER_CRITICAL(&_mux);
+    _state = (state == LOG_COLLECT_IDLE) ? LOG_COLLECT_IDLE : LOG_COLLECT_BUSY;
+    _stats.currentId = _id;
+    portEXIT_CRITICAL(&_mux);
+
+    if (state == LOG_COLLECT_IDLE) return;
+
+    if (_busFor(_id).query(BUS_CLASS_LOG, LOG_DRAIN_FRAME_TYPE, query, sizeof(query), 0, onReply, this, query[0]) == 0) {
+        portENTER_CRITICAL(&_mux);
+        _state = state; // Red pun - sljedeći tick
+        portEXIT_CRITICAL(&_mux);
+    }
+}
+
+void LogCollector::onReply(BusTransaction& txn) {
+    LogCollector* self = static_cast<LogCollector*>(txn.arg);
+    const uint8_t* r = txn.reply;
+
+    portENTER_CRITICAL(&self->_mux);
+    if (txn.tag == LOG_DRAIN_READ_CMD) {
+        if (txn.result != BUS_OK || txn.replyLen < 2 + LOG_DRAIN_ENTRY_SIZE || r[1] != LOG_DRAIN_ENTRY_SIZE) {
+            if (txn.result != BUS_ABORTED) self->_stats.readFailures++;
+            self->_state = LOG_COLLECT_IDLE;   // Sljedeći kontroler; ovaj opet u sljedećem krugu
+        } else if (r[2] == 0 && r[3] == 0) {
+            self->_state = LOG_COLLECT_IDLE;   // LOGGER_EMPTY
+        } else if (self->_haveLast && memcmp(self->_last, r + 2, LOG_DRAIN_ENTRY_SIZE) == 0) {
+            self->_stats.duplicates++;
+            self->_state = LOG_COLLECT_DELETE; // Već u flashu - samo obriši
+        } else {
+            memcpy(self->_entry, r + 2, LOG_DRAIN_ENTRY_SIZE);
+            self->_state = LOG_COLLECT_STORE;
+        }
+    } else {
+        if (txn.result != BUS_OK || txn.replyLen < 2) {
+            if (txn.result != BUS_ABORTED) self->_stats.deleteFailures++;
+            self->_state = LOG_COLLECT_READ;   // Ponovo čitanje - duplikat prepoznaje _last
+        } else {
+            self->_state = (r[1] == 0) ? LOG_COLLECT_READ : LOG_COLLECT_IDLE;
+        }
+    }
+    portEXIT_CRITICAL(&self->_mux);
+}
+
+bool LogCollector::owns(uint8_t id) {
+    bool owned;
+
+    portENTER_CRITICAL(&_mux);
+    owned = (_state != LOG_COLLECT_IDLE && _id == id);
+    portEXIT_CRITICAL(&_mux);
+
+    return owned;
+}
+
+void LogCollector::getStats(LogCollectorStats& out) {
+    portENTER_CRITICAL(&_mux);
+    out = _stats;
+    out.state = _state;
+    if (_state == LOG_COLLECT_IDLE) out.currentId = 0;
+    portEXIT_CRITICAL(&_mux);
+}
@@ -0,0 +1,245 @@
+#include "LogDrain.h"
+#include <ESPAsyncWebServer.h>
+#include "LogMacros.h"
+
+LogDrain::LogDrain(LogEntryFormatter formatter, LogOrphanSink orphans) : _formatter(formatter), _orphans(orphans) {
+    memset(_jobs, 0, sizeof(_jobs));
+    _mux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+LogDrainJob* LogDrain::start(RS485Bus& bus, uint8_t id, bool remove, uint16_t limit, bool& busy) {
+    LogDrainJob* job = NULL;
+    busy = false;
+
+    portENTER_CRITICAL(&_mux);
+    // Napuštena sesija istog ID-a ima zapise koje klijent još nije dobio - nastavlja se
+    for (int i = 0; i < LOG_DRAIN_JOBS; i++) {
+        LogDrainJob& j = _jobs[i];
+        if (j.state == LOG_DRAIN_FREE || j.id != id || j.bus != &bus) continue;
+        if (j.attached) busy = true;
+        else job = &j;
+        break;
+    }
+    if (job == NULL && !busy) {
+        for (int i = 0; i < LOG_DRAIN_JOBS; i++) {
+            if (_jobs[i].state != LOG_DRAIN_FREE) continue;
+            job = &_jobs[i];
+            job->owner = this;
+            job->id = id;
+            job->bus = &bus;
+            job->pendingDelete = false;
+            job->head = 0;
+            job->count = 0;
+            job->state = LOG_DRAIN_READY;
+            break;
+        }
+    }
+    if (job != NULL) {
+        if (job->state == LOG_DRAIN_DONE) job->state = LOG_DRAIN_READY;
+        job->attached = true;
+        job->remove = remove;
+        job->limit = limit;
+        job->produced = job->count; // Preuzeti zapisi ulaze u limit
+        job->delivered = 0;
+        job->trailerSent = false;
+        job->reason = NULL;
+        job->lineLen = 0;
+        job->linePos = 0;
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    if (job != NULL) advance(job);
+    return job;
+}
+
+void LogDrain::finish(LogDrainJob* job, const char* reason) {
+    job->state = LOG_DRAIN_DONE;
+    job->reason = reason;
+}
+
+void LogDrain::advance(LogDrainJob* job) {
+    uint8_t cmd = 0;
+
+    portENTER_CRITICAL(&_mux);
+    if (job->state == LOG_DRAIN_READY && job->attached) {
+        if (job->pendingDelete && !job->remove) {
+            finish(job, "read_only");
+        } else if (job->pendingDelete) {
+            cmd = LOG_DRAIN_DELETE_CMD;
+        } else if (job->produced >= job->limit) {
+            finish(job, "limit");
+        } else if (job->count < LOG_DRAIN_RING) {
+            cmd = LOG_DRAIN_READ_CMD;
+        }
+        if (cmd != 0) job->state = LOG_DRAIN_BUSY;
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    if (cmd == 0) return;
+
+    uint8_t query[2] = {cmd, job->id};
+    if (job->bus->query(BUS_CLASS_LOG, LOG_DRAIN_FRAME_TYPE, query, sizeof(query), 0, onReply, job, cmd) == 0) {
+        portENTER_CRITICAL(&_mux);
+        job->state = LOG_DRAIN_READY; // Red pun - tick() ponavlja
+        portEXIT_CRITICAL(&_mux);
+    }
+}
+
+void LogDrain::onReply(BusTransaction& txn) {
+    LogDrainJob* job = static_cast<LogDrainJob*>(txn.arg);
+    LogDrain* self = job->owner;
+    const uint8_t* r = txn.reply;
+
+    portENTER_CRITICAL(&self->_mux);
+    if (txn.result == BUS_ABORTED) {
+        job->state = LOG_DRAIN_READY; // Oporavak busa - isti upit ponovo
+    } else if (txn.result != BUS_OK) {
+        self->finish(job, RS485Bus::resultName(txn.result));
+    } else if (txn.tag == LOG_DRAIN_READ_CMD) {
+        if (txn.replyLen < 2 + LOG_DRAIN_ENTRY_SIZE || r[1] != LOG_DRAIN_ENTRY_SIZE) {
+            self->finish(job, "invalid_reply");
+        } else if (r[2] == 0 && r[3] == 0) {
+            self->finish(job, "empty"); // log_id 0 = LOGGER_EMPTY
+        } else {
+            memcpy(job->ring[(job->head + job->count) % LOG_DRAIN_RING], r + 2, LOG_DRAIN_ENTRY_SIZE);
+            job->count++;
+            job->produced++;
+            job->pendingDelete = true;
+            job->state = LOG_DRAIN_READY;
+        }
+    } else {
+        job->pendingDelete = false;
+        if (txn.replyLen < 2) self->finish(job, "invalid_reply");
+        else if (r[1] != 0) self->finish(job, "empty");
+        else job->state = LOG_DRAIN_READY;
+    }
+    portEXIT_CRITICAL(&self->_mux);
+
+    self->advance(job);
+    self->releaseIfIdle(job);
+}
+
+size_t LogDrain::fill(LogDrainJob* job, uint8_t* buf, size_t maxLen) {
+    size_t out = 0;
+    bool freed = false;
+
+    while (out < maxLen) {
+        if (job->linePos < job->lineLen) {
+            size_t n = job->lineLen - job->linePos;
+            if (n > maxLen - out) n = maxLen - out;
+            memcpy(buf + out, job->line + job->linePos, n);
+            out += n;
+            job->linePos += n;
+            continue;
+        }
+
+        uint8_t entry[LOG_DRAIN_ENTRY_SIZE];
+        bool haveEntry = false;
+        bool trailer = false;
+
+        portENTER_CRITICAL(&_mux);
+        if (job->lineLen > 0 && job->linePos == job->lineLen && job->count > 0 && !job->trailerSent) {
+            // Linija je cijela predana TCP-u - tek sada zapis napušta ring
+            job->head = (job->head + 1) % LOG_DRAIN_RING;
+            job->count--;
+            job->delivered++;
+            freed = true;
+        }
+        job->lineLen = 0;
+        job->linePos = 0;
+        if (job->count > 0) {
+            memcpy(entry, job->ring[job->head], LOG_DRAIN_ENTRY_SIZE);
+            haveEntry = true;
+        } else if (job->state == LOG_DRAIN_DONE && !job->trailerSent) {
+            job->trailerSent = true;
+            trailer = true;
+        }
+        portEXIT_CRITICAL(&_mux);
+
+        if (haveEntry) {
+            size_t len = _formatter(job->line, LOG_DRAIN_LINE_MAX - 1, job->id, entry);
+            job->line[len++] = '\n';
+            job->lineLen = len;
+        } else if (trailer) {
+            int len = snprintf(job->line, LOG_DRAIN_LINE_MAX,
+                               "{\"done\":true,\"device_id\":%d,\"count\":%u,\"reason\":\"%s\"}\n",
+                               job->id, job->delivered, job->reason ? job->reason : "unknown");
+            job->lineLen = (len > 0 && len < LOG_DRAIN_LINE_MAX) ? len : 0;
+            job->linePos = 0;
+            // Trailer nije iz ringa - ne smije pomjeriti head u sljedećem krugu
+        } else {
+            break;
+        }
+    }
+
+    if (freed) advance(job);
+    if (out > 0) return out;
+
+    bool finished;
+    portENTER_CRITICAL(&_mux);
+    finished = job->trailerSent && job->linePos >= job->lineLen;
+    portEXIT_CRITICAL(&_mux);
+    return finished ? 0 : RESPONSE_TRY_AGAIN;
+}
+
+void LogDrain::releaseIfIdle(LogDrainJob* job) {
+    portENTER_CRITICAL(&_mux);
+    if (!job->attached && job->state != LOG_DRAIN_BUSY && job->state != LOG_DRAIN_FREE && job->count == 0) {
+        job->state = LOG_DRAIN_FREE;
+    }
+    portEXIT_CRITICAL(&_mux);
+}
+
+void LogDrain::detach(LogDrainJob* job) {
+    portENTER_CRITICAL(&_mux);
+    job->attached = false;
+    job->detachedAt = millis();
+    if (job->state == LOG_DRAIN_DONE && job->trailerSent) job->count = 0; // Sve isporučeno
+    portEXIT_CRITICAL(&_mux);
+
+    releaseIfIdle(job);
+}
+
+bool LogDrain::active(uint8_t id) {
+    bool found = false;
+
+    portENTER_CRITICAL(&_mux);
+    for (int i = 0; i < LOG_DRAIN_JOBS && !found; i++) {
+        found = (_jobs[i].state != LOG_DRAIN_FREE && _jobs[i].id == id);
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    return found;
+}
+
+void LogDrain::tick() {
+    uint32_t now = millis();
+
+    for (int i = 0; i < LOG_DRAIN_JOBS; i++) {
+        LogDrainJob* job = &_jobs[i];
+        uint8_t orphaned[LOG_DRAIN_RING][LOG_DRAIN_ENTRY_SIZE];
+        uint8_t expired = 0;
+
+        portENTER_CRITICAL(&_mux);
+        bool retry = (job->state == LOG_DRAIN_READY && job->attached);
+        if (!job->attached && job->state != LOG_DRAIN_FREE && job->state != LOG_DRAIN_BUSY &&
+            now - job->detachedAt >= LOG_DRAIN_ORPHAN_MS) {
+            // Zadnji zapis bez DELETE_LOG je još na kontroleru - pročitaće ga kolektor, ne duplira se
+            expired = (job->pendingDelete && job->count > 0) ? job->count - 1 : job->count;
+            for (int k = 0; k < expired; k++) {
+                memcpy(orphaned[k], job->ring[(job->head + k) % LOG_DRAIN_RING], LOG_DRAIN_ENTRY_SIZE);
+            }
+            job->count = 0;
+            job->state = LOG_DRAIN_FREE;
+        }
+        portEXIT_CRITICAL(&_mux);
+
+        if (retry) advance(job);
+
+        uint8_t lost = 0;
+        for (int k = 0; k < expired; k++) {
+            if (_orphans == NULL || !_orphans(job->id, orphaned[k])) lost++;
+        }
+        if (lost > 0) LOG_ERROR("[LogDrain] ID %d: %d undelivered log entries dropped\n", job->id, lost);
+    }
+}
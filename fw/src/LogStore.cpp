@@ -0,0 +1,313 @@
+#include "LogStore.h"
+#include "LogMacros.h"
+
+struct LogStoreHeader {
+    char magic[8];
+    uint32_t recordSize;
+    uint32_t recordsPerSector;
+};
+
+static uint8_t bcdToDec(uint8_t v) {
+    return ((v >> 4) * 10) + (v & 0x0F);
+}
+
+LogStore::LogStore(ExternalFlash& flash, int slot) : _flash(flash), _slot(slot) {
+    _ready = false;
+    _head = 1;
+    _headCount = 0;
+    _nextSeq = 1;
+    memset(_headBloom, 0, sizeof(_headBloom));
+    memset(_count, 0, sizeof(_count));
+    memset(_minDay, 0xFF, sizeof(_minDay));
+    memset(_maxDay, 0, sizeof(_maxDay));
+    memset(&_stats, 0, sizeof(_stats));
+    _stats.capacity = LOG_STORE_CAPACITY;
+    _mux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+uint32_t LogStore::offsetOf(uint16_t sector, int record) {
+    return (uint32_t)sector * LOG_STORE_SECTOR_SIZE + (uint32_t)record * LOG_STORE_RECORD_SIZE;
+}
+
+// Dani od 01.01.2000 (days-from-civil); 0 za nevažeći datum
+uint16_t LogStore::dayNumber(uint8_t day, uint8_t month, uint16_t year) {
+    if (day < 1 || day > 31 || month < 1 || month > 12 || year < 2000 || year > 2099) return 0;
+
+    int y = year - (month <= 2);
+    int era = y / 400;
+    int yoe = y - era * 400;
+    int mp = (month + 9) % 12;
+    int doy = (153 * mp + 2) / 5 + day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int days = era * 146097 + doe - 730425; // 730425 = 01.01.2000
+    return (uint16_t)(days + 1);
+}
+
+uint16_t LogStore::entryDay(const uint8_t* entry) {
+    return dayNumber(bcdToDec(entry[10]), bcdToDec(entry[11]), 2000 + bcdToDec(entry[12]));
+}
+
+void LogStore::bloomAdd(uint8_t* bloom, const uint8_t* card) {
+    uint32_t h = 2166136261UL;
+    for (int i = 0; i < 5; i++) h = (h ^ card[i]) * 16777619UL;
+    uint32_t h2 = (h >> 16) | 1;
+    for (int k = 0; k < LOG_STORE_BLOOM_HASHES; k++) {
+        uint32_t bit = (h + k * h2) % (LOG_STORE_BLOOM_BYTES * 8);
+        bloom[bit >> 3] |= (1 << (bit & 7));
+    }
+}
+
+bool LogStore::bloomHas(const uint8_t* bloom, const uint8_t* card) {
+    uint32_t h = 2166136261UL;
+    for (int i = 0; i < 5; i++) h = (h ^ card[i]) * 16777619UL;
+    uint32_t h2 = (h >> 16) | 1;
+    for (int k = 0; k < LOG_STORE_BLOOM_HASHES; k++) {
+        uint32_t bit = (h + k * h2) % (LOG_STORE_BLOOM_BYTES * 8);
+        if (!(bloom[bit >> 3] & (1 << (bit & 7)))) return false;
+    }
+    return true;
+}
+
+bool LogStore::format() {
+    LOG_INFO("[LogStore] Formatting slot %d\n", _slot);
+    if (!_flash.eraseSlot(_slot)) return false;
+
+    LogStoreHeader header;
+    memset(&header, 0, sizeof(header));
+    strncpy(header.magic, LOG_STORE_MAGIC, sizeof(header.magic));
+    header.recordSize = LOG_STORE_RECORD_SIZE;
+    header.recordsPerSector = LOG_STORE_RECORDS_PER_SECTOR;
+    return _flash.writeBufferToSlot(_slot, 0, (const uint8_t*)&header, sizeof(header));
+}
+
+// used = pozicija iza zadnjeg neobrisanog zapisa (i prekinutog), valid = potvrđeni zapisi
+void LogStore::scanSector(uint16_t sector, uint8_t& used, uint8_t& valid, uint16_t& minDay, uint16_t& maxDay,
+                          uint8_t* bloom, uint32_t& maxSeq) {
+    used = 0;
+    valid = 0;
+    minDay = LOG_DAY_ANY_TO;
+    maxDay = 0;
+    memset(bloom, 0, LOG_STORE_BLOOM_BYTES);
+
+    for (int r = 0; r < LOG_STORE_RECORDS_PER_SECTOR; r++) {
+        LogRecord rec;
+        _flash.readBufferFromSlot(_slot, offsetOf(sector, r), (uint8_t*)&rec, sizeof(rec));
+
+        bool erased = true;
+        for (size_t i = 0; i < sizeof(rec) && erased; i++) erased = (((uint8_t*)&rec)[i] == 0xFF);
+        if (erased) continue;
+
+        used = r + 1;
+        if (rec.commit != LOG_RECORD_COMMIT) continue;
+
+        valid++;
+        if (rec.seq > maxSeq) maxSeq = rec.seq;
+        if (rec.day < minDay) minDay = rec.day;
+        if (rec.day > maxDay) maxDay = rec.day;
+        bloomAdd(bloom, rec.entry + 5);
+    }
+}
+
+void LogStore::writeSummary(uint16_t sector, uint8_t count, uint16_t minDay, uint16_t maxDay, const uint8_t* bloom) {
+    LogSectorSummary summary;
+    memset(&summary, 0xFF, sizeof(summary));
+    summary.magic = LOG_SUMMARY_MAGIC;
+    summary.count = count;
+    summary.minDay = minDay;
+    summary.maxDay = maxDay;
+    memcpy(summary.bloom, bloom, LOG_STORE_BLOOM_BYTES);
+    _flash.writeBufferToSlot(_slot, offsetOf(sector, 0) + LOG_STORE_SUMMARY_OFFSET, (const uint8_t*)&summary, sizeof(summary));
+}
+
+bool LogStore::begin() {
+    if (_slot < 0 || _slot >= FW_SLOT_COUNT) return false;
+
+    LogStoreHeader header;
+    if (!_flash.readBufferFromSlot(_slot, 0, (uint8_t*)&header, sizeof(header))) return false;
+    if (strncmp(header.magic, LOG_STORE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.recordSize != LOG_STORE_RECORD_SIZE || header.recordsPerSector != LOG_STORE_RECORDS_PER_SECTOR) {
+        if (!format()) {
+            LOG_ERROR_LN("[LogStore] Format failed");
+            return false;
+        }
+    }
+
+    // Glava ringa = sektor čiji prvi zapis ima najveći seq
+    uint32_t headSeq = 0;
+    bool hasData[LOG_STORE_SECTORS] = {false};
+    for (uint16_t s = 1; s < LOG_STORE_SECTORS; s++) {
+        LogRecord first;
+        _flash.readBufferFromSlot(_slot, offsetOf(s, 0), (uint8_t*)&first, sizeof(first));
+        hasData[s] = (first.commit != 0xFF || first.seq != 0xFFFFFFFF); // Sektor se puni od zapisa 0
+        if (first.commit == LOG_RECORD_COMMIT && first.seq >= headSeq) {
+            headSeq = first.seq;
+            _head = s;
+        }
+    }
+
+    uint32_t maxSeq = 0;
+    uint32_t records = 0;
+    uint8_t bloom[LOG_STORE_BLOOM_BYTES];
+    for (uint16_t s = 1; s < LOG_STORE_SECTORS; s++) {
+        if (s == _head || !hasData[s]) continue;
+
+        LogSectorSummary summary;
+        _flash.readBufferFromSlot(_slot, offsetOf(s, 0) + LOG_STORE_SUMMARY_OFFSET, (uint8_t*)&summary, sizeof(summary));
+        if (summary.magic == LOG_SUMMARY_MAGIC) {
+            _count[s] = summary.count;
+            _minDay[s] = summary.minDay;
+            _maxDay[s] = summary.maxDay;
+        } else {
+            // Restart prije sažetka (ili stari sektor prije zatvaranja) - sažetak iz zapisa
+            uint8_t used;
+            scanSector(s, used, _count[s], _minDay[s], _maxDay[s], bloom, maxSeq);
+            if (_count[s] > 0) writeSummary(s, _count[s], _minDay[s], _maxDay[s], bloom);
+        }
+        records += _count[s];
+    }
+
+    uint8_t used;
+    scanSector(_head, used, _count[_head], _minDay[_head], _maxDay[_head], _headBloom, maxSeq);
+    _headCount = used;
+    records += _count[_head];
+    if (maxSeq < headSeq) maxSeq = headSeq;
+    _nextSeq = maxSeq + 1;
+    _stats.records = records;
+    _ready = true;
+
+    if (_headCount >= LOG_STORE_RECORDS_PER_SECTOR) sealHead();
+
+    LOG_INFO("[LogStore] Slot %d: %u records, head sector %d, next seq %u\n", _slot, records, _head, _nextSeq);
+    return true;
+}
+
+// Zatvara pun sektor i briše najstariji koji postaje nova glava
+void LogStore::sealHead() {
+    writeSummary(_head, _count[_head], _minDay[_head], _maxDay[_head], _headBloom);
+
+    uint16_t next = (_head + 1 < LOG_STORE_SECTORS) ? _head + 1 : 1;
+    _flash.eraseSlotSector(_slot, offsetOf(next, 0));
+
+    portENTER_CRITICAL(&_mux);
+    _stats.overwritten += _count[next];
+    _stats.records -= _count[next];
+    _count[next] = 0;
+    _minDay[next] = LOG_DAY_ANY_TO;
+    _maxDay[next] = 0;
+    memset(_headBloom, 0, sizeof(_headBloom));
+    _head = next;
+    _headCount = 0;
+    portEXIT_CRITICAL(&_mux);
+}
+
+bool LogStore::append(uint8_t id, const uint8_t* entry, uint32_t storedAt) {
+    if (!_ready) return false;
+
+    LogRecord rec;
+    memset(&rec, 0xFF, sizeof(rec));
+    rec.id = id;
+    rec.day = entryDay(entry);
+    rec.seq = _nextSeq;
+    rec.storedAt = storedAt;
+    memcpy(rec.entry, entry, sizeof(rec.entry));
+
+    // Zapis pa commit bajt: restart između ostavlja zapis koji se preskače
+    uint32_t offset = offsetOf(_head, _headCount);
+    uint8_t commit = LOG_RECORD_COMMIT;
+    if (!_flash.writeBufferToSlot(_slot, offset, (const uint8_t*)&rec, sizeof(rec)) ||
+        !_flash.writeBufferToSlot(_slot, offset, &commit, 1)) {
+        portENTER_CRITICAL(&_mux);
+        _stats.writeFailures++;
+        portEXIT_CRITICAL(&_mux);
+        return false;
+    }
+
+    portENTER_CRITICAL(&_mux);
+    _headCount++;
+    _nextSeq++;
+    _count[_head]++;
+    if (rec.day < _minDay[_head]) _minDay[_head] = rec.day;
+    if (rec.day > _maxDay[_head]) _maxDay[_head] = rec.day;
+    bloomAdd(_headBloom, rec.entry + 5);
+    _stats.records++;
+    _stats.appended++;
+    portEXIT_CRITICAL(&_mux);
+
+    if (_headCount >= LOG_STORE_RECORDS_PER_SECTOR) sealHead();
+    return true;
+}
+
+void LogStore::startQuery(LogQuery& q) {
+    portENTER_CRITICAL(&_mux);
+    q.sector = _head;
+    q.record = _headCount - 1;
+    portEXIT_CRITICAL(&_mux);
+    q.visited = 0;
+    q.sectorChecked = false;
+    q.scanned = 0;
+    q.skippedSectors = 0;
+}
+
+LogQueryStep LogStore::next(LogQuery& q, LogRecord& out) {
+    if (!_ready) return LOG_Q_END;
+
+    for (int budget = LOG_QUERY_SCAN_BUDGET; budget > 0; budget--) {
+        if (q.visited >= LOG_STORE_SECTORS - 1) return LOG_Q_END;
+
+        if (!q.sectorChecked) {
+            uint8_t bloom[LOG_STORE_BLOOM_BYTES];
+            bool isHead;
+
+            portENTER_CRITICAL(&_mux);
+            uint8_t count = _count[q.sector];
+            uint16_t minDay = _minDay[q.sector];
+            uint16_t maxDay = _maxDay[q.sector];
+            isHead = (q.sector == _head);
+            if (isHead) memcpy(bloom, _headBloom, sizeof(bloom));
+            portEXIT_CRITICAL(&_mux);
+
+            bool skip = (count == 0 || maxDay < q.fromDay || minDay > q.toDay);
+            if (!skip && q.byCard) {
+                if (!isHead) {
+                    _flash.readBufferFromSlot(_slot, offsetOf(q.sector, 0) + LOG_STORE_SUMMARY_OFFSET +
+                                              offsetof(LogSectorSummary, bloom), bloom, sizeof(bloom));
+                }
+                skip = !bloomHas(bloom, q.card);
+            }
+
+            if (skip) {
+                if (count > 0) q.skippedSectors++;
+                q.record = -1;
+            } else if (q.visited > 0) {
+                q.record = LOG_STORE_RECORDS_PER_SECTOR - 1; // Prekinuti zapisi se preskaču po commit bajtu
+            }
+            q.sectorChecked = true;
+        }
+
+        if (q.record < 0) {
+            q.sector = (q.sector > 1) ? q.sector - 1 : LOG_STORE_SECTORS - 1;
+            q.visited++;
+            q.sectorChecked = false;
+            continue;
+        }
+
+        _flash.readBufferFromSlot(_slot, offsetOf(q.sector, q.record), (uint8_t*)&out, sizeof(out));
+        q.record--;
+        q.scanned++;
+
+        if (out.commit != LOG_RECORD_COMMIT) continue;
+        if (q.id != 0 && out.id != q.id) continue;
+        if (out.day < q.fromDay || out.day > q.toDay) continue;
+        if (q.byCard && memcmp(out.entry + 5, q.card, 5) != 0) continue;
+        return LOG_Q_MATCH;
+    }
+
+    return LOG_Q_AGAIN;
+}
+
+void LogStore::getStats(LogStoreStats& out) {
+    portENTER_CRITICAL(&_mux);
+    out = _stats;
+    out.nextSeq = _nextSeq;
+    portEXIT_CRITICAL(&_mux);
+}
@@ -0,0 +1,598 @@
+#include "RS485Bus.h"
+#include "LogMacros.h"
+
+// traceTx() čita zaglavlje direktno iz TX bafera: [SOF][ID][LEN hi][LEN lo][TYPE][HCRC x2]
+#if TF_ID_BYTES != 1 || TF_LEN_BYTES != 2 || TF_TYPE_BYTES != 1 || !TF_USE_SOF_BYTE
+    #error "RS485Bus::traceTx assumes 1-byte ID, 2-byte LEN, 1-byte TYPE and SOF"
+#endif
+#define BUS_FRAME_HEAD_LEN  7
+
+static const uint16_t classQueueLen[BUS_CLASS_COUNT] = {
+    BUS_QUEUE_LEN_ACCESS,
+    BUS_QUEUE_LEN_WRITE,
+    BUS_QUEUE_LEN_READ,
+    BUS_QUEUE_LEN_LOG,
+    BUS_QUEUE_LEN_FIRMWARE,
+};
+
+RS485Bus::RS485Bus(HardwareSerial& serial, int dePin, int rxPin, int txPin, const char* name)
+    : _serial(serial), _dePin(dePin), _rxPin(rxPin), _txPin(txPin), _name(name), _baud(0), _txRemaining(0), _task(NULL), _lock(NULL),
+      _active(NULL), _nextTicket(0), _rateWindowStart(0), _rateTxBase(0), _rateRxBase(0),
+      _recoverRequest(0), _recoverWindowStart(0) {
+    memset(_queues, 0, sizeof(_queues));
+    memset(_stats, 0, sizeof(_stats));
+    memset(&_counters, 0, sizeof(_counters));
+    memset(_pool, 0, sizeof(_pool));
+    memset(&_recovery, 0, sizeof(_recovery));
+    TF_InitStatic(&_tf, TF_MASTER);
+    _tf.userdata = this; // TF_WriteImpl i listeneri nalaze instancu preko userdata
+}
+
+bool RS485Bus::addTypeListener(TF_TYPE type, TF_Listener cb) {
+    return TF_AddTypeListener(&_tf, type, cb);
+}
+
+bool RS485Bus::begin(uint32_t baud) {
+    pinMode(_dePin, OUTPUT);
+    digitalWrite(_dePin, LOW);
+    _baud = baud;
+    _serial.setRxBufferSize(BUS_RX_BUFFER_SIZE); // Mora prije begin()
+    _serial.begin(baud, SERIAL_8N1, _rxPin, _txPin);
+
+    _lock = xSemaphoreCreateRecursiveMutex();
+    if (_lock == NULL) {
+        LOG_ERROR_LN("RS485Bus: Failed to create mutex");
+        return false;
+    }
+
+    for (int c = 0; c < BUS_CLASS_COUNT; c++) {
+        _queues[c] = xQueueCreate(classQueueLen[c], sizeof(BusTransaction*));
+        _stats[c].capacity = classQueueLen[c];
+        if (_queues[c] == NULL) {
+            LOG_ERROR_LN("RS485Bus: Failed to create queue");
+            return false;
+        }
+    }
+
+    if (xTaskCreatePinnedToCore(taskEntry, _name, BUS_TASK_STACK, this,
+                                BUS_TASK_PRIORITY, &_task, BUS_TASK_CORE) != pdPASS) {
+        LOG_ERROR_LN("RS485Bus: Failed to start bus task");
+        return false;
+    }
+
+    // FIFO pun ili pauza na liniji -> probudi bus task
+    _serial.onReceive([this]() { xTaskNotifyGive(_task); });
+
+    LOG_INFO("RS485Bus: %s started at %u baud (queue %d)\n", _name, baud, BUS_QUEUE_LEN);
+    return true;
+}
+
+uint32_t RS485Bus::query(BusClass cls, TF_TYPE type, const uint8_t* data, uint16_t len, uint16_t timeoutMs,
+                         BusCallback cb, void* arg, uint32_t tag, bool shareable) {
+    if (len > BUS_MAX_PAYLOAD) return 0;
+
+    BusTransaction* txn = allocate(len);
+    if (txn == NULL) return 0;
+
+    txn->cls = cls;
+    txn->type = type;
+    memcpy(txn->tx, data, len);
+    txn->txLen = len;
+    txn->expectReply = true;
+    txn->timeoutMs = timeoutMs ? timeoutMs : BUS_DEFAULT_TIMEOUT_MS;
+    txn->callback = cb;
+    txn->arg = arg;
+    txn->tag = tag;
+
+    if (shareable) {
+        uint32_t ticket = txn->ticket;
+        if (attachFollower(txn)) return ticket;
+    }
+    return enqueue(txn, shareable);
+}
+
+bool RS485Bus::send(BusClass cls, TF_TYPE type, const uint8_t* data, uint16_t len) {
+    return sendAtBaud(cls, type, data, len, 0, 0);
+}
+
+bool RS485Bus::sendAtBaud(BusClass cls, TF_TYPE type, const uint8_t* data, uint16_t len, uint32_t sendBaud, uint32_t nextBaud) {
+    if (len > BUS_MAX_PAYLOAD) return false;
+
+    BusTransaction* txn = allocate(len);
+    if (txn == NULL) return false;
+
+    txn->cls = cls;
+    txn->type = type;
+    memcpy(txn->tx, data, len);
+    txn->txLen = len;
+    txn->expectReply = false;
+    txn->sendBaud = sendBaud;
+    txn->nextBaud = nextBaud;
+    return enqueue(txn) != 0;
+}
+
+void RS485Bus::cancel(uint32_t ticket) {
+    if (ticket == 0) return;
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+    for (int i = 0; i < BUS_TXN_POOL; i++) {
+        if (_pool[i].ticket == ticket) {
+            _pool[i].cancelled = true;
+            break;
+        }
+    }
+    xSemaphoreGiveRecursive(_lock);
+}
+
+BusTransaction* RS485Bus::allocate(uint16_t txLen) {
+    uint16_t cap;
+    uint8_t* tx = _buffers.alloc(txLen, cap);
+    if (tx == NULL) {
+        LOG_ERROR("RS485Bus: No buffer for %u byte payload\n", txLen);
+        return NULL;
+    }
+
+    BusTransaction* txn = NULL;
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+    for (int i = 0; i < BUS_TXN_POOL; i++) {
+        if (_pool[i].ticket == 0) {
+            txn = &_pool[i];
+            memset(txn, 0, sizeof(BusTransaction));
+            if (++_nextTicket == 0) _nextTicket = 1;
+            txn->ticket = _nextTicket;
+            txn->tx = tx;
+            break;
+        }
+    }
+    xSemaphoreGiveRecursive(_lock);
+
+    if (txn == NULL) _buffers.release(tx);
+    return txn;
+}
+
+void RS485Bus::release(BusTransaction* txn) {
+    // Pozivalac drži _lock; pratilac dijeli reply vođe i nema svoj
+    _buffers.release(txn->tx);
+    if (!txn->isFollower) _buffers.release(txn->reply);
+    txn->tx = NULL;
+    txn->reply = NULL;
+    txn->ticket = 0;
+}
+
+uint32_t RS485Bus::enqueue(BusTransaction* txn, bool shareable) {
+    // Ticket pročitati PRIJE slanja u red - bus task može odmah završiti i osloboditi slot
+    uint32_t ticket = txn->ticket;
+    BusClass cls = txn->cls;
+
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+    txn->enqueuedAt = millis();
+    bool queued = xQueueSend(_queues[cls], &txn, 0) == pdTRUE;
+    if (queued) {
+        // Vođa tek kada je u redu - odbijen upit bi pratioce ostavio bez callbacka
+        txn->shareable = shareable;
+        _stats[cls].enqueued++;
+    } else {
+        _stats[cls].rejected++;
+        release(txn);
+    }
+    xSemaphoreGiveRecursive(_lock);
+
+    if (!queued) {
+        LOG_ERROR("RS485Bus: %s queue full, transaction rejected\n", className(cls));
+        return 0;
+    }
+    if (_task != NULL) xTaskNotifyGive(_task);
+    return ticket;
+}
+
+BusTransaction* RS485Bus::dequeueNext() {
+    BusTransaction* head;
+    int best = -1;
+    int32_t bestRank = 0;
+    uint32_t now = millis();
+
+    // Efektivni rang = klasa - starost/korak; jednak rang -> viša klasa
+    for (int c = 0; c < BUS_CLASS_COUNT; c++) {
+        if (xQueuePeek(_queues[c], &head, 0) != pdTRUE) continue;
+        int32_t rank = c - (int32_t)((now - head->enqueuedAt) / BUS_AGING_STEP_MS);
+        if (best < 0 || rank < bestRank) {
+            best = c;
+            bestRank = rank;
+        }
+    }
+    if (best < 0) return NULL;
+
+    BusTransaction* txn;
+    if (xQueueReceive(_queues[best], &txn, 0) != pdTRUE) return NULL;
+
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+    BusClassStats& st = _stats[best];
+    uint32_t wait = now - txn->enqueuedAt;
+    st.started++;
+    st.waitLastMs = wait;
+    if (wait > st.waitMaxMs) st.waitMaxMs = wait;
+    st.waitAvgMs = (st.started == 1) ? wait : st.waitAvgMs + ((int32_t)(wait - st.waitAvgMs) >> 3);
+    for (int c = 0; c < best; c++) {
+        if (uxQueueMessagesWaiting(_queues[c]) > 0) {
+            st.aged++;
+            break;
+        }
+    }
+    xSemaphoreGiveRecursive(_lock);
+
+    return txn;
+}
+
+void RS485Bus::recover(bool reinitUart) {
+    uint8_t level = reinitUart ? 2 : 1;
+    if (_recoverRequest < level) _recoverRequest = level;
+    if (_task != NULL) xTaskNotifyGive(_task);
+}
+
+bool RS485Bus::isIdle() {
+    if (_active != NULL) return false;
+    for (int c = 0; c < BUS_CLASS_COUNT; c++) {
+        if (_queues[c] != NULL && uxQueueMessagesWaiting(_queues[c]) > 0) return false;
+    }
+    return true;
+}
+
+void RS485Bus::getRecoveryStats(BusRecoveryStats& out) {
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+    out = _recovery;
+    xSemaphoreGiveRecursive(_lock);
+}
+
+void RS485Bus::getCounters(BusCounters& out) {
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+    out = _counters;
+    xSemaphoreGiveRecursive(_lock);
+}
+
+void RS485Bus::updateRates(uint32_t now) {
+    if (now - _rateWindowStart < 1000) return;
+
+    uint32_t elapsed = now - _rateWindowStart;
+    _counters.txBytesPerSec = (uint64_t)(_counters.bytesTx - _rateTxBase) * 1000 / elapsed;
+    _counters.rxBytesPerSec = (uint64_t)(_counters.bytesRx - _rateRxBase) * 1000 / elapsed;
+    _rateTxBase = _counters.bytesTx;
+    _rateRxBase = _counters.bytesRx;
+    _rateWindowStart = now;
+}
+
+void RS485Bus::getStats(BusClass cls, BusClassStats& out) {
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+    out = _stats[cls];
+    out.depth = _queues[cls] ? uxQueueMessagesWaiting(_queues[cls]) : 0;
+    xSemaphoreGiveRecursive(_lock);
+}
+
+const char* RS485Bus::className(BusClass cls) {
+    switch (cls) {
+        case BUS_CLASS_ACCESS:   return "access";
+        case BUS_CLASS_WRITE:    return "write";
+        case BUS_CLASS_READ:     return "read";
+        case BUS_CLASS_LOG:      return "log";
+        case BUS_CLASS_FIRMWARE: return "firmware";
+        default:                 return "unknown";
+    }
+}
+
+const char* RS485Bus::resultName(BusResult result) {
+    switch (result) {
+        case BUS_OK:          return "ok";
+        case BUS_TIMEOUT:     return "timeout";
+        case BUS_SEND_FAILED: return "send_failed";
+        case BUS_ABORTED:     return "aborted";
+        case BUS_NO_BUFFER:   return "no_buffer";
+        default:              return "unknown";
+    }
+}
+
+bool RS485Bus::attachFollower(BusTransaction* txn) {
+    bool attached = false;
+
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+    for (int i = 0; i < BUS_TXN_POOL; i++) {
+        BusTransaction* lead = &_pool[i];
+        if (lead == txn || lead->ticket == 0 || !lead->shareable || lead->isFollower) continue;
+        if (lead->type != txn->type || lead->txLen != txn->txLen) continue;
+        if (memcmp(lead->tx, txn->tx, txn->txLen) != 0) continue;
+
+        txn->isFollower = true;
+        _buffers.release(txn->tx); // Šalje se frame vođe
+        txn->tx = NULL;
+        txn->nextFollower = lead->followers;
+        lead->followers = txn;
+        _stats[txn->cls].coalesced++;
+        attached = true;
+        break;
+    }
+    xSemaphoreGiveRecursive(_lock);
+
+    return attached;
+}
+
+bool RS485Bus::dropIfCancelled(BusTransaction* txn) {
+    bool dropped = false;
+
+    // Otkazan vođa se i dalje šalje ako neko čeka njegov odgovor
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+    if (txn->cancelled && txn->followers == NULL) {
+        release(txn);
+        dropped = true;
+    }
+    xSemaphoreGiveRecursive(_lock);
+
+    return dropped;
+}
+
+void RS485Bus::taskEntry(void* self) {
+    static_cast<RS485Bus*>(self)->run();
+}
+
+void RS485Bus::run() {
+    uint32_t lastTick = millis();
+    uint8_t rx[BUS_RX_CHUNK];
+
+    for (;;) {
+        if (_recoverRequest != 0) {
+            bool reinitUart = (_recoverRequest == 2);
+            _recoverRequest = 0;
+            doRecover(reinitUart);
+            lastTick = millis(); // Vrijeme oporavka ne troši timeoute novih transakcija
+        }
+
+        // Jedini potrošač Serial porta - nema više dijeljenja parsera sa loop()/HTTP handlerom
+        int avail;
+        while ((avail = _serial.available()) > 0) {
+            size_t n = _serial.read(rx, (avail < BUS_RX_CHUNK) ? avail : BUS_RX_CHUNK);
+            if (n == 0) break;
+            _counters.bytesRx += n;
+            TF_Accept(&_tf, rx, n);
+        }
+
+        // TinyFrame tick = 1 ms (timeout ID listenera i parsera)
+        uint32_t now = millis();
+        while (lastTick != now) {
+            TF_Tick(&_tf);
+            lastTick++;
+        }
+        updateRates(now);
+
+        if (_active == NULL) {
+            startNext();
+        }
+
+        // Čekaj RX/novi posao; dok transakcija čeka odgovor budi se svaki tick zbog timeouta
+        ulTaskNotifyTake(pdTRUE, (_active != NULL) ? 1 : pdMS_TO_TICKS(BUS_IDLE_WAIT_MS));
+    }
+}
+
+void RS485Bus::startNext() {
+    BusTransaction* txn;
+
+    while ((txn = dequeueNext()) != NULL) {
+        if (dropIfCancelled(txn)) continue;
+
+        if (!txn->expectReply) {
+            if (txn->sendBaud) applyBaud(txn->sendBaud);
+            bool sent = TF_SendSimple(&_tf, txn->type, txn->tx, txn->txLen);
+            if (txn->nextBaud) applyBaud(txn->nextBaud);
+            complete(txn, sent ? BUS_OK : BUS_SEND_FAILED);
+            continue; // Nema odgovora - bus je odmah slobodan
+        }
+
+        TF_Msg msg;
+        TF_ClearMsg(&msg);
+        msg.type = txn->type;
+        msg.data = txn->tx;
+        msg.len = txn->txLen;
+        msg.userdata = txn;
+
+        _active = txn;
+        txn->startedAt = millis();
+        if (!TF_Query(&_tf, &msg, replyListener, txn->timeoutMs)) {
+            LOG_ERROR_LN("RS485Bus: TF_Query failed (ID listener table full?)");
+            _counters.listenerFull++;
+            complete(txn, BUS_SEND_FAILED);
+            continue;
+        }
+        return; // Čekaj odgovor ili timeout prije sljedeće transakcije
+    }
+}
+
+void RS485Bus::complete(BusTransaction* txn, BusResult result) {
+    if (txn == _active) _active = NULL;
+    txn->result = result;
+    _counters.results[result]++;
+    txn->rttMs = millis() - txn->startedAt;
+
+    // Callback pod lock-om: cancel() iz AsyncTCP taska čeka dok se odgovor ne pošalje,
+    // pa request ne može biti obrisan usred request->send()
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+    if (!txn->cancelled && txn->callback != NULL) {
+        txn->callback(*txn);
+    }
+
+    // Pratioci dobijaju isti odgovor - jedan frame na busu za sve
+    BusTransaction* f = txn->followers;
+    while (f != NULL) {
+        BusTransaction* next = f->nextFollower;
+        f->result = result;
+        f->rttMs = txn->rttMs;
+        f->replyLen = txn->replyLen;
+        f->reply = txn->reply;
+        if (!f->cancelled && f->callback != NULL) {
+            f->callback(*f);
+        }
+        release(f);
+        f = next;
+    }
+    txn->followers = NULL;
+    release(txn);
+    xSemaphoreGiveRecursive(_lock);
+}
+
+void RS485Bus::doRecover(bool reinitUart) {
+    uint32_t now = millis();
+    uint8_t rx[BUS_RX_CHUNK];
+
+    // Eskalacija: drugi oporavak u prozoru re-inicijalizuje UART, preko BUS_RECOVER_MAX odustaje
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+    if (_recovery.recent == 0 || now - _recoverWindowStart > BUS_RECOVER_WINDOW_MS) {
+        _recoverWindowStart = now;
+        _recovery.recent = 0;
+    }
+    _recovery.recent++;
+    _recovery.recoveries++;
+    _recovery.lastAtMs = now;
+    if (_recovery.recent >= 2) reinitUart = true;
+    if (_recovery.recent > BUS_RECOVER_MAX) _recovery.exhausted = true;
+    xSemaphoreGiveRecursive(_lock);
+
+    LOG_ERROR("RS485Bus: Recovery #%u (%u in window, UART reinit: %s)\n",
+              _recovery.recoveries, _recovery.recent, reinitUart ? "yes" : "no");
+
+    // 1. Zastarjeli ID listeneri - bez userdata TinyFrame ne zove timeout callback,
+    //    aktivnu transakciju završavamo ovdje sa BUS_ABORTED
+    for (TF_COUNT i = 0; i < _tf.count_id_lst; i++) {
+        struct TF_IdListener_* lst = &_tf.id_listeners[i];
+        if (lst->fn == NULL) continue;
+        lst->userdata = NULL;
+        lst->userdata2 = NULL;
+        TF_RemoveIdListener(&_tf, lst->id);
+    }
+    if (_active != NULL) {
+        _recovery.aborted++;
+        complete(_active, BUS_ABORTED);
+    }
+
+    // 2. UART driver ispočetka (FIFO, ring buffer, greške linije)
+    if (reinitUart) {
+        _serial.end();
+        _serial.setRxBufferSize(BUS_RX_BUFFER_SIZE);
+        _serial.begin(_baud, SERIAL_8N1, _rxPin, _txPin);
+        _serial.onReceive([this]() { xTaskNotifyGive(_task); });
+        _recovery.uartReinits++;
+    }
+
+    // 3. Drain RX dok linija ne utihne - kontroler možda još šalje ostatak frame-a
+    uint32_t start = millis();
+    uint32_t quietSince = start;
+    while (millis() - start < BUS_RECOVER_IDLE_MAX_MS) {
+        int avail = _serial.available();
+        if (avail > 0) {
+            _recovery.discardedBytes += _serial.read(rx, (avail < BUS_RX_CHUNK) ? avail : BUS_RX_CHUNK);
+            quietSince = millis();
+        } else if (millis() - quietSince >= BUS_RECOVER_IDLE_MS) {
+            break;
+        } else {
+            vTaskDelay(1);
+        }
+    }
+
+    // 4. Parser čeka novi SOF
+    TF_ResetParser(&_tf);
+}
+
+void RS485Bus::applyBaud(uint32_t baud) {
+    if (baud == _baud) return;
+
+    // write() je već sačekao flush - zadnji bajt je izašao na staroj brzini
+    _serial.updateBaudRate(baud);
+    _baud = baud;
+    TF_ResetParser(&_tf);
+    LOG_INFO("RS485Bus: %s switched to %u baud\n", _name, baud);
+
+    // Kontroleri prebacuju UART nakon prijema frame-a; bajtovi primljeni u međuvremenu su šum
+    vTaskDelay(pdMS_TO_TICKS(BUS_BAUD_SETTLE_MS));
+    uint8_t rx[BUS_RX_CHUNK];
+    int avail;
+    while ((avail = _serial.available()) > 0) {
+        _serial.read(rx, (avail < BUS_RX_CHUNK) ? avail : BUS_RX_CHUNK);
+    }
+}
+
+TF_Result RS485Bus::replyListener(TinyFrame* tf, TF_Msg* msg) {
+    RS485Bus* self = static_cast<RS485Bus*>(tf->userdata);
+    BusTransaction* txn = static_cast<BusTransaction*>(msg->userdata);
+    if (txn == NULL) return TF_CLOSE;
+    msg->userdata = NULL;
+
+    // data == NULL -> TinyFrame javlja istek ID listenera
+    if (msg->data == NULL) {
+        self->complete(txn, BUS_TIMEOUT);
+        return TF_CLOSE;
+    }
+
+    LOG_DEBUG_F("RS485Bus: reply %d bytes, frame_id=0x%02X, type=0x%02X\n", msg->len, msg->frame_id, msg->type);
+
+    // Bafer po LEN polju frame-a; ostatak nuliran kao kod starog fiksnog niza (dekoderi čitaju reply[0..n])
+    uint16_t cap;
+    txn->reply = self->_buffers.alloc(msg->len, cap);
+    if (txn->reply == NULL) {
+        self->complete(txn, BUS_NO_BUFFER);
+        return TF_CLOSE;
+    }
+    txn->replyLen = msg->len;
+    memcpy(txn->reply, msg->data, msg->len);
+    memset(txn->reply + msg->len, 0, cap - msg->len);
+    self->complete(txn, BUS_OK);
+    return TF_CLOSE;
+}
+
+void RS485Bus::traceTx(const uint8_t* buff, uint32_t len) {
+    // Frame duži od TF_SENDBUF_LEN stiže u više blokova - trace samo na prvom (zaglavlje)
+    if (_txRemaining > 0) {
+        _txRemaining = (len >= _txRemaining) ? 0 : _txRemaining - len;
+        return;
+    }
+    if (len < BUS_FRAME_HEAD_LEN || buff[0] != TF_SOF_BYTE) return;
+
+    uint16_t payloadLen = ((uint16_t)buff[2] << 8) | buff[3];
+    uint32_t total = BUS_FRAME_HEAD_LEN + (payloadLen ? payloadLen + 2 : 0);
+    _counters.framesTx++;
+    _trace.record(BUS_TRACE_TX, TF_FRAME_OK, buff[1], buff[4], payloadLen,
+                  buff + BUS_FRAME_HEAD_LEN, len - BUS_FRAME_HEAD_LEN);
+    _txRemaining = (total > len) ? total - len : 0;
+}
+
+void RS485Bus::onFrame(TF_FrameStatus status) {
+    switch (status) {
+        case TF_FRAME_OK:             _counters.framesRx++; break;
+        case TF_FRAME_HEAD_CKSUM:     _counters.headCrcErrors++; break;
+        case TF_FRAME_DATA_CKSUM:     _counters.dataCrcErrors++; break;
+        case TF_FRAME_TOO_LONG:       _counters.oversize++; break;
+        case TF_FRAME_PARSER_TIMEOUT: _counters.parserTimeouts++; break;
+        case TF_FRAME_UNHANDLED:      _counters.unhandled++; return; // Frame je već u trace-u kao OK
+    }
+
+    // Podaci su validni samo ako je parser došao do njih i nije ih odbacio
+    bool hasData = (status == TF_FRAME_OK || status == TF_FRAME_DATA_CKSUM);
+    _trace.record(BUS_TRACE_RX, status, _tf.id, _tf.type, _tf.len,
+                  hasData ? _tf.data : NULL, hasData ? _tf.len : 0);
+}
+
+void RS485Bus::write(const uint8_t* buff, uint32_t len) {
+    traceTx(buff, len);
+    _counters.bytesTx += len;
+    digitalWrite(_dePin, HIGH);
+
+    _serial.write(buff, len);
+    _serial.flush(); // čekaj da svi bajtovi izađu iz UART-a
+
+    digitalWrite(_dePin, LOW);
+}
+
+/**
+ *  TINYFRAME NA RS485 BUS TRANSMITER
+ */
+void TF_WriteImpl(TinyFrame *const tf, const uint8_t *buff, uint32_t len)
+{
+    static_cast<RS485Bus*>(tf->userdata)->write(buff, len);
+}
+
+void TF_FrameHook(TinyFrame *tf, TF_FrameStatus status)
+{
+    static_cast<RS485Bus*>(tf->userdata)->onFrame(status);
+}
@@ -0,0 +1,121 @@
+#include "RoomCache.h"
+#include "CommandTable.h"
+
+// Redoslijed slotova u redu; mora pratiti roomCacheTtl()
+static const uint8_t CACHED_CMDS[ROOM_CACHE_CMDS] = {
+    CMD_GET_ROOM_STATUS,
+    CMD_GET_PINS,
+    CMD_GET_ROOM_TEMP,
+    CMD_GET_GUEST_IN_TEMP,
+    CMD_GET_GUEST_OUT_TEMP,
+    CMD_GET_FAN_BAND,
+    CMD_GET_SYSID,
+    CMD_GET_VERSION,
+};
+
+RoomCache::RoomCache() {
+    memset(_rows, 0, sizeof(_rows));
+    memset(&_stats, 0, sizeof(_stats));
+    _mux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+int RoomCache::slotFor(uint8_t cmd) {
+    for (int i = 0; i < ROOM_CACHE_CMDS; i++) {
+        if (CACHED_CMDS[i] == cmd) return i;
+    }
+    return -1;
+}
+
+// Pozivalac drži _mux
+RoomCache::Entry* RoomCache::find(uint8_t id, uint8_t cmd) {
+    if (id == 0 || id > ROOM_CACHE_IDS) return NULL;
+    int slot = slotFor(cmd);
+    Entry* row = _rows[id - 1];
+    if (slot < 0 || row == NULL) return NULL;
+    return &row[slot];
+}
+
+bool RoomCache::lookup(uint8_t id, uint8_t cmd, uint32_t maxAgeMs, uint8_t* out, uint16_t& len, uint32_t& ageMs) {
+    bool hit = false;
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&_mux);
+    Entry* e = find(id, cmd);
+    if (e != NULL && e->len > 0) {
+        uint32_t age = now - e->storedAt;
+        uint32_t limit = (maxAgeMs < e->ttlMs) ? maxAgeMs : e->ttlMs;
+        if (age <= limit) {
+            memcpy(out, e->data, e->len);
+            len = e->len;
+            ageMs = age;
+            hit = true;
+        }
+    }
+    if (hit) _stats.hits++;
+    else _stats.misses++;
+    portEXIT_CRITICAL(&_mux);
+
+    return hit;
+}
+
+void RoomCache::store(uint8_t id, uint8_t cmd, const uint8_t* data, uint16_t len, uint32_t ttlMs) {
+    if (id == 0 || id > ROOM_CACHE_IDS || len == 0 || len > ROOM_CACHE_MAX_REPLY) return;
+    if (slotFor(cmd) < 0) return;
+
+    // Red se alocira van kritične sekcije; ako ga je drugi task u međuvremenu postavio, naš se oslobađa
+    if (_rows[id - 1] == NULL) {
+        Entry* row = (Entry*)calloc(ROOM_CACHE_CMDS, sizeof(Entry));
+        if (row == NULL) return;
+        portENTER_CRITICAL(&_mux);
+        if (_rows[id - 1] == NULL) {
+            _rows[id - 1] = row;
+            row = NULL;
+        }
+        portEXIT_CRITICAL(&_mux);
+        if (row != NULL) free(row);
+    }
+
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&_mux);
+    Entry* e = find(id, cmd);
+    if (e->len == 0) _stats.used++;
+    e->len = len;
+    e->storedAt = now;
+    e->ttlMs = ttlMs;
+    memcpy(e->data, data, len);
+    _stats.stores++;
+    portEXIT_CRITICAL(&_mux);
+}
+
+void RoomCache::invalidate(uint8_t id, uint8_t cmd) {
+    portENTER_CRITICAL(&_mux);
+    Entry* e = find(id, cmd);
+    if (e != NULL && e->len > 0) {
+        e->len = 0;
+        _stats.used--;
+        _stats.invalidations++;
+    }
+    portEXIT_CRITICAL(&_mux);
+}
+
+void RoomCache::invalidateAll(uint8_t id) {
+    if (id == 0 || id > ROOM_CACHE_IDS) return;
+
+    portENTER_CRITICAL(&_mux);
+    Entry* row = _rows[id - 1];
+    for (int i = 0; row != NULL && i < ROOM_CACHE_CMDS; i++) {
+        if (row[i].len > 0) {
+            row[i].len = 0;
+            _stats.used--;
+            _stats.invalidations++;
+        }
+    }
+    portEXIT_CRITICAL(&_mux);
+}
+
+void RoomCache::getStats(RoomCacheStats& out) {
+    portENTER_CRITICAL(&_mux);
+    out = _stats;
+    portEXIT_CRITICAL(&_mux);
+}
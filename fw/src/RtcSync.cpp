@@ -0,0 +1,113 @@
+#include "RtcSync.h"
+#include "LogMacros.h"
+
+RtcSync::RtcSync(uint8_t segment, ControllerRoster& roster, uint8_t (*segmentOf)(uint8_t id))
+    : _segment(segment), _roster(roster), _segmentOf(segmentOf) {
+    _pendingReason = "boot";
+    _pendingSince = 0;            // Počinje od prvog nextStep() - vrijeme je tek tada validno
+    _lastBroadcastAt = 0;
+    _nextCheckAt = 0;
+    _cursor = 1;
+    _inFlight = false;
+    _idleAtStep = false;
+    memset(&_stats, 0, sizeof(_stats));
+    _mux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+bool RtcSync::nextStep(bool busIdle, RtcAction& action, uint8_t& id) {
+    uint32_t now = millis();
+    bool send = false;
+
+    portENTER_CRITICAL(&_mux);
+    if (_pendingReason == NULL && _stats.broadcasts > 0 && now - _lastBroadcastAt >= RTC_SYNC_MAX_MS) {
+        _pendingReason = "interval";
+        _pendingSince = now;
+    }
+    if (_pendingReason != NULL && _pendingSince == 0) _pendingSince = now;
+
+    if (_pendingReason != NULL) {
+        // Očitavanje nema smisla dok broadcast čeka
+        if (busIdle || now - _pendingSince >= RTC_MAX_DEFER_MS) {
+            action = RTC_ACT_BROADCAST;
+            _idleAtStep = busIdle;
+            send = true;
+        }
+    } else if (!_inFlight && busIdle && (int32_t)(now - _nextCheckAt) >= 0) {
+        // Sljedeći prisutni kontroler segmenta, jedan krug od kursora
+        for (int n = 0; n < ROSTER_MAX_ID; n++) {
+            uint8_t candidate = _cursor;
+            _cursor = (_cursor >= ROSTER_MAX_ID) ? 1 : _cursor + 1;
+            if (_roster.isLive(candidate) && _segmentOf(candidate) == _segment) {
+                action = RTC_ACT_READ;
+                id = candidate;
+                _inFlight = true;
+                send = true;
+                break;
+            }
+        }
+        if (!send) _nextCheckAt = now + RTC_CHECK_MS; // Segment prazan
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    return send;
+}
+
+void RtcSync::onBroadcast(bool queued) {
+    if (!queued) return; // Ostaje na čekanju za sljedeći slot
+
+    uint32_t now = millis();
+    const char* reason;
+
+    portENTER_CRITICAL(&_mux);
+    reason = _pendingReason;
+    _stats.broadcasts++;
+    if (!_idleAtStep) _stats.deferredSends++;
+    _stats.lastReason = reason;
+    _pendingReason = NULL;
+    _lastBroadcastAt = now;
+    _nextCheckAt = now + RTC_CHECK_MS;
+    portEXIT_CRITICAL(&_mux);
+
+    LOG_INFO("[RTC] Segment %d: broadcast (%s)\n", _segment, reason);
+}
+
+void RtcSync::onReadResult(uint8_t id, bool ok, int32_t driftS) {
+    uint32_t now = millis();
+    bool drifted = false;
+
+    portENTER_CRITICAL(&_mux);
+    _inFlight = false;
+    _nextCheckAt = now + RTC_CHECK_MS;
+    _stats.checks++;
+    if (!ok) {
+        _stats.readFailures++;
+    } else {
+        _stats.lastDriftS = driftS;
+        _stats.lastDriftId = id;
+        if ((driftS > RTC_DRIFT_MAX_S || driftS < -RTC_DRIFT_MAX_S) && _pendingReason == NULL) {
+            _pendingReason = "drift";
+            _pendingSince = now;
+            drifted = true;
+        }
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    if (drifted) LOG_INFO("[RTC] Segment %d: ID %d drift %d s\n", _segment, id, driftS);
+}
+
+void RtcSync::requestBroadcast(const char* reason) {
+    portENTER_CRITICAL(&_mux);
+    _pendingReason = reason;
+    _pendingSince = millis();
+    portEXIT_CRITICAL(&_mux);
+}
+
+void RtcSync::getStats(RtcSyncStats& out) {
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&_mux);
+    out = _stats;
+    out.lastBroadcastAgoMs = _stats.broadcasts ? now - _lastBroadcastAt : 0;
+    out.pending = (_pendingReason != NULL);
+    portEXIT_CRITICAL(&_mux);
+}
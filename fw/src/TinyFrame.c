@@ -24,6 +24,13 @@
 #define TF_MIN(a, b) ((a)<(b)?(a):(b))
 #define TF_TRY(func) do { if(!(func)) return false; } while (0)
 
+// Prijavljuje ishod svakog primljenog/odbačenog frame-a (TF_FrameHook) - prije prve upotrebe
+#if TF_USE_FRAME_HOOK
+    #define TF_FRAME_EVENT(tf, status) TF_FrameHook(tf, status)
+#else
+    #define TF_FRAME_EVENT(tf, status)
+#endif
+
 
 // Type-dependent masks for bit manipulation in the ID field
 #define TF_ID_MASK (TF_ID)(((TF_ID)1 << (sizeof(TF_ID)*8 - 1)) - 1)
@@ -523,6 +530,7 @@ static void _TF_FN TF_HandleReceivedMessage(TinyFrame *tf){
         }
     }
     TF_Error("Unhandled message, type %d", (int)msg.type);
+    TF_FRAME_EVENT(tf, TF_FRAME_UNHANDLED);
 }
 
 /** Externally renew an ID listener */
@@ -577,6 +585,7 @@ void _TF_FN TF_AcceptChar(TinyFrame *tf, unsigned char c){
     // Parser timeout - clear
     if (tf->parser_timeout_ticks >= TF_PARSER_TIMEOUT_TICKS) {
         if (tf->state != TFState_SOF) {
+            TF_FRAME_EVENT(tf, TF_FRAME_PARSER_TIMEOUT);
             TF_ResetParser(tf);
             TF_Error("Parser timeout");
         }
@@ -644,12 +653,14 @@ void _TF_FN TF_AcceptChar(TinyFrame *tf, unsigned char c){
 
                 if (tf->cksum != tf->ref_cksum) {
                     TF_Error("Rx head cksum mismatch");
+                    TF_FRAME_EVENT(tf, TF_FRAME_HEAD_CKSUM);
                     TF_ResetParser(tf);
                     break;
                 }
 
                 if (tf->len == 0) {
                     // if the message has no body, we're done.
+                    TF_FRAME_EVENT(tf, TF_FRAME_OK);
                     TF_HandleReceivedMessage(tf);
                     TF_ResetParser(tf);
                     break;
@@ -680,6 +691,7 @@ void _TF_FN TF_AcceptChar(TinyFrame *tf, unsigned char c){
             if (tf->rxi == tf->len) {
                 #if TF_CKSUM_TYPE == TF_CKSUM_NONE
                     // All done
+                    TF_FRAME_EVENT(tf, TF_FRAME_OK);
                     TF_HandleReceivedMessage(tf);
                     TF_ResetParser(tf);
                 #else
@@ -697,10 +709,14 @@ void _TF_FN TF_AcceptChar(TinyFrame *tf, unsigned char c){
                 CKSUM_FINALIZE(tf->cksum);
                 if (!tf->discard_data) {
                     if (tf->cksum == tf->ref_cksum) {
+                        TF_FRAME_EVENT(tf, TF_FRAME_OK);
                         TF_HandleReceivedMessage(tf);
                     } else {
                         TF_Error("Body cksum mismatch");
+                        TF_FRAME_EVENT(tf, TF_FRAME_DATA_CKSUM);
                     }
+                } else {
+                    TF_FRAME_EVENT(tf, TF_FRAME_TOO_LONG);
                 }
                 TF_ResetParser(tf);
             }
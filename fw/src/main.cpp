@@ -7,6 +7,7 @@
 #include <ESPAsyncWebServer.h>
 #include <Preferences.h>
 #include <cstring>
+#include <cstdarg>
 #include <Ticker.h>
 #include <SunSet.h>
 #include <ArduinoJson.h>
@@ -17,6 +18,21 @@
 #include <DallasTemperature.h>
 #include "ExternalFlash.h"
 #include "FirmwareUpdateService.h"
+#include "RS485Bus.h"
+#include "RoomCache.h"
+#include "ControllerHealth.h"
+#include "ControllerRoster.h"
+#include "BusSpeed.h"
+#include "RtcSync.h"
+#include "LogDrain.h"
+#include "LogStore.h"
+#include "LogCollector.h"
+#include "BulkCommand.h"
+#include "CommandTable.h"
+#include "JsonWriter.h"
+#include "DeferredResponse.h"
+#include "BusMetrics.h"
+#include "BusRouting.h"
 #include "LogMacros.h"
 #include <driver/rtc_io.h>
 
@@ -34,6 +50,14 @@ extern "C"
 #define LED_PIN       2   // Onboard LED (Status)
 #define RS485_DE_PIN  4   // RS485 Transmit Enable
 
+// Drugi RS485 segment na UART1 - uključiti sa -DRS485_SEGMENTS=2 u platformio.ini
+#ifndef RS485_SEGMENTS
+#define RS485_SEGMENTS 1
+#endif
+#define RS485B_TX_PIN 15  // Strapping pin - UART TX je u mirovanju HIGH, što odgovara boot-u
+#define RS485B_RX_PIN 34  // Samo ulaz - dovoljno za RX
+#define RS485B_DE_PIN 12  // Strapping pin (MTDI) - transiver mora držati DE nisko pri boot-u
+
 // SPI Flash pinovi (VSPI bus)
 #define FLASH_CS      5   // SPI Flash Chip Select
 #define FLASH_SCK     18  // SPI Flash Serial Clock
@@ -45,7 +69,7 @@ SPIClass vspi(VSPI);
 
 // Objects for Firmware Update
 ExternalFlash extFlash(FLASH_CS, vspi);
-// updateService moved below tfapp DEFINITION
+// updateService moved below rs485 DEFINITION
 
 // Wrapper for TinyFrame listener - forward declaration
 TF_Result UpdateService_Listener(TinyFrame *tf, TF_Msg *msg);
@@ -63,10 +87,22 @@ TF_Result UpdateService_Listener(TinyFrame *tf, TF_Msg *msg);
 #define LIGHT_PIN     32  // Vanjska rasvjeta
 #define VALVE         33  // Termo ventil (Pumpa)
 #define SET_RTC_DATE_TIME 213
+#define GET_RTC_DATE_TIME 212 // Očitavanje RTC-a kontrolera, odgovor kao SET_RTC_DATE_TIME bez adrese (RtcSync)
 #define DEF_TFBRA 255 // default broadcast address
 #define S_CUSTOM 23
 #define S_IR     20   // IR remote data za klima uređaj
 #define S_SOS    40   // SOS signal iz toaleta (emergency button)
+#define S_STATE  41   // Kontroler javlja promjenu stanja: [ID][EVENT][VALUE]
+
+// S_STATE događaji
+#define STATE_EVT_CARD      0x01  // VALUE: 1 = kartica ubačena, 0 = izvađena
+#define STATE_EVT_SETPOINT  0x02  // VALUE: novi setpoint (°C)
+#define STATE_EVT_PINS      0x03  // VALUE: bitmaska izlaza (format kao GET_PINS)
+
+#define RS485_RECOVER_TIMEOUTS 5  // Uzastopni timeouti korisničkih upita do oporavka busa
+#define SYSCTRL_BUF_LEN (2 + QR_CODE_MAX_LEN + 1) // Najduži RS485 zahtjev: CMD + ID + QR kod + terminator
+#define RS485_REPLY_JSON_MAX 512 // "data" objekat odgovora kontrolera (GET_ROOM_TEMP, QR kod, log zapis)
+#define CURSOR_STREAM_LINE_MAX 1024 // Najveći komad chunked odgovora po kursoru (jedan kontroler, jedan histogram)
 
 
 IRac ac(IR_PIN);
@@ -99,8 +135,6 @@ bool overrideState = false;
 bool lightRestorePending = false; // Warm boot: čekaj validno vrijeme prije upravljanja LIGHT_PIN
 unsigned long lightRestoreTimeout = 0; // Vrijeme kad je restore aktiviran (za timeout fallback)
 bool lastTimerState = false;  // Prethodno stanje timera (za detekciju promene)
-int rdy, replyDataLength;
-volatile bool httpHandlerWaiting = false;  // Flag za blokiranje loop() čitanja
 volatile bool otaUpdateInProgress = false;
 volatile bool otaUpdateReadyToReboot = false;
 unsigned long otaRebootAtMs = 0;
@@ -173,11 +207,11 @@ bool thermostatRestorePending = false; // Warm boot: čekaj prvo validno očitan
 float th_setpoint = 25.0;   // Termostat varijable
 float th_treshold = 0.5;    // osnovni prag
 int currentFanLevel = 0;    // Globalna varijabla, čuva trenutno aktivnu brzinu: 0 = off, 1 = L, 2 = M, 3 = H
-uint8_t replyData[64] = {0};
 
 // SOS i IR status varijable (primljeni događaji sa toalet uređaja)
 bool sosStatus = false;        // SOS signal aktivan
 unsigned long sosTimestamp = 0; // Vrijeme kada je SOS primljen
+uint32_t statusEpoch = 0;       // GET_STATUS snapshot: promjene koje se ne porede direktno (NVS, stringovi)
 struct IRData {
   uint8_t th_ctrl = 0;   // 0=OFF, 1=COOLING, 2=HEATING
   uint8_t th_state = 0;  // 0=OFF, 1=ON
@@ -191,6 +225,7 @@ struct IRData {
 } irData;
 
 std::unique_ptr<AsyncWebServer> server;
+AsyncEventSource events("/events"); // Server-Sent Events: promjene stanja kontrolera
 // Lista pinova koje već koristiš ili koji su hardverski rizični
 const int usedPins[] = { // NOLINT(cert-err58-cpp)
     BOOT_PIN,           // GPIO 0 - Boot dugme
@@ -215,6 +250,11 @@ const int usedPins[] = { // NOLINT(cert-err58-cpp)
     28, 29, 30, 31,     // Ne postoje
     LIGHT_PIN,          // GPIO 32 - Vanjska rasvjeta
     VALVE,              // GPIO 33 - Termo ventil
+#if RS485_SEGMENTS > 1
+    RS485B_DE_PIN,      // GPIO 12 - RS485 segment 2 Direction Enable
+    RS485B_TX_PIN,      // GPIO 15 - RS485 segment 2 TX
+    RS485B_RX_PIN,      // GPIO 34 - RS485 segment 2 RX
+#endif
     37, 38, 39          // Samo ulaz (ADC), nema OUTPUT funkciju
 };
 
@@ -253,10 +293,58 @@ OneWire oneWire2(ONE_WIRE2_PIN);
 DallasTemperature sensors2(&oneWire2);
 PulsePinState pulseStates[MAX_PULSE_PINS];
 SunSet sun;
-Ticker rtcSyncTicker;
 Preferences preferences;
-TinyFrame tfapp;
-FirmwareUpdateService updateService(extFlash, tfapp); // Initialized here now
+RS485Bus rs485(Serial2, RS485_DE_PIN);
+#if RS485_SEGMENTS > 1
+RS485Bus rs485b(Serial1, RS485B_DE_PIN, RS485B_RX_PIN, RS485B_TX_PIN, "rs485b");
+RS485Bus *const busSegments[RS485_SEGMENTS] = {&rs485, &rs485b};
+#else
+RS485Bus *const busSegments[RS485_SEGMENTS] = {&rs485};
+#endif
+BusRouting busRouting;
+RoomCache roomCache;
+ControllerHealth controllerHealth;
+ControllerRoster roster;
+BusMetrics busMetrics;
+FirmwareUpdateService updateService(extFlash, rs485); // Initialized here now
+
+// Segment na kojem je kontroler (routing tabela ograničena na ugrađene segmente)
+uint8_t segmentOf(uint8_t id) {
+  uint8_t seg = busRouting.segmentFor(id);
+  return (seg < RS485_SEGMENTS) ? seg : 0;
+}
+
+RS485Bus &busFor(uint8_t id) {
+  return *busSegments[segmentOf(id)];
+}
+
+#if RS485_SEGMENTS > 1
+BusSpeed busSpeed[RS485_SEGMENTS] = {BusSpeed(0, roster, segmentOf), BusSpeed(1, roster, segmentOf)};
+RtcSync rtcSync[RS485_SEGMENTS] = {RtcSync(0, roster, segmentOf), RtcSync(1, roster, segmentOf)};
+#else
+BusSpeed busSpeed[RS485_SEGMENTS] = {BusSpeed(0, roster, segmentOf)};
+RtcSync rtcSync[RS485_SEGMENTS] = {RtcSync(0, roster, segmentOf)};
+#endif
+
+size_t formatLogLine(char *out, size_t max, uint8_t id, const uint8_t *entry);
+bool storeOrphanLog(uint8_t id, const uint8_t *entry);
+LogDrain logDrain(formatLogLine, storeOrphanLog); // /logs/drain sesije
+LogStore logStore(extFlash, LOG_STORE_SLOT);
+LogCollector logCollector(logStore, roster, logDrain, busFor);
+
+void onBulkTxn(uint8_t cmd, uint8_t id, BusTransaction &txn);
+uint16_t bulkTimeoutFor(uint8_t id, BusClass cls) { return controllerHealth.timeoutFor(id, cls); }
+BulkCommand bulkCommand(busFor, segmentOf, bulkTimeoutFor, onBulkTxn); // /sysctrl.cgi?ID=1-40,55
+
+// Dijagnostički endpointi: ?segment=N (podrazumijevano 0)
+int segmentParam(AsyncWebServerRequest *request) {
+  int seg = request->hasParam("segment") ? request->getParam("segment")->value().toInt() : 0;
+  return (seg >= 0 && seg < RS485_SEGMENTS) ? seg : 0;
+}
+
+RS485Bus &busSegmentParam(AsyncWebServerRequest *request) {
+  return *busSegments[segmentParam(request)];
+}
 
 // Implementation of wrapper
 TF_Result UpdateService_Listener(TinyFrame *tf, TF_Msg *msg) {
@@ -280,223 +368,11 @@ const char *update_form_html = R"rawliteral(
 </html>
 )rawliteral";
 /**
- * ENUMERATOR PODRZANIH KOMANDI
- * 
- * IC KONTROLER KOMANDE (0xAC-0xE1) - NE MIJENJATI! Definisano u common.h
- * ESP32 LOKALNE KOMANDE (0x50-0x68) - Interni, korisnik ih ne vidi
- */
-enum CommandType
-{
-  CMD_UNKNOWN,
-  CMD_GET_ROOM_STATUS = 0x94,      // IC kontroler - Get Room Status (Card Stacker)
-  // ESP32 lokalne komande - Interni pinovi i senzori
-  CMD_ESP_GET_PINS = 0xA0,
-  CMD_ESP_SET_PIN = 0xA1,
-  CMD_ESP_RESET_PIN = 0xA2,
-  CMD_ESP_PULSE_PIN = 0xA3,
-  CMD_GET_STATUS = 0xAA,
-  
-  // IC Kontroler komande - RS485 (common.h) - NE MIJENJATI!
-  CMD_GET_ROOM_TEMP = 0xAC,
-  CMD_SET_PIN = 0xB1,
-  CMD_GET_PINS = 0xB2,
-  CMD_SET_THST_ON = 0xB4,
-  CMD_GET_FAN_DIFFERENCE = 0xB5,
-  CMD_GET_FAN_BAND = 0xB6,
-  CMD_RESTART_CTRL = 0xC0,
-  CMD_READ_LOG = 0xCE,             // IC kontroler - Read last log
-  CMD_DELETE_LOG = 0xCF,           // IC kontroler - Delete last log
-  CMD_SET_GUEST_IN_TEMP = 0xD0,
-  CMD_SET_GUEST_OUT_TEMP = 0xD1,
-  CMD_SET_ROOM_TEMP = 0xD6,
-  CMD_GET_GUEST_IN_TEMP = 0xD7,
-  CMD_GET_GUEST_OUT_TEMP = 0xD8,
-  CMD_OPEN_DOOR = 0xDB,            // HOTEL_SET_PIN_V2
-  CMD_SET_THST_HEATING = 0xDC,
-  CMD_SET_THST_COOLING = 0xDD,
-  CMD_SET_THST_OFF = 0xDE,
-  CMD_SET_PASSWORD = 0x96,
-
-  CMD_QR_CODE_GET = 0xE5,          // IC kontroler - Get QR Code
-  CMD_QR_CODE_SET = 0xE6,          // IC kontroler - Set QR Code
-  CMD_SET_LANG = 0xE9,             // IC kontroler - Set Language
-  CMD_GET_SYSID = 0xEA,            // IC kontroler - Get System ID
-  CMD_SET_SYSID = 0xEB,            // IC kontroler - Set System ID
-  CMD_GET_PASSWORD = 0xEC,         // IC kontroler
-  CMD_SET_FWD_HEATING = 0xED,      // IC kontroler - Set Forward Heating Flag
-  CMD_SET_FWD_COOLING = 0xEE,      // IC kontroler - Set Forward Cooling Flag
-  CMD_SET_ENABLE_HEATING = 0xEF,   // IC kontroler - Set Enable Heating Flag
-  CMD_SET_ENABLE_COOLING = 0xF0,   // IC kontroler - Set Enable Cooling Flag
-  CMD_GET_VERSION = 0xF1,          // IC kontroler / ESP32 - Get Firmware Versions
-  // ESP32 lokalne komande - Premješteno na siguran opseg (0x50-0x68)
-  
-  CMD_GET_SSID_PSWRD = 0x50,
-  CMD_SET_SSID_PSWRD = 0x51,
-  CMD_GET_MDNS_NAME = 0x52,
-  CMD_SET_MDNS_NAME = 0x53,
-  CMD_GET_TCPIP_PORT = 0x54,
-  CMD_SET_TCPIP_PORT = 0x55,
-  CMD_GET_IP_ADDRESS = 0x56,
-  CMD_RESTART = 0x57,
-  CMD_GET_TIMER = 0x58,
-  CMD_SET_TIMER = 0x59,
-  CMD_GET_TIME = 0x5A,
-  CMD_SET_TIME = 0x5B,
-  CMD_OUTDOOR_LIGHT_ON = 0x5C,
-  CMD_OUTDOOR_LIGHT_OFF = 0x5D,
-  CMD_GET_PINGWDG = 0x5E,
-  CMD_PINGWDG_ON = 0x5F,
-  CMD_PINGWDG_OFF = 0x60,
-  CMD_TH_SETPOINT = 0x61,
-  CMD_TH_DIFF = 0x62,
-  CMD_TH_STATUS = 0x63,
-  CMD_TH_HEATING = 0x64,
-  CMD_TH_COOLING = 0x65,
-  CMD_TH_OFF = 0x66,
-  CMD_TH_ON = 0x67,
-  CMD_TH_EMA = 0x68,
-  CMD_SOS_RESET = 0x69,  // Resetuje SOS status nakon što je hitnost riješena
-  CMD_SET_IR_PROTOCOL = 0x70, // Set IR Protocol ID
-  CMD_GET_IR_PROTOCOL = 0x71, // Get IR Protocol ID
-  CMD_SET_IR = 0x72           // Send basic IR command (ON/OFF, Mode, Temp)
-
-};
-/**
- * KONVERTOR HTTP KOMANDI U ENUMERATOR
+ * KONVERTOR HTTP KOMANDI U ENUMERATOR (tabela imena u CommandTable.cpp)
  */
 CommandType stringToCommand(const String &cmd)
 {
-  if (cmd == "RESTART")
-    return CMD_RESTART;
-  if (cmd == "RESTART_CTRL")
-    return CMD_RESTART_CTRL;
-  if (cmd == "GET_STATUS")
-    return CMD_GET_STATUS;
-  if (cmd == "GET_SSID_PSWRD")
-    return CMD_GET_SSID_PSWRD;
-  if (cmd == "SET_SSID_PSWRD")
-    return CMD_SET_SSID_PSWRD;
-  if (cmd == "GET_MDNS_NAME")
-    return CMD_GET_MDNS_NAME;
-  if (cmd == "SET_MDNS_NAME")
-    return CMD_SET_MDNS_NAME;
-  if (cmd == "GET_TCPIP_PORT")
-    return CMD_GET_TCPIP_PORT;
-  if (cmd == "SET_TCPIP_PORT")
-    return CMD_SET_TCPIP_PORT;
-  if (cmd == "GET_ROOM_TEMP")
-    return CMD_GET_ROOM_TEMP;
-  if (cmd == "ESP_GET_PINS")
-    return CMD_ESP_GET_PINS;
-  if (cmd == "ESP_SET_PIN")
-    return CMD_ESP_SET_PIN;
-  if (cmd == "ESP_RESET_PIN")
-    return CMD_ESP_RESET_PIN;
-  if (cmd == "ESP_PULSE_PIN")
-    return CMD_ESP_PULSE_PIN;
-  if (cmd == "GET_PINS")
-    return CMD_GET_PINS;
-  if (cmd == "SET_PIN")
-    return CMD_SET_PIN;
-  if (cmd == "OPEN_DOOR")
-    return CMD_OPEN_DOOR;
-  if (cmd == "SET_THST_ON")
-    return CMD_SET_THST_ON;
-  if (cmd == "GET_FAN_DIFFERENCE")
-    return CMD_GET_FAN_DIFFERENCE;
-  if (cmd == "GET_FAN_BAND")
-    return CMD_GET_FAN_BAND;
-  if (cmd == "SET_GUEST_IN_TEMP")
-    return CMD_SET_GUEST_IN_TEMP;
-  if (cmd == "SET_GUEST_OUT_TEMP")
-    return CMD_SET_GUEST_OUT_TEMP;
-  if (cmd == "SET_ROOM_TEMP")
-    return CMD_SET_ROOM_TEMP;
-  if (cmd == "GET_GUEST_IN_TEMP")
-    return CMD_GET_GUEST_IN_TEMP;
-  if (cmd == "GET_GUEST_OUT_TEMP")
-    return CMD_GET_GUEST_OUT_TEMP;
-  if (cmd == "SET_THST_HEATING")
-    return CMD_SET_THST_HEATING;
-  if (cmd == "SET_THST_COOLING")
-    return CMD_SET_THST_COOLING;
-  if (cmd == "SET_THST_OFF")
-    return CMD_SET_THST_OFF;
-  if (cmd == "SET_PASSWORD")
-    return CMD_SET_PASSWORD;
-  if (cmd == "GET_PASSWORD")
-    return CMD_GET_PASSWORD;
-  if (cmd == "READ_LOG")
-    return CMD_READ_LOG;
-  if (cmd == "DELETE_LOG")
-    return CMD_DELETE_LOG;
-  if (cmd == "GET_IP_ADDRESS")
-    return CMD_GET_IP_ADDRESS;
-  if (cmd == "GET_TIMER")
-    return CMD_GET_TIMER;
-  if (cmd == "SET_TIMER")
-    return CMD_SET_TIMER;
-  if (cmd == "GET_TIME")
-    return CMD_GET_TIME;
-  if (cmd == "SET_TIME")
-    return CMD_SET_TIME;
-  if (cmd == "OUTDOOR_LIGHT_ON")
-    return CMD_OUTDOOR_LIGHT_ON;
-  if (cmd == "OUTDOOR_LIGHT_OFF")
-    return CMD_OUTDOOR_LIGHT_OFF;
-  if (cmd == "GET_PINGWDG")
-    return CMD_GET_PINGWDG;
-  if (cmd == "PINGWDG_ON")
-    return CMD_PINGWDG_ON;
-  if (cmd == "PINGWDG_OFF")
-    return CMD_PINGWDG_OFF;
-  if (cmd == "TH_SETPOINT")
-    return CMD_TH_SETPOINT;
-  if (cmd == "TH_DIFF")
-    return CMD_TH_DIFF;
-  if (cmd == "TH_STATUS")
-    return CMD_TH_STATUS;
-  if (cmd == "TH_HEATING")
-    return CMD_TH_HEATING;
-  if (cmd == "TH_COOLING")
-    return CMD_TH_COOLING;
-  if (cmd == "TH_OFF")
-    return CMD_TH_OFF;
-  if (cmd == "TH_ON")
-    return CMD_TH_ON;
-  if (cmd == "TH_EMA")
-    return CMD_TH_EMA;
-  if (cmd == "SET_LANG")
-    return CMD_SET_LANG;
-  if (cmd == "GET_SYSID")
-    return CMD_GET_SYSID;
-  if (cmd == "SET_SYSID")
-    return CMD_SET_SYSID;
-  if (cmd == "QR_CODE_SET")
-    return CMD_QR_CODE_SET;
-  if (cmd == "QR_CODE_GET")
-    return CMD_QR_CODE_GET;
-  if (cmd == "GET_ROOM_STATUS")
-    return CMD_GET_ROOM_STATUS;
-  if (cmd == "SOS_RESET")
-    return CMD_SOS_RESET;
-  if (cmd == "SET_FWD_HEATING")
-    return CMD_SET_FWD_HEATING;
-  if (cmd == "SET_FWD_COOLING")
-    return CMD_SET_FWD_COOLING;
-  if (cmd == "SET_ENABLE_HEATING")
-    return CMD_SET_ENABLE_HEATING;
-  if (cmd == "SET_ENABLE_COOLING")
-    return CMD_SET_ENABLE_COOLING;
-  if (cmd == "GET_VERSION")
-    return CMD_GET_VERSION;
-  if (cmd == "SET_IR_PROTOCOL")
-    return CMD_SET_IR_PROTOCOL;
-  if (cmd == "GET_IR_PROTOCOL")
-    return CMD_GET_IR_PROTOCOL;
-  if (cmd == "SET_IR")
-    return CMD_SET_IR;
-  return CMD_UNKNOWN;
+  return commandFromName(cmd.c_str(), cmd.length());
 }
 /**
  * HELPER FUNKCIJA - BCD to Decimal konverzija
@@ -628,6 +504,580 @@ String getAccessDescription(uint8_t eventCode, uint8_t userGroup)
   if (eventCode == 0xDB) return "Pogresan sistem ID";
   return getEventName(eventCode);
 }
+/**
+ * HELPER FUNKCIJA - Dekodiranje jednog log zapisa (16 bajta, BCD datum/vrijeme) u otvoren JSON objekat
+ * Zajednička za READ_LOG odgovor, /logs/drain i /logs/query NDJSON linije
+ */
+template <class Sink>
+void writeLogEntry(JsonWriter<Sink> &json, int deviceId, const uint8_t *entry)
+{
+  uint16_t logId = (entry[0] << 8) | entry[1];
+  uint8_t logEvent = entry[2];
+  uint8_t logType = entry[3];
+  uint8_t logGroup = entry[4];
+
+  // Card ID (5 bytes) - from log bytes [5-9]
+  char cardIdHex[11];
+  sprintf(cardIdHex, "%02X%02X%02X%02X%02X", entry[5], entry[6], entry[7], entry[8], entry[9]);
+
+  char dateStr[12];
+  char timeStr[9];
+  sprintf(dateStr, "%02d.%02d.20%02d", bcdToDec(entry[10]), bcdToDec(entry[11]), bcdToDec(entry[12]));
+  sprintf(timeStr, "%02d:%02d:%02d", bcdToDec(entry[13]), bcdToDec(entry[14]), bcdToDec(entry[15]));
+
+  char eventCode[5];
+  char timestamp[21];
+  sprintf(eventCode, "0x%x", logEvent);
+  sprintf(timestamp, "%s %s", dateStr, timeStr);
+
+  json.field("status", "OK");
+  json.field("device_id", deviceId);
+  json.field("log_id", logId);
+  json.field("event_code", eventCode);
+  json.field("event_name", getEventName(logEvent).c_str());
+  json.field("event_description", getAccessDescription(logEvent, logGroup).c_str());
+  json.field("type", logType);
+  json.field("group", logGroup);
+  json.field("card_id", cardIdHex);
+  json.field("date", dateStr);
+  json.field("time", timeStr);
+  json.field("timestamp", timestamp);
+}
+/**
+ * HELPER FUNKCIJA - LogEntryFormatter za LogDrain (jedna NDJSON linija bez '\n')
+ */
+size_t formatLogLine(char *out, size_t max, uint8_t id, const uint8_t *entry)
+{
+  JsonBufferSink sink(out, max);
+  JsonWriter<JsonBufferSink> json(sink);
+  json.beginObject();
+  writeLogEntry(json, id, entry);
+  json.endObject();
+  return sink.length();
+}
+/**
+ * HELPER FUNKCIJA - Slot eksternog flasha zauzet LogStore-om (nikad kada je LOG_STORE_SLOT = -1)
+ */
+bool isLogStoreSlot(int slot)
+{
+  return LOG_STORE_SLOT >= 0 && slot == LOG_STORE_SLOT;
+}
+/**
+ * HELPER FUNKCIJA - LogOrphanSink za LogDrain: zapis napuštene sesije ide u LogStore kao iz kolektora
+ */
+bool storeOrphanLog(uint8_t id, const uint8_t *entry)
+{
+  if (!logStore.ready())
+    return false;
+  time_t t = time(NULL);
+  uint32_t storedAt = (t > 1600000000) ? (uint32_t)t : 0;
+  return logStore.append(id, entry, storedAt);
+}
+/**
+ * HELPER FUNKCIJA - Datum "dd.mm.yyyy" u dan LogStore indeksa; 0 = nevažeći
+ */
+uint16_t parseLogDay(const String &date)
+{
+  int day, month, year;
+  if (sscanf(date.c_str(), "%d.%d.%d", &day, &month, &year) != 3)
+    return 0;
+  return LogStore::dayNumber(day, month, year);
+}
+/**
+ * STANJE /logs/query STREAMA (jedan po zahtjevu, briše se u onDisconnect)
+ */
+struct LogQueryStream
+{
+  LogQuery query;
+  uint16_t limit;
+  uint16_t count;
+  bool done;
+  char line[LOG_DRAIN_LINE_MAX];
+  size_t lineLen;
+  size_t linePos;
+};
+
+size_t fillLogQuery(LogQueryStream *stream, uint8_t *buffer, size_t maxLen)
+{
+  size_t out = 0;
+
+  while (out < maxLen)
+  {
+    if (stream->linePos < stream->lineLen)
+    {
+      size_t n = stream->lineLen - stream->linePos;
+      if (n > maxLen - out)
+        n = maxLen - out;
+      memcpy(buffer + out, stream->line + stream->linePos, n);
+      out += n;
+      stream->linePos += n;
+      continue;
+    }
+    if (stream->done)
+      break;
+
+    LogRecord rec;
+    LogQueryStep step = (stream->count < stream->limit) ? logStore.next(stream->query, rec) : LOG_Q_END;
+    if (step == LOG_Q_AGAIN)
+      break; // Budžet skeniranja potrošen - nastavak u sljedećem pozivu
+
+    int len;
+    if (step == LOG_Q_MATCH)
+    {
+      JsonBufferSink sink(stream->line, LOG_DRAIN_LINE_MAX - 1);
+      JsonWriter<JsonBufferSink> json(sink);
+      json.beginObject();
+      writeLogEntry(json, rec.id, rec.entry);
+      json.field("seq", rec.seq);
+      if (rec.storedAt != 0)
+        json.field("stored_at", rec.storedAt);
+      json.endObject();
+      len = sink.length();
+      stream->line[len++] = '\n';
+      stream->count++;
+    }
+    else
+    {
+      len = snprintf(stream->line, LOG_DRAIN_LINE_MAX,
+                     "{\"done\":true,\"count\":%u,\"scanned\":%u,\"skipped_sectors\":%u}\n",
+                     stream->count, stream->query.scanned, stream->query.skippedSectors);
+      stream->done = true;
+    }
+    stream->lineLen = len;
+    stream->linePos = 0;
+  }
+
+  if (out > 0)
+    return out;
+  return stream->done ? 0 : RESPONSE_TRY_AGAIN;
+}
+/**
+ * STANJE CHUNKED ODGOVORA PO KURSORU (/controller_health, /roster, /metrics) - jedan po zahtjevu, briše se u onDisconnect
+ *
+ * Producer upisuje sljedeći komad (otvaranje, jedan element, zatvaranje) u out i pomjera stage/cursor;
+ * 0 = kraj odgovora. Tako se lista od 254 kontrolera šalje bez JsonDocument-a i String-a cijelog tijela.
+ */
+struct CursorStream;
+typedef size_t (*CursorProducer)(CursorStream *stream, char *out, size_t max);
+
+struct CursorStream
+{
+  CursorProducer produce;
+  uint8_t stage;
+  uint16_t cursor;
+  uint16_t items;  // Već poslanih elemenata niza (zarez ispred sljedećeg)
+  bool done;
+  char line[CURSOR_STREAM_LINE_MAX];
+  size_t lineLen;
+  size_t linePos;
+};
+
+size_t fillCursorStream(CursorStream *stream, uint8_t *buffer, size_t maxLen)
+{
+  size_t out = 0;
+
+  while (out < maxLen)
+  {
+    if (stream->linePos < stream->lineLen)
+    {
+      size_t n = stream->lineLen - stream->linePos;
+      if (n > maxLen - out)
+        n = maxLen - out;
+      memcpy(buffer + out, stream->line + stream->linePos, n);
+      out += n;
+      stream->linePos += n;
+      continue;
+    }
+    if (stream->done)
+      break;
+
+    stream->lineLen = stream->produce(stream, stream->line, CURSOR_STREAM_LINE_MAX);
+    stream->linePos = 0;
+    if (stream->lineLen == 0)
+      stream->done = true;
+  }
+  return out;
+}
+
+void sendCursorStream(AsyncWebServerRequest *request, const char *contentType, CursorProducer produce)
+{
+  CursorStream *stream = new CursorStream();
+  stream->produce = produce;
+  stream->stage = 0;
+  stream->cursor = 0;
+  stream->items = 0;
+  stream->done = false;
+  stream->lineLen = 0;
+  stream->linePos = 0;
+
+  AsyncWebServerResponse *response = request->beginChunkedResponse(contentType,
+    [stream](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+      return fillCursorStream(stream, buffer, maxLen);
+    });
+  request->onDisconnect([stream]() { delete stream; });
+  request->send(response);
+}
+/**
+ * /metrics - dopisivanje jedne ili više Prometheus linija u komad; višak se odsijeca na max
+ */
+size_t metricf(char *out, size_t max, size_t len, const char *fmt, ...)
+{
+  if (len + 1 >= max)
+    return len;
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(out + len, max - len, fmt, args);
+  va_end(args);
+  if (n < 0)
+    return len;
+  return (len + n < max) ? len + n : max - 1;
+}
+
+// Histogram: kumulativni bucketi, _sum, _count + timeouti kao zaseban brojač
+size_t metricHistogram(char *out, size_t max, size_t len, const char *name, const char *label, const RttHistogram &h)
+{
+  uint32_t cumulative = 0;
+  for (int b = 0; b < METRICS_RTT_BUCKETS; b++) {
+    cumulative += h.buckets[b];
+    uint16_t bound = BusMetrics::bucketBound(b);
+    if (bound)
+      len = metricf(out, max, len, "%s_bucket{%s,le=\"%u\"} %u\n", name, label, bound, cumulative);
+    else
+      len = metricf(out, max, len, "%s_bucket{%s,le=\"+Inf\"} %u\n", name, label, cumulative);
+  }
+  len = metricf(out, max, len, "%s_sum{%s} %u\n", name, label, h.sumMs);
+  return metricf(out, max, len, "%s_count{%s} %u\n", name, label, h.count);
+}
+
+// Faze /metrics: prvo metrike po segmentu (kursor = segment), pa keš, pa histogrami (kursor = slot / ID)
+enum MetricsStage
+{
+  MS_FRAMES,
+  MS_BYTES,
+  MS_BYTES_PER_SEC,
+  MS_RX_ERRORS,
+  MS_LISTENER_FULL,
+  MS_TRANSACTIONS,
+  MS_QUEUE_DEPTH,
+  MS_QUEUE_REJECTED,
+  MS_RECOVERIES,
+  MS_BAUD,
+  MS_BAUD_FALLBACKS,
+  MS_RTC_BROADCASTS,
+  MS_CACHE,
+  MS_COMMAND_RTT,
+  MS_COMMAND_TIMEOUTS,
+  MS_CONTROLLER_RTT,
+  MS_CONTROLLER_TIMEOUTS,
+  MS_END
+};
+
+// Uzorci jedne metrike moraju biti zajedno - zato faza po metrici, a ne po segmentu
+size_t metricSegment(uint8_t stage, int s, char *out, size_t max)
+{
+  static const char *const TYPES[MS_CACHE] = {
+    "httpbridge_bus_frames_total counter",
+    "httpbridge_bus_bytes_total counter",
+    "httpbridge_bus_bytes_per_second gauge",
+    "httpbridge_bus_rx_errors_total counter",
+    "httpbridge_bus_listener_full_total counter",
+    "httpbridge_bus_transactions_total counter",
+    "httpbridge_bus_queue_depth gauge",
+    "httpbridge_bus_queue_rejected_total counter",
+    "httpbridge_bus_recoveries_total counter",
+    "httpbridge_bus_baud gauge",
+    "httpbridge_bus_baud_fallbacks_total counter",
+    "httpbridge_rtc_broadcasts_total counter",
+  };
+  RS485Bus *bus = busSegments[s];
+  BusCounters bc;
+  BusClassStats st;
+  size_t len = 0;
+
+  if (s == 0)
+    len = metricf(out, max, len, "# TYPE %s\n", TYPES[stage]);
+  if (stage <= MS_TRANSACTIONS)
+    bus->getCounters(bc);
+
+  switch (stage)
+  {
+  case MS_FRAMES:
+    len = metricf(out, max, len, "httpbridge_bus_frames_total{segment=\"%d\",dir=\"tx\"} %u\n", s, bc.framesTx);
+    len = metricf(out, max, len, "httpbridge_bus_frames_total{segment=\"%d\",dir=\"rx\"} %u\n", s, bc.framesRx);
+    break;
+  case MS_BYTES:
+    len = metricf(out, max, len, "httpbridge_bus_bytes_total{segment=\"%d\",dir=\"tx\"} %u\n", s, bc.bytesTx);
+    len = metricf(out, max, len, "httpbridge_bus_bytes_total{segment=\"%d\",dir=\"rx\"} %u\n", s, bc.bytesRx);
+    break;
+  case MS_BYTES_PER_SEC:
+    len = metricf(out, max, len, "httpbridge_bus_bytes_per_second{segment=\"%d\",dir=\"tx\"} %u\n", s, bc.txBytesPerSec);
+    len = metricf(out, max, len, "httpbridge_bus_bytes_per_second{segment=\"%d\",dir=\"rx\"} %u\n", s, bc.rxBytesPerSec);
+    break;
+  case MS_RX_ERRORS:
+    len = metricf(out, max, len, "httpbridge_bus_rx_errors_total{segment=\"%d\",reason=\"head_crc\"} %u\n", s, bc.headCrcErrors);
+    len = metricf(out, max, len, "httpbridge_bus_rx_errors_total{segment=\"%d\",reason=\"data_crc\"} %u\n", s, bc.dataCrcErrors);
+    len = metricf(out, max, len, "httpbridge_bus_rx_errors_total{segment=\"%d\",reason=\"too_long\"} %u\n", s, bc.oversize);
+    len = metricf(out, max, len, "httpbridge_bus_rx_errors_total{segment=\"%d\",reason=\"parser_timeout\"} %u\n", s, bc.parserTimeouts);
+    len = metricf(out, max, len, "httpbridge_bus_rx_errors_total{segment=\"%d\",reason=\"unhandled\"} %u\n", s, bc.unhandled);
+    break;
+  case MS_LISTENER_FULL:
+    len = metricf(out, max, len, "httpbridge_bus_listener_full_total{segment=\"%d\"} %u\n", s, bc.listenerFull);
+    break;
+  case MS_TRANSACTIONS:
+    for (int r = 0; r < BUS_RESULT_COUNT; r++)
+      len = metricf(out, max, len, "httpbridge_bus_transactions_total{segment=\"%d\",result=\"%s\"} %u\n", s, RS485Bus::resultName((BusResult)r), bc.results[r]);
+    break;
+  case MS_QUEUE_DEPTH:
+  case MS_QUEUE_REJECTED:
+    for (int c = 0; c < BUS_CLASS_COUNT; c++)
+    {
+      bus->getStats((BusClass)c, st);
+      if (stage == MS_QUEUE_DEPTH)
+        len = metricf(out, max, len, "httpbridge_bus_queue_depth{segment=\"%d\",class=\"%s\"} %u\n", s, RS485Bus::className((BusClass)c), st.depth);
+      else
+        len = metricf(out, max, len, "httpbridge_bus_queue_rejected_total{segment=\"%d\",class=\"%s\"} %u\n", s, RS485Bus::className((BusClass)c), st.rejected);
+    }
+    break;
+  case MS_RECOVERIES:
+  {
+    BusRecoveryStats rec;
+    bus->getRecoveryStats(rec);
+    len = metricf(out, max, len, "httpbridge_bus_recoveries_total{segment=\"%d\"} %u\n", s, rec.recoveries);
+    break;
+  }
+  case MS_BAUD:
+    len = metricf(out, max, len, "httpbridge_bus_baud{segment=\"%d\"} %u\n", s, bus->baud());
+    break;
+  case MS_BAUD_FALLBACKS:
+  {
+    BusSpeedStatus ss;
+    busSpeed[s].getStatus(ss);
+    len = metricf(out, max, len, "httpbridge_bus_baud_fallbacks_total{segment=\"%d\"} %u\n", s, ss.fallbacks);
+    break;
+  }
+  case MS_RTC_BROADCASTS:
+  {
+    RtcSyncStats rtc;
+    rtcSync[s].getStats(rtc);
+    len = metricf(out, max, len, "httpbridge_rtc_broadcasts_total{segment=\"%d\"} %u\n", s, rtc.broadcasts);
+    break;
+  }
+  }
+  return len;
+}
+/**
+ * /metrics PRODUCER - jedan segment, jedan histogram komande ili jedan kontroler po komadu
+ */
+size_t produceMetrics(CursorStream *stream, char *out, size_t max)
+{
+  char label[24];
+  RttHistogram h;
+  uint8_t cmd;
+  size_t len = 0;
+
+  while (len == 0 && stream->stage < MS_END)
+  {
+    uint8_t stage = stream->stage;
+    uint16_t i = stream->cursor++;
+    bool next = false;
+
+    if (stage < MS_CACHE)
+    {
+      if (i < RS485_SEGMENTS)
+        len = metricSegment(stage, i, out, max);
+      else
+        next = true;
+    }
+    else if (stage == MS_CACHE)
+    {
+      RoomCacheStats cs;
+      roomCache.getStats(cs);
+      len = metricf(out, max, len, "# TYPE httpbridge_cache_lookups_total counter\n");
+      len = metricf(out, max, len, "httpbridge_cache_lookups_total{result=\"hit\"} %u\n", cs.hits);
+      len = metricf(out, max, len, "httpbridge_cache_lookups_total{result=\"miss\"} %u\n", cs.misses);
+      next = true;
+    }
+    else if (stage == MS_COMMAND_RTT || stage == MS_COMMAND_TIMEOUTS)
+    {
+      if (i == 0)
+        len = metricf(out, max, len, (stage == MS_COMMAND_RTT) ? "# TYPE httpbridge_command_rtt_ms histogram\n"
+                                                               : "# TYPE httpbridge_command_timeouts_total counter\n");
+      if (!busMetrics.getCommand(i, cmd, h))
+        next = true;
+      else if (stage == MS_COMMAND_RTT)
+      {
+        snprintf(label, sizeof(label), "cmd=\"0x%02X\"", cmd);
+        len = metricHistogram(out, max, len, "httpbridge_command_rtt_ms", label, h);
+      }
+      else
+        len = metricf(out, max, len, "httpbridge_command_timeouts_total{cmd=\"0x%02X\"} %u\n", cmd, h.timeouts);
+    }
+    else
+    {
+      // Kontroleri: kursor 0 nosi samo TYPE liniju, ID-evi bez mjerenja se preskaču
+      if (i == 0)
+        len = metricf(out, max, len, (stage == MS_CONTROLLER_RTT) ? "# TYPE httpbridge_controller_rtt_ms histogram\n"
+                                                                  : "# TYPE httpbridge_controller_timeouts_total counter\n");
+      else if (i > METRICS_MAX_ID)
+        next = true;
+      else if (!busMetrics.getController(i, h))
+        continue;
+      else if (stage == MS_CONTROLLER_RTT)
+      {
+        snprintf(label, sizeof(label), "id=\"%d\"", i);
+        len = metricHistogram(out, max, len, "httpbridge_controller_rtt_ms", label, h);
+      }
+      else
+        len = metricf(out, max, len, "httpbridge_controller_timeouts_total{id=\"%d\"} %u\n", i, h.timeouts);
+    }
+
+    if (next)
+    {
+      stream->stage++;
+      stream->cursor = 0;
+    }
+  }
+  return len;
+}
+/**
+ * /roster PRODUCER - zaglavlje sa stanjem sweep-a, pa jedan objekat po kontroleru iz rostera
+ */
+size_t produceRoster(CursorStream *stream, char *out, size_t max)
+{
+  JsonBufferSink sink(out, max);
+  JsonWriter<JsonBufferSink> json(sink);
+
+  if (stream->stage == 0)
+  {
+    RosterStats rs;
+    roster.getStats(rs);
+    json.beginObject();
+    json.field("live", rs.live);
+    json.field("sweeping", rs.sweeping);
+    json.field("next_id", rs.sweeping ? rs.cursor : 0);
+    json.field("passes", rs.passes);
+    json.field("last_pass_ms", rs.lastPassMs);
+    json.beginArray("controllers"); // Zatvara ga stage 1
+    stream->stage = 1;
+    stream->cursor = 1;
+    return sink.length();
+  }
+  if (stream->stage == 2)
+    return 0;
+
+  while (stream->cursor <= ROSTER_MAX_ID)
+  {
+    uint8_t id = stream->cursor++;
+    RosterEntry e;
+    if (!roster.get(id, e))
+      continue;
+
+    char hexBuf[12];
+    if (stream->items++ > 0)
+      sink.write((const uint8_t *)",", 1);
+    json.beginObject();
+    json.field("id", id);
+    json.field("system_id", e.sysid);
+    sprintf(hexBuf, "0x%04X", e.sysid);
+    json.field("system_id_hex", hexBuf);
+    json.field("format", ControllerRoster::formatName(e.format));
+    if (e.format == ROSTER_FMT_VERSION5)
+    {
+      sprintf(hexBuf, "0x%08X", e.bootloaderVer);
+      json.field("bootloader_version", hexBuf);
+      sprintf(hexBuf, "0x%08X", e.appVer);
+      json.field("application_version", hexBuf);
+    }
+    if (e.lastSeenMs != 0)
+      json.field("last_seen_ms", millis() - e.lastSeenMs);
+    else
+      json.nullField("last_seen_ms"); // Učitano iz NVS-a, još nije potvrđeno u ovom boot-u
+    json.field("misses", e.misses);
+    if (e.baudMask != 0)
+    {
+      json.beginArray("baud_rates");
+      for (int i = 0; i < BAUD_RATE_COUNT; i++)
+        if (e.baudMask & (1 << i))
+          json.value(BusSpeed::rate(i));
+      json.endArray();
+    }
+    json.endObject();
+    return sink.length();
+  }
+
+  sink.write((const uint8_t *)"]}", 2);
+  stream->stage = 2;
+  return sink.length();
+}
+/**
+ * /controller_health PRODUCER - jedan objekat po ID-u sa mjerenjima ili aktivnim breaker-om
+ */
+size_t produceControllerHealth(CursorStream *stream, char *out, size_t max)
+{
+  JsonBufferSink sink(out, max);
+
+  if (stream->stage == 0)
+  {
+    sink.write((const uint8_t *)"{\"controllers\":[", 16);
+    stream->stage = 1;
+    stream->cursor = 1;
+    return sink.length();
+  }
+  if (stream->stage == 2)
+    return 0;
+
+  while (stream->cursor <= HEALTH_MAX_ID)
+  {
+    uint8_t id = stream->cursor++;
+    BreakerInfo br;
+    RttInfo rtt[HEALTH_CLASSES];
+    bool hasRtt[HEALTH_CLASSES];
+    bool seen = controllerHealth.getBreaker(id, br);
+    bool active = seen;
+    for (int c = 0; c < HEALTH_CLASSES; c++)
+    {
+      hasRtt[c] = controllerHealth.getRtt(id, (BusClass)c, rtt[c]);
+      seen = seen || hasRtt[c];
+    }
+    if (!seen)
+      continue; // ID bez ijednog mjerenja se ne šalje
+
+    if (stream->items++ > 0)
+      sink.write((const uint8_t *)",", 1);
+    JsonWriter<JsonBufferSink> json(sink);
+    json.beginObject();
+    json.field("id", id);
+    if (active)
+    {
+      json.beginObject("breaker");
+      json.field("state", ControllerHealth::breakerName(br.state));
+      json.field("failures", br.failures);
+      json.field("trips", br.trips);
+      json.field("rejected", br.rejected);
+      json.field("open_ms", br.openForMs);
+      json.field("next_probe_ms", br.nextProbeInMs);
+      json.endObject();
+    }
+    for (int c = 0; c < HEALTH_CLASSES; c++)
+    {
+      if (!hasRtt[c])
+        continue;
+      json.beginObject(RS485Bus::className((BusClass)c));
+      json.field("srtt_ms", rtt[c].srttMs);
+      json.field("rttvar_ms", rtt[c].rttvarMs);
+      json.field("rto_ms", rtt[c].rtoMs);
+      json.field("samples", rtt[c].samples);
+      json.field("backoff", rtt[c].backoff);
+      json.endObject();
+    }
+    json.endObject();
+    return sink.length();
+  }
+
+  sink.write((const uint8_t *)"]}", 2);
+  stream->stage = 2;
+  return sink.length();
+}
 /**
  * HELPER FUNKCIJA ZA BLOKADU SETOVANJA INPUT ONLY PINOVA
  */
@@ -955,33 +1405,51 @@ String getAvailablePinsStatus()
   return result;
 }
 /**
- * TINYFRAME ODGOVOR
+ * DOGAĐAJI SA BUSA ZA loop()
+ *
+ * Listeneri se izvršavaju u RS485 bus tasku: tamo ostaju samo potvrda (TF_Respond) i ažuriranje keša.
+ * NVS upis (SOS), SSE (State) i IR predajnik (blokirajući sendAc) rade se u loop(), da ne zadržavaju
+ * ostale transakcije na busu niti diraju klijente AsyncEventSource-a van async_tcp/loop konteksta.
  */
-TF_Result ID_Listener(TinyFrame *tf, TF_Msg *msg)
+#define BUS_EVENT_QUEUE_LEN 16
+#define BUS_EVENT_DATA_MAX  8   // Najduži payload: IR (8 bajta)
+
+struct BusEvent
 {
-  LOG_INFO("=== ID_Listener: received %d bytes, frame_id=0x%02X, type=0x%02X ===\n", 
-                msg->len, msg->frame_id, msg->type);
-  LOG_DEBUG("Data: ");
-  for (int i = 0; i < msg->len && i < 50; i++) {
-    if (msg->data[i] < 0x10) LOG_DEBUG("0");
-    LOG_DEBUG_HEX(msg->data[i]);
-    LOG_DEBUG(" ");
-  }
-  LOG_DEBUG_LN();
-  
-  replyDataLength = msg->len;
-  memcpy(replyData, msg->data, msg->len);
-  rdy = -1;
-  return TF_CLOSE;
+  uint8_t type;                 // S_SOS, S_STATE, S_IR
+  uint8_t len;
+  uint8_t data[BUS_EVENT_DATA_MAX];
+};
+
+QueueHandle_t busEvents = NULL;
+
+void postBusEvent(uint8_t type, const uint8_t *data, uint16_t len)
+{
+  BusEvent ev;
+  ev.type = type;
+  ev.len = (len < BUS_EVENT_DATA_MAX) ? len : BUS_EVENT_DATA_MAX;
+  memcpy(ev.data, data, ev.len);
+  if (busEvents == NULL || xQueueSend(busEvents, &ev, 0) != pdTRUE)
+    LOG_ERROR("⚠️ Bus event 0x%02X dropped (queue full)\n", type);
 }
 /**
  * TINYFRAME LISTENER ZA SOS SIGNAL
  */
 TF_Result SOS_Listener(TinyFrame *tf, TF_Msg *msg)
+{
+  postBusEvent(S_SOS, msg->data, msg->len);
+
+  // Pošalji potvrdu prijema
+  TF_Respond(tf, msg);
+  return TF_STAY;
+}
+
+void handleSosEvent()
 {
   LOG_INFO_LN("⚠️ SOS Signal primljen iz toaleta!");
   sosStatus = true;
   sosTimestamp = millis();
+  statusEpoch++;
   
   // Sačuvaj u Preferences za perzistentnost (UNIX timestamp)
   preferences.begin("sos_event", false);
@@ -990,72 +1458,171 @@ TF_Result SOS_Listener(TinyFrame *tf, TF_Msg *msg)
   preferences.end();
   
   LOG_INFO_LN("✅ SOS događaj sačuvan u memoriju (timestamp: %lu)", time(nullptr));
-  
+}
+uint32_t roomCacheTtl(CommandType cmd);
+/**
+ * TINYFRAME LISTENER ZA PROMJENE STANJA KONTROLERA
+ */
+TF_Result State_Listener(TinyFrame *tf, TF_Msg *msg)
+{
+  if (msg->len < 3)
+  {
+    LOG_ERROR("⚠️ State_Listener: Neočekivana dužina paketa (%d), očekivano 3\n", msg->len);
+    TF_Respond(tf, msg);
+    return TF_STAY;
+  }
+
+  uint8_t id = msg->data[0];
+  uint8_t evt = msg->data[1];
+  uint8_t value = msg->data[2];
+
+  // Ažuriraj keš istim formatom koji bi vratio GET odgovor kontrolera (prije sljedeće transakcije)
+  switch (evt)
+  {
+  case STATE_EVT_CARD:
+  {
+    uint8_t reply[2] = {CMD_GET_ROOM_STATUS, value};
+    roomCache.store(id, CMD_GET_ROOM_STATUS, reply, sizeof(reply), roomCacheTtl(CMD_GET_ROOM_STATUS));
+    break;
+  }
+  case STATE_EVT_SETPOINT:
+    roomCache.invalidate(id, CMD_GET_ROOM_TEMP); // Ostala polja termostata nisu u poruci
+    break;
+
+  case STATE_EVT_PINS:
+  {
+    uint8_t reply[3] = {CMD_SET_PIN, CMD_GET_PINS, value};
+    roomCache.store(id, CMD_GET_PINS, reply, sizeof(reply), roomCacheTtl(CMD_GET_PINS));
+    break;
+  }
+  default:
+    LOG_ERROR("⚠️ State_Listener: Nepoznat događaj 0x%02X (ID %d)\n", evt, id);
+    TF_Respond(tf, msg);
+    return TF_STAY;
+  }
+
+  postBusEvent(S_STATE, msg->data, 3);
+
   // Pošalji potvrdu prijema
   TF_Respond(tf, msg);
   return TF_STAY;
 }
+
+void handleStateEvent(uint8_t id, uint8_t evt, uint8_t value)
+{
+  JsonDocument doc;
+  doc["id"] = id;
+
+  switch (evt)
+  {
+  case STATE_EVT_CARD:
+    doc["event"] = "card";
+    doc["room_status"] = value ? "GUEST_IN" : "EMPTY";
+    doc["card_inserted"] = (bool)value;
+    break;
+
+  case STATE_EVT_SETPOINT:
+    doc["event"] = "setpoint";
+    doc["setpoint_temperature"] = value;
+    break;
+
+  default: // STATE_EVT_PINS - nepoznate State_Listener ne prosljeđuje
+  {
+    String bin = "";
+    for (int i = 7; i >= 0; i--)
+      bin += String(bitRead(value, i));
+    doc["event"] = "pins";
+    doc["pin_states"] = bin;
+    break;
+  }
+  }
+
+  String json;
+  serializeJson(doc, json);
+  events.send(json.c_str(), "state", millis());
+  LOG_INFO("🔔 State: %s\n", json.c_str());
+}
 /**
  * TINYFRAME LISTENER ZA IR REMOTE DATA
  */
 TF_Result IR_Listener(TinyFrame *tf, TF_Msg *msg)
 {
-  if (msg->len >= 8) {
-    // 1. Handle Physical IR Transmission
-    preferences.begin("ir_settings", true);
-    int protoID = preferences.getInt("protocol", 0);
-    preferences.end();
+  if (msg->len >= 8)
+    postBusEvent(S_IR, msg->data, 8);
+  else
+    LOG_ERROR("⚠️ IR_Listener: Neočekivana dužina paketa (%d), očekivano 8", msg->len);
+  
+  // Pošalji potvrdu prijema
+  TF_Respond(tf, msg);
+  return TF_STAY;
+}
 
-    if (protoID > 0) {
-      // Configure Protocol
-      ac.next.protocol = (decode_type_t)protoID;
-      
-      // Control Logic (Power & Mode)
-      // msg->data[0] mapping: 0=OFF, 1=COOL, 2=HEAT
-      uint8_t ctrl = msg->data[0];
-      
-      if (ctrl == 0) {
-        ac.next.power = false;
-      } else {
-        ac.next.power = true;
-        ac.next.mode = (ctrl == 1) ? stdAc::opmode_t::kCool : stdAc::opmode_t::kHeat;
-      }
+void handleIrEvent(const uint8_t *data)
+{
+  // 1. Handle Physical IR Transmission
+  preferences.begin("ir_settings", true);
+  int protoID = preferences.getInt("protocol", 0);
+  preferences.end();
 
-      // Setpoint (msg->data[5])
-      ac.next.degrees = msg->data[5];
-      ac.next.celsius = true; // Always Celsius
-      
-      // Fan Speed -> Force Auto for simplicity, or map if needed
-      ac.next.fanspeed = stdAc::fanspeed_t::kAuto;
+  if (protoID > 0) {
+    // Configure Protocol
+    ac.next.protocol = (decode_type_t)protoID;
+    
+    // Control Logic (Power & Mode)
+    // data[0] mapping: 0=OFF, 1=COOL, 2=HEAT
+    uint8_t ctrl = data[0];
+    
+    if (ctrl == 0) {
+      ac.next.power = false;
+    } else {
+      ac.next.power = true;
+      ac.next.mode = (ctrl == 1) ? stdAc::opmode_t::kCool : stdAc::opmode_t::kHeat;
+    }
 
-      // Send the signal
-      LOG_INFO_LN("📡 Sending IR: Proto=%d, Power=%d, Mode=%d, Temp=%d", 
-                    protoID, ac.next.power, (int)ac.next.mode, ac.next.degrees);
-      ac.sendAc(); 
-    }
-
-    // 2. Original Logging Logic (Preserved)
-    irData.th_ctrl = msg->data[0];
-    irData.th_state = msg->data[1];
-    irData.mv_temp = (msg->data[2] << 8) | msg->data[3];
-    irData.mv_offset = msg->data[4];
-    irData.sp_temp = msg->data[5];
-    irData.fan_ctrl = msg->data[6];
-    irData.fan_speed = msg->data[7];
-    irData.received = true;
-    irData.timestamp = millis();
+    // Setpoint (data[5])
+    ac.next.degrees = data[5];
+    ac.next.celsius = true; // Always Celsius
     
-    LOG_INFO_LN("📡 IR Data Received: ctrl=%d, state=%d, temp=%d.%02d°C, sp=%d°C, fan=%d/%d",
-                  irData.th_ctrl, irData.th_state, 
-                  irData.mv_temp / 100, irData.mv_temp % 100,
-                  irData.sp_temp, irData.fan_ctrl, irData.fan_speed);
-  } else {
-    LOG_ERROR("⚠️ IR_Listener: Neočekivana dužina paketa (%d), očekivano 8", msg->len);
+    // Fan Speed -> Force Auto for simplicity, or map if needed
+    ac.next.fanspeed = stdAc::fanspeed_t::kAuto;
+
+    // Send the signal
+    LOG_INFO_LN("📡 Sending IR: Proto=%d, Power=%d, Mode=%d, Temp=%d", 
+                  protoID, ac.next.power, (int)ac.next.mode, ac.next.degrees);
+    ac.sendAc(); 
   }
+
+  // 2. Original Logging Logic (Preserved)
+  irData.th_ctrl = data[0];
+  irData.th_state = data[1];
+  irData.mv_temp = (data[2] << 8) | data[3];
+  irData.mv_offset = data[4];
+  irData.sp_temp = data[5];
+  irData.fan_ctrl = data[6];
+  irData.fan_speed = data[7];
+  irData.received = true;
+  irData.timestamp = millis();
   
-  // Pošalji potvrdu prijema
-  TF_Respond(tf, msg);
-  return TF_STAY;
+  LOG_INFO_LN("📡 IR Data Received: ctrl=%d, state=%d, temp=%d.%02d°C, sp=%d°C, fan=%d/%d",
+                irData.th_ctrl, irData.th_state, 
+                irData.mv_temp / 100, irData.mv_temp % 100,
+                irData.sp_temp, irData.fan_ctrl, irData.fan_speed);
+}
+/**
+ * OBRADA DOGAĐAJA SA BUSA U loop()
+ */
+void handleBusEvents()
+{
+  BusEvent ev;
+  while (busEvents != NULL && xQueueReceive(busEvents, &ev, 0) == pdTRUE)
+  {
+    switch (ev.type)
+    {
+    case S_SOS:   handleSosEvent(); break;
+    case S_STATE: handleStateEvent(ev.data[0], ev.data[1], ev.data[2]); break;
+    case S_IR:    handleIrEvent(ev.data); break;
+    }
+  }
 }
 /**
  * KONVERTOR STRING HHMM u sate i minute
@@ -1088,16 +1655,23 @@ void sendJsonSuccess(AsyncWebServerRequest *request, const String &message, Json
 /**
  * JSON RESPONSE HELPER - Error
  */
+template <class Sink>
+void writeJsonError(Sink &sink, int code, const char *message)
+{
+  JsonWriter<Sink> json(sink);
+  json.beginObject();
+  json.field("status", "error");
+  json.field("code", code);
+  json.field("message", message);
+  json.endObject();
+}
+
 void sendJsonError(AsyncWebServerRequest *request, int code, const String &message)
 {
-  JsonDocument doc;
-  doc["status"] = "error";
-  doc["code"] = code;
-  doc["message"] = message;
-  
-  String response;
-  serializeJson(doc, response);
-  request->send(code, "application/json", response);
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  response->setCode(code);
+  writeJsonError(*response, code, message.c_str());
+  request->send(response);
 }
 /**
  * RUČNA KONTROLA VANJSKE RASVJETE
@@ -1139,6 +1713,7 @@ void loadTimerPreferences()
   timerOnTime = preferences.getString("onTime", "0000");
   timerOffTime = preferences.getString("offTime", "0000");
   preferences.end();
+  statusEpoch++;
 }
 /**
  * IZRAČUN MINUTA OD PONOĆI
@@ -1335,634 +1910,1402 @@ void setupLightControl()
   lightTicker.attach(60.0, updateLightState); // Provjerava svakih 60 sekundi
 }
 /**
- * OBRADA HTTP CGI ZAHTJEVA
+ * TTL KEŠIRANOG ODGOVORA PO KOMANDI (0 = ne kešira se; lista mora pratiti CACHED_CMDS u RoomCache.cpp)
  */
-void handleSysctrlRequest(AsyncWebServerRequest *request)
+uint32_t roomCacheTtl(CommandType cmd)
 {
-  if (otaUpdateInProgress)
+  switch (cmd)
   {
-    sendJsonError(request, 503, "OTA update in progress");
-    return;
+  case CMD_GET_ROOM_STATUS:     return 2000;
+  case CMD_GET_PINS:            return 2000;
+  case CMD_GET_ROOM_TEMP:       return 5000;
+  case CMD_GET_GUEST_IN_TEMP:   return 60000;
+  case CMD_GET_GUEST_OUT_TEMP:  return 60000;
+  case CMD_GET_FAN_BAND:        return 60000;
+  case CMD_GET_SYSID:           return 600000;
+  case CMD_GET_VERSION:         return 600000;
+  default:                      return 0;
   }
+}
+/**
+ * ReplyWriter NAD JsonWriter - polja idu u bafer podataka, greška se pamti za omotač odgovora
+ */
+struct Rs485ReplyJson
+{
+  JsonWriter<JsonBufferSink> *json;
+  char error[COMMAND_FAULT_MAX];
+};
 
-  String bin = "";
-  String body = "";  // Dodano za kompatibilnost sa CMD_READ_LOG koji još nije konvertovan
-
-  if (!request->hasParam("CMD"))
-  {
-    sendJsonError(request, 400, "Missing CMD parameter");
-    return;
-  }
+void replyPutInt(void *ctx, const char *key, int32_t value)
+{
+  ((Rs485ReplyJson *)ctx)->json->field(key, value);
+}
 
-  String cmdStr = request->getParam("CMD")->value();
-  CommandType cmd = stringToCommand(cmdStr);
+void replyPutBool(void *ctx, const char *key, bool value)
+{
+  ((Rs485ReplyJson *)ctx)->json->field(key, value);
+}
 
-  uint8_t buf[64] = {0};
-  int length = 0;
-  bool isLocalCommand = false;  // Flag: true za komande koje se obrađuju lokalno (bez RS485)
-  led_state = LED_FAST;
+void replyPutText(void *ctx, const char *key, const char *value)
+{
+  ((Rs485ReplyJson *)ctx)->json->field(key, value);
+}
 
+void replyPutError(void *ctx, const char *message)
+{
+  Rs485ReplyJson *reply = (Rs485ReplyJson *)ctx;
+  strlcpy(reply->error, message, sizeof(reply->error));
+}
+/**
+ * DEKODIRANJE RS485 ODGOVORA U JSON
+ * Podaci se pišu u bafer na steku, a omotač (status/message/data) direktno u sink (stream ili DeferredResponse)
+ */
+template <class Sink>
+void writeRs485Reply(Sink &sink, CommandType cmd, int deviceId, const uint8_t *replyData, int replyDataLength,
+                     bool cached, uint32_t ageMs)
+{
+  LOG_INFO_LN(">>> Response received, processing...");
+  char data[RS485_REPLY_JSON_MAX];
+  JsonBufferSink dataSink(data, sizeof(data));
+  JsonWriter<JsonBufferSink> json(dataSink);
+  Rs485ReplyJson reply = {&json, ""};
+  ReplyWriter writer = {&reply, replyPutInt, replyPutBool, replyPutText, replyPutError};
+  const CommandDescriptor *desc = findCommand(cmd);
+  const char *message = NULL;
+
+  json.beginObject();
   switch (cmd)
   {
-
-  case CMD_RESTART:
-  {
-    LOG_INFO_LN("Device restart...");
-    isLocalCommand = true;  // ✅ Lokalna komanda
-    sendJsonSuccess(request, "Restart in 3s");
-    delay(3000);
-    ESP.restart();
-    break;
-  }
-  case CMD_RESTART_CTRL:
+  case CMD_READ_LOG:
   {
-    if (!request->hasParam("ID"))
+    // Response format: [CMD][LOG_DSIZE][16-byte log data][device_addr_H][device_addr_L]
+    // Total: 20 bytes
+    if (replyDataLength < 20)
     {
-      sendJsonError(request, 400, "Missing ID parameter");
-      return;
+      snprintf(reply.error, sizeof(reply.error), "Invalid response length (expected 20, got %d)", replyDataLength);
+      break;
     }
-
-    int id = request->getParam("ID")->value().toInt();
-
-    // ✅ Validacija ID-a
-    if (id < 1 || id > 254)
+    
+    if (replyData[1] != 16)
     {
-      sendJsonError(request, 400, "Invalid ID (must be 1-254)");
-      return;
+      snprintf(reply.error, sizeof(reply.error), "Invalid log data size (expected 16, got %d)", replyData[1]);
+      break;
+    }
+    
+    // Parse 16-byte log data (bytes 2-17)
+    uint16_t logId = (replyData[2] << 8) | replyData[3];
+    
+    // Check if log list is empty (log_id = 0x0000 indicates LOGGER_EMPTY)
+    if (logId == 0)
+    {
+      message = "Log list is empty";
+      json.field("status", "EMPTY");
+      json.field("device_id", deviceId);
+      break;
+    }
+    
+    // Debug: Print raw bytes to Serial
+    LOG_DEBUG("LOG RAW DATA: ");
+    for (int i = 2; i < 18; i++) {
+      if (replyData[i] < 0x10) LOG_DEBUG("0");
+      LOG_DEBUG_HEX(replyData[i]);
+      LOG_DEBUG(" ");
     }
-    buf[0] = cmd;
-    buf[1] = id;
-    length = 2;
+    LOG_DEBUG_LN();
+
+    writeLogEntry(json, deviceId, replyData + 2);
     break;
   }
-  case CMD_GET_SSID_PSWRD:
-  {
-    preferences.begin("wifi", false);
-    preferences.getString("ssid", _ssid, sizeof(_ssid));
-    preferences.getString("password", _pass, sizeof(_pass));
-    preferences.end();
 
-    JsonDocument data;
-    data["ssid"] = String(_ssid);
-    data["password"] = strlen(_pass) == 0 ? "" : String(_pass);
-    data["open_network"] = strlen(_pass) == 0;
-    
-    sendJsonSuccess(request, "WiFi credentials retrieved", &data);
-    return;
-  }
-  case CMD_SET_SSID_PSWRD:
+  case CMD_DELETE_LOG:
   {
-    if (!request->hasParam("SSID"))
+    // Response format: [CMD][Status][device_addr_H][device_addr_L]
+    // Status byte: 0 = LOGGER_OK, 1 = LOGGER_EMPTY
+    // Total: 4 bytes
+    if (replyDataLength < 4)
     {
-      sendJsonError(request, 400, "Missing SSID parameter");
-      return;
+      snprintf(reply.error, sizeof(reply.error), "Invalid response length (expected 4, got %d)", replyDataLength);
+      break;
     }
-    strlcpy(_ssid, request->getParam("SSID")->value().c_str(), sizeof(_ssid));
-    strlcpy(_pass, request->hasParam("PSWRD") ? request->getParam("PSWRD")->value().c_str() : "", sizeof(_pass));
-
-    preferences.begin("wifi", false);
-    preferences.putString("ssid", _ssid);
-    preferences.putString("password", _pass);
-    preferences.end();
     
-    JsonDocument data;
-    data["ssid"] = String(_ssid);
-    sendJsonSuccess(request, "WiFi credentials saved", &data);
-    return;
+    uint8_t status = replyData[1];  // LOGGER_OK=0, LOGGER_EMPTY=1
+    message = (status == 0) ? "Log deleted successfully" : "Log list is empty";
+    json.field("status", status == 0 ? "OK" : "EMPTY");
+    json.field("device_id", deviceId);
+    break;
   }
-  case CMD_GET_MDNS_NAME:
-  {
-    isLocalCommand = true;  // ✅ Lokalna komanda
 
-    preferences.begin("_mdns", false);
-    preferences.getString("mdns", _mdns, sizeof(_mdns));
-    preferences.end();
-    
-    JsonDocument data;
-    data["mdns"] = String(_mdns);
-    sendJsonSuccess(request, "mDNS name retrieved", &data);
-    return;
-  }
-  case CMD_SET_MDNS_NAME:
-  {
-    if (!request->hasParam("MDNS"))
+  default:
+    // Polja odgovora iz CommandTable; odgovor koji ne odgovara komandi se samo loguje
+    if (desc == NULL || !decodeReply(*desc, replyData, replyDataLength, writer))
     {
-      sendJsonError(request, 400, "Missing MDNS parameter");
-      return;
+      LOG_DEBUG_F("Unknown response 0x%02X (%d bytes):", replyData[0], replyDataLength);
+      for (int i = 0; i < replyDataLength; i++)
+        LOG_DEBUG_F(" %02X", replyData[i]);
+      LOG_DEBUG_LN();
+      strlcpy(reply.error, "Unknown response", sizeof(reply.error));
     }
-    strlcpy(_mdns, request->getParam("MDNS")->value().c_str(), sizeof(_mdns));
-    preferences.begin("_mdns", false);
-    preferences.putString("mdns", _mdns);
-    preferences.end();
-    
-    JsonDocument data;
-    data["mdns"] = String(_mdns);
-    sendJsonSuccess(request, "mDNS name saved", &data);
-    return;
+    break;
   }
-  case CMD_GET_IP_ADDRESS:
+  json.endObject();
+
+  if (dataSink.overflow() && reply.error[0] == '\0')
+    strlcpy(reply.error, "Response too large", sizeof(reply.error));
+
+  JsonWriter<Sink> out(sink);
+  out.beginObject();
+  if (reply.error[0] != '\0') {
+    out.field("status", "error");
+    out.field("message", reply.error);
+    out.field("code", 500);
+  } else {
+    out.field("status", "success");
+    if (message != NULL)
+      out.field("message", message);
+    out.key("data").raw(data, dataSink.length());
+  }
+  if (roomCacheTtl(cmd) > 0) {
+    out.field("cached", cached);
+    out.field("age_ms", ageMs);
+  }
+  out.endObject();
+}
+
+// Odgovor iz keša - poziva se iz async_tcp taska
+void sendRs485Reply(AsyncWebServerRequest *request, CommandType cmd, int deviceId, const uint8_t *replyData, int replyDataLength,
+                    bool cached = false, uint32_t ageMs = 0)
+{
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  writeRs485Reply(*response, cmd, deviceId, replyData, replyDataLength, cached, ageMs);
+  request->send(response);
+}
+/**
+ * KLASA PRIORITETA RS485 KOMANDE
+ */
+BusClass busClassForCommand(CommandType cmd)
+{
+  switch (cmd)
   {
-    JsonDocument data;
-    data["ip"] = WiFi.localIP().toString();
-    data["subnet"] = WiFi.subnetMask().toString();
-    data["gateway"] = WiFi.gatewayIP().toString();
-    sendJsonSuccess(request, "IP address retrieved", &data);
-    return;
+  case CMD_OPEN_DOOR:
+  case CMD_SET_PASSWORD:
+  case CMD_GET_PASSWORD:
+    return BUS_CLASS_ACCESS;
+
+  case CMD_READ_LOG:
+  case CMD_DELETE_LOG:
+    return BUS_CLASS_LOG;
+
+  case CMD_SET_PIN:
+  case CMD_SET_THST_ON:
+  case CMD_SET_THST_OFF:
+  case CMD_SET_THST_HEATING:
+  case CMD_SET_THST_COOLING:
+  case CMD_SET_ROOM_TEMP:
+  case CMD_SET_GUEST_IN_TEMP:
+  case CMD_SET_GUEST_OUT_TEMP:
+  case CMD_SET_FWD_HEATING:
+  case CMD_SET_FWD_COOLING:
+  case CMD_SET_ENABLE_HEATING:
+  case CMD_SET_ENABLE_COOLING:
+  case CMD_SET_LANG:
+  case CMD_SET_SYSID:
+  case CMD_QR_CODE_SET:
+  case CMD_RESTART_CTRL:
+    return BUS_CLASS_WRITE;
+
+  default:
+    return BUS_CLASS_READ;
   }
-  case CMD_GET_TCPIP_PORT:
+}
+/**
+ * READ-ONLY RS485 KOMANDE - identični upiti u toku dijele jedan odgovor
+ */
+bool isSharedReadCommand(CommandType cmd)
+{
+  switch (cmd)
   {
-    preferences.begin("_port", false);
-    _port = preferences.getInt("port", 0);
-    preferences.end();
-    
-    JsonDocument data;
-    data["port"] = _port;
-    sendJsonSuccess(request, "TCP/IP port retrieved", &data);
-    return;
+  case CMD_GET_ROOM_STATUS:
+  case CMD_GET_ROOM_TEMP:
+  case CMD_GET_PINS:
+  case CMD_GET_FAN_DIFFERENCE:
+  case CMD_GET_FAN_BAND:
+  case CMD_GET_GUEST_IN_TEMP:
+  case CMD_GET_GUEST_OUT_TEMP:
+  case CMD_QR_CODE_GET:
+  case CMD_GET_SYSID:
+  case CMD_GET_VERSION:
+    return true;
+
+  default:
+    return false; // GET_PASSWORD i READ_LOG se ne dijele (lozinke, sekvencijalni log)
   }
-  case CMD_SET_TCPIP_PORT:
+}
+/**
+ * AŽURIRANJE KEŠA NAKON RS485 TRANSAKCIJE
+ */
+void updateRoomCache(CommandType cmd, uint8_t id, const BusTransaction &txn)
+{
+  bool ok = (txn.result == BUS_OK);
+  uint32_t ttl = roomCacheTtl(cmd);
+
+  if (ttl > 0)
   {
-    if (!request->hasParam("PORT"))
-    {
-      sendJsonError(request, 400, "Missing PORT parameter");
-      return;
-    }
-    _port = request->getParam("PORT")->value().toInt();
-    preferences.begin("_port", false);
-    preferences.putInt("port", _port);
-    preferences.end();
-    
-    JsonDocument data;
-    data["port"] = _port;
-    sendJsonSuccess(request, "TCP/IP port saved", &data);
+    if (ok)
+      roomCache.store(id, cmd, txn.reply, txn.replyLen, ttl);
     return;
   }
-  case CMD_SET_PASSWORD:
+
+  // SET komande: upiši poznatu novu vrijednost ili poništi zavisni GET
+  switch (cmd)
+  {
+  case CMD_SET_GUEST_IN_TEMP:
+  case CMD_SET_GUEST_OUT_TEMP:
   {
-    if (!request->hasParam("ID") || !request->hasParam("TYPE") || !request->hasParam("PASSWORD"))
+    CommandType getCmd = (cmd == CMD_SET_GUEST_IN_TEMP) ? CMD_GET_GUEST_IN_TEMP : CMD_GET_GUEST_OUT_TEMP;
+    // Kontroler nema ACK za ovu komandu - vraća isti frame [CMD][ID][temp] kada je vrijednost upisana
+    if (ok && txn.replyLen >= 3 && txn.reply[0] == cmd && txn.reply[2] == txn.tx[2])
     {
-      sendJsonError(request, 400, "Missing ID, TYPE or PASSWORD parameter");
-      return;
+      uint8_t reply[2] = {(uint8_t)getCmd, txn.tx[2]}; // Format GET odgovora: [CMD][temp]
+      roomCache.store(id, getCmd, reply, sizeof(reply), roomCacheTtl(getCmd));
     }
-    
-    int id = request->getParam("ID")->value().toInt();
-    String type = request->getParam("TYPE")->value();
-    String password = request->getParam("PASSWORD")->value();
-    
-    // Validacija ID-a
-    if (id < 1 || id > 254)
+    else
     {
-      sendJsonError(request, 400, "Invalid ID (must be 1-254)");
-      return;
+      roomCache.invalidate(id, getCmd);
     }
-    
-    // Validacija lozinke (samo numerički karakteri)
-    for (size_t i = 0; i < password.length(); i++)
+    break;
+  }
+
+  case CMD_SET_SYSID:
+    if (ok && txn.replyLen >= 2 && txn.reply[1] == 0x06)
     {
-      if (!isdigit(password[i]))
-      {
-        sendJsonError(request, 400, "Password must contain only digits");
-        return;
-      }
+      uint8_t reply[3] = {CMD_GET_SYSID, txn.tx[2], txn.tx[3]}; // [CMD][MSB][LSB]
+      roomCache.store(id, CMD_GET_SYSID, reply, sizeof(reply), roomCacheTtl(CMD_GET_SYSID));
     }
-    
-    String dataString = "";
-    
-    if (type == "GUEST")
+    else
     {
-      // Guest lozinka zahtijeva GUEST_ID i EXPIRY
-      if (!request->hasParam("GUEST_ID") || !request->hasParam("EXPIRY"))
-      {
-        sendJsonError(request, 400, "Missing GUEST_ID or EXPIRY for GUEST type");
-        return;
-      }
-      
-      int guestId = request->getParam("GUEST_ID")->value().toInt();
-      String expiry = request->getParam("EXPIRY")->value();
-      
-      // Validacija GUEST_ID
-      if (guestId < 1 || guestId > 8)
-      {
-        sendJsonError(request, 400, "Invalid GUEST_ID (must be 1-8)");
-        return;
-      }
-      
-      // Validacija EXPIRY formata (mora biti 10 karaktera: HHMMDDMMYY)
-      if (expiry.length() != 10)
-      {
-        sendJsonError(request, 400, "Invalid EXPIRY format (must be HHMMDDMMYY)");
-        return;
-      }
-      
-      // Kreiraj string: G{ID},{PASSWORD},{EXPIRY}
-      dataString = "G" + String(guestId) + "," + password + "," + expiry;
+      roomCache.invalidate(id, CMD_GET_SYSID);
     }
-    else if (type == "MAID")
-    {
-      dataString = "H" + password;
-    }
-    else if (type == "MANAGER")
-    {
-      dataString = "M" + password;
-    }
-    else if (type == "SERVICE")
+    break;
+
+  case CMD_SET_ROOM_TEMP:
+  case CMD_SET_THST_ON:
+  case CMD_SET_THST_OFF:
+  case CMD_SET_THST_HEATING:
+  case CMD_SET_THST_COOLING:
+  case CMD_SET_FWD_HEATING:
+  case CMD_SET_FWD_COOLING:
+  case CMD_SET_ENABLE_HEATING:
+  case CMD_SET_ENABLE_COOLING:
+    roomCache.invalidate(id, CMD_GET_ROOM_TEMP);
+    break;
+
+  case CMD_SET_PIN:
+    roomCache.invalidate(id, CMD_GET_PINS);
+    break;
+
+  case CMD_RESTART_CTRL:
+    roomCache.invalidateAll(id);
+    break;
+
+  default:
+    break;
+  }
+}
+/**
+ * RTT HISTOGRAM - S_CUSTOM payload je [CMD][ID]...; pratioci nisu bili na busu
+ */
+void recordBusMetrics(const BusTransaction &txn, bool countTimeout = true)
+{
+  if (txn.isFollower || txn.txLen < 2)
+    return;
+
+  if (txn.result == BUS_OK)
+    busMetrics.observeRtt(txn.tx[0], txn.tx[1], txn.rttMs);
+  else if (txn.result == BUS_TIMEOUT && countTimeout)
+    busMetrics.observeTimeout(txn.tx[0], txn.tx[1]);
+}
+/**
+ * RS485 TRANSAKCIJA ZAVRŠENA - poziva se iz RS485 bus taska
+ * Request pripada async_tcp tasku - odgovor se samo upisuje u DeferredResponse, šalje ga async_tcp
+ */
+void completeSysctrlError(DeferredResponse *response, int code, const char *message)
+{
+  writeJsonError(response->sink(), code, message);
+  response->complete(code);
+}
+
+void onSysctrlReply(BusTransaction &txn)
+{
+  DeferredResponse *response = (DeferredResponse *)txn.arg;
+  CommandType cmd = (CommandType)(txn.tag & 0xFF);
+  int deviceId = (txn.tag >> 8) & 0xFF;
+
+  updateRoomCache(cmd, deviceId, txn);
+  recordBusMetrics(txn);
+
+  // RTT uzorak samo od transakcije koja je stvarno bila na busu (ne od pratilaca)
+  if (!txn.isFollower)
+  {
+    static uint8_t consecutiveTimeouts[RS485_SEGMENTS] = {0};
+    uint8_t seg = segmentOf(deviceId);
+
+    if (txn.result == BUS_OK)
     {
-      dataString = "S" + password;
+      controllerHealth.onReply(deviceId, txn.cls, txn.rttMs);
+      consecutiveTimeouts[seg] = 0;
     }
-    else if (type == "DELETE_GUEST")
+    else if (txn.result == BUS_TIMEOUT)
     {
-      // Brisanje Guest lozinke: G{ID}X
-      if (!request->hasParam("GUEST_ID"))
-      {
-        sendJsonError(request, 400, "Missing GUEST_ID for DELETE_GUEST");
-        return;
-      }
-      
-      int guestId = request->getParam("GUEST_ID")->value().toInt();
-      
-      if (guestId < 1 || guestId > 8)
+      controllerHealth.onTimeout(deviceId, txn.cls);
+      // Breaker ograničava jedan mrtav ID na 3 timeouta - niz duži od toga znači da bus/parser ne valja
+      if (++consecutiveTimeouts[seg] >= RS485_RECOVER_TIMEOUTS)
       {
-        sendJsonError(request, 400, "Invalid GUEST_ID (must be 1-8)");
-        return;
+        consecutiveTimeouts[seg] = 0;
+        busSegments[seg]->recover();
       }
-      
-      dataString = "G" + String(guestId) + "X";
     }
-    else
-    {
-      sendJsonError(request, 400, "Invalid TYPE (must be GUEST, MAID, MANAGER, SERVICE or DELETE_GUEST)");
-      return;
-    }
-    
-    // Kreiraj RS485 poruku
-    buf[0] = CMD_SET_PASSWORD;
-    buf[1] = id;
-    strlcpy((char *)buf + 2, dataString.c_str(), sizeof(buf) - 2);
-    length = 2 + dataString.length() + 1;  // +1 za null terminator
-    
-    break;
   }
-  case CMD_SET_ROOM_TEMP:
-  case CMD_SET_GUEST_IN_TEMP:
-  case CMD_SET_GUEST_OUT_TEMP:
+
+  if (txn.result == BUS_OK && cmd == CMD_GET_SYSID)
+    roster.learnSysid(deviceId, txn.reply, txn.replyLen);
+  else if (txn.result == BUS_OK && cmd == CMD_GET_VERSION)
+    roster.learnVersion(deviceId, txn.reply, txn.replyLen);
+
+  if (txn.result == BUS_TIMEOUT)
   {
-    if (!request->hasParam("ID") || !request->hasParam("VALUE"))
-    {
-      sendJsonError(request, 400, "Missing ID or VALUE");
-      return;
-    }
+    LOG_ERROR_LN(">>> TIMEOUT detected!");
+    completeSysctrlError(response, 408, "Timeout: No response from device");
+    return;
+  }
 
-    int id = request->getParam("ID")->value().toInt();
-    int value = request->getParam("VALUE")->value().toInt();
+  if (txn.result == BUS_ABORTED)
+  {
+    completeSysctrlError(response, 503, "RS485 bus recovering, retry");
+    return;
+  }
 
-    // ✅ Validacija ID-a
-    if (id < 1 || id > 254)
-    {
-      sendJsonError(request, 400, "Invalid ID (must be 1-254)");
-      return;
-    }
+  if (txn.result == BUS_NO_BUFFER)
+  {
+    completeSysctrlError(response, 503, "RS485 reply buffers exhausted, retry");
+    return;
+  }
 
-    // ✅ Validacija VALUE-a
-    if (value < 5 || value > 40)
-    {
-      sendJsonError(request, 400, "Invalid VALUE (must be 5-40)");
-      return;
-    }
+  if (txn.result != BUS_OK)
+  {
+    LOG_ERROR_LN(">>> RS485 send failed!");
+    completeSysctrlError(response, 500, "RS485 send failed");
+    return;
+  }
 
-    buf[0] = cmd;
-    buf[1] = id;
-    buf[2] = value;
-    length = 3;
-    break;
+  writeRs485Reply(response->sink(), cmd, deviceId, txn.reply, txn.replyLen, false, 0);
+  response->complete(200);
+}
+/**
+ * PROBA KONTROLERA SA OTVORENIM BREAKEROM - GET_SYSID, poziva se iz RS485 bus taska
+ */
+void onBreakerProbe(BusTransaction &txn)
+{
+  uint8_t id = txn.tag;
+  bool ok = (txn.result == BUS_OK);
+
+  recordBusMetrics(txn);
+  if (ok)
+    controllerHealth.onReply(id, txn.cls, txn.rttMs);
+  controllerHealth.onProbeResult(id, ok);
+  LOG_INFO("[Breaker] Probe ID %d: %s\n", id, ok ? "OK, closed" : "no response");
+}
+
+void probeOpenBreakers()
+{
+  uint8_t id = controllerHealth.nextProbe();
+  if (id == 0)
+    return;
+
+  uint8_t probe[2] = {CMD_GET_SYSID, id};
+  if (busFor(id).query(BUS_CLASS_LOG, S_CUSTOM, probe, sizeof(probe), BREAKER_PROBE_TIMEOUT_MS,
+                  onBreakerProbe, NULL, id) == 0)
+    controllerHealth.onProbeResult(id, false); // Red pun - pokušaj ponovo kasnije
+}
+/**
+ * ROSTER SWEEP - odgovor na GET_SYSID/GET_VERSION, poziva se iz RS485 bus taska
+ */
+void onRosterReply(BusTransaction &txn)
+{
+  uint8_t id = txn.tag & 0xFF;
+  RosterQuery query = (RosterQuery)(txn.tag >> 8);
+
+  if (txn.result == BUS_ABORTED)
+  {
+    roster.retryStep(); // Oporavak busa - adresa nije odgovorila ni potvrdno ni odrečno
+    return;
   }
-  case CMD_GET_PASSWORD:
+  recordBusMetrics(txn, false); // Prazne adrese nisu timeouti kontrolera
+  roster.onSweepReply(id, query, txn.result == BUS_OK, txn.reply, txn.replyLen);
+}
+
+void runRosterSweep()
+{
+  uint8_t id;
+  RosterQuery query;
+  if (!roster.nextStep(id, query))
+    return;
+
+  uint8_t cmd[3] = {CMD_GET_SYSID, id, BAUD_OP_QUERY};
+  uint16_t len = 2;
+  if (query == ROSTER_Q_VERSION)
+    cmd[0] = CMD_GET_VERSION;
+  else if (query == ROSTER_Q_BAUD)
   {
-    if (!request->hasParam("ID") || !request->hasParam("TYPE"))
-    {
-      sendJsonError(request, 400, "Missing ID or TYPE");
-      return;
-    }
-    
-    int id = request->getParam("ID")->value().toInt();
-    String type = request->getParam("TYPE")->value();
-    
-    // Validacija ID-a
-    if (id < 1 || id > 254)
+    cmd[0] = CMD_SET_BAUD;
+    len = 3;
+  }
+  if (busFor(id).query(BUS_CLASS_LOG, S_CUSTOM, cmd, len, ROSTER_PROBE_TIMEOUT_MS,
+                  onRosterReply, NULL, (uint32_t)id | ((uint32_t)query << 8)) == 0)
+    roster.retryStep();
+}
+/**
+ * PREGOVARANJE BRZINE BUSA - ping nakon prebacivanja, poziva se iz RS485 bus taska
+ */
+void onBaudPing(BusTransaction &txn)
+{
+  BusSpeed &speed = busSpeed[txn.tag >> 8];
+
+  if (txn.result == BUS_ABORTED)
+  {
+    speed.retryStep();
+    return;
+  }
+  recordBusMetrics(txn, false); // Neuspjeh je signal za povratak na staru brzinu, ne timeout kontrolera
+  speed.onPingResult(txn.result == BUS_OK);
+}
+
+void runBusSpeed()
+{
+  for (int s = 0; s < RS485_SEGMENTS; s++)
+  {
+    RS485Bus &bus = *busSegments[s];
+    BusCounters bc;
+    bus.getCounters(bc);
+    BaudStep step;
+    if (!busSpeed[s].nextStep(step, bus.baud(), bc))
+      continue;
+
+    bool queued;
+    if (step.action == BAUD_ACT_SWITCH)
     {
-      sendJsonError(request, 400, "Invalid ID (must be 1-254)");
-      return;
+      uint8_t cmd[5] = {CMD_SET_BAUD, DEF_TFBRA, BAUD_OP_SWITCH, step.toIdx, BAUD_HOLD_SEC};
+      queued = bus.sendAtBaud(BUS_CLASS_WRITE, S_CUSTOM, cmd, sizeof(cmd),
+                              BusSpeed::rate(step.fromIdx), BusSpeed::rate(step.toIdx));
     }
-    
-    char userGroup = 0;
-    uint8_t guestId = 0;
-    
-    if (type == "GUEST")
-    {
-      if (!request->hasParam("GUEST_ID"))
-      {
-        sendJsonError(request, 400, "Missing GUEST_ID for GUEST type");
-        return;
-      }
-      
-      guestId = request->getParam("GUEST_ID")->value().toInt();
-      
-      // Validacija GUEST_ID
-      if (guestId < 1 || guestId > 8)
-      {
-        sendJsonError(request, 400, "Invalid GUEST_ID (must be 1-8)");
-        return;
-      }
-      
-      userGroup = 'G';
-      buf[0] = CMD_GET_PASSWORD;
-      buf[1] = id;
-      buf[2] = userGroup;
-      buf[3] = guestId;
-      length = 4;
-    }
-    else if (type == "MAID")
+    else
     {
-      userGroup = 'H';
-      buf[0] = CMD_GET_PASSWORD;
-      buf[1] = id;
-      buf[2] = userGroup;
-      length = 3;
+      uint8_t cmd[2] = {CMD_GET_SYSID, step.id};
+      queued = bus.query(BUS_CLASS_LOG, S_CUSTOM, cmd, sizeof(cmd), BAUD_VERIFY_TIMEOUT_MS,
+                         onBaudPing, NULL, step.id | (s << 8)) != 0;
     }
-    else if (type == "MANAGER")
+    if (!queued)
+      busSpeed[s].retryStep();
+  }
+}
+/**
+ * PARAMETRI KOMANDE - HTTP zahtjev, uz fiksne vrijednosti i preimenovanja koraka makroa
+ */
+struct CommandParams
+{
+  AsyncWebServerRequest *request;
+  const char *const *fixed; // {"IME", "vrijednost", ..., NULL}; ima prednost nad zahtjevom
+  const char *const *alias; // {"IME u komandi", "IME u zahtjevu", ..., NULL}
+
+  static const char *find(const char *const *pairs, const char *name)
+  {
+    for (; pairs != NULL && pairs[0] != NULL; pairs += 2)
+      if (strcmp(pairs[0], name) == 0)
+        return pairs[1];
+    return NULL;
+  }
+
+  const char *value(const char *name) const
+  {
+    const char *fixedValue = find(fixed, name);
+    if (fixedValue != NULL)
+      return fixedValue;
+    const char *source = find(alias, name);
+    AsyncWebParameter *p = request->getParam(source ? source : name);
+    return p ? p->value().c_str() : NULL;
+  }
+
+  bool has(const char *name) const { return value(name) != NULL; }
+
+  // CommandInput::lookup (CommandTable)
+  static const char *lookup(void *ctx, const char *name) { return ((const CommandParams *)ctx)->value(name); }
+};
+
+struct CommandError
+{
+  int code; // HTTP kod, 0 = bez greške
+  String message;
+
+  int set(int c, const String &m)
+  {
+    code = c;
+    message = m;
+    return 0;
+  }
+};
+/**
+ * SASTAVLJANJE RS485 KOMANDE IZ PARAMETARA (zajedničko za /sysctrl i /macro)
+ * Vraća dužinu frame-a u buf (SYSCTRL_BUF_LEN); 0 = nije bus komanda ili greška (err.code != 0)
+ */
+int buildRs485Command(CommandType cmd, const CommandParams &params, uint8_t *buf, CommandError &err)
+{
+  err.code = 0;
+
+  const CommandDescriptor *desc = findCommand(cmd);
+  if (desc == NULL)
+    return 0;
+
+  // Bez ID-a -> verzija ESP32 firmware-a, lokalno u handleSysctrlRequest
+  if (cmd == CMD_GET_VERSION && !params.has("ID"))
+    return 0;
+
+  CommandInput input = {(void *)&params, CommandParams::lookup};
+  CommandFault fault;
+  int length = encodeCommand(*desc, input, buf, SYSCTRL_BUF_LEN, fault);
+  if (length == 0)
+    return err.set(fault.code, fault.message);
+
+  // Kolektor između READ i DELETE - ručni DELETE bi obrisao zapis koji kolektor još nije upisao
+  if ((cmd == CMD_READ_LOG || cmd == CMD_DELETE_LOG) && logCollector.owns(buf[1]))
+    return err.set(409, "Log collector is reading this ID, retry");
+
+  return length;
+}
+/**
+ * OBRADA HTTP CGI ZAHTJEVA
+ */
+/**
+ * KOMANDA ZA LISTU KONTROLERA - ID=1-40,55,60-70 ili ID=ALL (svi prisutni u roster-u)
+ * Frame se validira jednom, upiti se pipeline-uju kroz red busa, rezultat po ID-u ide kao NDJSON.
+ */
+#define BULK_BROADCAST_MIN 2 // Broadcast tek kada zamjenjuje bar ovoliko upita
+
+static_assert(SYSCTRL_BUF_LEN <= BULK_FRAME_MAX, "BulkCommand frame too small for SYSCTRL_BUF_LEN");
+
+bool isIdList(const String &value)
+{
+  return value.indexOf(',') >= 0 || value.indexOf('-') >= 0 || value.equalsIgnoreCase("ALL");
+}
+
+// "1-40,55,60-70" -> bitmapa; broj ID-eva ili 0 za neispravnu listu
+int parseIdList(const String &value, uint32_t *ids)
+{
+  memset(ids, 0, BULK_MAP_WORDS * sizeof(uint32_t));
+  int count = 0;
+
+  if (value.equalsIgnoreCase("ALL"))
+  {
+    for (int id = 1; id <= ROSTER_MAX_ID; id++)
     {
-      userGroup = 'M';
-      buf[0] = CMD_GET_PASSWORD;
-      buf[1] = id;
-      buf[2] = userGroup;
-      length = 3;
+      if (!roster.isLive(id))
+        continue;
+      BulkCommand::mapSet(ids, id);
+      count++;
     }
-    else if (type == "SERVICE")
+    return count;
+  }
+
+  const char *p = value.c_str();
+  while (*p)
+  {
+    char *end;
+    long first = strtol(p, &end, 10);
+    if (end == p)
+      return 0;
+    long last = first;
+    p = end;
+    if (*p == '-')
     {
-      userGroup = 'S';
-      buf[0] = CMD_GET_PASSWORD;
-      buf[1] = id;
-      buf[2] = userGroup;
-      length = 3;
+      last = strtol(p + 1, &end, 10);
+      if (end == p + 1)
+        return 0;
+      p = end;
     }
-    else
+    if (first < 1 || last > BULK_MAX_ID || first > last)
+      return 0;
+
+    for (long id = first; id <= last; id++)
     {
-      sendJsonError(request, 400, "Invalid TYPE (must be GUEST, MAID, MANAGER or SERVICE)");
-      return;
+      if (BulkCommand::mapHas(ids, id))
+        continue;
+      BulkCommand::mapSet(ids, id);
+      count++;
     }
-    
-    break;
+
+    if (*p == ',')
+      p++;
+    else if (*p != '\0')
+      return 0;
   }
+  return count;
+}
+
+bool isBulkCommand(CommandType cmd)
+{
+  switch (cmd)
+  {
+  case CMD_OPEN_DOOR:    // Vrata se otvaraju pojedinačno
+  case CMD_GET_PASSWORD: // Lozinke se ne iznose listom
   case CMD_READ_LOG:
-  case CMD_DELETE_LOG:
+  case CMD_DELETE_LOG:   // Logovi idu kroz /logs/drain i LogCollector
+    return false;
+
+  default:
+    return true;
+  }
+}
+
+// Idempotentne SET komande, iste za svaki kontroler - mogu na DEF_TFBRA umjesto upita po ID-u
+bool isBroadcastCommand(CommandType cmd)
+{
+  switch (cmd)
+  {
+  case CMD_SET_ROOM_TEMP:
+  case CMD_SET_GUEST_IN_TEMP:
+  case CMD_SET_GUEST_OUT_TEMP:
+  case CMD_SET_THST_ON:
+  case CMD_SET_THST_OFF:
+  case CMD_SET_THST_HEATING:
+  case CMD_SET_THST_COOLING:
+  case CMD_SET_FWD_HEATING:
+  case CMD_SET_FWD_COOLING:
+  case CMD_SET_ENABLE_HEATING:
+  case CMD_SET_ENABLE_COOLING:
+  case CMD_SET_LANG:
+    return true;
+
+  default:
+    return false; // Lozinke, SYSID, QR kod i RESTART_CTRL su po sobi ili traže potvrdu
+  }
+}
+/**
+ * UPIT IZ ID LISTE ZAVRŠEN - poziva se iz RS485 bus taska
+ */
+void onBulkTxn(uint8_t cmd, uint8_t id, BusTransaction &txn)
+{
+  updateRoomCache((CommandType)cmd, id, txn);
+  recordBusMetrics(txn);
+
+  // Bez recover() na niz timeouta kao u onSysctrlReply - lista često sadrži ID-eve kojih nema na busu
+  if (!txn.isFollower)
+  {
+    if (txn.result == BUS_OK)
+      controllerHealth.onReply(id, txn.cls, txn.rttMs);
+    else if (txn.result == BUS_TIMEOUT)
+      controllerHealth.onTimeout(id, txn.cls);
+  }
+
+  if (txn.result == BUS_OK && cmd == CMD_GET_SYSID)
+    roster.learnSysid(id, txn.reply, txn.replyLen);
+  else if (txn.result == BUS_OK && cmd == CMD_GET_VERSION)
+    roster.learnVersion(id, txn.reply, txn.replyLen);
+}
+
+void handleBulkRequest(AsyncWebServerRequest *request, CommandType cmd)
+{
+  if (!isBulkCommand(cmd))
+  {
+    sendJsonError(request, 400, "Command not allowed on an ID list");
+    return;
+  }
+
+  uint32_t ids[BULK_MAP_WORDS];
+  int count = parseIdList(request->getParam("ID")->value(), ids);
+  if (count == 0)
+  {
+    sendJsonError(request, 400, "Invalid ID list (e.g. ID=1-40,55,60-70 or ID=ALL)");
+    return;
+  }
+
+  // Validacija i frame za prvi ID; ostali ID-evi mijenjaju samo buf[1]
+  int first = 1;
+  while (!BulkCommand::mapHas(ids, first))
+    first++;
+  char firstId[4];
+  snprintf(firstId, sizeof(firstId), "%d", first);
+  const char *const fixed[] = {"ID", firstId, NULL};
+
+  uint8_t buf[SYSCTRL_BUF_LEN] = {0};
+  CommandParams params = {request, fixed, NULL};
+  CommandError err;
+  int length = buildRs485Command(cmd, params, buf, err);
+  if (err.code != 0)
+  {
+    sendJsonError(request, err.code, err.message);
+    return;
+  }
+  if (length == 0)
+  {
+    sendJsonError(request, 400, "Command does not accept an ID list");
+    return;
+  }
+
+  if (!bulkCommand.available())
+  {
+    sendJsonError(request, 503, "All bulk command slots busy, retry");
+    return;
+  }
+
+  uint32_t broadcast[BULK_MAP_WORDS] = {0};
+  uint32_t offline[BULK_MAP_WORDS] = {0};
+  bool allowBroadcast = isBroadcastCommand(cmd) &&
+                        !(request->hasParam("BROADCAST") && request->getParam("BROADCAST")->value() == "0");
+
+  for (int seg = 0; allowBroadcast && seg < RS485_SEGMENTS; seg++)
   {
-    if (!request->hasParam("ID"))
+    // Samo kada lista pokriva sve prisutne kontrolere segmenta - broadcast ne smije dirati sobe van liste
+    int covered = 0;
+    bool all = true;
+    for (int id = 1; id <= BULK_MAX_ID && all; id++)
     {
-      sendJsonError(request, 400, "Missing ID parameter");
-      return;
+      if (segmentOf(id) != seg || !roster.isLive(id))
+        continue;
+      if (BulkCommand::mapHas(ids, id))
+        covered++;
+      else
+        all = false;
     }
-    
-    int id = request->getParam("ID")->value().toInt();
-    
-    if (id < 1 || id > 254)
+    if (!all || covered < BULK_BROADCAST_MIN)
+      continue;
+
+    uint8_t frame[SYSCTRL_BUF_LEN];
+    memcpy(frame, buf, length);
+    frame[1] = DEF_TFBRA;
+    if (!busSegments[seg]->send(BUS_CLASS_WRITE, S_CUSTOM, frame, length))
+      continue; // Red pun - pojedinačni upiti
+
+    for (int id = 1; id <= BULK_MAX_ID; id++)
     {
-      sendJsonError(request, 400, "Invalid ID (must be 1-254)");
-      return;
+      if (segmentOf(id) != seg || !BulkCommand::mapHas(ids, id))
+        continue;
+      BulkCommand::mapClear(ids, id);
+      BulkCommand::mapSet(broadcast, id);
+      roomCache.invalidateAll(id); // Broadcast nema odgovora - ni nove vrijednosti za keš
     }
-    
-    buf[0] = cmd;
-    buf[1] = id;
-    length = 2;
-    break;
   }
-  case CMD_GET_ROOM_TEMP:
-  case CMD_GET_GUEST_IN_TEMP:
-  case CMD_GET_GUEST_OUT_TEMP:
-  case CMD_SET_THST_OFF:
-  case CMD_SET_THST_ON:
-  case CMD_SET_THST_HEATING:
-  case CMD_SET_THST_COOLING:
-  case CMD_GET_FAN_DIFFERENCE:
-  case CMD_GET_FAN_BAND:
+
+  // Kontroler ne odgovara (circuit breaker otvoren) - linija bez upita
+  for (int id = 1; id <= BULK_MAX_ID; id++)
+  {
+    if (!BulkCommand::mapHas(ids, id) || controllerHealth.allowRequest(id))
+      continue;
+    BulkCommand::mapClear(ids, id);
+    BulkCommand::mapSet(offline, id);
+  }
+
+  BulkJob *job = bulkCommand.start(buf, length, busClassForCommand(cmd), isSharedReadCommand(cmd),
+                                   ids, broadcast, offline);
+  if (job == NULL)
+  {
+    sendJsonError(request, 503, "All bulk command slots busy, retry");
+    return;
+  }
+
+  LOG_INFO("[Bulk] CMD 0x%02X for %d controllers\n", buf[0], count);
+
+  AsyncWebServerResponse *response = request->beginChunkedResponse("application/x-ndjson",
+    [job](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+      return bulkCommand.fill(job, buffer, maxLen);
+    });
+  request->onDisconnect([job]() { bulkCommand.detach(job); });
+  request->send(response);
+}
+
+/**
+ * GET_STATUS SNAPSHOT
+ * "data" se serijalizuje unaprijed i gradi ponovo samo kada se promijeni StatusState: varijable i pinovi
+ * se porede po zahtjevu, a statusEpoch broji promjene koje se čitaju iz NVS-a ili su stringovi. Sunce i
+ * DST se računaju jednom po satu, NVS se čita samo nakon promjene statusEpoch. "rssi" i "utc" su živi i
+ * umeću se pri slanju, pa je ETag slab (W/). FIELDS=thermostat,light šalje samo te sekcije, a ETag
+ * projekcije se mijenja samo kada se promijeni neka od njih.
+ * FIELDS ne smanjuje izgradnju: snapshot je zajednički za sve projekcije, pa promjena stanja uvijek
+ * serijalizuje sve sekcije, a projekcija samo bira njihove bajtove. Preskaču se jedino RSSI i UTC.
+ */
+#define STATUS_SNAPSHOT_MAX 1024
+
+enum StatusSection : uint8_t
+{
+  STATUS_WIFI,
+  STATUS_TIME,
+  STATUS_SUN,
+  STATUS_LIGHT,
+  STATUS_PING_WATCHDOG,
+  STATUS_THERMOSTAT,
+  STATUS_SOS,
+  STATUS_IR,
+  STATUS_SECTION_COUNT
+};
+
+#define STATUS_ALL_SECTIONS ((1 << STATUS_SECTION_COUNT) - 1)
+
+static const char *const statusSectionNames[STATUS_SECTION_COUNT] = {
+    "wifi", "time", "sun", "light", "ping_watchdog", "thermostat", "sos", "ir"};
+
+struct StatusState
+{
+  uint32_t hour;             // Sunce i DST
+  uint32_t epoch;
+  uint32_t ip;
+  int32_t port;
+  float temperature;
+  float setpoint;
+  float threshold;
+  float emaAlpha;
+  float fluid;
+  uint8_t pins;              // Bit 0 relej, 1 ventil, 2-4 ventilator L/M/H
+  uint8_t mode;
+  bool overrideActive;
+  bool pingWatchdog;
+  bool sos;
+  bool fluidAvailable;
+};
+
+struct StatusLayout
+{
+  uint16_t len;
+  uint16_t rssiAt;                           // Pozicija vrijednosti "rssi"
+  uint16_t utcAt;                            // Pozicija vrijednosti "utc"
+  uint16_t from[STATUS_SECTION_COUNT];       // "ključ":vrijednost sekcije, bez zareza ispred
+  uint16_t to[STATUS_SECTION_COUNT];
+};
+
+struct StatusSnapshot
+{
+  StatusState state;                         // Stanje iz kojeg je body sastavljen
+  uint32_t bootId;                           // ETag iz prethodnog boot-a ne smije dobiti 304
+  uint32_t version;                          // Broj izgradnji
+  uint32_t sectionVersion[STATUS_SECTION_COUNT]; // Izgradnja u kojoj se sekcija zadnji put promijenila
+  bool valid;
+
+  // Spori ulazi iz prethodne izgradnje
+  bool dstActive;
+  char sunrise[6];
+  char sunset[6];
+  unsigned long sosUnixTime;
+  int irProtocol;
+
+  uint8_t current;                           // Aktivni body; drugi prima sljedeću izgradnju
+  StatusLayout layout;
+  char body[2][STATUS_SNAPSHOT_MAX];
+};
+
+StatusSnapshot statusSnapshot;
+
+void readStatusState(StatusState &st)
+{
+  memset(&st, 0, sizeof(st)); // Poređenje sa memcmp - i padding mora biti nula
+  st.hour = time(NULL) / 3600;
+  st.epoch = statusEpoch;
+  st.ip = (uint32_t)WiFi.localIP();
+  st.port = _port;
+  st.temperature = emaTemperature;
+  st.setpoint = th_setpoint;
+  st.threshold = th_treshold;
+  st.emaAlpha = emaAlpha;
+  st.fluid = tempSensor2Available ? fluid : -999;
+  st.pins = (digitalRead(LIGHT_PIN) ? 0x01 : 0) | (digitalRead(VALVE) ? 0x02 : 0) |
+            (digitalRead(FAN_L) ? 0x04 : 0) | (digitalRead(FAN_M) ? 0x08 : 0) | (digitalRead(FAN_H) ? 0x10 : 0);
+  st.mode = th_mode;
+  st.overrideActive = overrideActive;
+  st.pingWatchdog = pingWatchdogEnabled;
+  st.sos = sosStatus;
+  st.fluidAvailable = tempSensor2Available;
+}
+
+void endStatusSection(StatusLayout &l, StatusSection sec, const JsonBufferSink &sink, uint16_t mark)
+{
+  l.from[sec] = (sink.c_str()[mark] == ',') ? mark + 1 : mark;
+  l.to[sec] = sink.length();
+}
+
+void refreshStatusInputs(const StatusState &st)
+{
+  StatusSnapshot &s = statusSnapshot;
+
+  // Sunce i DST se mijenjaju najviše jednom po satu
+  if (!s.valid || s.state.hour != st.hour)
   {
-    if (!request->hasParam("ID"))
+    time_t now;
+    time(&now);
+    struct tm utc_tm = *gmtime(&now);
+
+    s.dstActive = isDST(utc_tm.tm_year + 1900, utc_tm.tm_mon + 1, utc_tm.tm_mday, utc_tm.tm_hour);
+    int tzOffsetMinutes = s.dstActive ? 120 : 60;
+
+    // Sun position
+    sun.setPosition(LATITUDE, LONGITUDE, 0);
+    sun.setCurrentDate(utc_tm.tm_year + 1900, utc_tm.tm_mon + 1, utc_tm.tm_mday);
+
+    strcpy(s.sunrise, "----");
+    strcpy(s.sunset, "----");
+
+    float sunriseUTC = sun.calcSunrise();
+    float sunsetUTC = sun.calcSunset();
+
+    if (!isnan(sunriseUTC) && !isnan(sunsetUTC))
     {
-      sendJsonError(request, 400, "Missing ID");
-      return;
+      int sunriseMin = ((int)sunriseUTC + tzOffsetMinutes + 1440) % 1440;
+      int sunsetMin = ((int)sunsetUTC + tzOffsetMinutes + 1440) % 1440;
+
+      sprintf(s.sunrise, "%02d:%02d", sunriseMin / 60, sunriseMin % 60);
+      sprintf(s.sunset, "%02d:%02d", sunsetMin / 60, sunsetMin % 60);
     }
-    
-    int id = request->getParam("ID")->value().toInt();
-    
-    // ✅ Validacija 1-bajtne adrese
-    if (id < 1 || id > 254)
+  }
+
+  // NVS samo nakon statusEpoch promjene (SOS događaj, IR protokol)
+  if (!s.valid || s.state.epoch != st.epoch)
+  {
+    s.sosUnixTime = 0;
+    if (st.sos)
+    {
+      preferences.begin("sos_event", true);
+      s.sosUnixTime = preferences.getULong("timestamp", 0);
+      preferences.end();
+    }
+
+    preferences.begin("ir_settings", true);
+    s.irProtocol = preferences.getInt("protocol", 0);
+    preferences.end();
+  }
+}
+
+bool buildStatusSnapshot(const StatusState &st)
+{
+  StatusSnapshot &s = statusSnapshot;
+  refreshStatusInputs(st);
+
+  // Formatiraj ON/OFF vrijeme iz stringa "HHMM"
+  char onStr[6] = "----";
+  char offStr[6] = "----";
+  if (timerOnTime.length() == 4)
+    sprintf(onStr, "%02d:%02d", timerOnTime.substring(0, 2).toInt(), timerOnTime.substring(2, 4).toInt());
+  if (timerOffTime.length() == 4)
+    sprintf(offStr, "%02d:%02d", timerOffTime.substring(0, 2).toInt(), timerOffTime.substring(2, 4).toInt());
+
+  const char *fanState = "OFF";
+  if (st.pins & 0x10) fanState = "HIGH";
+  else if (st.pins & 0x08) fanState = "MEDIUM";
+  else if (st.pins & 0x04) fanState = "LOW";
+
+  uint8_t next = s.current ^ 1;
+  StatusLayout l;
+  JsonBufferSink sink(s.body[next], STATUS_SNAPSHOT_MAX);
+  JsonWriter<JsonBufferSink> json(sink);
+  uint16_t mark;
+  json.beginObject();
+
+  // WiFi info
+  mark = sink.length();
+  json.beginObject("wifi");
+  json.field("ssid", WiFi.SSID().c_str());
+  json.field("password", WiFi.psk().c_str());
+  json.field("mdns", _mdns);
+  json.field("ip", WiFi.localIP().toString().c_str());
+  json.field("port", _port);
+  // Ključ bez vrijednosti - sendStatusSnapshot umeće trenutni RSSI
+  json.key("rssi");
+  l.rssiAt = sink.length();
+  json.raw("", 0);
+  json.endObject();
+  endStatusSection(l, STATUS_WIFI, sink, mark);
+
+  // Time info
+  mark = sink.length();
+  json.beginObject("time");
+  json.key("utc");
+  l.utcAt = sink.length();
+  json.raw("", 0);
+  json.field("timezone_offset_minutes", s.dstActive ? 120 : 60);
+  json.field("dst_active", s.dstActive);
+  json.endObject();
+  endStatusSection(l, STATUS_TIME, sink, mark);
+
+  // Sun info
+  mark = sink.length();
+  json.beginObject("sun");
+  json.field("sunrise", s.sunrise);
+  json.field("sunset", s.sunset);
+  json.endObject();
+  endStatusSection(l, STATUS_SUN, sink, mark);
+
+  // Light control
+  mark = sink.length();
+  json.beginObject("light");
+  json.field("relay_state", (st.pins & 0x01) ? "ON" : "OFF");
+  json.field("control_mode", st.overrideActive ? "MANUAL" : "AUTO");
+  json.field("timer_on_type", timerOnType.c_str());
+  json.field("timer_off_type", timerOffType.c_str());
+  json.field("on_time", onStr);
+  json.field("off_time", offStr);
+  json.endObject();
+  endStatusSection(l, STATUS_LIGHT, sink, mark);
+
+  // Ping watchdog
+  mark = sink.length();
+  json.field("ping_watchdog", st.pingWatchdog);
+  endStatusSection(l, STATUS_PING_WATCHDOG, sink, mark);
+
+  // Thermostat
+  mark = sink.length();
+  json.beginObject("thermostat");
+  json.field("temperature", st.temperature);
+  json.field("setpoint", st.setpoint);
+  json.field("threshold", st.threshold);
+  json.field("mode", st.mode == TH_HEATING ? "HEATING" : st.mode == TH_COOLING ? "COOLING" : "OFF");
+  json.field("valve", (st.pins & 0x02) ? "ON" : "OFF");
+  json.field("fan", fanState);
+  json.field("ema_alpha", st.emaAlpha);
+  json.field("fluid_temp", st.fluid);
+  json.field("fluid_available", st.fluidAvailable);
+  json.endObject();
+  endStatusSection(l, STATUS_THERMOSTAT, sink, mark);
+
+  // SOS Status
+  mark = sink.length();
+  json.beginObject("sos");
+  if (st.sos) {
+    struct tm sosTime = *localtime((time_t*)&s.sosUnixTime);
+    char sosTimeStr[20];
+    snprintf(sosTimeStr, sizeof(sosTimeStr), "%04d-%02d-%02d %02d:%02d:%02d",
+             sosTime.tm_year + 1900, sosTime.tm_mon + 1, sosTime.tm_mday,
+             sosTime.tm_hour, sosTime.tm_min, sosTime.tm_sec);
+
+    json.field("active", true);
+    json.field("timestamp", sosTimeStr);
+  } else {
+    json.field("active", false);
+  }
+  json.endObject();
+  endStatusSection(l, STATUS_SOS, sink, mark);
+
+  // IR Remote Data
+  mark = sink.length();
+  json.beginObject("ir");
+  json.field("protocol_id", s.irProtocol);
+  json.field("protocol_name", typeToString((decode_type_t)s.irProtocol).c_str());
+  json.endObject();
+  endStatusSection(l, STATUS_IR, sink, mark);
+
+  json.endObject();
+
+  if (sink.overflow())
+  {
+    LOG_ERROR("[Status] Snapshot exceeds %d bytes\n", STATUS_SNAPSHOT_MAX);
+    s.valid = false;
+    return false;
+  }
+  l.len = sink.length();
+
+  // Verzija sekcije se mijenja samo kada se promijene njeni bajtovi (živi rssi/utc nisu u body)
+  s.version++;
+  for (int i = 0; i < STATUS_SECTION_COUNT; i++)
+  {
+    uint16_t n = l.to[i] - l.from[i];
+    bool same = s.valid && n == s.layout.to[i] - s.layout.from[i] &&
+                memcmp(s.body[next] + l.from[i], s.body[s.current] + s.layout.from[i], n) == 0;
+    if (!same)
+      s.sectionVersion[i] = s.version;
+  }
+
+  s.layout = l;
+  s.current = next;
+  s.state = st;
+  s.valid = true;
+  return true;
+}
+
+// Lista imena sekcija odvojenih zarezom u bit masku; 0 = prazna lista ili nepoznato ime
+uint8_t parseStatusFields(const String &list)
+{
+  uint8_t mask = 0;
+  int start = 0;
+
+  while (start <= (int)list.length())
+  {
+    int comma = list.indexOf(',', start);
+    if (comma < 0)
+      comma = list.length();
+
+    String name = list.substring(start, comma);
+    int i = 0;
+    while (i < STATUS_SECTION_COUNT && name != statusSectionNames[i])
+      i++;
+    if (i == STATUS_SECTION_COUNT)
+      return 0;
+
+    mask |= (1 << i);
+    start = comma + 1;
+  }
+  return mask;
+}
+
+// Dio body-a sa živim vrijednostima na zapamćenim pozicijama; WiFi.RSSI() samo ako je u opsegu
+void writeStatusRange(AsyncResponseStream *out, uint16_t from, uint16_t to, const char *utc)
+{
+  const StatusLayout &l = statusSnapshot.layout;
+  const uint8_t *body = (const uint8_t *)statusSnapshot.body[statusSnapshot.current];
+  uint16_t pos = from;
+
+  if (l.rssiAt >= from && l.rssiAt < to)
+  {
+    out->write(body + pos, l.rssiAt - pos);
+    out->printf("%d", WiFi.RSSI());
+    pos = l.rssiAt;
+  }
+  if (l.utcAt >= from && l.utcAt < to)
+  {
+    out->write(body + pos, l.utcAt - pos);
+    out->printf("\"%s\"", utc);
+    pos = l.utcAt;
+  }
+  out->write(body + pos, to - pos);
+}
+
+void sendStatusSnapshot(AsyncWebServerRequest *request)
+{
+  uint8_t mask = STATUS_ALL_SECTIONS;
+  if (request->hasParam("FIELDS"))
+  {
+    mask = parseStatusFields(request->getParam("FIELDS")->value());
+    if (mask == 0)
     {
-      sendJsonError(request, 400, "Invalid ID (must be 1-254)");
+      sendJsonError(request, 400, "Invalid FIELDS (wifi,time,sun,light,ping_watchdog,thermostat,sos,ir)");
       return;
     }
-    
-    buf[0] = cmd;
-    buf[1] = id;
-    length = 2;
-    break;
   }
-  case CMD_SET_PIN:
+
+  StatusState st;
+  readStatusState(st);
+
+  if (statusSnapshot.bootId == 0)
+    statusSnapshot.bootId = esp_random() | 1;
+
+  if (!statusSnapshot.valid || memcmp(&st, &statusSnapshot.state, sizeof(st)) != 0)
   {
-    if (!request->hasParam("ID") || !request->hasParam("PIN") || !request->hasParam("VALUE"))
+    if (!buildStatusSnapshot(st))
     {
-      sendJsonError(request, 400, "Missing ID or PIN or VALUE");
+      sendJsonError(request, 500, "Status snapshot too large");
       return;
     }
+  }
+
+  uint32_t version = 0;
+  for (int i = 0; i < STATUS_SECTION_COUNT; i++)
+  {
+    if ((mask & (1 << i)) && statusSnapshot.sectionVersion[i] > version)
+      version = statusSnapshot.sectionVersion[i];
+  }
+
+  // Projekcija ima svoj tag - isti If-None-Match sa drugim FIELDS ne smije dobiti 304
+  char tag[32];
+  char etag[36];
+  if (mask == STATUS_ALL_SECTIONS)
+    snprintf(tag, sizeof(tag), "\"%08x-%u\"", (unsigned)statusSnapshot.bootId, (unsigned)version);
+  else
+    snprintf(tag, sizeof(tag), "\"%08x-%u-%02x\"", (unsigned)statusSnapshot.bootId, (unsigned)version, mask);
+  snprintf(etag, sizeof(etag), "W/%s", tag);
+
+  // If-None-Match može nositi listu tagova ili tag bez W/ - slabo poređenje
+  if (request->hasHeader("If-None-Match") &&
+      strstr(request->getHeader("If-None-Match")->value().c_str(), tag) != NULL)
+  {
+    AsyncWebServerResponse *notModified = request->beginResponse(304);
+    notModified->addHeader("ETag", etag);
+    notModified->addHeader("Cache-Control", "no-cache");
+    request->send(notModified);
+    return;
+  }
+
+  char utcTimeStr[30] = "";
+  if (mask & (1 << STATUS_TIME))
+  {
+    time_t now;
+    time(&now);
+    struct tm utc_tm = *gmtime(&now);
+    snprintf(utcTimeStr, sizeof(utcTimeStr), "%04d-%02d-%02d %02d:%02d:%02d",
+             utc_tm.tm_year + 1900, utc_tm.tm_mon + 1, utc_tm.tm_mday,
+             utc_tm.tm_hour, utc_tm.tm_min, utc_tm.tm_sec);
+  }
 
-    int id = request->getParam("ID")->value().toInt();
-    int pin = request->getParam("PIN")->value().toInt();
-    int value = request->getParam("VALUE")->value().toInt();
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  response->addHeader("ETag", etag);
+  response->addHeader("Cache-Control", "no-cache");
+  response->print("{\"status\":\"success\",\"message\":\"System status retrieved\",\"data\":{");
+  bool first = true;
+  for (int i = 0; i < STATUS_SECTION_COUNT; i++)
+  {
+    if (!(mask & (1 << i)))
+      continue;
+    if (!first)
+      response->print(",");
+    writeStatusRange(response, statusSnapshot.layout.from[i], statusSnapshot.layout.to[i], utcTimeStr);
+    first = false;
+  }
+  response->print("}}");
+  request->send(response);
+}
 
-    // ✅ Validacija ID-a
-    if (id < 1 || id > 254)
-    {
-      sendJsonError(request, 400, "Invalid ID (must be 1-254)");
-      return;
-    }
+void handleSysctrlRequest(AsyncWebServerRequest *request)
+{
+  if (otaUpdateInProgress)
+  {
+    sendJsonError(request, 503, "OTA update in progress");
+    return;
+  }
 
-    // ✅ Validacija PIN-a
-    if (pin < 1 || pin > 6)
-    {
-      sendJsonError(request, 400, "Invalid PIN (must be 1-6)");
-      return;
-    }
+  if (!request->hasParam("CMD"))
+  {
+    sendJsonError(request, 400, "Missing CMD parameter");
+    return;
+  }
 
-    // ✅ Validacija VALUE-a
-    if (value != 0 && value != 1)
-    {
-      sendJsonError(request, 400, "Invalid VALUE (must be 0 or 1)");
-      return;
-    }
+  String cmdStr = request->getParam("CMD")->value();
+  CommandType cmd = stringToCommand(cmdStr);
 
-    buf[0] = cmd;
-    buf[1] = id;
-    buf[2] = 254;
-    buf[3] = pin;
-    buf[4] = value;
-    length = 5;
-    break;
-  }
-  case CMD_OPEN_DOOR:
+  if (request->hasParam("ID") && isIdList(request->getParam("ID")->value()))
   {
-    // Jednostavna "one-shot" komanda za otvaranje vrata
-    // Prima samo ID (broj sobe), automatski šalje PORT=C, PIN=8, VALUE=1
-    if (!request->hasParam("ID"))
-    {
-      sendJsonError(request, 400, "Missing ID");
-      return;
-    }
-
-    int id = request->getParam("ID")->value().toInt();
+    handleBulkRequest(request, cmd);
+    return;
+  }
 
-    // ✅ Validacija 1-bajtne adrese
-    if (id < 1 || id > 254)
-    {
-      sendJsonError(request, 400, "Invalid ID (must be 1-254)");
-      return;
-    }
+  uint8_t buf[SYSCTRL_BUF_LEN] = {0};
+  int length = 0;
+  bool isLocalCommand = false;  // Flag: true za komande koje se obrađuju lokalno (bez RS485)
+  led_state = LED_FAST;
 
-    // Komanda za otvaranje vrata (bez dodatnih parametara)
-    buf[0] = cmd;       // 0xDB (OPEN_DOOR)
-    buf[1] = id;        // 1-bajtna adresa (1-254)
-    length = 2;         // Samo CMD i ID
-    break;
+  // Komande za kontrolere - validacija i frame u buildRs485Command, ostale se obrađuju lokalno
+  CommandParams params = {request, NULL, NULL};
+  CommandError err;
+  length = buildRs485Command(cmd, params, buf, err);
+  if (err.code != 0)
+  {
+    sendJsonError(request, err.code, err.message);
+    return;
   }
-  case CMD_GET_PINS:
+
+  switch (cmd)
   {
-    if (!request->hasParam("ID"))
-    {
-      sendJsonError(request, 400, "Missing ID");
-      return;
-    }
-    int id = request->getParam("ID")->value().toInt();
-    // ✅ Validacija ID-a
-    if (id < 1 || id > 254)
-    {
-      sendJsonError(request, 400, "Invalid ID (must be 1-254)");
-      return;
-    }
-    buf[0] = 0xB1;
-    buf[1] = id;
-    buf[2] = 0xB2;
-    length = 3;
+
+  case CMD_RESTART:
+  {
+    LOG_INFO_LN("Device restart...");
+    isLocalCommand = true;  // ✅ Lokalna komanda
+    sendJsonSuccess(request, "Restart in 3s");
+    delay(3000);
+    ESP.restart();
     break;
   }
-  case CMD_SET_LANG:
+  case CMD_GET_SSID_PSWRD:
   {
-    if (!request->hasParam("ID") || !request->hasParam("VALUE"))
-    {
-      sendJsonError(request, 400, "Missing ID or VALUE");
-      return;
-    }
-    int id = request->getParam("ID")->value().toInt();
-    int lang = request->getParam("VALUE")->value().toInt();
-
-    if (id < 1 || id > 254) {
-      sendJsonError(request, 400, "Invalid ID");
-      return;
-    }
+    preferences.begin("wifi", false);
+    preferences.getString("ssid", _ssid, sizeof(_ssid));
+    preferences.getString("password", _pass, sizeof(_pass));
+    preferences.end();
 
-    if (lang < 0 || lang > 2) {
-      sendJsonError(request, 400, "Invalid VALUE (0=SRB, 1=ENG, 2=GER)");
-      return;
-    }
+    JsonDocument data;
+    data["ssid"] = String(_ssid);
+    data["password"] = strlen(_pass) == 0 ? "" : String(_pass);
+    data["open_network"] = strlen(_pass) == 0;
     
-    buf[0] = cmd;
-    buf[1] = id;
-    buf[2] = (uint8_t)lang;
-    length = 3;
-    break;
+    sendJsonSuccess(request, "WiFi credentials retrieved", &data);
+    return;
   }
-  case CMD_QR_CODE_SET:
+  case CMD_SET_SSID_PSWRD:
   {
-    if (!request->hasParam("ID") || !request->hasParam("QR_CODE"))
+    if (!request->hasParam("SSID"))
     {
-      sendJsonError(request, 400, "Missing ID or QR_CODE");
+      sendJsonError(request, 400, "Missing SSID parameter");
       return;
     }
-    int id = request->getParam("ID")->value().toInt();
-    String qr = request->getParam("QR_CODE")->value();
+    strlcpy(_ssid, request->getParam("SSID")->value().c_str(), sizeof(_ssid));
+    strlcpy(_pass, request->hasParam("PSWRD") ? request->getParam("PSWRD")->value().c_str() : "", sizeof(_pass));
 
-    if (id < 1 || id > 254) {
-      sendJsonError(request, 400, "Invalid ID");
-      return;
-    }
-    if (qr.length() > 128) {
-      sendJsonError(request, 400, "QR Code too long (max 128)");
-      return;
-    }
+    preferences.begin("wifi", false);
+    preferences.putString("ssid", _ssid);
+    preferences.putString("password", _pass);
+    preferences.end();
+    
+    JsonDocument data;
+    data["ssid"] = String(_ssid);
+    sendJsonSuccess(request, "WiFi credentials saved", &data);
+    return;
+  }
+  case CMD_GET_MDNS_NAME:
+  {
+    isLocalCommand = true;  // ✅ Lokalna komanda
 
-    buf[0] = cmd;
-    buf[1] = id;
-    memcpy(buf + 2, qr.c_str(), qr.length());
-    buf[2 + qr.length()] = 0; // Null terminate just in case, though length handles it
-    length = 2 + qr.length(); // CMD + ID + String
-    break;
+    preferences.begin("_mdns", false);
+    preferences.getString("mdns", _mdns, sizeof(_mdns));
+    preferences.end();
+    
+    JsonDocument data;
+    data["mdns"] = String(_mdns);
+    sendJsonSuccess(request, "mDNS name retrieved", &data);
+    return;
   }
-  case CMD_QR_CODE_GET:
-  case CMD_GET_ROOM_STATUS:
+  case CMD_SET_MDNS_NAME:
   {
-    if (!request->hasParam("ID"))
+    if (!request->hasParam("MDNS"))
     {
-      sendJsonError(request, 400, "Missing ID");
-      return;
-    }
-    int id = request->getParam("ID")->value().toInt();
-    if (id < 1 || id > 254) {
-      sendJsonError(request, 400, "Invalid ID");
+      sendJsonError(request, 400, "Missing MDNS parameter");
       return;
     }
-    buf[0] = cmd;
-    buf[1] = id;
-    length = 2;
-    break;
+    strlcpy(_mdns, request->getParam("MDNS")->value().c_str(), sizeof(_mdns));
+    preferences.begin("_mdns", false);
+    preferences.putString("mdns", _mdns);
+    preferences.end();
+    statusEpoch++;
+    
+    JsonDocument data;
+    data["mdns"] = String(_mdns);
+    sendJsonSuccess(request, "mDNS name saved", &data);
+    return;
   }
-  case CMD_GET_SYSID:
+  case CMD_GET_IP_ADDRESS:
   {
-    if (!request->hasParam("ID"))
-    {
-      sendJsonError(request, 400, "Missing ID");
-      return;
-    }
-    int id = request->getParam("ID")->value().toInt();
-    if (id < 1 || id > 254) {
-      sendJsonError(request, 400, "Invalid ID");
-      return;
-    }
-    buf[0] = cmd;
-    buf[1] = id;
-    length = 2;
-    break;
+    JsonDocument data;
+    data["ip"] = WiFi.localIP().toString();
+    data["subnet"] = WiFi.subnetMask().toString();
+    data["gateway"] = WiFi.gatewayIP().toString();
+    sendJsonSuccess(request, "IP address retrieved", &data);
+    return;
   }
-  case CMD_SET_SYSID:
+  case CMD_GET_TCPIP_PORT:
+  {
+    preferences.begin("_port", false);
+    _port = preferences.getInt("port", 0);
+    preferences.end();
+    
+    JsonDocument data;
+    data["port"] = _port;
+    sendJsonSuccess(request, "TCP/IP port retrieved", &data);
+    return;
+  }
+  case CMD_SET_TCPIP_PORT:
   {
-    if (!request->hasParam("ID") || !request->hasParam("VALUE"))
+    if (!request->hasParam("PORT"))
     {
-      sendJsonError(request, 400, "Missing ID or VALUE");
-      return;
-    }
-    int id = request->getParam("ID")->value().toInt();
-    int sysid_val = request->getParam("VALUE")->value().toInt(); // Očekujemo decimalnu vrijednost (npr. 43981 za 0xABCD)
-
-    if (id < 1 || id > 254) {
-      sendJsonError(request, 400, "Invalid ID");
+      sendJsonError(request, 400, "Missing PORT parameter");
       return;
     }
+    _port = request->getParam("PORT")->value().toInt();
+    preferences.begin("_port", false);
+    preferences.putInt("port", _port);
+    preferences.end();
     
-    // Rastavljanje 16-bitnog SYSID na 2 bajta
-    // Napomena: common.h koristi format [CMD][ADDR][VAL_MSB][VAL_LSB] za neke komande, 
-    // ali provjeri rs485_ulaz.c implementaciju:
-    // RS_SetSysID: sysid[0] = msg->data[2]; sysid[1] = msg->data[3];
-    
-    buf[0] = cmd;
-    buf[1] = id;
-    buf[2] = (uint8_t)((sysid_val >> 8) & 0xFF); // MSB
-    buf[3] = (uint8_t)(sysid_val & 0xFF);        // LSB
-    length = 4;
-    break;
+    JsonDocument data;
+    data["port"] = _port;
+    sendJsonSuccess(request, "TCP/IP port saved", &data);
+    return;
   }
   case CMD_GET_TIMER:
   {
@@ -2141,6 +3484,8 @@ void handleSysctrlRequest(AsyncWebServerRequest *request)
 
     struct timeval now = {.tv_sec = t};
     settimeofday(&now, nullptr);
+    for (int s = 0; s < RS485_SEGMENTS; s++)
+      rtcSync[s].requestBroadcast("manual");
 
     JsonDocument responseDoc;
     responseDoc["date"] = date;
@@ -2180,183 +3525,40 @@ void handleSysctrlRequest(AsyncWebServerRequest *request)
     break;
   }
   case CMD_PINGWDG_OFF:
-  {
-    pingWatchdogEnabled = false;
-    preferences.begin("_pingwdg", false); // false = read/write
-    preferences.putBool("pingwdg", false);
-    preferences.end();
-    
-    JsonDocument data;
-    data["enabled"] = false;
-    sendJsonSuccess(request, "Ping watchdog disabled", &data);
-    break;
-  }
-  case CMD_GET_VERSION:
-  {
-    // Ako nema ID parametar -> ESP32 firmware info
-    if (!request->hasParam("ID"))
-    {
-      char versionStr[32];
-      sprintf(versionStr, "%d.%d.%d", VERSION_MAJOR, VERSION_MINOR, VERSION_PATCH);
-      
-      JsonDocument data;
-      data["device_type"] = "ESP32";
-      data["firmware_version"] = String(versionStr);
-      data["build_number"] = VERSION_PATCH;
-      data["build_date"] = BUILD_DATE;
-      sendJsonSuccess(request, "ESP32 firmware version retrieved", &data);
-      return;
-    }
-    
-    // Ako ima ID parametar -> šalji GET_VERSION na STM32
-    int id = request->getParam("ID")->value().toInt();
-    
-    if (id < 1 || id > 254)
-    {
-      sendJsonError(request, 400, "Invalid ID (must be 1-254)");
-      return;
-    }
-    
-    buf[0] = CMD_GET_VERSION;
-    buf[1] = id;
-    length = 2;
-    break;
-  }
-  case CMD_GET_STATUS:
-  {
-    // Reset watchdog timer - dobili smo GET_STATUS komandu
-    resetGetStatusWatchdog();
-    
-    isLocalCommand = true;  // ✅ Lokalna komanda, bez RS485
-    
-    time_t now;
-    time(&now);
-    struct tm utc_tm = *gmtime(&now);
-
-    bool dstActive = isDST(utc_tm.tm_year + 1900, utc_tm.tm_mon + 1, utc_tm.tm_mday, utc_tm.tm_hour);
-    int tzOffsetMinutes = dstActive ? 120 : 60;
-
-    // Sun position
-    sun.setPosition(LATITUDE, LONGITUDE, 0);
-    sun.setCurrentDate(utc_tm.tm_year + 1900, utc_tm.tm_mon + 1, utc_tm.tm_mday);
-
-    char sunriseStr[6] = "----";
-    char sunsetStr[6] = "----";
-
-    float sunriseUTC = sun.calcSunrise();
-    float sunsetUTC = sun.calcSunset();
-
-    if (!isnan(sunriseUTC) && !isnan(sunsetUTC))
-    {
-      int sunriseMin = ((int)sunriseUTC + tzOffsetMinutes + 1440) % 1440;
-      int sunsetMin = ((int)sunsetUTC + tzOffsetMinutes + 1440) % 1440;
-
-      sprintf(sunriseStr, "%02d:%02d", sunriseMin / 60, sunriseMin % 60);
-      sprintf(sunsetStr, "%02d:%02d", sunsetMin / 60, sunsetMin % 60);
-    }
-
-    // Formatiraj ON/OFF vrijeme iz stringa "HHMM"
-    char onStr[6] = "----";
-    char offStr[6] = "----";
-    if (timerOnTime.length() == 4)
-      sprintf(onStr, "%02d:%02d", timerOnTime.substring(0, 2).toInt(), timerOnTime.substring(2, 4).toInt());
-    if (timerOffTime.length() == 4)
-      sprintf(offStr, "%02d:%02d", timerOffTime.substring(0, 2).toInt(), timerOffTime.substring(2, 4).toInt());
-
-    // Wi-Fi info
-    String ipStr = WiFi.localIP().toString();
-    String ssidStr = WiFi.SSID();
-    String passStr = WiFi.psk();
-
-    // Relay
-    bool relayState = digitalRead(LIGHT_PIN);
-
-    // Format UTC time kao string
-    char utcTimeStr[30];
-    snprintf(utcTimeStr, sizeof(utcTimeStr), "%04d-%02d-%02d %02d:%02d:%02d",
-             utc_tm.tm_year + 1900, utc_tm.tm_mon + 1, utc_tm.tm_mday,
-             utc_tm.tm_hour, utc_tm.tm_min, utc_tm.tm_sec);
-
-    // Kreiraj JSON response
-    JsonDocument doc;
-    
-    // WiFi info
-    doc["wifi"]["ssid"] = ssidStr;
-    doc["wifi"]["password"] = String(passStr);
-    doc["wifi"]["mdns"] = String(_mdns);
-    doc["wifi"]["ip"] = ipStr;
-    doc["wifi"]["port"] = _port;
-    doc["wifi"]["rssi"] = WiFi.RSSI();
-    // Time info
-    doc["time"]["utc"] = String(utcTimeStr);
-    doc["time"]["timezone_offset_minutes"] = tzOffsetMinutes;
-    doc["time"]["dst_active"] = dstActive;
-    
-    // Sun info
-    doc["sun"]["sunrise"] = String(sunriseStr);
-    doc["sun"]["sunset"] = String(sunsetStr);
-    
-    // Light control
-    doc["light"]["relay_state"] = relayState ? "ON" : "OFF";
-    doc["light"]["control_mode"] = overrideActive ? "MANUAL" : "AUTO";
-    doc["light"]["timer_on_type"] = timerOnType;
-    doc["light"]["timer_off_type"] = timerOffType;
-    doc["light"]["on_time"] = String(onStr);
-    doc["light"]["off_time"] = String(offStr);
-    
-    // Ping watchdog
-    doc["ping_watchdog"] = pingWatchdogEnabled;
-    
-    // Thermostat
-    doc["thermostat"]["temperature"] = emaTemperature;
-    doc["thermostat"]["setpoint"] = th_setpoint;
-    doc["thermostat"]["threshold"] = th_treshold;
-    doc["thermostat"]["mode"] = th_mode == TH_HEATING ? "HEATING" : th_mode == TH_COOLING ? "COOLING" : "OFF";
-    doc["thermostat"]["valve"] = digitalRead(VALVE) ? "ON" : "OFF";
-    
-    String fanState = "OFF";
-    if (digitalRead(FAN_H)) fanState = "HIGH";
-    else if (digitalRead(FAN_M)) fanState = "MEDIUM";
-    else if (digitalRead(FAN_L)) fanState = "LOW";
-    doc["thermostat"]["fan"] = fanState;
-    doc["thermostat"]["ema_alpha"] = emaAlpha;
-    doc["thermostat"]["fluid_temp"] = tempSensor2Available ? fluid : -999;
-    doc["thermostat"]["fluid_available"] = tempSensor2Available;
-    
-    // SOS Status
-    if (sosStatus) {
-      preferences.begin("sos_event", true);
-      unsigned long sosUnixTime = preferences.getULong("timestamp", 0);
-      preferences.end();
-      
-      struct tm sosTime = *localtime((time_t*)&sosUnixTime);
-      char sosTimeStr[20];
-      snprintf(sosTimeStr, sizeof(sosTimeStr), "%04d-%02d-%02d %02d:%02d:%02d",
-               sosTime.tm_year + 1900, sosTime.tm_mon + 1, sosTime.tm_mday,
-               sosTime.tm_hour, sosTime.tm_min, sosTime.tm_sec);
-      
-      doc["sos"]["active"] = true;
-      doc["sos"]["timestamp"] = String(sosTimeStr);
-    } else {
-      doc["sos"]["active"] = false;
-    }
-    
-    // IR Remote Data
-    preferences.begin("ir_settings", true);
-    int proto = preferences.getInt("protocol", 0);
+  {
+    pingWatchdogEnabled = false;
+    preferences.begin("_pingwdg", false); // false = read/write
+    preferences.putBool("pingwdg", false);
     preferences.end();
+    
+    JsonDocument data;
+    data["enabled"] = false;
+    sendJsonSuccess(request, "Ping watchdog disabled", &data);
+    break;
+  }
+  case CMD_GET_VERSION:
+  {
+    if (length > 0)
+      break; // Sa ID-om ide na STM32 - frame sastavio buildRs485Command
 
-    doc["ir"]["protocol_id"] = proto;
-    doc["ir"]["protocol_name"] = typeToString((decode_type_t)proto);
-
-    JsonDocument finalDoc;
-    finalDoc["status"] = "success";
-    finalDoc["message"] = "System status retrieved";
-    finalDoc["data"] = doc;
-
-    String response;
-    serializeJson(finalDoc, response);
-    request->send(200, "application/json", response);
+    char versionStr[32];
+    sprintf(versionStr, "%d.%d.%d", VERSION_MAJOR, VERSION_MINOR, VERSION_PATCH);
+    
+    JsonDocument data;
+    data["device_type"] = "ESP32";
+    data["firmware_version"] = String(versionStr);
+    data["build_number"] = VERSION_PATCH;
+    data["build_date"] = BUILD_DATE;
+    sendJsonSuccess(request, "ESP32 firmware version retrieved", &data);
+    return;
+  }
+  case CMD_GET_STATUS:
+  {
+    // Reset watchdog timer - dobili smo GET_STATUS komandu
+    resetGetStatusWatchdog();
+    
+    isLocalCommand = true;  // ✅ Lokalna komanda, bez RS485
+    sendStatusSnapshot(request);
     break;
   }
   case CMD_ESP_GET_PINS:
@@ -2636,6 +3838,7 @@ void handleSysctrlRequest(AsyncWebServerRequest *request)
     // Resetuj SOS status i obriši iz Preferences
     sosStatus = false;
     sosTimestamp = 0;
+    statusEpoch++;
     
     preferences.begin("sos_event", false);
     preferences.clear(); // Briše sve iz sos_event namespace-a
@@ -2652,6 +3855,7 @@ void handleSysctrlRequest(AsyncWebServerRequest *request)
         preferences.begin("ir_settings", false);
         preferences.putInt("protocol", proto);
         preferences.end();
+        statusEpoch++;
         
         JsonDocument data;
         data["protocol_id"] = proto;
@@ -2749,39 +3953,9 @@ void handleSysctrlRequest(AsyncWebServerRequest *request)
       sendJsonSuccess(request, "IR Command Sent", &data);
       return;
   }
-  case CMD_SET_FWD_HEATING:
-  case CMD_SET_FWD_COOLING:
-  case CMD_SET_ENABLE_HEATING:
-  case CMD_SET_ENABLE_COOLING:
-  {
-    if (!request->hasParam("ID") || !request->hasParam("VALUE"))
-    {
-      sendJsonError(request, 400, "Missing ID or VALUE parameter");
-      return;
-    }
-
-    int id = request->getParam("ID")->value().toInt();
-    int value = request->getParam("VALUE")->value().toInt();
-
-    if (id < 1 || id > 254)
-    {
-      sendJsonError(request, 400, "Invalid ID (must be 1-254)");
-      return;
-    }
-
-    if (value != 0 && value != 1)
-    {
-      sendJsonError(request, 400, "Invalid VALUE (must be 0 or 1)");
-      return;
-    }
-
-    buf[0] = cmd;
-    buf[1] = id;
-    buf[2] = value;
-    length = 3;
-    break;
-  }
   default:
+    if (length > 0)
+      break; // Frame za kontroler sastavio buildRs485Command
     isLocalCommand = false;
     sendJsonError(request, 400, "Unknown command");
     return;
@@ -2799,6 +3973,28 @@ void handleSysctrlRequest(AsyncWebServerRequest *request)
   // ===== RUTA: Remote komande koje trebali RS485 bus =====
   if (buf[0] && length)
   {
+    // Read-through keš: odgovor iz RAM-a ako je dovoljno svjež (MAX_AGE u ms, 0 = uvijek sa busa)
+    uint32_t ttl = roomCacheTtl(cmd);
+    if (ttl > 0)
+    {
+      uint32_t maxAge = request->hasParam("MAX_AGE") ? (uint32_t)request->getParam("MAX_AGE")->value().toInt() : ttl;
+      uint8_t cachedReply[ROOM_CACHE_MAX_REPLY];
+      uint16_t cachedLen;
+      uint32_t ageMs;
+      if (roomCache.lookup(buf[1], cmd, maxAge, cachedReply, cachedLen, ageMs))
+      {
+        sendRs485Reply(request, cmd, buf[1], cachedReply, cachedLen, true, ageMs);
+        return;
+      }
+    }
+
+    // Kontroler ne odgovara (circuit breaker otvoren) - ne troši vrijeme busa na siguran timeout
+    if (!controllerHealth.allowRequest(buf[1]))
+    {
+      sendJsonError(request, 504, "Controller offline (circuit open)");
+      return;
+    }
+
     LOG_DEBUG("Sending command: ");
     for (int i = 0; i < length; i++)
     {
@@ -2809,578 +4005,357 @@ void handleSysctrlRequest(AsyncWebServerRequest *request)
     }
     LOG_DEBUG_LN();
     
-    // Blokiraj loop() od čitanja Serial2 ŠTO PRIJE!
-    httpHandlerWaiting = true;
-    
-    // KLJUČNO: Očisti Serial2 buffer prije slanja komande!
-    int flushed = 0;
-    while (Serial2.available()) {
-      Serial2.read();
-      flushed++;
-    }
-    if (flushed > 0) {
-      LOG_DEBUG_F(">>> Flushed %d old bytes from Serial2 buffer\n", flushed);
-    }
-    
-    LOG_DEBUG_F(">>> Starting TF_QuerySimple, rdy=%d\n", TF_PARSER_TIMEOUT_TICKS * 10);
-    // TF_SendSimple(&tfapp, S_CUSTOM, buf, length);
-    TF_QuerySimple(&tfapp, S_CUSTOM, buf, length, ID_Listener, TF_PARSER_TIMEOUT_TICKS * 10);
-    rdy = TF_PARSER_TIMEOUT_TICKS * 10;
-    int bytesRead = 0;
-    do
-    {
-      // WHILE ne IF - mora čitati SVE dostupne bajtove odmah!
-      while (Serial2.available())
-      {
-        uint8_t b = Serial2.read();
-        bytesRead++;
-        LOG_DEBUG_F("[0x%02X]", b);
-        TF_AcceptChar(&tfapp, b);
-        
-        // PREKINI ODMAH ako je ID_Listener postavio rdy = -1
-        if (rdy < 0) {
-          break;
-        }
-      }
-      
-      // Provjeri ponovo nakon while petlje
-      if (rdy < 0) {
-        break;
-      }
-      
-      --rdy;
-      delay(1);
-      
-      // Resetuj WDT tokom dugog čekanja na odgovor
-      if (rdy % 10 == 0) {
-        esp_task_wdt_reset();
-      }
-    } while (rdy > 0);
-    
-    // Deblokiraj loop()
-    httpHandlerWaiting = false;
-    
-    LOG_DEBUG_F("\n>>> Wait loop finished, rdy=%d, bytes read=%d\n", rdy, bytesRead);
-
-    if (rdy == 0)
+    // Transakcija ide u red RS485 bus taska - AsyncTCP task se odmah oslobađa,
+    // onSysctrlReply() upisuje odgovor u DeferredResponse, a šalje ga async_tcp task odmah po complete()
+    BusClass cls = busClassForCommand(cmd);
+    RS485Bus *bus = &busFor(buf[1]);
+    DeferredResponse *response = new DeferredResponse();
+    uint32_t ticket = bus->query(cls, S_CUSTOM, buf, length, controllerHealth.timeoutFor(buf[1], cls),
+                                  onSysctrlReply, response, (uint32_t)cmd | ((uint32_t)buf[1] << 8),
+                                  isSharedReadCommand(cmd));
+    if (ticket == 0)
     {
-      LOG_ERROR_LN(">>> TIMEOUT detected!");
-      
-      // Očisti zaglavljen buffer
-      httpHandlerWaiting = false;
-      while (Serial2.available()) {
-        Serial2.read();
-      }
-      Serial2.flush();
-      
-      // Loguj upozorenje o mogućem Command buffer error-u
-      LOG_ERROR_LN("[WARNING] Timeout may have left TinyFrame in inconsistent state");
-      LOG_ERROR_LN("[WARNING] If Command buffer error occurs on next request, device will auto-restart");
-      
-      sendJsonError(request, 408, "Timeout: No response from device");
+      delete response;
+      sendJsonError(request, 503, "RS485 bus busy");
+      return;
     }
-    else
-    {
-      LOG_INFO_LN(">>> Response received, processing...");
-      JsonDocument responseDoc;
-
-      // Special handling for QR_CODE_GET because response might not start with CMD byte
-      if (cmd == CMD_QR_CODE_GET) {
-         // Assuming the response is just the string data
-         char qrBuf[129] = {0};
-         memcpy(qrBuf, replyData, (replyDataLength < 128) ? replyDataLength : 128);
-         responseDoc["qr_code"] = String(qrBuf);
-      } else
-      switch (replyData[0])
-      {
-      case CMD_GET_ROOM_TEMP:
-        if (replyDataLength >= 3) { // Minimum response length for GET_ROOM_TEMP (CMD + room_temp + setpoint_temp)
-          responseDoc["room_temperature"] = replyData[1];
-          responseDoc["setpoint_temperature"] = replyData[2];
-
-          if (replyDataLength >= 12) { // Full thermostat data from rs485_termostat.c (CMD + 11 data bytes)
-            responseDoc["fan_speed"] = replyData[3];
-            responseDoc["thermostat_control_mode"] = replyData[4];
-            // Polja thermostat_state i setpoint_difference su uklonjena iz novog formata
-            responseDoc["setpoint_max"] = replyData[5]; // Pomaknuto na index 5
-            responseDoc["setpoint_min"] = replyData[6]; // Pomaknuto na index 6
-            responseDoc["fan_control_mode"] = replyData[7]; // Pomaknuto na index 7
-            responseDoc["forward_heating"] = (bool)replyData[8]; // Pomaknuto na index 8
-            responseDoc["forward_cooling"] = (bool)replyData[9]; // Pomaknuto na index 9
-            responseDoc["thst_enable_heating"] = (bool)replyData[10]; // Novo polje
-            responseDoc["thst_enable_cooling"] = (bool)replyData[11]; // Novo polje
-          } else { // Limited data from rs485_scene.c, set other fields to null
-            responseDoc["fan_speed"] = nullptr;
-            responseDoc["thermostat_control_mode"] = nullptr;
-            // Polja thermostat_state i setpoint_difference su uklonjena
-            // Postavi nova polja na null za rs485_scene.c
-            responseDoc["setpoint_max"] = nullptr;
-            responseDoc["setpoint_min"] = nullptr;
-            responseDoc["fan_control_mode"] = nullptr;
-            responseDoc["forward_heating"] = nullptr;
-            responseDoc["forward_cooling"] = nullptr;
-            responseDoc["thst_enable_heating"] = nullptr;
-            responseDoc["thst_enable_cooling"] = nullptr;
-          }
-        } else {
-          // Handle case where response is too short or invalid
-          responseDoc["room_temperature"] = nullptr;
-          responseDoc["setpoint_temperature"] = nullptr;
-          responseDoc["fan_speed"] = nullptr;
-          responseDoc["thermostat_control_mode"] = nullptr;
-          responseDoc["thermostat_state"] = nullptr;
-          responseDoc["setpoint_difference"] = nullptr;
-          responseDoc["setpoint_max"] = nullptr;
-          responseDoc["setpoint_min"] = nullptr;
-          responseDoc["fan_control_mode"] = nullptr;
-          responseDoc["forward_heating"] = nullptr;
-          responseDoc["forward_cooling"] = nullptr;
-          responseDoc["thst_enable_heating"] = nullptr;
-          responseDoc["thst_enable_cooling"] = nullptr;
-          responseDoc["error"] = "Incomplete GET_ROOM_TEMP response";
-        }
-        break;
-      case 0xB1:
-        if ((replyDataLength == 3) && (replyData[1] == 0xB2))
-        {
-          for (int i = 7; i >= 0; i--)
-            bin += String(bitRead(replyData[2], i));
-          responseDoc["pin_states"] = bin;
-        }
-        else
-        {
-          responseDoc["result"] = "Pin set OK";
-        }
-        break;
-
-      case CMD_GET_FAN_DIFFERENCE:
-        responseDoc["fan_difference"] = replyData[1];
-        break;
-
-      case CMD_GET_FAN_BAND:
-        responseDoc["fan_low_band"] = replyData[1];
-        responseDoc["fan_high_band"] = replyData[2];
-        break;
-
-      case CMD_GET_GUEST_IN_TEMP:
-        responseDoc["guest_in_temperature"] = replyData[1];
-        break;
-
-      case CMD_GET_GUEST_OUT_TEMP:
-        responseDoc["guest_out_temperature"] = replyData[1];
-        break;
-
-      case CMD_SET_PASSWORD:
-        responseDoc["result"] = "Password set OK";
-        break;
-
-      case CMD_GET_PASSWORD:
-      {
-        if (replyDataLength < 2)
-        {
-          responseDoc["error"] = "Invalid response length";
-          break;
-        }
-        
-        uint8_t ack = replyData[1];
-        
-        if (ack != 0x06)  // ACK = 0x06
-        {
-          responseDoc["error"] = "Password read FAILED (NAK)";
-          break;
-        }
-        
-        // Provjeri tip korisnika prema dužini odgovora
-        if (replyDataLength == 10)  // Guest: CMD + ACK + 8 bytes
-        {
-          uint8_t guestId = replyData[2];
-          uint32_t password = ((uint32_t)replyData[3] << 16) | ((uint32_t)replyData[4] << 8) | replyData[5];
-          uint32_t expiry = ((uint32_t)replyData[6] << 24) | ((uint32_t)replyData[7] << 16) | 
-                            ((uint32_t)replyData[8] << 8) | replyData[9];
-          
-          // Konvertuj expiry Unix timestamp u datum
-          time_t expiryTime = (time_t)expiry;
-          struct tm *timeInfo = gmtime(&expiryTime);  // Koristi gmtime jer IC kontroler vraća UTC timestamp
-          char expiryStr[20];
-          strftime(expiryStr, sizeof(expiryStr), "%Y-%m-%d %H:%M", timeInfo);
-          
-          responseDoc["user_type"] = "guest";
-          responseDoc["guest_id"] = guestId;
-          responseDoc["password"] = password;
-          responseDoc["expiry"] = String(expiryStr);
-        }
-        else if (replyDataLength == 5)  // Maid/Manager/Service: CMD + ACK + 3 bytes
-        {
-          uint32_t password = ((uint32_t)replyData[2] << 16) | ((uint32_t)replyData[3] << 8) | replyData[4];
-          responseDoc["user_type"] = "staff";
-          responseDoc["password"] = password;
-        }
-        else
-        {
-          responseDoc["error"] = "Unexpected response format (length=" + String(replyDataLength) + ")";
-        }
-        
-        break;
-      }
-
-      case CMD_OPEN_DOOR:
-        responseDoc["result"] = "Door opened";
-        break;
-
-      case CMD_SET_ROOM_TEMP:
-      case CMD_SET_GUEST_IN_TEMP:
-      case CMD_SET_GUEST_OUT_TEMP:
-        responseDoc["result"] = "Temperature set OK";
-        break;
-
-      case CMD_SET_THST_ON:
-      case CMD_SET_THST_OFF:
-      case CMD_SET_THST_HEATING:
-      case CMD_SET_THST_COOLING:
-        responseDoc["result"] = "Thermostat set OK";
-        break;
-
-      case CMD_SET_FWD_HEATING:
-        if (replyDataLength >= 2) {
-          responseDoc["result"] = "Forward heating flag set";
-          responseDoc["value"] = (bool)replyData[1];
-        }
-        break;
-
-      case CMD_SET_FWD_COOLING:
-        if (replyDataLength >= 2) {
-          responseDoc["result"] = "Forward cooling flag set";
-          responseDoc["value"] = (bool)replyData[1];
-        }
-        break;
-
-      case CMD_SET_ENABLE_HEATING:
-        if (replyDataLength >= 2) {
-          responseDoc["result"] = "Enable heating flag set";
-          responseDoc["value"] = (bool)replyData[1];
-        }
-        break;
 
-      case CMD_SET_ENABLE_COOLING:
-        if (replyDataLength >= 2) {
-          responseDoc["result"] = "Enable cooling flag set";
-          responseDoc["value"] = (bool)replyData[1];
-        }
-        break;
+    // Request briše response tek poslije onDisconnect - cancel() čeka callback koji ga možda upravo puni
+    request->onDisconnect([bus, ticket]() { bus->cancel(ticket); });
+    request->send(response);
+  }
+  else
+  {
+    // KRITIČNA GREŠKA - Komunikacija je možda zaglavljena
+    LOG_ERROR_LN("==========================================");
+    LOG_ERROR_LN("[CRITICAL] Command buffer error detected!");
+    LOG_ERROR_LN("[CRITICAL] Recovering RS485/TinyFrame in place...");
+    LOG_ERROR_LN("==========================================" );
+    
+    // Loguj debug info
+    LOG_ERROR("[DEBUG] buf[0]=0x%02X, length=%d, isLocalCommand=%d\n", 
+                buf[0], length, isLocalCommand);
+    
+    // Reset parsera, ID listenera i UART-a u bus tasku; restart tek ako se ponavlja (loop())
+    for (int s = 0; s < RS485_SEGMENTS; s++)
+      busSegments[s]->recover();
+    sendJsonError(request, 500, "Command buffer error - RS485 bus reset");
+  }
+}
+/**
+ * MAKRO KOMANDE - imenovane sekvence komandi jednog kontrolera (/macro)
+ * Svi frame-ovi se sastave i validiraju prije slanja; koraci idu jedan za drugim u BUS_CLASS_ACCESS,
+ * sljedeći se stavlja u red iz callbacka prethodnog, prvi neuspjeh prekida sekvencu.
+ */
+#define MACRO_MAX_STEPS 4
 
-      case CMD_READ_LOG:
-      {
-        // Response format: [CMD][LOG_DSIZE][16-byte log data][device_addr_H][device_addr_L]
-        // Total: 20 bytes
-        if (replyDataLength < 20)
-        {
-          body += "Invalid response length (expected 20, got " + String(replyDataLength) + ")";
-          break;
-        }
-        
-        if (replyData[1] != 16)
-        {
-          body += "Invalid log data size (expected 16, got " + String(replyData[1]) + ")";
-          break;
-        }
-        
-        // Parse 16-byte log data (bytes 2-17)
-        uint16_t logId = (replyData[2] << 8) | replyData[3];
-        
-        // Check if log list is empty (log_id = 0x0000 indicates LOGGER_EMPTY)
-        if (logId == 0)
-        {
-          int deviceId = request->getParam("ID")->value().toInt();
-          body = "{";
-          body += "\"status\":\"success\",";
-          body += "\"message\":\"Log list is empty\",";
-          body += "\"data\":{";
-          body += "\"status\":\"EMPTY\",";
-          body += "\"device_id\":" + String(deviceId);
-          body += "}}";
-          request->send(200, "application/json", body);
-          return;
-        }
-        
-        uint8_t logEvent = replyData[4];
-        uint8_t logType = replyData[5];
-        uint8_t logGroup = replyData[6];
-        
-        // Card ID (5 bytes) - from log bytes [5-9]
-        char cardIdHex[11];
-        sprintf(cardIdHex, "%02X%02X%02X%02X%02X", 
-                replyData[7], replyData[8], replyData[9], replyData[10], replyData[11]);
-        
-        // Debug: Print raw bytes to Serial
-        LOG_DEBUG("LOG RAW DATA: ");
-        for (int i = 2; i < 18; i++) {
-          if (replyData[i] < 0x10) LOG_DEBUG("0");
-          LOG_DEBUG_HEX(replyData[i]);
-          LOG_DEBUG(" ");
-        }
-        LOG_DEBUG_LN();
-        
-        // Date/Time (BCD format)
-        uint8_t day = bcdToDec(replyData[12]);
-        uint8_t month = bcdToDec(replyData[13]);
-        uint8_t year = bcdToDec(replyData[14]);
-        uint8_t hour = bcdToDec(replyData[15]);
-        uint8_t minute = bcdToDec(replyData[16]);
-        uint8_t second = bcdToDec(replyData[17]);
-        
-        // Format date and time strings
-        char dateStr[12];
-        char timeStr[9];
-        sprintf(dateStr, "%02d.%02d.20%02d", day, month, year);
-        sprintf(timeStr, "%02d:%02d:%02d", hour, minute, second);
-        
-        // Device ID from request parameter
-        int deviceId = request->getParam("ID")->value().toInt();
-        
-        // Build JSON response
-        body = "{";
-        body += "\"status\":\"success\",";
-        body += "\"data\":{";
-        body += "\"status\":\"OK\",";
-        body += "\"device_id\":" + String(deviceId) + ",";
-        body += "\"log_id\":" + String(logId) + ",";
-        body += "\"event_code\":\"0x" + String(logEvent, HEX) + "\",";
-        body += "\"event_name\":\"" + getEventName(logEvent) + "\",";
-        body += "\"event_description\":\"" + getAccessDescription(logEvent, logGroup) + "\",";
-        body += "\"type\":" + String(logType) + ",";
-        body += "\"group\":" + String(logGroup) + ",";
-        body += "\"card_id\":\"" + String(cardIdHex) + "\",";
-        body += "\"date\":\"" + String(dateStr) + "\",";
-        body += "\"time\":\"" + String(timeStr) + "\",";
-        body += "\"timestamp\":\"" + String(dateStr) + " " + String(timeStr) + "\"";
-        body += "}}";
-        
-        request->send(200, "application/json", body);
-        return;
-      }
+struct MacroStep
+{
+  const char *cmd;          // Ime komande kao u /sysctrl.cgi?CMD=
+  const char *const *fixed; // CommandParams::fixed
+  const char *const *alias; // CommandParams::alias
+  const char *requires;     // Korak se preskače ako zahtjev nema ovaj parametar (NULL = obavezan korak)
+};
 
-      case CMD_DELETE_LOG:
-      {
-        // Response format: [CMD][Status][device_addr_H][device_addr_L]
-        // Status byte: 0 = LOGGER_OK, 1 = LOGGER_EMPTY
-        // Total: 4 bytes
-        if (replyDataLength < 4)
-        {
-          body += "Invalid response length (expected 4, got " + String(replyDataLength) + ")";
-          break;
-        }
-        
-        uint8_t status = replyData[1];  // LOGGER_OK=0, LOGGER_EMPTY=1
-        int deviceId = request->getParam("ID")->value().toInt();
-        
-        // Build JSON response
-        body = "{";
-        body += "\"status\":\"success\",";
-        body += "\"message\":\"" + String(status == 0 ? "Log deleted successfully" : "Log list is empty") + "\",";
-        body += "\"data\":{";
-        body += "\"status\":\"" + String(status == 0 ? "OK" : "EMPTY") + "\",";
-        body += "\"device_id\":" + String(deviceId);
-        body += "}}";
-        
-        request->send(200, "application/json", body);
-        return;
-      }
-      
-      case CMD_SET_LANG:
-        responseDoc["result"] = "Language set OK";
-        break;
+struct MacroDef
+{
+  const char *name;
+  MacroStep steps[MACRO_MAX_STEPS];
+  uint8_t count;
+};
 
-      case CMD_QR_CODE_SET:
-        if (replyDataLength >= 2 && replyData[1] == 0x06) // ACK
-            responseDoc["result"] = "QR code set OK";
-        else
-            responseDoc["result"] = "QR code set FAILED";
-        break;
+static const char *const MACRO_GUEST[] = {"TYPE", "GUEST", NULL};
+static const char *const MACRO_DELETE_GUEST[] = {"TYPE", "DELETE_GUEST", NULL};
+static const char *const MACRO_TEMP[] = {"VALUE", "TEMP", NULL};
+
+static const MacroDef macros[] = {
+  // ?ID=&PASSWORD=&GUEST_ID=&EXPIRY=[&TEMP=][&QR_CODE=]
+  {"CHECKIN", {{"SET_PASSWORD", MACRO_GUEST, NULL, NULL},
+               {"SET_GUEST_IN_TEMP", NULL, MACRO_TEMP, "TEMP"},
+               {"SET_THST_ON", NULL, NULL, NULL},
+               {"QR_CODE_SET", NULL, NULL, "QR_CODE"}}, 4},
+  // ?ID=&GUEST_ID=[&TEMP=]
+  {"CHECKOUT", {{"SET_PASSWORD", MACRO_DELETE_GUEST, NULL, NULL},
+                {"SET_GUEST_OUT_TEMP", NULL, MACRO_TEMP, "TEMP"}}, 2},
+};
 
-      case CMD_GET_ROOM_STATUS:
-        if (replyDataLength >= 2) {
-            bool cardIn = replyData[1];
-            responseDoc["room_status"] = cardIn ? "GUEST_IN" : "EMPTY";
-            responseDoc["card_inserted"] = cardIn;
-        }
-        break;
+struct MacroRun
+{
+  DeferredResponse *response; // Puni ga bus task, šalje async_tcp; briše ga request
+  RS485Bus *bus;
+  const MacroDef *macro;
+  uint8_t id;
+  bool run[MACRO_MAX_STEPS]; // false = preskočen (nema parametra)
+  uint8_t frames[MACRO_MAX_STEPS][SYSCTRL_BUF_LEN];
+  uint8_t lengths[MACRO_MAX_STEPS];
+  int8_t results[MACRO_MAX_STEPS]; // BusResult, -1 = nije poslan
+  uint16_t rttMs[MACRO_MAX_STEPS];
+  uint8_t current;
+  uint32_t startedAt;
+  uint32_t ticket;
+  int8_t rejected;                // Korak koji je kontroler odbio (NAK, pogrešan odgovor), -1 = nijedan
+  char fault[COMMAND_FAULT_MAX];  // Razlog odbijanja
+  bool abandoned; // Klijent otišao - ne šalji dalje (macroMux)
+};
 
-      case CMD_RESTART_CTRL:
-        responseDoc["result"] = "Controller restart OK";
-        break;
-      
-      case CMD_SET_SYSID:
-        if (replyDataLength >= 2 && replyData[1] == 0x06) // ACK
-          responseDoc["result"] = "System ID set OK";
-        else
-          responseDoc["result"] = "System ID set FAILED";
-        break;
+portMUX_TYPE macroMux = portMUX_INITIALIZER_UNLOCKED;
 
-      case CMD_GET_SYSID:
-        if (replyDataLength >= 3)
-        {
-          uint16_t sysidVal = (replyData[1] << 8) | replyData[2];
-          char hexStr[10];
-          sprintf(hexStr, "0x%04X", sysidVal);
-          responseDoc["system_id"] = sysidVal;
-          responseDoc["system_id_hex"] = String(hexStr);
-        }
-        else
-        {
-          responseDoc["error"] = "Invalid response length";
-        }
-        break;
+void onMacroReply(BusTransaction &txn);
 
-      case CMD_GET_VERSION:
-      {
-        // Response format: [CMD][bootloader_ver][app_ver][bldr_backup_ver][app_backup_ver][new_file_ver]
-        // Each version is 4 bytes (big-endian uint32_t)
-        // Total: 1 + 5*4 = 21 bytes
-        if (replyDataLength < 21)
-        {
-          responseDoc["error"] = "Invalid response length (expected 21, got " + String(replyDataLength) + ")";
-          break;
-        }
+/**
+ * PROVJERA ODGOVORA KORAKA KROZ CommandDescriptor - isto pravilo kao /sysctrl.cgi (failed/ACK, format)
+ */
+struct MacroReplyCheck
+{
+  const char *result;
+  char error[COMMAND_FAULT_MAX];
+};
 
-        // Helper lambda to parse 4-byte version
-        auto parseVersion = [](uint8_t* data, int offset) -> uint32_t {
-          return ((uint32_t)data[offset] << 24) | 
-                 ((uint32_t)data[offset + 1] << 16) | 
-                 ((uint32_t)data[offset + 2] << 8) | 
-                 data[offset + 3];
-        };
-
-        // Parse 5 firmware versions
-        uint32_t bootloaderVer = parseVersion(replyData, 1);
-        uint32_t applicationVer = parseVersion(replyData, 5);
-        uint32_t bootloaderBackupVer = parseVersion(replyData, 9);
-        uint32_t applicationBackupVer = parseVersion(replyData, 13);
-        uint32_t newFileVer = parseVersion(replyData, 17);
-
-        // Format versions as hex strings
-        char hexBuf[16];
-        
-        if (bootloaderVer != 0) {
-          sprintf(hexBuf, "0x%08X", bootloaderVer);
-          responseDoc["bootloader_version"] = String(hexBuf);
-        } else {
-          responseDoc["bootloader_version"] = nullptr;
-        }
+void macroPutInt(void *ctx, const char *key, int32_t value) {}
+void macroPutBool(void *ctx, const char *key, bool value) {}
 
-        if (applicationVer != 0) {
-          sprintf(hexBuf, "0x%08X", applicationVer);
-          responseDoc["application_version"] = String(hexBuf);
-        } else {
-          responseDoc["application_version"] = nullptr;
-        }
+void macroPutText(void *ctx, const char *key, const char *value)
+{
+  if (strcmp(key, "result") == 0)
+    ((MacroReplyCheck *)ctx)->result = value;
+}
 
-        if (bootloaderBackupVer != 0) {
-          sprintf(hexBuf, "0x%08X", bootloaderBackupVer);
-          responseDoc["bootloader_backup_version"] = String(hexBuf);
-        } else {
-          responseDoc["bootloader_backup_version"] = nullptr;
-        }
+void macroPutError(void *ctx, const char *message)
+{
+  MacroReplyCheck *check = (MacroReplyCheck *)ctx;
+  strlcpy(check->error, message, sizeof(check->error));
+}
 
-        if (applicationBackupVer != 0) {
-          sprintf(hexBuf, "0x%08X", applicationBackupVer);
-          responseDoc["application_backup_version"] = String(hexBuf);
-        } else {
-          responseDoc["application_backup_version"] = nullptr;
-        }
+// false + fault = kontroler je odgovorio, ali nije prihvatio komandu
+bool macroReplyAccepted(CommandType cmd, const BusTransaction &txn, char *fault, size_t max)
+{
+  const CommandDescriptor *desc = findCommand(cmd);
+  if (desc == NULL)
+    return true;
+
+  MacroReplyCheck check = {NULL, ""};
+  ReplyWriter writer = {&check, macroPutInt, macroPutBool, macroPutText, macroPutError};
+  if (!decodeReply(*desc, txn.reply, txn.replyLen, writer))
+    strlcpy(fault, "Unexpected reply", max);
+  else if (check.error[0] != '\0')
+    strlcpy(fault, check.error, max);
+  else if (desc->failed != NULL && check.result == desc->failed)
+    strlcpy(fault, desc->failed, max);
+  else
+    return true;
+  return false;
+}
 
-        if (newFileVer != 0) {
-          sprintf(hexBuf, "0x%08X", newFileVer);
-          responseDoc["new_file_version"] = String(hexBuf);
-        } else {
-          responseDoc["new_file_version"] = nullptr;
-        }
+// Sljedeći korak koji se šalje od run->current; false = kraj
+bool queueMacroStep(MacroRun *run)
+{
+  while (run->current < run->macro->count && !run->run[run->current])
+    run->current++;
+  if (run->current >= run->macro->count)
+    return false;
 
-        break;
-      }
+  uint8_t i = run->current;
+  uint32_t ticket = run->bus->query(BUS_CLASS_ACCESS, S_CUSTOM, run->frames[i], run->lengths[i],
+                                    controllerHealth.timeoutFor(run->id, BUS_CLASS_ACCESS),
+                                    onMacroReply, run, run->frames[i][0] | ((uint32_t)run->id << 8));
+  if (ticket == 0)
+  {
+    run->results[i] = BUS_SEND_FAILED;
+    return false;
+  }
 
-      default:
-      {
-        char hexCmd[5];
-        sprintf(hexCmd, "0x%02X", replyData[0]);
-        responseDoc["error"] = "Unknown response";
-        responseDoc["command"] = String(hexCmd);
-        
-        String hexData = "";
-        for (size_t i = 0; i < replyDataLength; i++)
-        {
-          if (replyData[i] < 0x10)
-            hexData += "0";
-          hexData += String(replyData[i], HEX);
-          hexData += " ";
-        }
-        responseDoc["raw_data"] = hexData;
-        responseDoc["data_length"] = replyDataLength;
-        break;
-      }
-      }
+  portENTER_CRITICAL(&macroMux);
+  run->ticket = ticket;
+  bool abandoned = run->abandoned;
+  portEXIT_CRITICAL(&macroMux);
 
-      JsonDocument finalDoc;
-      if (responseDoc["error"].is<const char*>()) {
-        finalDoc["status"] = "error";
-        finalDoc["message"] = responseDoc["error"];
-        finalDoc["code"] = 500;
-      } else {
-        finalDoc["status"] = "success";
-        finalDoc["data"] = responseDoc;
-      }
+  if (abandoned)
+    run->bus->cancel(ticket);
+  return true;
+}
 
-      String response;
-      serializeJson(finalDoc, response);
-      request->send(200, "application/json", response);
+void sendMacroResult(MacroRun *run)
+{
+  const MacroDef *macro = run->macro;
+  int failed = -1;
+
+  JsonWriter<JsonBufferSink> json(run->response->sink());
+  json.beginObject();
+  json.field("macro", macro->name);
+  json.field("device_id", run->id);
+  json.beginArray("steps");
+  for (int i = 0; i < macro->count; i++)
+  {
+    json.beginObject();
+    json.field("cmd", macro->steps[i].cmd);
+    if (!run->run[i])
+      json.field("result", "skipped");
+    else if (run->results[i] < 0)
+      json.field("result", "not_run");
+    else
+    {
+      if (run->rejected == i)
+        json.field("result", "rejected");
+      else
+        json.field("result", run->results[i] == BUS_OK ? "ok" : RS485Bus::resultName((BusResult)run->results[i]));
+      json.field("rtt_ms", run->rttMs[i]);
+      if (run->results[i] != BUS_OK || run->rejected == i)
+        failed = i;
     }
+    json.endObject();
+  }
+  json.endArray();
+  json.field("elapsed_ms", millis() - run->startedAt);
+
+  int code = 200;
+  if (failed < 0)
+  {
+    json.field("status", "success");
   }
   else
   {
-    // KRITIČNA GREŠKA - Komunikacija je zaglavljena
-    LOG_ERROR_LN("==========================================");
-    LOG_ERROR_LN("[CRITICAL] Command buffer error detected!");
-    LOG_ERROR_LN("[CRITICAL] RS485/TinyFrame communication is stuck!");
-    LOG_ERROR_LN("[CRITICAL] Device will restart in 2 seconds...");
-    LOG_ERROR_LN("==========================================" );
-    
-    // Loguj debug info
-    LOG_ERROR("[DEBUG] buf[0]=0x%02X, length=%d, isLocalCommand=%d\n", 
-                buf[0], length, isLocalCommand);
-    
-    sendJsonError(request, 500, "Command buffer error - device restarting");
-    
-    // Resetuj WDT prije restarty
-    esp_task_wdt_reset();
-    
-    // Čekaj malo da klijent primi odgovor
-    delay(500);
-    
-    // Reinicijalizuj prije ponovnog pokušaja
-    LOG_INFO_LN(">>> Attempting TinyFrame/Serial2 reinitialization...");
-    
-    // Očisti Serial2 buffer
-    while (Serial2.available()) {
-      Serial2.read();
+    BusResult r = (BusResult)run->results[failed];
+    char message[32 + COMMAND_FAULT_MAX];
+    if (run->rejected == failed)
+    {
+      snprintf(message, sizeof(message), "Step %s rejected: %s", macro->steps[failed].cmd, run->fault);
+      code = 502; // Kontroler je odgovorio, ali nije izvršio korak
     }
-    Serial2.flush();
-    
-    // Restart kompletnog sistema
-    LOG_ERROR_LN(">>> Performing hard reset of device");
-    delay(1000);
-    ESP.restart();
+    else
+    {
+      snprintf(message, sizeof(message), "Step %s failed: %s", macro->steps[failed].cmd, RS485Bus::resultName(r));
+      code = (r == BUS_TIMEOUT) ? 408 : (r == BUS_SEND_FAILED) ? 500 : 503;
+    }
+    json.field("status", "error");
+    json.field("failed_step", failed);
+    json.field("message", message);
   }
+  json.endObject();
+
+  run->response->complete(code);
+}
+
+// Iz RS485 bus taska, pod bus lock-om (cancel() iz onDisconnect čeka)
+void onMacroReply(BusTransaction &txn)
+{
+  MacroRun *run = (MacroRun *)txn.arg;
+  uint8_t i = run->current;
+  CommandType cmd = (CommandType)(txn.tag & 0xFF);
+
+  updateRoomCache(cmd, run->id, txn);
+  recordBusMetrics(txn);
+  if (txn.result == BUS_OK)
+    controllerHealth.onReply(run->id, txn.cls, txn.rttMs);
+  else if (txn.result == BUS_TIMEOUT)
+    controllerHealth.onTimeout(run->id, txn.cls);
+
+  run->results[i] = txn.result;
+  run->rttMs[i] = txn.rttMs;
+  bool accepted = (txn.result == BUS_OK) && macroReplyAccepted(cmd, txn, run->fault, sizeof(run->fault));
+  if (txn.result == BUS_OK && !accepted)
+    run->rejected = i;
+
+  portENTER_CRITICAL(&macroMux);
+  bool abandoned = run->abandoned;
+  portEXIT_CRITICAL(&macroMux);
+  if (abandoned)
+    return;
+
+  // Sljedeći korak ide u red tek sada - između koraka može proći druga ACCESS ili ostarjela transakcija
+  run->current++;
+  if (accepted && queueMacroStep(run))
+    return;
+
+  sendMacroResult(run);
 }
 /**
- *  TINYFRAME NA RS485 BUS TRANSMITER
+ * OBRADA /macro ZAHTJEVA
  */
-void TF_WriteImpl(TinyFrame *const tf, const uint8_t *buff, uint32_t len)
+void handleMacroRequest(AsyncWebServerRequest *request)
 {
-  digitalWrite(RS485_DE_PIN, HIGH);
+  if (otaUpdateInProgress)
+  {
+    sendJsonError(request, 503, "OTA update in progress");
+    return;
+  }
 
-  Serial2.write(buff, len);
-  Serial2.flush(); // čekaj da svi bajtovi izađu iz UART-a
+  if (!request->hasParam("NAME") || !request->hasParam("ID"))
+  {
+    sendJsonError(request, 400, "Missing NAME or ID parameter");
+    return;
+  }
 
-  digitalWrite(RS485_DE_PIN, LOW);
+  String name = request->getParam("NAME")->value();
+  const MacroDef *macro = NULL;
+  for (size_t i = 0; i < sizeof(macros) / sizeof(macros[0]); i++)
+    if (name == macros[i].name)
+      macro = &macros[i];
+  if (macro == NULL)
+  {
+    sendJsonError(request, 400, "Unknown macro");
+    return;
+  }
+
+  int id = request->getParam("ID")->value().toInt();
+  if (id < 1 || id > 254)
+  {
+    sendJsonError(request, 400, "Invalid ID (must be 1-254)");
+    return;
+  }
+
+  MacroRun *run = new MacroRun();
+  run->macro = macro;
+  run->id = id;
+  run->rejected = -1;
+
+  // Svi koraci se validiraju prije prvog frame-a - greška u parametrima ne ostavlja sobu napola podešenu
+  for (int i = 0; i < macro->count; i++)
+  {
+    const MacroStep &step = macro->steps[i];
+    CommandParams params = {request, step.fixed, step.alias};
+    run->results[i] = -1;
+    run->run[i] = (step.requires == NULL || request->hasParam(step.requires));
+    if (!run->run[i])
+      continue;
+
+    CommandError err;
+    run->lengths[i] = buildRs485Command(stringToCommand(step.cmd), params, run->frames[i], err);
+    if (err.code != 0 || run->lengths[i] == 0)
+    {
+      delete run;
+      sendJsonError(request, err.code ? err.code : 500, String(step.cmd) + ": " + err.message);
+      return;
+    }
+  }
+
+  if (!controllerHealth.allowRequest(id))
+  {
+    delete run;
+    sendJsonError(request, 504, "Controller offline (circuit open)");
+    return;
+  }
+
+  run->bus = &busFor(id);
+  run->response = new DeferredResponse();
+  run->startedAt = millis();
+  if (!queueMacroStep(run))
+  {
+    delete run->response;
+    delete run;
+    sendJsonError(request, 503, "RS485 bus busy");
+    return;
+  }
+
+  // Nakon cancel() callback više ne dira run - i kada je odgovor već poslan (destruktor requesta)
+  request->onDisconnect([run]() {
+    portENTER_CRITICAL(&macroMux);
+    run->abandoned = true;
+    uint32_t ticket = run->ticket;
+    portEXIT_CRITICAL(&macroMux);
+    run->bus->cancel(ticket);
+    delete run;
+  });
+  request->send(run->response);
 }
 /**
  * KONVERTOR SA UINT8 NA BCD FORMAT
@@ -3390,16 +4365,10 @@ uint8_t toBCD(uint8_t val)
   return ((val / 10) << 4) | (val % 10);
 }
 /**
- *  UPDATE DATUMA I VREMENA UREĐAJA NA RS485 BUSU
+ *  UPDATE DATUMA I VREMENA UREĐAJA NA RS485 SEGMENTU
  */
-void sendRtcToBus()
+bool sendRtcToBus(RS485Bus &bus)
 {
-  if (otaUpdateInProgress)
-    return;
-
-  if (timeValid == false)
-    return;
-
   time_t rawTime = time(nullptr);
 
   struct tm *timeInfo = localtime(&rawTime);
@@ -3407,7 +4376,7 @@ void sendRtcToBus()
   if (timeInfo == nullptr)
   {
     LOG_ERROR_LN("[RTC SEND] Greška: timeInfo je nullptr");
-    return;
+    return false;
   }
 
   uint8_t buf[9];
@@ -3428,14 +4397,71 @@ void sendRtcToBus()
   }
   LOG_DEBUG_LN();
 
-  bool sent = TF_SendSimple(&tfapp, S_CUSTOM, buf, sizeof(buf));
+  // Bus je prazan (RtcSync), pa frame izlazi odmah i vrijeme u njemu je tačno
+  bool sent = bus.send(BUS_CLASS_WRITE, S_CUSTOM, buf, sizeof(buf));
   if (!sent)
   {
     LOG_ERROR_LN("RTC Update ERROR !");
   }
-  else
+  return sent;
+}
+/**
+ * OČITAN RTC KONTROLERA - poziva se iz RS485 bus taska
+ */
+void onRtcRead(BusTransaction &txn)
+{
+  RtcSync &sync = rtcSync[txn.tag >> 8];
+  uint8_t id = txn.tag & 0xFF;
+  const uint8_t *r = txn.reply;
+
+  recordBusMetrics(txn, false); // Stariji firmware ne zna GET_RTC - nije timeout kontrolera
+  // [CMD][dan u sedmici][dan][mjesec][godina][sat][minut][sekund], BCD
+  if (txn.result != BUS_OK || txn.replyLen < 8 || r[0] != GET_RTC_DATE_TIME)
+  {
+    sync.onReadResult(id, false, 0);
+    return;
+  }
+
+  struct tm ctrl = {};
+  ctrl.tm_mday = bcdToDec(r[2]);
+  ctrl.tm_mon = bcdToDec(r[3]) - 1;
+  ctrl.tm_year = bcdToDec(r[4]) + 100;
+  ctrl.tm_hour = bcdToDec(r[5]);
+  ctrl.tm_min = bcdToDec(r[6]);
+  ctrl.tm_sec = bcdToDec(r[7]);
+  ctrl.tm_isdst = -1;
+  time_t ctrlTime = mktime(&ctrl);
+  if (ctrlTime == -1)
+  {
+    sync.onReadResult(id, false, 0);
+    return;
+  }
+  sync.onReadResult(id, true, (int32_t)(ctrlTime - time(nullptr)));
+}
+
+void runRtcSync()
+{
+  if (otaUpdateInProgress || timeValid == false)
+    return;
+
+  for (int s = 0; s < RS485_SEGMENTS; s++)
   {
-    LOG_INFO_LN("RTC Update OK");
+    RS485Bus &bus = *busSegments[s];
+    RtcAction action;
+    uint8_t id;
+    if (!rtcSync[s].nextStep(bus.isIdle(), action, id))
+      continue;
+
+    if (action == RTC_ACT_BROADCAST)
+    {
+      rtcSync[s].onBroadcast(sendRtcToBus(bus));
+      continue;
+    }
+
+    uint8_t cmd[2] = {GET_RTC_DATE_TIME, id};
+    if (bus.query(BUS_CLASS_LOG, S_CUSTOM, cmd, sizeof(cmd), RTC_READ_TIMEOUT_MS,
+                  onRtcRead, NULL, id | (s << 8)) == 0)
+      rtcSync[s].onReadResult(id, false, 0);
   }
 }
 /**
@@ -3536,7 +4562,6 @@ void setup()
   
 
   Serial.begin(115200);
-  Serial2.begin(115200);
 
   LOG_INFO("[WDT] Task watchdog armed at setup() start. Timeout: %ds\n", WDT_TIMEOUT);
   
@@ -3575,6 +4600,8 @@ void setup()
   
   if (extFlash.begin()) {
     LOG_INFO_LN("External Flash Initialized");
+    if (LOG_STORE_SLOT >= 0 && !logStore.begin())
+      LOG_ERROR_LN("Log store init failed");
   } else {
     LOG_ERROR_LN("External Flash Init FAILED");
   }
@@ -3639,14 +4666,23 @@ void setup()
 
   server = std::unique_ptr<AsyncWebServer>(new AsyncWebServer(_port)); // Dinamička alokacija servera s portom iz Preferences
 
-  TF_InitStatic(&tfapp, TF_MASTER);
-  
-  // Registruj listenere za SOS i IR događaje
-  TF_AddTypeListener(&tfapp, S_SOS, SOS_Listener);
-  TF_AddTypeListener(&tfapp, S_IR, IR_Listener);
-  // Registruj Firmware Update Listener
-  TF_AddTypeListener(&tfapp, TF_TYPE_FIRMWARE_UPDATE, UpdateService_Listener);
-  LOG_INFO_LN("✅ TinyFrame listeneri registrovani: S_SOS, S_IR, FW_UPDATE");
+  // Registruj listenere za SOS i IR događaje - svaki segment ima svoju TinyFrame instancu
+  busEvents = xQueueCreate(BUS_EVENT_QUEUE_LEN, sizeof(BusEvent));
+  for (int s = 0; s < RS485_SEGMENTS; s++)
+  {
+    busSegments[s]->addTypeListener(S_SOS, SOS_Listener);
+    busSegments[s]->addTypeListener(S_IR, IR_Listener);
+    busSegments[s]->addTypeListener(S_STATE, State_Listener);
+    // Registruj Firmware Update Listener
+    busSegments[s]->addTypeListener(TF_TYPE_FIRMWARE_UPDATE, UpdateService_Listener);
+  }
+  LOG_INFO_LN("✅ TinyFrame listeneri registrovani: S_SOS, S_IR, S_STATE, FW_UPDATE");
+
+  // RS485 bus task preuzima Serial2 i TinyFrame (RX, tick, transakcije); segment 2 Serial1
+  busRouting.begin();
+  for (int s = 0; s < RS485_SEGMENTS; s++)
+    busSegments[s]->begin(115200);
+  roster.begin();
   
   // Učitaj SOS status iz Preferences (perzistentnost)
   preferences.begin("sos_event", true);
@@ -3658,8 +4694,6 @@ void setup()
   }
   preferences.end();
   
-  rtcSyncTicker.attach(60.0, sendRtcToBus);
-
   tryConnectWiFi(); // 👈 Ovde se sada samo poziva čista funkcija
 
   if (!MDNS.begin(_mdns))
@@ -3792,6 +4826,11 @@ void setup()
         sendJsonError(request, 400, "Invalid slot (0-7)");
         return;
     }
+
+    if (isLogStoreSlot(slot)) {
+        sendJsonError(request, 400, "Slot reserved for log store");
+        return;
+    }
     
     sendJsonSuccess(request, "Upload Complete");
   }, 
@@ -3834,6 +4873,8 @@ void setup()
              }
         }
 
+        if (isLogStoreSlot(uploadSlot)) uploadSlot = -1; // LogStore - ne briši, odgovor 400 na kraju
+
         if (uploadSlot >= 0 && uploadSlot < FW_SLOT_COUNT) {
             if (uploadSlot < 4) { // Standard firmware slots
                 LOG_INFO("Upload: Erasing Slot %d... (This may take time)\n", uploadSlot);
@@ -3930,20 +4971,28 @@ void setup()
 
   // 2. List Slots Status
   server->on("/slots", HTTP_GET, [](AsyncWebServerRequest *request) {
-    JsonDocument doc;
-    JsonArray slots = doc["slots"].to<JsonArray>();
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    JsonWriter<AsyncResponseStream> json(*response);
+    json.beginObject();
+    json.beginArray("slots");
     
     for (int i = 0; i < FW_SLOT_COUNT; i++) {
-        JsonObject slotObj = slots.add<JsonObject>();
-        slotObj["id"] = i;
-
-        if (i < 4) { // Standard Firmware Slots
-            slotObj["type"] = "firmware";
+        json.beginObject();
+        json.field("id", i);
+
+        if (isLogStoreSlot(i)) {
+            LogStoreStats st;
+            logStore.getStats(st);
+            json.field("type", "log_store");
+            json.field("valid", logStore.ready());
+            json.field("records", st.records);
+        } else if (i < 4) { // Standard Firmware Slots
+            json.field("type", "firmware");
             FwInfoTypeDef info;
             if (extFlash.getSlotInfo(i, &info)) {
-                slotObj["size"] = info.size;
-                slotObj["version"] = info.version;
-                slotObj["crc32"] = info.crc32;
+                json.field("size", info.size);
+                json.field("version", info.version);
+                json.field("crc32", info.crc32);
                 
                 // Stricter validation
                 bool isValid = true;
@@ -3958,32 +5007,34 @@ void setup()
                                  (fw_type >= 0x40 && fw_type <= 0x49))) { // CS
                     isValid = false;
                 }
-                slotObj["valid"] = isValid;
+                json.field("valid", isValid);
             } else {
-                slotObj["error"] = "Read Failed";
-                slotObj["valid"] = false;
+                json.field("error", "Read Failed");
+                json.field("valid", false);
             }
         } else { // Raw Binary Slots
-            slotObj["type"] = "raw_binary";
+            json.field("type", "raw_binary");
             RawSlotInfoTypeDef rawInfo;
             if (extFlash.readBufferFromSlot(i, RAW_SLOT_HEADER_OFFSET, (uint8_t*)&rawInfo, sizeof(RawSlotInfoTypeDef))) {
                 if (rawInfo.magic == RAW_SLOT_MAGIC && rawInfo.valid == 1) {
-                    slotObj["filename"] = rawInfo.filename;
-                    slotObj["size"] = rawInfo.size;
-                    slotObj["crc32"] = rawInfo.crc32;
-                    slotObj["valid"] = true;
+                    rawInfo.filename[sizeof(rawInfo.filename) - 1] = '\0'; // Header sa flasha - bez garancije terminatora
+                    json.field("filename", rawInfo.filename);
+                    json.field("size", rawInfo.size);
+                    json.field("crc32", rawInfo.crc32);
+                    json.field("valid", true);
                 } else {
-                    slotObj["valid"] = false;
+                    json.field("valid", false);
                 }
             } else {
-                slotObj["error"] = "Read Failed";
-                slotObj["valid"] = false;
+                json.field("error", "Read Failed");
+                json.field("valid", false);
             }
         }
+        json.endObject();
     }
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    json.endArray();
+    json.endObject();
+    request->send(response);
   });
 
   // 3. Start Update Process
@@ -4004,6 +5055,11 @@ void setup()
     int slot = pSlot->value().toInt();
     int addr = pAddr->value().toInt();
 
+    if (isLogStoreSlot(slot)) {
+        sendJsonError(request, 400, "Slot reserved for log store");
+        return;
+    }
+
     // --- LOGIKA ADRESIRANJA PO SLOTOVIMA ---
     const uint32_t ADDR_FW_STAGING = 0x90F00000; // RT_NEW_FILE_ADDR (Firmware)
     const uint32_t ADDR_EXT_FLASH  = 0x90000000; // EXT_FLASH_ADDR (Resursi)
@@ -4028,7 +5084,7 @@ void setup()
         staging = hasStagingParam ? customStaging : ADDR_EXT_FLASH;  // Default Ext, dozvoljen override
     }
     
-    if (updateService.startUpdate(slot, addr, staging)) {
+    if (updateService.startUpdate(slot, addr, staging, &busFor(addr))) {
         sendJsonSuccess(request, "Update Started");
     } else {
         sendJsonError(request, 500, "Failed to start update (Busy or Invalid Slot)");
@@ -4079,6 +5135,412 @@ void setup()
     request->send(200, "text/plain", output);
   });
 
+  // 6. RS485 bus scheduler - dubina redova i čekanje po klasi prioriteta (?segment=N)
+  server->on("/bus_status", HTTP_GET, [](AsyncWebServerRequest *request) {
+    RS485Bus &bus = busSegmentParam(request);
+    JsonDocument doc;
+    JsonArray classes = doc["classes"].to<JsonArray>();
+    for (int c = 0; c < BUS_CLASS_COUNT; c++) {
+      BusClassStats st;
+      bus.getStats((BusClass)c, st);
+      JsonObject o = classes.add<JsonObject>();
+      o["class"] = RS485Bus::className((BusClass)c);
+      o["depth"] = st.depth;
+      o["capacity"] = st.capacity;
+      o["enqueued"] = st.enqueued;
+      o["rejected"] = st.rejected;
+      o["started"] = st.started;
+      o["aged"] = st.aged;
+      o["coalesced"] = st.coalesced;
+      o["wait_last_ms"] = st.waitLastMs;
+      o["wait_avg_ms"] = st.waitAvgMs;
+      o["wait_max_ms"] = st.waitMaxMs;
+    }
+
+    RoomCacheStats cs;
+    roomCache.getStats(cs);
+    JsonObject cache = doc["cache"].to<JsonObject>();
+    cache["used"] = cs.used;
+    cache["capacity"] = ROOM_CACHE_ENTRIES;
+    cache["hits"] = cs.hits;
+    cache["misses"] = cs.misses;
+    cache["stores"] = cs.stores;
+    cache["invalidations"] = cs.invalidations;
+
+    doc["baud"] = bus.baud();
+
+    JsonArray buffers = doc["buffers"].to<JsonArray>();
+    for (int c = 0; c < BUS_BUF_CLASSES; c++) {
+      BusBufferStats bs;
+      bus.getBufferStats(c, bs);
+      JsonObject o = buffers.add<JsonObject>();
+      o["size"] = bs.size;
+      o["count"] = bs.count;
+      o["in_use"] = bs.inUse;
+      o["peak"] = bs.peak;
+      o["allocs"] = bs.allocs;
+      o["fails"] = bs.fails;
+    }
+
+    BusRecoveryStats rec;
+    bus.getRecoveryStats(rec);
+    JsonObject recovery = doc["recovery"].to<JsonObject>();
+    recovery["count"] = rec.recoveries;
+    recovery["uart_reinits"] = rec.uartReinits;
+    recovery["aborted"] = rec.aborted;
+    recovery["discarded_bytes"] = rec.discardedBytes;
+    if (rec.lastAtMs != 0)
+      recovery["last_ago_ms"] = millis() - rec.lastAtMs;
+    else
+      recovery["last_ago_ms"] = nullptr;
+
+    RtcSyncStats rtc;
+    rtcSync[segmentParam(request)].getStats(rtc);
+    JsonObject rtcObj = doc["rtc_sync"].to<JsonObject>();
+    rtcObj["broadcasts"] = rtc.broadcasts;
+    rtcObj["deferred"] = rtc.deferredSends;
+    rtcObj["last_reason"] = rtc.lastReason;
+    if (rtc.broadcasts)
+      rtcObj["last_ago_ms"] = rtc.lastBroadcastAgoMs;
+    else
+      rtcObj["last_ago_ms"] = nullptr;
+    rtcObj["pending"] = rtc.pending;
+    rtcObj["checks"] = rtc.checks;
+    rtcObj["read_failures"] = rtc.readFailures;
+    if (rtc.lastDriftId != 0)
+    {
+      rtcObj["last_drift_s"] = rtc.lastDriftS;
+      rtcObj["last_drift_id"] = rtc.lastDriftId;
+    }
+
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+  });
+
+  // 7. RTT, timeout i circuit breaker po kontroleru (samo ID-evi sa mjerenjima ili greškama)
+  server->on("/controller_health", HTTP_GET, [](AsyncWebServerRequest *request) {
+    sendCursorStream(request, "application/json", produceControllerHealth);
+  });
+
+  // 8. Server-Sent Events - promjene stanja kontrolera (S_STATE)
+  server->addHandler(&events);
+
+  // 9. Roster - kontroleri koji su odgovorili na discovery sweep (?rescan=1 pokreće novi prolaz)
+  server->on("/roster", HTTP_GET, [](AsyncWebServerRequest *request) {
+    if (request->hasParam("rescan"))
+      roster.rescan();
+
+    sendCursorStream(request, "application/json", produceRoster);
+  });
+
+  // 10. RS485 frame trace - ?since=<seq> za inkrementalno čitanje, ?limit=N, ?format=bin, ?segment=N
+  server->on("/bus_trace", HTTP_GET, [](AsyncWebServerRequest *request) {
+    RS485Bus &bus = busSegmentParam(request);
+    uint32_t first, last;
+    bus.trace().bounds(first, last);
+
+    uint16_t limit = request->hasParam("limit") ? request->getParam("limit")->value().toInt() : 64;
+    if (limit == 0 || limit > BUS_TRACE_ENTRIES)
+      limit = BUS_TRACE_ENTRIES;
+    // Bez since -> zadnjih limit frame-ova
+    uint32_t from = request->hasParam("since") ? (uint32_t)request->getParam("since")->value().toInt() + 1
+                                               : ((last >= limit) ? last - limit + 1 : 1);
+
+    std::unique_ptr<BusTraceRecord[]> records(new BusTraceRecord[limit]);
+    uint16_t count = bus.trace().read(from, records.get(), limit);
+
+    if (request->hasParam("format") && request->getParam("format")->value() == "bin")
+    {
+      // [ "BTR1" ][u16 record size][u16 count][u32 first][u32 last][u32 now_us] + zapisi (little-endian)
+      struct __attribute__((packed)) {
+        char magic[4];
+        uint16_t recordSize;
+        uint16_t count;
+        uint32_t first;
+        uint32_t last;
+        uint32_t nowUs;
+      } header = {{'B', 'T', 'R', '1'}, sizeof(BusTraceRecord), count, first, last, (uint32_t)micros()};
+
+      AsyncResponseStream *response = request->beginResponseStream("application/octet-stream");
+      response->write((const uint8_t *)&header, sizeof(header));
+      response->write((const uint8_t *)records.get(), count * sizeof(BusTraceRecord));
+      request->send(response);
+      return;
+    }
+
+    JsonDocument doc;
+    doc["first_seq"] = first;
+    doc["last_seq"] = last;
+    doc["now_us"] = (uint32_t)micros();
+    JsonArray frames = doc["frames"].to<JsonArray>();
+    for (int i = 0; i < count; i++)
+    {
+      const BusTraceRecord &r = records[i];
+      JsonObject f = frames.add<JsonObject>();
+      f["seq"] = r.seq;
+      f["t_us"] = r.timeUs;
+      f["dir"] = (r.dir == BUS_TRACE_TX) ? "tx" : "rx";
+      f["status"] = BusTrace::statusName(r.status);
+      f["frame_id"] = r.frameId;
+      f["type"] = r.type;
+      f["len"] = r.len;
+
+      char hex[BUS_TRACE_PREFIX * 3 + 1];
+      int pos = 0;
+      for (int b = 0; b < r.prefixLen; b++)
+        pos += sprintf(hex + pos, b ? " %02X" : "%02X", r.data[b]);
+      hex[pos] = 0;
+      f["data"] = hex;
+    }
+
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+  });
+
+  // 11. Prometheus metrike - brojači busa i RTT histogrami po komandi i kontroleru
+  server->on("/metrics", HTTP_GET, [](AsyncWebServerRequest *request) {
+    sendCursorStream(request, "text/plain; version=0.0.4", produceMetrics);
+  });
+
+  // 12. Routing ID -> RS485 segment; ?first=10&last=40&segment=1 mijenja i čuva u NVS
+  server->on("/bus_routes", HTTP_GET, [](AsyncWebServerRequest *request) {
+    if (request->hasParam("first") && request->hasParam("segment"))
+    {
+      int first = request->getParam("first")->value().toInt();
+      int last = request->hasParam("last") ? request->getParam("last")->value().toInt() : first;
+      int segment = request->getParam("segment")->value().toInt();
+      if (segment < 0 || segment >= RS485_SEGMENTS || first < 1 || last > ROUTING_MAX_ID || first > last ||
+          !busRouting.setRange(first, last, segment))
+      {
+        sendJsonError(request, 400, "Invalid route (first/last 1-254, segment < " + String(RS485_SEGMENTS) + ")");
+        return;
+      }
+    }
+
+    JsonDocument doc;
+    doc["segments"] = RS485_SEGMENTS;
+    JsonArray routes = doc["routes"].to<JsonArray>();
+    uint8_t first, last, segment;
+    for (int id = 1; busRouting.nextRange(id, first, last, segment); id = last + 1)
+    {
+      JsonObject r = routes.add<JsonObject>();
+      r["first"] = first;
+      r["last"] = last;
+      r["segment"] = segment;
+    }
+
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+  });
+
+  // 13. Brzina busa po segmentu; ?negotiate=1 vraća osnovnu brzinu i pregovara ispočetka
+  server->on("/bus_speed", HTTP_GET, [](AsyncWebServerRequest *request) {
+    bool negotiate = request->hasParam("negotiate");
+
+    JsonDocument doc;
+    JsonArray segments = doc["segments"].to<JsonArray>();
+    for (int s = 0; s < RS485_SEGMENTS; s++)
+    {
+      if (negotiate)
+        busSpeed[s].negotiate();
+
+      BusSpeedStatus st;
+      busSpeed[s].getStatus(st);
+      JsonObject o = segments.add<JsonObject>();
+      o["segment"] = s;
+      o["baud"] = busSegments[s]->baud();
+      o["state"] = BusSpeed::stateName(st.state);
+      o["negotiated_baud"] = BusSpeed::rate(st.rateIdx);
+      if (st.state == BAUD_STATE_SWITCHING || st.state == BAUD_STATE_VERIFY)
+        o["target_baud"] = BusSpeed::rate(st.targetIdx);
+      o["controllers"] = st.controllers;
+      JsonArray common = o["supported"].to<JsonArray>();
+      for (int i = 0; i < BAUD_RATE_COUNT; i++)
+        if (st.commonMask & (1 << i))
+          common.add(BusSpeed::rate(i));
+      o["switches"] = st.switches;
+      o["fallbacks"] = st.fallbacks;
+      o["last_fallback"] = st.lastFallback;
+      if (st.blockedIdx != 0)
+      {
+        o["blocked_baud"] = BusSpeed::rate(st.blockedIdx);
+        o["blocked_for_ms"] = st.blockedForMs;
+      }
+    }
+
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+  });
+
+  // 14. Pražnjenje access loga kontrolera kao NDJSON stream; ?ID=n[&limit=N][&delete=0]
+  server->on("/logs/drain", HTTP_GET, [](AsyncWebServerRequest *request) {
+    if (otaUpdateInProgress)
+    {
+      sendJsonError(request, 503, "OTA update in progress");
+      return;
+    }
+
+    int id = request->hasParam("ID") ? request->getParam("ID")->value().toInt() : 0;
+    if (id < 1 || id > ROSTER_MAX_ID)
+    {
+      sendJsonError(request, 400, "Missing or invalid ID parameter");
+      return;
+    }
+
+    int limit = request->hasParam("limit") ? request->getParam("limit")->value().toInt() : LOG_DRAIN_MAX_LIMIT;
+    if (limit < 1 || limit > LOG_DRAIN_MAX_LIMIT)
+      limit = LOG_DRAIN_MAX_LIMIT;
+    bool remove = !(request->hasParam("delete") && request->getParam("delete")->value() == "0");
+
+    if (!controllerHealth.allowRequest(id))
+    {
+      sendJsonError(request, 504, "Controller offline (circuit open)");
+      return;
+    }
+
+    if (logCollector.owns(id))
+    {
+      sendJsonError(request, 409, "Log collector is reading this ID, retry");
+      return;
+    }
+
+    bool busy;
+    LogDrainJob *job = logDrain.start(busFor(id), id, remove, limit, busy);
+    if (job == NULL)
+    {
+      if (busy)
+        sendJsonError(request, 409, "Log drain already running for this ID");
+      else
+        sendJsonError(request, 503, "All log drain slots busy, retry");
+      return;
+    }
+
+    AsyncWebServerResponse *response = request->beginChunkedResponse("application/x-ndjson",
+      [job](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+        return logDrain.fill(job, buffer, maxLen);
+      });
+    request->onDisconnect([job]() { logDrain.detach(job); });
+    request->send(response);
+  });
+
+  // 15. Logovi iz LogStore-a (bez busa); ?card=HEX10&ID=n&from=dd.mm.yyyy&to=dd.mm.yyyy&days=N&limit=N
+  server->on("/logs/query", HTTP_GET, [](AsyncWebServerRequest *request) {
+    if (!logStore.ready())
+    {
+      sendJsonError(request, 503, "Log store not available");
+      return;
+    }
+
+    LogQueryStream *stream = new LogQueryStream();
+    if (stream == NULL)
+    {
+      sendJsonError(request, 503, "Out of memory");
+      return;
+    }
+    LogQuery &q = stream->query;
+    q.fromDay = LOG_DAY_ANY_FROM;
+    q.toDay = LOG_DAY_ANY_TO;
+
+    const char *error = NULL;
+    if (request->hasParam("ID"))
+    {
+      int id = request->getParam("ID")->value().toInt();
+      if (id < 1 || id > ROSTER_MAX_ID)
+        error = "Invalid ID (must be 1-254)";
+      q.id = id;
+    }
+    if (request->hasParam("card"))
+    {
+      String card = request->getParam("card")->value();
+      q.byCard = true;
+      if (card.length() != 10)
+        error = "Invalid card (10 hex digits)";
+      for (int i = 0; i < 5 && error == NULL; i++)
+      {
+        char hex[3] = {card[i * 2], card[i * 2 + 1], 0};
+        char *end;
+        q.card[i] = strtoul(hex, &end, 16);
+        if (*end != 0)
+          error = "Invalid card (10 hex digits)";
+      }
+    }
+    if (request->hasParam("days"))
+    {
+      int days = request->getParam("days")->value().toInt();
+      struct tm timeinfo;
+      if (!timeValid || !getLocalTime(&timeinfo, 0))
+        error = "Time not synchronized, use from/to";
+      else if (days < 1 || days > 3650)
+        error = "Invalid days";
+      else
+      {
+        q.toDay = LogStore::dayNumber(timeinfo.tm_mday, timeinfo.tm_mon + 1, timeinfo.tm_year + 1900);
+        q.fromDay = (q.toDay > days) ? q.toDay - days + 1 : 1;
+      }
+    }
+    if (request->hasParam("from") && (q.fromDay = parseLogDay(request->getParam("from")->value())) == 0)
+      error = "Invalid from (dd.mm.yyyy)";
+    if (request->hasParam("to") && (q.toDay = parseLogDay(request->getParam("to")->value())) == 0)
+      error = "Invalid to (dd.mm.yyyy)";
+
+    int limit = request->hasParam("limit") ? request->getParam("limit")->value().toInt() : 100;
+    stream->limit = (limit >= 1 && limit <= LOG_DRAIN_MAX_LIMIT) ? limit : LOG_DRAIN_MAX_LIMIT;
+
+    if (error != NULL)
+    {
+      delete stream;
+      sendJsonError(request, 400, error);
+      return;
+    }
+
+    logStore.startQuery(q);
+    AsyncWebServerResponse *response = request->beginChunkedResponse("application/x-ndjson",
+      [stream](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+        return fillLogQuery(stream, buffer, maxLen);
+      });
+    request->onDisconnect([stream]() { delete stream; });
+    request->send(response);
+  });
+
+  // 16. LogStore i pozadinski kolektor
+  server->on("/logs/status", HTTP_GET, [](AsyncWebServerRequest *request) {
+    LogStoreStats st;
+    LogCollectorStats col;
+    logStore.getStats(st);
+    logCollector.getStats(col);
+
+    JsonDocument doc;
+    JsonObject store = doc["store"].to<JsonObject>();
+    store["ready"] = logStore.ready();
+    store["slot"] = LOG_STORE_SLOT;
+    store["records"] = st.records;
+    store["capacity"] = st.capacity;
+    store["appended"] = st.appended;
+    store["overwritten"] = st.overwritten;
+    store["write_failures"] = st.writeFailures;
+    store["next_seq"] = st.nextSeq;
+
+    JsonObject c = doc["collector"].to<JsonObject>();
+    c["collected"] = col.collected;
+    c["duplicates"] = col.duplicates;
+    c["read_failures"] = col.readFailures;
+    c["delete_failures"] = col.deleteFailures;
+    c["store_failures"] = col.storeFailures;
+    c["rounds"] = col.rounds;
+    c["current_id"] = col.currentId;
+
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+  });
+
+  // 17. Imenovane sekvence komandi jednog kontrolera (check-in); ?NAME=CHECKIN&ID=n&...
+  server->on("/macro", HTTP_GET, handleMacroRequest);
+
   server->begin();
   LOG_INFO_LN("Update server on http://%s:%d/update", WiFi.localIP().toString().c_str(), _port);
   
@@ -4104,36 +5566,28 @@ void loop()
     ESP.restart();
   }
   
+  // Oporavak RS485 busa se ponavlja bez uspjeha - restart kao zadnja opcija
+  for (int s = 0; s < RS485_SEGMENTS; s++) {
+    if (busSegments[s]->recoveryExhausted()) {
+      LOG_ERROR("[RS485] Segment %d recovery failed %d times in %d s. Restarting...\n", s, BUS_RECOVER_MAX, BUS_RECOVER_WINDOW_MS / 1000);
+      delay(1000);
+      ESP.restart();
+    }
+  }
+  
   updateService.loop();
+  handleBusEvents(); // SOS, S_STATE i IR iz listenera bus taska
 
   unsigned long buttonPressStart = 0;
-  static uint32_t tick = millis();
+  uint32_t tick = millis();
   static unsigned long wifiCheckTimer = 0;
+  static uint32_t breakerProbeTimer = 0;
+  static uint32_t rosterTimer = 0;
 
   esp_task_wdt_reset();
 
   checkLed(); // onboard LED signal aktivnosti
 
-  if (tick != millis()) // TinyFrame tick
-  {
-    tick = millis();
-    TF_Tick(&tfapp);
-  }
-
-  while (Serial2.available()) // Obrada dolaznih bajtova preko Serial2 (RS485)
-  {
-    if (otaUpdateInProgress) {
-      break;
-    }
-
-    // NE čitaj Serial2 ako HTTP handler trenutno čeka odgovor!
-    if (!httpHandlerWaiting) {
-      TF_AcceptChar(&tfapp, Serial2.read());
-    } else {
-      break;  // Pusti HTTP handler da čita
-    }
-  }
-
   if (digitalRead(BOOT_PIN) == LOW) // WiFi reset putem dugmeta (BOOT dugme)
   {
     digitalWrite(LED_PIN, HIGH);
@@ -4194,6 +5648,25 @@ void loop()
     }
   }
 
+  if (tick - breakerProbeTimer >= 250) // najviše jedna proba mrtvog kontrolera po intervalu
+  {
+    breakerProbeTimer = tick;
+    probeOpenBreakers();
+  }
+
+  if (tick - rosterTimer >= ROSTER_STEP_MS) // discovery sweep - jedan upit u letu, NVS upis promjena
+  {
+    rosterTimer = tick;
+    runRosterSweep();
+    roster.flush();
+    runBusSpeed();
+    runRtcSync();
+  }
+
+  logDrain.tick(); // /logs/drain: upiti odbijeni zbog punog reda, istek napuštenih sesija
+  logCollector.tick(); // READ_LOG/DELETE_LOG u praznim slotovima busa -> LogStore
+  bulkCommand.tick(); // ID liste: upiti odbijeni zbog punog reda
+
   for (int i = 0; i < MAX_PULSE_PINS; i++) // reset pina setovanog sa puls komandom
   {
     if (pulseStates[i].active && (millis() - pulseStates[i].pulseStart >= pulseStates[i].duration))
@@ -0,0 +1,275 @@
+// Host benchmark: stari if-lanac stringToCommand() protiv commandFromName() (binarna pretraga).
+// Provjerava da oba daju istu komandu za svako ime i za promašaje, pa mjeri ns po pozivu.
+// Build i pokretanje: make -C fw/test/host run
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "CommandTable.h"
+
+// stringToCommand() prije tabele; std::string umjesto Arduino String-a (isti operator== sa literalom)
+static CommandType stringToCommand(const std::string &cmd)
+{
+  if (cmd == "RESTART")
+    return CMD_RESTART;
+  if (cmd == "RESTART_CTRL")
+    return CMD_RESTART_CTRL;
+  if (cmd == "GET_STATUS")
+    return CMD_GET_STATUS;
+  if (cmd == "GET_SSID_PSWRD")
+    return CMD_GET_SSID_PSWRD;
+  if (cmd == "SET_SSID_PSWRD")
+    return CMD_SET_SSID_PSWRD;
+  if (cmd == "GET_MDNS_NAME")
+    return CMD_GET_MDNS_NAME;
+  if (cmd == "SET_MDNS_NAME")
+    return CMD_SET_MDNS_NAME;
+  if (cmd == "GET_TCPIP_PORT")
+    return CMD_GET_TCPIP_PORT;
+  if (cmd == "SET_TCPIP_PORT")
+    return CMD_SET_TCPIP_PORT;
+  if (cmd == "GET_ROOM_TEMP")
+    return CMD_GET_ROOM_TEMP;
+  if (cmd == "ESP_GET_PINS")
+    return CMD_ESP_GET_PINS;
+  if (cmd == "ESP_SET_PIN")
+    return CMD_ESP_SET_PIN;
+  if (cmd == "ESP_RESET_PIN")
+    return CMD_ESP_RESET_PIN;
+  if (cmd == "ESP_PULSE_PIN")
+    return CMD_ESP_PULSE_PIN;
+  if (cmd == "GET_PINS")
+    return CMD_GET_PINS;
+  if (cmd == "SET_PIN")
+    return CMD_SET_PIN;
+  if (cmd == "OPEN_DOOR")
+    return CMD_OPEN_DOOR;
+  if (cmd == "SET_THST_ON")
+    return CMD_SET_THST_ON;
+  if (cmd == "GET_FAN_DIFFERENCE")
+    return CMD_GET_FAN_DIFFERENCE;
+  if (cmd == "GET_FAN_BAND")
+    return CMD_GET_FAN_BAND;
+  if (cmd == "SET_GUEST_IN_TEMP")
+    return CMD_SET_GUEST_IN_TEMP;
+  if (cmd == "SET_GUEST_OUT_TEMP")
+    return CMD_SET_GUEST_OUT_TEMP;
+  if (cmd == "SET_ROOM_TEMP")
+    return CMD_SET_ROOM_TEMP;
+  if (cmd == "GET_GUEST_IN_TEMP")
+    return CMD_GET_GUEST_IN_TEMP;
+  if (cmd == "GET_GUEST_OUT_TEMP")
+    return CMD_GET_GUEST_OUT_TEMP;
+  if (cmd == "SET_THST_HEATING")
+    return CMD_SET_THST_HEATING;
+  if (cmd == "SET_THST_COOLING")
+    return CMD_SET_THST_COOLING;
+  if (cmd == "SET_THST_OFF")
+    return CMD_SET_THST_OFF;
+  if (cmd == "SET_PASSWORD")
+    return CMD_SET_PASSWORD;
+  if (cmd == "GET_PASSWORD")
+    return CMD_GET_PASSWORD;
+  if (cmd == "READ_LOG")
+    return CMD_READ_LOG;
+  if (cmd == "DELETE_LOG")
+    return CMD_DELETE_LOG;
+  if (cmd == "GET_IP_ADDRESS")
+    return CMD_GET_IP_ADDRESS;
+  if (cmd == "GET_TIMER")
+    return CMD_GET_TIMER;
+  if (cmd == "SET_TIMER")
+    return CMD_SET_TIMER;
+  if (cmd == "GET_TIME")
+    return CMD_GET_TIME;
+  if (cmd == "SET_TIME")
+    return CMD_SET_TIME;
+  if (cmd == "OUTDOOR_LIGHT_ON")
+    return CMD_OUTDOOR_LIGHT_ON;
+  if (cmd == "OUTDOOR_LIGHT_OFF")
+    return CMD_OUTDOOR_LIGHT_OFF;
+  if (cmd == "GET_PINGWDG")
+    return CMD_GET_PINGWDG;
+  if (cmd == "PINGWDG_ON")
+    return CMD_PINGWDG_ON;
+  if (cmd == "PINGWDG_OFF")
+    return CMD_PINGWDG_OFF;
+  if (cmd == "TH_SETPOINT")
+    return CMD_TH_SETPOINT;
+  if (cmd == "TH_DIFF")
+    return CMD_TH_DIFF;
+  if (cmd == "TH_STATUS")
+    return CMD_TH_STATUS;
+  if (cmd == "TH_HEATING")
+    return CMD_TH_HEATING;
+  if (cmd == "TH_COOLING")
+    return CMD_TH_COOLING;
+  if (cmd == "TH_OFF")
+    return CMD_TH_OFF;
+  if (cmd == "TH_ON")
+    return CMD_TH_ON;
+  if (cmd == "TH_EMA")
+    return CMD_TH_EMA;
+  if (cmd == "SET_LANG")
+    return CMD_SET_LANG;
+  if (cmd == "GET_SYSID")
+    return CMD_GET_SYSID;
+  if (cmd == "SET_SYSID")
+    return CMD_SET_SYSID;
+  if (cmd == "QR_CODE_SET")
+    return CMD_QR_CODE_SET;
+  if (cmd == "QR_CODE_GET")
+    return CMD_QR_CODE_GET;
+  if (cmd == "GET_ROOM_STATUS")
+    return CMD_GET_ROOM_STATUS;
+  if (cmd == "SOS_RESET")
+    return CMD_SOS_RESET;
+  if (cmd == "SET_FWD_HEATING")
+    return CMD_SET_FWD_HEATING;
+  if (cmd == "SET_FWD_COOLING")
+    return CMD_SET_FWD_COOLING;
+  if (cmd == "SET_ENABLE_HEATING")
+    return CMD_SET_ENABLE_HEATING;
+  if (cmd == "SET_ENABLE_COOLING")
+    return CMD_SET_ENABLE_COOLING;
+  if (cmd == "GET_VERSION")
+    return CMD_GET_VERSION;
+  if (cmd == "SET_IR_PROTOCOL")
+    return CMD_SET_IR_PROTOCOL;
+  if (cmd == "GET_IR_PROTOCOL")
+    return CMD_GET_IR_PROTOCOL;
+  if (cmd == "SET_IR")
+    return CMD_SET_IR;
+  return CMD_UNKNOWN;
+}
+
+static const char *const NAMES[] = {
+  "RESTART",
+  "RESTART_CTRL",
+  "GET_STATUS",
+  "GET_SSID_PSWRD",
+  "SET_SSID_PSWRD",
+  "GET_MDNS_NAME",
+  "SET_MDNS_NAME",
+  "GET_TCPIP_PORT",
+  "SET_TCPIP_PORT",
+  "GET_ROOM_TEMP",
+  "ESP_GET_PINS",
+  "ESP_SET_PIN",
+  "ESP_RESET_PIN",
+  "ESP_PULSE_PIN",
+  "GET_PINS",
+  "SET_PIN",
+  "OPEN_DOOR",
+  "SET_THST_ON",
+  "GET_FAN_DIFFERENCE",
+  "GET_FAN_BAND",
+  "SET_GUEST_IN_TEMP",
+  "SET_GUEST_OUT_TEMP",
+  "SET_ROOM_TEMP",
+  "GET_GUEST_IN_TEMP",
+  "GET_GUEST_OUT_TEMP",
+  "SET_THST_HEATING",
+  "SET_THST_COOLING",
+  "SET_THST_OFF",
+  "SET_PASSWORD",
+  "GET_PASSWORD",
+  "READ_LOG",
+  "DELETE_LOG",
+  "GET_IP_ADDRESS",
+  "GET_TIMER",
+  "SET_TIMER",
+  "GET_TIME",
+  "SET_TIME",
+  "OUTDOOR_LIGHT_ON",
+  "OUTDOOR_LIGHT_OFF",
+  "GET_PINGWDG",
+  "PINGWDG_ON",
+  "PINGWDG_OFF",
+  "TH_SETPOINT",
+  "TH_DIFF",
+  "TH_STATUS",
+  "TH_HEATING",
+  "TH_COOLING",
+  "TH_OFF",
+  "TH_ON",
+  "TH_EMA",
+  "SET_LANG",
+  "GET_SYSID",
+  "SET_SYSID",
+  "QR_CODE_SET",
+  "QR_CODE_GET",
+  "GET_ROOM_STATUS",
+  "SOS_RESET",
+  "SET_FWD_HEATING",
+  "SET_FWD_COOLING",
+  "SET_ENABLE_HEATING",
+  "SET_ENABLE_COOLING",
+  "GET_VERSION",
+  "SET_IR_PROTOCOL",
+  "GET_IR_PROTOCOL",
+  "SET_IR",
+};
+static const size_t NAME_COUNT = sizeof(NAMES) / sizeof(NAMES[0]);
+
+// Promašaji: prazno, prefiks, produžetak, mala slova, zadnji znak promijenjen
+static const char *const MISSES[] = {
+  "",
+  "GET",
+  "SET_",
+  "RESTART_",
+  "SET_IRX",
+  "get_pins",
+  "GET_PINZ",
+  "UNKNOWN_COMMAND",
+  "ZZZ",
+  "AAA",
+};
+static const size_t MISS_COUNT = sizeof(MISSES) / sizeof(MISSES[0]);
+
+#define BENCH_ROUNDS 20000
+
+static volatile int sink; // Da optimizator ne izbaci pozive
+
+template <class F>
+static double nsPerLookup(const std::string *inputs, size_t count, F lookup)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < BENCH_ROUNDS; r++)
+    for (size_t i = 0; i < count; i++)
+      sink += lookup(inputs[i]);
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / ((double)BENCH_ROUNDS * count);
+}
+
+int main()
+{
+  std::string inputs[NAME_COUNT + MISS_COUNT];
+  size_t count = 0;
+  int mismatches = 0;
+
+  for (size_t i = 0; i < NAME_COUNT; i++)
+    inputs[count++] = NAMES[i];
+  for (size_t i = 0; i < MISS_COUNT; i++)
+    inputs[count++] = MISSES[i];
+
+  for (size_t i = 0; i < count; i++)
+  {
+    CommandType before = stringToCommand(inputs[i]);
+    CommandType after = commandFromName(inputs[i].c_str(), inputs[i].size());
+    if (before != after)
+    {
+      printf("MISMATCH '%s': chain 0x%02X, table 0x%02X\n", inputs[i].c_str(), before, after);
+      mismatches++;
+    }
+  }
+
+  double chain = nsPerLookup(inputs, count, [](const std::string &s) { return (int)stringToCommand(s); });
+  double table = nsPerLookup(inputs, count, [](const std::string &s) { return (int)commandFromName(s.c_str(), s.size()); });
+
+  printf("%zu names + %zu misses, %d rounds\n", NAME_COUNT, MISS_COUNT, BENCH_ROUNDS);
+  printf("if-chain:     %7.1f ns/lookup\n", chain);
+  printf("sorted table: %7.1f ns/lookup\n", table);
+  printf("%s\n", mismatches ? "FAIL" : "OK");
+  return mismatches ? 1 : 0;
+}
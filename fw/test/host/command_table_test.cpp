@@ -0,0 +1,287 @@
+// Host testovi za CommandTable: encodeCommand (opseg, nedostajući parametri, posebni enkoderi)
+// i decodeReply (replyCode/replyMin, failed/ACK pravilo, dekoderi).
+// Build i pokretanje: make -C fw/test/host test
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "CommandTable.h"
+
+static int failures = 0;
+static int checks = 0;
+
+#define CHECK(cond) do { checks++; if (!(cond)) { failures++; printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); } } while (0)
+#define CHECK_STR(actual, expected) do { checks++; std::string a_ = (actual); if (a_ != (expected)) { failures++; \
+    printf("FAIL %s:%d: '%s' != '%s'\n", __FILE__, __LINE__, a_.c_str(), (expected)); } } while (0)
+
+// Parametri zahtjeva kao lista "NAME", "value", ..., NULL
+static const char* lookupParam(void* ctx, const char* name) {
+    const char* const* p = (const char* const*)ctx;
+    for (; p[0] != NULL; p += 2) {
+        if (strcmp(p[0], name) == 0) return p[1];
+    }
+    return NULL;
+}
+
+struct Encoded {
+    int len;
+    uint8_t buf[2 + QR_CODE_MAX_LEN + 1];
+    CommandFault fault;
+};
+
+static Encoded encode(CommandType cmd, const char* const* params) {
+    Encoded e;
+    memset(&e, 0, sizeof(e));
+    const CommandDescriptor* d = findCommand(cmd);
+    if (d == NULL) {
+        e.len = -1;
+        return e;
+    }
+    CommandInput in = {(void*)params, lookupParam};
+    e.len = encodeCommand(*d, in, e.buf, sizeof(e.buf), e.fault);
+    return e;
+}
+
+// Odgovor kao "key=value;" redom kojim ga dekoder upisuje; greška kao "error=..."
+static void putInt(void* ctx, const char* key, int32_t value) {
+    *(std::string*)ctx += std::string(key) + "=" + std::to_string(value) + ";";
+}
+static void putBool(void* ctx, const char* key, bool value) {
+    *(std::string*)ctx += std::string(key) + "=" + (value ? "true" : "false") + ";";
+}
+static void putText(void* ctx, const char* key, const char* value) {
+    *(std::string*)ctx += std::string(key) + "=" + (value ? value : "null") + ";";
+}
+static void putError(void* ctx, const char* message) {
+    *(std::string*)ctx += std::string("error=") + message + ";";
+}
+
+static std::string decode(CommandType cmd, const uint8_t* reply, uint16_t len) {
+    std::string out;
+    ReplyWriter w = {&out, putInt, putBool, putText, putError};
+    if (!decodeReply(*findCommand(cmd), reply, len, w)) return "raw";
+    return out;
+}
+
+static void testGenericEncoder() {
+    const char* const ok[] = {"ID", "12", "VALUE", "22", NULL};
+    Encoded e = encode(CMD_SET_GUEST_IN_TEMP, ok);
+    CHECK(e.len == 3);
+    CHECK(e.buf[0] == CMD_SET_GUEST_IN_TEMP && e.buf[1] == 12 && e.buf[2] == 22);
+    CHECK(e.fault.code == 0);
+
+    const char* const word[] = {"ID", "3", "VALUE", "4660", NULL};
+    e = encode(CMD_SET_SYSID, word);
+    CHECK(e.len == 4);
+    CHECK(e.buf[2] == 0x12 && e.buf[3] == 0x34); // PARAM_WORD: MSB prvi
+
+    const char* const none[] = {"ID", "7", NULL};
+    e = encode(CMD_OPEN_DOOR, none);
+    CHECK(e.len == 2 && e.buf[0] == CMD_OPEN_DOOR && e.buf[1] == 7);
+}
+
+static void testRangeErrors() {
+    const char* const high[] = {"ID", "12", "VALUE", "41", NULL};
+    Encoded e = encode(CMD_SET_GUEST_IN_TEMP, high);
+    CHECK(e.len == 0 && e.fault.code == 400);
+    CHECK_STR(e.fault.message, "Invalid VALUE (must be 5-40)");
+
+    const char* const hint[] = {"ID", "12", "PIN", "3", "VALUE", "2", NULL};
+    e = encode(CMD_SET_PIN, hint);
+    CHECK_STR(e.fault.message, "Invalid VALUE (must be 0 or 1)");
+
+    const char* const id0[] = {"ID", "0", NULL};
+    e = encode(CMD_OPEN_DOOR, id0);
+    CHECK(e.fault.code == 400);
+    CHECK_STR(e.fault.message, "Invalid ID (must be 1-254)");
+
+    const char* const id255[] = {"ID", "255", NULL};
+    e = encode(CMD_OPEN_DOOR, id255);
+    CHECK(e.len == 0 && e.fault.code == 400);
+
+    // strtol do kraja stringa: "5abc" i prazna vrijednost se odbijaju (String::toInt ih je prihvatao)
+    const char* const trailing[] = {"ID", "12", "VALUE", "22abc", NULL};
+    e = encode(CMD_SET_GUEST_IN_TEMP, trailing);
+    CHECK_STR(e.fault.message, "Invalid VALUE (must be 5-40)");
+
+    const char* const empty[] = {"ID", "", NULL};
+    e = encode(CMD_OPEN_DOOR, empty);
+    CHECK(e.len == 0 && e.fault.code == 400);
+
+    const char* const qrLong[] = {"ID", "1", "QR_CODE",
+        "0123456789012345678901234567890123456789012345678901234567890123"
+        "01234567890123456789012345678901234567890123456789012345678901234", NULL}; // 129
+    e = encode(CMD_QR_CODE_SET, qrLong);
+    CHECK_STR(e.fault.message, "Invalid QR_CODE (length 0-128)");
+}
+
+static void testMissingParams() {
+    const char* const noId[] = {"VALUE", "22", NULL};
+    Encoded e = encode(CMD_SET_GUEST_IN_TEMP, noId);
+    CHECK(e.len == 0 && e.fault.code == 400);
+    CHECK_STR(e.fault.message, "Missing ID or VALUE");
+
+    const char* const onlyId[] = {"ID", "5", NULL};
+    e = encode(CMD_SET_PIN, onlyId);
+    CHECK_STR(e.fault.message, "Missing ID, PIN or VALUE");
+
+    e = encode(CMD_SET_PASSWORD, onlyId);
+    CHECK_STR(e.fault.message, "Missing ID or TYPE");
+}
+
+static void testPasswordEncoder() {
+    const char* const guest[] = {"ID", "12", "TYPE", "GUEST", "GUEST_ID", "1", "PASSWORD", "1234",
+                                 "EXPIRY", "1200201026", NULL};
+    Encoded e = encode(CMD_SET_PASSWORD, guest);
+    CHECK(e.len == 2 + 18 + 1);
+    CHECK(e.buf[0] == CMD_SET_PASSWORD && e.buf[1] == 12);
+    CHECK_STR((const char*)e.buf + 2, "G1,1234,1200201026");
+
+    const char* const maid[] = {"ID", "12", "TYPE", "MAID", "PASSWORD", "55", NULL};
+    e = encode(CMD_SET_PASSWORD, maid);
+    CHECK_STR((const char*)e.buf + 2, "H55");
+
+    // DELETE_GUEST ne traži PASSWORD
+    const char* const del[] = {"ID", "12", "TYPE", "DELETE_GUEST", "GUEST_ID", "3", NULL};
+    e = encode(CMD_SET_PASSWORD, del);
+    CHECK(e.len == 2 + 3 + 1);
+    CHECK_STR((const char*)e.buf + 2, "G3X");
+
+    const char* const delRange[] = {"ID", "12", "TYPE", "DELETE_GUEST", "GUEST_ID", "9", NULL};
+    e = encode(CMD_SET_PASSWORD, delRange);
+    CHECK_STR(e.fault.message, "Invalid GUEST_ID (must be 1-8)");
+
+    const char* const digits[] = {"ID", "12", "TYPE", "MAID", "PASSWORD", "12a", NULL};
+    e = encode(CMD_SET_PASSWORD, digits);
+    CHECK_STR(e.fault.message, "Password must contain only digits");
+
+    const char* const type[] = {"ID", "12", "TYPE", "OWNER", "PASSWORD", "1", NULL};
+    e = encode(CMD_SET_PASSWORD, type);
+    CHECK_STR(e.fault.message, "Invalid TYPE (must be GUEST, MAID, MANAGER, SERVICE or DELETE_GUEST)");
+
+    const char* const noPassword[] = {"ID", "12", "TYPE", "GUEST", "GUEST_ID", "1", NULL};
+    e = encode(CMD_SET_PASSWORD, noPassword);
+    CHECK_STR(e.fault.message, "Missing PASSWORD parameter");
+
+    const char* const noExpiry[] = {"ID", "12", "TYPE", "GUEST", "GUEST_ID", "1", "PASSWORD", "1", NULL};
+    e = encode(CMD_SET_PASSWORD, noExpiry);
+    CHECK_STR(e.fault.message, "Missing EXPIRY parameter");
+
+    const char* const badExpiry[] = {"ID", "12", "TYPE", "GUEST", "GUEST_ID", "1", "PASSWORD", "1", "EXPIRY", "12002010", NULL};
+    e = encode(CMD_SET_PASSWORD, badExpiry);
+    CHECK_STR(e.fault.message, "Invalid EXPIRY format (must be HHMMDDMMYY)");
+
+    const char* const get[] = {"ID", "4", "TYPE", "GUEST", "GUEST_ID", "2", NULL};
+    e = encode(CMD_GET_PASSWORD, get);
+    CHECK(e.len == 4 && e.buf[2] == 'G' && e.buf[3] == 2);
+
+    const char* const getStaff[] = {"ID", "4", "TYPE", "SERVICE", NULL};
+    e = encode(CMD_GET_PASSWORD, getStaff);
+    CHECK(e.len == 3 && e.buf[2] == 'S');
+}
+
+static void testPinEncoders() {
+    const char* const set[] = {"ID", "9", "PIN", "3", "VALUE", "1", NULL};
+    Encoded e = encode(CMD_SET_PIN, set);
+    CHECK(e.len == 5);
+    CHECK(e.buf[0] == CMD_SET_PIN && e.buf[1] == 9 && e.buf[2] == 254 && e.buf[3] == 3 && e.buf[4] == 1);
+
+    const char* const pin0[] = {"ID", "9", "PIN", "0", "VALUE", "1", NULL};
+    e = encode(CMD_SET_PIN, pin0);
+    CHECK_STR(e.fault.message, "Invalid PIN (must be 1-6)");
+
+    const char* const get[] = {"ID", "9", NULL};
+    e = encode(CMD_GET_PINS, get);
+    CHECK(e.len == 3 && e.buf[0] == CMD_SET_PIN && e.buf[1] == 9 && e.buf[2] == CMD_GET_PINS);
+}
+
+static void testQrEncoder() {
+    const char* const qr[] = {"ID", "20", "QR_CODE", "ABC123", NULL};
+    Encoded e = encode(CMD_QR_CODE_SET, qr);
+    CHECK(e.len == 2 + 6); // Terminator nije dio frame-a
+    CHECK(e.buf[0] == CMD_QR_CODE_SET && e.buf[1] == 20);
+    CHECK(memcmp(e.buf + 2, "ABC123", 6) == 0 && e.buf[8] == 0);
+
+    const char* const empty[] = {"ID", "20", "QR_CODE", "", NULL};
+    e = encode(CMD_QR_CODE_SET, empty);
+    CHECK(e.len == 2);
+}
+
+static void testDecodeResultAndNak() {
+    const uint8_t thst[] = {CMD_SET_THST_ON};
+    CHECK_STR(decode(CMD_SET_THST_ON, thst, sizeof(thst)), "result=Thermostat set OK;");
+
+    const uint8_t qrAck[] = {CMD_QR_CODE_SET, COMMAND_ACK};
+    CHECK_STR(decode(CMD_QR_CODE_SET, qrAck, sizeof(qrAck)), "result=QR code set OK;");
+    const uint8_t qrNak[] = {CMD_QR_CODE_SET, 0xFF};
+    CHECK_STR(decode(CMD_QR_CODE_SET, qrNak, sizeof(qrNak)), "result=QR code set FAILED;");
+    // failed != NULL bez ACK bajta -> FAILED
+    CHECK_STR(decode(CMD_QR_CODE_SET, qrNak, 1), "result=QR code set FAILED;");
+
+    const uint8_t pwdAck[] = {CMD_SET_PASSWORD, COMMAND_ACK};
+    CHECK_STR(decode(CMD_SET_PASSWORD, pwdAck, sizeof(pwdAck)), "result=Password set OK;");
+    const uint8_t pwdNak[] = {CMD_SET_PASSWORD, 0x15};
+    CHECK_STR(decode(CMD_SET_PASSWORD, pwdNak, sizeof(pwdNak)), "result=Password set FAILED;");
+
+    const uint8_t sysNak[] = {CMD_SET_SYSID, 0x15};
+    CHECK_STR(decode(CMD_SET_SYSID, sysNak, sizeof(sysNak)), "result=System ID set FAILED;");
+
+    // Echo SET_GUEST_IN_TEMP nema ACK - failed je NULL
+    const uint8_t echo[] = {CMD_SET_GUEST_IN_TEMP, 12, 22};
+    CHECK_STR(decode(CMD_SET_GUEST_IN_TEMP, echo, sizeof(echo)), "result=Temperature set OK;");
+
+    const uint8_t pwdReadNak[] = {CMD_GET_PASSWORD, 0x15};
+    CHECK_STR(decode(CMD_GET_PASSWORD, pwdReadNak, sizeof(pwdReadNak)), "error=Password read FAILED (NAK);");
+}
+
+static void testDecodeFormat() {
+    const uint8_t wrongCode[] = {CMD_OPEN_DOOR};
+    CHECK_STR(decode(CMD_SET_THST_ON, wrongCode, sizeof(wrongCode)), "raw");
+    CHECK_STR(decode(CMD_SET_THST_ON, wrongCode, 0), "raw");
+
+    const uint8_t shortSysid[] = {CMD_GET_SYSID, 0x12};
+    CHECK_STR(decode(CMD_GET_SYSID, shortSysid, sizeof(shortSysid)), "error=Invalid response length (expected 3, got 2);");
+
+    const uint8_t sysid[] = {CMD_GET_SYSID, 0x12, 0x34};
+    CHECK_STR(decode(CMD_GET_SYSID, sysid, sizeof(sysid)), "system_id=4660;system_id_hex=0x1234;");
+
+    const uint8_t band[] = {CMD_GET_FAN_BAND, 2, 5};
+    CHECK_STR(decode(CMD_GET_FAN_BAND, band, sizeof(band)), "fan_low_band=2;fan_high_band=5;");
+
+    const uint8_t fwd[] = {CMD_SET_FWD_HEATING, 1};
+    CHECK_STR(decode(CMD_SET_FWD_HEATING, fwd, sizeof(fwd)), "result=Forward heating flag set;value=true;");
+
+    const uint8_t pins[] = {CMD_SET_PIN, CMD_GET_PINS, 0xA5};
+    CHECK_STR(decode(CMD_GET_PINS, pins, sizeof(pins)), "pin_states=10100101;");
+    const uint8_t pinSet[] = {CMD_SET_PIN};
+    CHECK_STR(decode(CMD_SET_PIN, pinSet, sizeof(pinSet)), "result=Pin set OK;");
+
+    const uint8_t status[] = {CMD_GET_ROOM_STATUS, 1};
+    CHECK_STR(decode(CMD_GET_ROOM_STATUS, status, sizeof(status)), "room_status=GUEST_IN;card_inserted=true;");
+
+    // rs485_scene.c šalje samo temperature - prošireno stanje termostata je null
+    const uint8_t temp[] = {CMD_GET_ROOM_TEMP, 21, 23};
+    std::string t = decode(CMD_GET_ROOM_TEMP, temp, sizeof(temp));
+    CHECK(t.find("room_temperature=21;setpoint_temperature=23;fan_speed=null;") == 0);
+
+    const uint8_t staff[] = {CMD_GET_PASSWORD, COMMAND_ACK, 0x01, 0x02, 0x03};
+    CHECK_STR(decode(CMD_GET_PASSWORD, staff, sizeof(staff)), "user_type=staff;password=66051;");
+    const uint8_t odd[] = {CMD_GET_PASSWORD, COMMAND_ACK, 0x01};
+    CHECK_STR(decode(CMD_GET_PASSWORD, odd, sizeof(odd)), "error=Unexpected response format (length=3);");
+
+    const uint8_t qr[] = {'X', 'Y', 'Z'};
+    CHECK_STR(decode(CMD_QR_CODE_GET, qr, sizeof(qr)), "qr_code=XYZ;");
+}
+
+int main() {
+    testGenericEncoder();
+    testRangeErrors();
+    testMissingParams();
+    testPasswordEncoder();
+    testPinEncoders();
+    testQrEncoder();
+    testDecodeResultAndNak();
+    testDecodeFormat();
+
+    printf("%d checks, %d failed\n", checks, failures);
+    return failures ? 1 : 0;
+}
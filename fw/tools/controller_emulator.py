@@ -0,0 +1,241 @@
+# ----------------------------------------------------------------------
+#  IC KONTROLER EMULATOR - TinyFrame preko RS485 (USB adapter)
+# ----------------------------------------------------------------------
+#  Emulira jedan ili više sobnih kontrolera na RS485 busu kako bi se bridge
+#  mogao testirati bez hardvera: odgovara na S_CUSTOM upite i šalje S_STATE
+#  notifikacije (kartica, setpoint, pinovi).
+#
+#  Upotreba:
+#    pip install pyserial
+#    python controller_emulator.py --port /dev/ttyUSB0 --ids 10,11 --auto 15
+#
+#  Komande na stdin:
+#    card <id> in|out       - kartica ubačena / izvađena
+#    setpoint <id> <temp>   - promjena setpointa na termostatu
+#    pin <id> <mask>        - nova bitmaska izlaza (npr. 0x05)
+#    show                   - ispiši stanje svih kontrolera
+# ----------------------------------------------------------------------
+import argparse
+import random
+import struct
+import sys
+import threading
+import time
+
+import serial
+
+# --- TINYFRAME KONFIGURACIJA (mora odgovarati fw/include/TF_Config.h) ---
+TF_SOF_BYTE = 0x01
+TF_ID_PEERBIT = 0x80   # Bridge je TF_MASTER; kontroleri šalju ID-eve bez peer bita
+
+# --- TIPOVI PORUKA (fw/src/main.cpp) ---
+S_CUSTOM = 23
+S_STATE = 41
+
+STATE_EVT_CARD = 0x01
+STATE_EVT_SETPOINT = 0x02
+STATE_EVT_PINS = 0x03
+
+# --- RS485 KOMANDE (common.h) ---
+CMD_GET_ROOM_STATUS = 0x94
+CMD_GET_ROOM_TEMP = 0xAC
+CMD_SET_PIN = 0xB1
+CMD_GET_PINS = 0xB2
+CMD_SET_ROOM_TEMP = 0xD6
+CMD_GET_SYSID = 0xEA
+CMD_GET_VERSION = 0xF1
+DEF_TFBRA = 255
+ACK = 0x06
+
+
+def crc16(data):
+    """CRC-16/ARC (poly 0x8005 reflektovan, init 0) - isto kao crc16_table u TinyFrame.c"""
+    crc = 0
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+
+def compose(frame_id, msg_type, payload):
+    head = struct.pack('>BBHB', TF_SOF_BYTE, frame_id, len(payload), msg_type)
+    frame = head + struct.pack('>H', crc16(head))
+    if payload:
+        frame += bytes(payload) + struct.pack('>H', crc16(payload))
+    return frame
+
+
+class FrameParser:
+    """Minimalni TinyFrame parser: SOF, ID(1), LEN(2), TYPE(1), HCRC(2), DATA, DCRC(2)"""
+
+    def __init__(self):
+        self.buf = bytearray()
+
+    def feed(self, data):
+        self.buf += data
+        frames = []
+        while True:
+            start = self.buf.find(bytes([TF_SOF_BYTE]))
+            if start < 0:
+                self.buf.clear()
+                break
+            del self.buf[:start]
+            if len(self.buf) < 7:
+                break
+            frame_id, length, msg_type = struct.unpack('>BHB', self.buf[1:5])
+            if struct.unpack('>H', self.buf[5:7])[0] != crc16(self.buf[:5]):
+                del self.buf[0]  # Lažni SOF - traži dalje
+                continue
+            total = 7 + (length + 2 if length else 0)
+            if len(self.buf) < total:
+                break
+            payload = bytes(self.buf[7:7 + length])
+            if length and struct.unpack('>H', self.buf[7 + length:total])[0] != crc16(payload):
+                print(f"[RX] CRC greška u podacima (ID 0x{frame_id:02X})")
+            else:
+                frames.append((frame_id, msg_type, payload))
+            del self.buf[:total]
+        return frames
+
+
+class Controller:
+    def __init__(self, addr):
+        self.addr = addr
+        self.card_in = False
+        self.room_temp = 22
+        self.setpoint = 23
+        self.pins = 0x00
+        self.sysid = 0xA5DC
+
+    def handle(self, data):
+        """Vraća odgovor na S_CUSTOM upit ili None ako kontroler ne odgovara"""
+        cmd = data[0]
+        if cmd == CMD_GET_ROOM_STATUS:
+            return [cmd, 1 if self.card_in else 0]
+        if cmd == CMD_GET_ROOM_TEMP:
+            # [CMD][room][sp][fan][mode][sp_max][sp_min][fan_mode][fwd_h][fwd_c][en_h][en_c]
+            return [cmd, self.room_temp, self.setpoint, 1, 0, 30, 16, 0, 0, 0, 1, 1]
+        if cmd == CMD_SET_PIN and len(data) >= 3 and data[2] == CMD_GET_PINS:
+            return [CMD_SET_PIN, CMD_GET_PINS, self.pins]
+        if cmd == CMD_SET_PIN and len(data) >= 5:
+            pin, value = data[3], data[4]
+            self.pins = (self.pins | (1 << (pin - 1))) if value else (self.pins & ~(1 << (pin - 1)))
+            return [cmd, ACK]
+        if cmd == CMD_SET_ROOM_TEMP and len(data) >= 3:
+            self.setpoint = data[2]
+            return [cmd, ACK]
+        if cmd == CMD_GET_SYSID:
+            return [cmd, self.sysid >> 8, self.sysid & 0xFF]
+        if cmd == CMD_GET_VERSION:
+            versions = [0x01000000, 0x01020003, 0x01000000, 0x01020002, 0]
+            return [cmd] + list(b''.join(struct.pack('>I', v) for v in versions))
+        return [cmd, ACK]
+
+
+class Emulator:
+    def __init__(self, port, baud, ids):
+        self.ser = serial.Serial(port, baud, timeout=0.01)
+        self.parser = FrameParser()
+        self.controllers = {i: Controller(i) for i in ids}
+        self.next_id = 0
+        self.tx_lock = threading.Lock()
+        self.pending = {}  # frame_id -> opis S_STATE poruke koja čeka ACK
+
+    def write(self, frame):
+        with self.tx_lock:
+            self.ser.write(frame)
+            self.ser.flush()
+
+    def push_state(self, addr, evt, value):
+        frame_id = self.next_id & 0x7F
+        self.next_id += 1
+        self.pending[frame_id] = (addr, evt, value, time.time())
+        self.write(compose(frame_id, S_STATE, [addr, evt, value]))
+        print(f"[TX] S_STATE ID {addr} evt 0x{evt:02X} value {value}")
+
+    def run_rx(self):
+        while True:
+            data = self.ser.read(256)
+            if not data:
+                self.check_pending()
+                continue
+            for frame_id, msg_type, payload in self.parser.feed(data):
+                self.dispatch(frame_id, msg_type, payload)
+
+    def dispatch(self, frame_id, msg_type, payload):
+        if msg_type == S_STATE and frame_id in self.pending:
+            addr, evt, _, _ = self.pending.pop(frame_id)
+            print(f"[RX] S_STATE ACK ID {addr} evt 0x{evt:02X}")
+            return
+        if msg_type != S_CUSTOM or len(payload) < 2:
+            return
+        addr = payload[1]
+        if addr == DEF_TFBRA:
+            return  # Broadcast (RTC) - bez odgovora
+        ctrl = self.controllers.get(addr)
+        if ctrl is None:
+            return  # Nije naš kontroler - šuti kao pravi uređaj
+        reply = ctrl.handle(payload)
+        print(f"[RX] CMD 0x{payload[0]:02X} ID {addr} -> {bytes(reply).hex(' ')}")
+        self.write(compose(frame_id, S_CUSTOM, reply))  # Odgovor zadržava ID upita
+
+    def check_pending(self):
+        now = time.time()
+        for frame_id, (addr, evt, value, sent) in list(self.pending.items()):
+            if now - sent > 0.5:
+                print(f"[TX] S_STATE bez ACK-a (ID {addr} evt 0x{evt:02X}) - ponavljam")
+                del self.pending[frame_id]
+                self.push_state(addr, evt, value)
+
+    def run_auto(self, period):
+        while True:
+            time.sleep(period)
+            ctrl = random.choice(list(self.controllers.values()))
+            ctrl.card_in = not ctrl.card_in
+            self.push_state(ctrl.addr, STATE_EVT_CARD, 1 if ctrl.card_in else 0)
+
+    def run_console(self):
+        for line in sys.stdin:
+            parts = line.split()
+            if not parts:
+                continue
+            try:
+                if parts[0] == 'show':
+                    for c in self.controllers.values():
+                        print(f"ID {c.addr}: card={'IN' if c.card_in else 'OUT'} sp={c.setpoint} pins=0x{c.pins:02X}")
+                    continue
+                ctrl = self.controllers[int(parts[1])]
+                if parts[0] == 'card':
+                    ctrl.card_in = parts[2] == 'in'
+                    self.push_state(ctrl.addr, STATE_EVT_CARD, 1 if ctrl.card_in else 0)
+                elif parts[0] == 'setpoint':
+                    ctrl.setpoint = int(parts[2])
+                    self.push_state(ctrl.addr, STATE_EVT_SETPOINT, ctrl.setpoint)
+                elif parts[0] == 'pin':
+                    ctrl.pins = int(parts[2], 0) & 0xFF
+                    self.push_state(ctrl.addr, STATE_EVT_PINS, ctrl.pins)
+                else:
+                    print("Nepoznata komanda")
+            except (IndexError, KeyError, ValueError):
+                print("Neispravna komanda ili nepoznat ID")
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Emulator IC kontrolera na RS485 busu")
+    ap.add_argument('--port', required=True, help="Serijski port RS485 adaptera")
+    ap.add_argument('--baud', type=int, default=115200)
+    ap.add_argument('--ids', default='10', help="Adrese kontrolera, npr. 10,11,12")
+    ap.add_argument('--auto', type=float, default=0, help="Period (s) nasumičnih promjena kartice, 0 = isključeno")
+    args = ap.parse_args()
+
+    emu = Emulator(args.port, args.baud, [int(i) for i in args.ids.split(',')])
+    threading.Thread(target=emu.run_rx, daemon=True).start()
+    if args.auto > 0:
+        threading.Thread(target=emu.run_auto, args=(args.auto,), daemon=True).start()
+    print(f"Emulator na {args.port}, kontroleri: {sorted(emu.controllers)}")
+    emu.run_console()
+
+
+if __name__ == '__main__':
+    main()